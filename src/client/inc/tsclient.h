@@ -124,6 +124,8 @@ typedef struct SParsedDataColInfo {
   int8_t         orderStatus;  // bound columns
 } SParsedDataColInfo;
 
+#define TSC_MAX_FLOWCTRL_WAIT 10000  // ms a submit msg waits in total for the admission by the vnode
+
 #define IS_DATA_COL_ORDERED(spd) ((spd->orderStatus) == (int8_t)ORDER_STATUS_ORDERED)
 
 typedef struct {
@@ -392,6 +394,7 @@ typedef struct SSqlObj {
 
   int64_t          squeryLock;
   int32_t          retryReason;  // previous error code
+  int32_t          flowCtrlWait; // ms waited for the admission of the submit msg by the vnode
   struct SSqlObj  *prev, *next;
   int64_t          self;
 } SSqlObj;
@@ -443,6 +446,8 @@ void tscReleaseClusterInfo(const char *clusterId);
 int tsParseSql(SSqlObj *pSql, bool initial);
 
 void tscProcessMsgFromServer(SRpcMsg *rpcMsg, SRpcEpSet *pEpSet);
+// ms to wait before resending the submit msg rejected by the admission control of the vnode, -1 to give up
+int32_t tscGetFlowCtrlRetryAfter(SSqlObj *pSql, SRpcMsg *rpcMsg);
 int  tscBuildAndSendRequest(SSqlObj *pSql, SQueryInfo* pQueryInfo);
 
 int  tscRenewTableMeta(SSqlObj *pSql);
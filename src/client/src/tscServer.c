@@ -39,6 +39,7 @@ void tscSaveSubscriptionProgress(void* sub);
 static int32_t extractSTableQueryVgroupId(STableMetaInfo* pTableMetaInfo);
 
 static int32_t minMsgSize() { return tsRpcHeadSize + 100; }
+
 static int32_t getWaitingTimeInterval(int32_t count) {
   int32_t initial = 100; // 100 ms by default
   if (count <= 1) {
@@ -403,6 +404,56 @@ bool shouldRewTableMeta(SSqlObj* pSql, SRpcMsg* rpcMsg) {
   return true;
 }
 
+static void tscResendFlowCtrlMsg(void *param, void *tmrId) {
+  int64_t  rid = (int64_t)param;
+  SSqlObj *pSql = (SSqlObj *)taosAcquireRef(tscObjRef, rid);
+  if (pSql == NULL) return;
+
+  int32_t code = tscSendMsgToServer(pSql);
+  if (code != TSDB_CODE_SUCCESS) {
+    pSql->res.code = code;
+    tscAsyncResultOnError(pSql);
+  }
+
+  taosReleaseRef(tscObjRef, rid);
+}
+
+/**
+ * The response of a submit msg rejected by the admission control of the vnode hints the time to resend it after.
+ * Return -1 if the response has no hint, or the waits of the msg would add up to more than TSC_MAX_FLOWCTRL_WAIT.
+ */
+int32_t tscGetFlowCtrlRetryAfter(SSqlObj *pSql, SRpcMsg *rpcMsg) {
+  if (rpcMsg->pCont == NULL || rpcMsg->contLen < (int32_t)(sizeof(SShellSubmitRspMsg) + sizeof(SShellSubmitRspExt))) {
+    return -1;
+  }
+
+  SShellSubmitRspMsg *pRsp = rpcMsg->pCont;
+  if (!pRsp->extend) return -1;
+
+  SShellSubmitRspExt *pExt = POINTER_SHIFT(pRsp, sizeof(SShellSubmitRspMsg));
+  int32_t             retryAfter = htonl(pExt->retryAfter);
+
+  if (pSql->flowCtrlWait + retryAfter > TSC_MAX_FLOWCTRL_WAIT) {
+    tscWarn("0x%" PRIx64 " submit msg is rejected by flow control, give up after waiting %d ms", pSql->self,
+            pSql->flowCtrlWait);
+    return -1;
+  }
+
+  pSql->flowCtrlWait += retryAfter;
+  tscDebug("0x%" PRIx64 " submit msg is rejected by flow control, resend after %d ms, waited:%d ms", pSql->self,
+           retryAfter, pSql->flowCtrlWait);
+  return retryAfter;
+}
+
+// resend the submit msg rejected by the admission control of the vnode after the time it hints
+static bool tscRetryFlowCtrlMsg(SSqlObj *pSql, SRpcMsg *rpcMsg) {
+  int32_t retryAfter = tscGetFlowCtrlRetryAfter(pSql, rpcMsg);
+  if (retryAfter < 0) return false;
+
+  taosTmrStart(tscResendFlowCtrlMsg, retryAfter, (void *)pSql->self, tscTmr);
+  return true;
+}
+
 void tscProcessMsgFromServer(SRpcMsg *rpcMsg, SRpcEpSet *pEpSet) {
   TSDB_CACHE_PTR_TYPE handle = (TSDB_CACHE_PTR_TYPE) rpcMsg->ahandle;
   SSqlObj* pSql = (SSqlObj*)taosAcquireRef(tscObjRef, handle);
@@ -455,6 +506,12 @@ void tscProcessMsgFromServer(SRpcMsg *rpcMsg, SRpcEpSet *pEpSet) {
     pSql->cmd.insertParam.schemaAttached = 1;
   }
 
+  if (cmd == TSDB_SQL_INSERT && rpcMsg->code == TSDB_CODE_VND_IS_FLOWCTRL && tscRetryFlowCtrlMsg(pSql, rpcMsg)) {
+    taosReleaseRef(tscObjRef, handle);
+    rpcFreeCont(rpcMsg->pCont);
+    return;
+  }
+
   bool renewTableMeta = shouldRewTableMeta(pSql, rpcMsg);
  if (renewTableMeta) {
     pSql->retry += 1;
@@ -493,6 +550,7 @@ void tscProcessMsgFromServer(SRpcMsg *rpcMsg, SRpcEpSet *pEpSet) {
   if (pRes->code == TSDB_CODE_SUCCESS) {
     tscDebug("0x%"PRIx64" reset retry counter to be 0 due to success rsp, old:%d", pSql->self, pSql->retry);
     pSql->retry = 0;
+    pSql->flowCtrlWait = 0;
   }
 
   if (pRes->code != TSDB_CODE_TSC_QUERY_CANCELLED) {
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "os.h"
+#include "taoserror.h"
+#include "tsclient.h"
+
+namespace {
+// the response of a submit msg rejected by the vnode, with the retry-after hint if extend is set
+SRpcMsg rejectRsp(std::vector<char> &buf, int32_t retryAfter, bool extend = true) {
+  buf.assign(sizeof(SShellSubmitRspMsg) + (extend ? sizeof(SShellSubmitRspExt) : 0), 0);
+
+  SShellSubmitRspMsg *pRsp = (SShellSubmitRspMsg *)buf.data();
+  pRsp->extend = extend ? 1 : 0;
+  pRsp->code = htonl(TSDB_CODE_VND_IS_FLOWCTRL);
+  if (extend) {
+    SShellSubmitRspExt *pExt = (SShellSubmitRspExt *)POINTER_SHIFT(pRsp, sizeof(SShellSubmitRspMsg));
+    pExt->retryAfter = htonl(retryAfter);
+  }
+
+  SRpcMsg rpcMsg = {0};
+  rpcMsg.code = TSDB_CODE_VND_IS_FLOWCTRL;
+  rpcMsg.pCont = buf.data();
+  rpcMsg.contLen = (int32_t)buf.size();
+  return rpcMsg;
+}
+}  // namespace
+
+TEST(FlowCtrlTest, resendAfterHint) {
+  SSqlObj *         pSql = (SSqlObj *)calloc(1, sizeof(SSqlObj));
+  std::vector<char> buf;
+
+  SRpcMsg rpcMsg = rejectRsp(buf, 300);
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), 300);
+  ASSERT_EQ(pSql->flowCtrlWait, 300);
+
+  rpcMsg = rejectRsp(buf, 20);
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), 20);
+  ASSERT_EQ(pSql->flowCtrlWait, 320);
+
+  free(pSql);
+}
+
+TEST(FlowCtrlTest, giveUpAfterMaxWait) {
+  SSqlObj *         pSql = (SSqlObj *)calloc(1, sizeof(SSqlObj));
+  std::vector<char> buf;
+  SRpcMsg           rpcMsg = rejectRsp(buf, 2000);
+
+  // resent until the waits add up to TSC_MAX_FLOWCTRL_WAIT
+  for (int i = 0; i < TSC_MAX_FLOWCTRL_WAIT / 2000; i++) {
+    ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), 2000);
+  }
+  ASSERT_EQ(pSql->flowCtrlWait, TSC_MAX_FLOWCTRL_WAIT);
+
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), -1);
+  ASSERT_EQ(pSql->flowCtrlWait, TSC_MAX_FLOWCTRL_WAIT);
+
+  // a hint beyond the wait left
+  pSql->flowCtrlWait = TSC_MAX_FLOWCTRL_WAIT - 100;
+  rpcMsg = rejectRsp(buf, 101);
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), -1);
+  rpcMsg = rejectRsp(buf, 100);
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), 100);
+
+  free(pSql);
+}
+
+TEST(FlowCtrlTest, noHintNoResend) {
+  SSqlObj *         pSql = (SSqlObj *)calloc(1, sizeof(SSqlObj));
+  std::vector<char> buf;
+
+  // the response of an older vnode
+  SRpcMsg rpcMsg = rejectRsp(buf, 0, false);
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), -1);
+
+  // extend set but the hint cut off
+  rpcMsg = rejectRsp(buf, 100);
+  rpcMsg.contLen -= 1;
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), -1);
+
+  rpcMsg.pCont = NULL;
+  rpcMsg.contLen = 0;
+  ASSERT_EQ(tscGetFlowCtrlRetryAfter(pSql, &rpcMsg), -1);
+  ASSERT_EQ(pSql->flowCtrlWait, 0);
+
+  free(pSql);
+}
@@ -330,11 +330,15 @@ typedef struct SDataCol {
   int             len;        // column data length
   VarDataOffsetT *dataOff;    // For binary and nchar data, the offset in the data column
   void *          pData;      // Actual data pointer
+  uint8_t *       codes;      // For dictionary encoded binary and nchar data read from file, the code of each row
   TSKEY           ts;         // only used in last NULL column
 } SDataCol;
 
 #define isAllRowsNull(pCol) ((pCol)->len == 0)
-static FORCE_INLINE void dataColReset(SDataCol *pDataCol) { pDataCol->len = 0; }
+static FORCE_INLINE void dataColReset(SDataCol *pDataCol) {
+  pDataCol->len = 0;
+  pDataCol->codes = NULL;
+}
 
 int tdAllocMemForCol(SDataCol *pCol, int maxPoints);
 
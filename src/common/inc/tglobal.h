@@ -56,6 +56,7 @@ extern int32_t  tsShellActivityTimer;
 extern uint32_t tsMaxTmrCtrl;
 extern float    tsNumOfThreadsPerCore;
 extern int32_t  tsNumOfCommitThreads;
+extern int32_t  tsNumOfApplyThreads;
 extern float    tsRatioOfQueryCores;
 extern int8_t   tsDaylight;
 extern char     tsTimezone[];
@@ -105,8 +106,13 @@ extern int32_t tsMaxRowsInFileBlock;
 extern int16_t tsCommitTime;  // seconds
 extern int32_t tsTimePrecision;
 extern int8_t  tsCompression;
+extern int32_t tsZstdLevel;
+extern char    tsBloomColumns[];
 extern int8_t  tsWAL;
 extern int32_t tsFsyncPeriod;
+extern int8_t  tsWalFsyncThread;
+extern int8_t  tsWalCompression;
+extern int8_t  tsWalRestorePipeline;
 extern int32_t tsReplications;
 extern int16_t tsPartitons;
 extern int32_t tsQuorum;
@@ -117,6 +123,13 @@ extern int8_t  tsCacheLastRow;
 extern bool    tsdbForceKeepFile;
 extern bool    tsdbForceCompactFile;
 extern int32_t tsdbWalFlushSize;
+extern int32_t tsTsdbBlkCacheSize;
+extern int32_t tsTsdbReadAheadBlocks;
+extern int32_t tsTsdbReadCoalesceGap;
+extern int32_t tsTsdbAutoCompactInterval;
+extern int32_t tsTsdbAutoCompactRatio;
+extern int32_t tsTsdbCompactSpeed;
+extern int32_t tsTsdbMaxTagIndexes;
 
 // balance
 extern int8_t  tsEnableBalance;
@@ -126,6 +139,7 @@ extern int32_t tsOfflineInterval;
 extern int32_t tsOfflineThreshold;
 extern int32_t tsMnodeEqualVnodeNum;
 extern int8_t  tsEnableFlowCtrl;
+extern int32_t tsFlowCtrlMaxDelay;
 extern int8_t  tsEnableSlaveQuery;
 extern int8_t  tsEnableAdjustMaster;
 
@@ -26,7 +26,7 @@ static void tdMergeTwoDataCols(SDataCols *target, SDataCols *src1, int *iter1, i
 int tdAllocMemForCol(SDataCol *pCol, int maxPoints) {
   int spaceNeeded = pCol->bytes * maxPoints;
   if(IS_VAR_DATA_TYPE(pCol->type)) {
-    spaceNeeded += sizeof(VarDataOffsetT) * maxPoints;
+    spaceNeeded += (sizeof(VarDataOffsetT) + sizeof(uint8_t)) * maxPoints;
   }
   if(pCol->spaceSize < spaceNeeded) {
     void* ptr = realloc(pCol->pData, spaceNeeded);
@@ -368,6 +368,7 @@ SDataCols *tdNewDataCols(int maxCols, int maxRows) {
       pCols->cols[i].len = 0;
       pCols->cols[i].pData = NULL;
       pCols->cols[i].dataOff = NULL;
+      pCols->cols[i].codes = NULL;
     }
   }
 
@@ -385,6 +386,7 @@ int tdInitDataCols(SDataCols *pCols, STSchema *pSchema) {
     for(i = oldMaxCols; i < pCols->maxCols; i++) {
       pCols->cols[i].pData = NULL;
       pCols->cols[i].dataOff = NULL;
+      pCols->cols[i].codes = NULL;
       pCols->cols[i].spaceSize = 0;
     }
   }
@@ -60,6 +60,7 @@ int32_t tsMaxConnections = 5000;
 int32_t tsShellActivityTimer = 3;  // second
 float   tsNumOfThreadsPerCore = 1.0f;
 int32_t tsNumOfCommitThreads = 4;
+int32_t tsNumOfApplyThreads = 0;  // threads helping to insert big submit msgs and to commit, 0 means no help
 float   tsRatioOfQueryCores = 1.0f;
 int8_t  tsDaylight = 0;
 char    tsTimezone[TSDB_TIMEZONE_LEN] = {0};
@@ -144,8 +145,13 @@ int32_t tsMaxRowsInFileBlock = TSDB_DEFAULT_MAX_ROW_FBLOCK;
 int16_t tsCommitTime = TSDB_DEFAULT_COMMIT_TIME;  // seconds
 int32_t tsTimePrecision = TSDB_DEFAULT_PRECISION;
 int8_t  tsCompression = TSDB_DEFAULT_COMP_LEVEL;
+int32_t tsZstdLevel = TSDB_DEFAULT_ZSTD_LEVEL;  // level of the second stage zstd compression, comp 3
+char    tsBloomColumns[64] = "";  // "binary|nchar" means block bloom filters are built for all binary and nchar columns
 int8_t  tsWAL = TSDB_DEFAULT_WAL_LEVEL;
 int32_t tsFsyncPeriod = TSDB_DEFAULT_FSYNC_PERIOD;
+int8_t  tsWalFsyncThread = 1;  // responses of durable writes are sent by the wal fsync thread of the disk
+int8_t  tsWalCompression = 0;  // compression of the wal record bodies, 0: none, 1: lz4, 2: zstd
+int8_t  tsWalRestorePipeline = 1;  // wal files are read and checked by another thread while restoring
 int32_t tsReplications = TSDB_DEFAULT_DB_REPLICA_OPTION;
 int32_t tsQuorum = TSDB_DEFAULT_DB_QUORUM_OPTION;
 int16_t tsPartitons = TSDB_DEFAULT_DB_PARTITON_OPTION;
@@ -162,6 +168,13 @@ int32_t tsTsdbMetaCompactRatio = TSDB_META_COMPACT_RATIO;
 bool    tsdbForceKeepFile = false;
 bool    tsdbForceCompactFile = false;                    // compact TSDB fileset forcibly
 int32_t tsdbWalFlushSize = TSDB_DEFAULT_WAL_FLUSH_SIZE;  // MB
+int32_t tsTsdbBlkCacheSize = 0;                          // MB, 0 means disabled
+int32_t tsTsdbReadAheadBlocks = 4;                       // data blocks read ahead by a query, 0 means disabled
+int32_t tsTsdbReadCoalesceGap = 16384;                   // columns closer than this are fetched by one read, none if -1
+int32_t tsTsdbAutoCompactInterval = 3600;                // seconds between the checks of auto compaction, 0 means disabled
+int32_t tsTsdbAutoCompactRatio = 33;                     // fragmentation percent of a fileset to compact it automatically
+int32_t tsTsdbCompactSpeed = 64;                         // MB/s written by auto compaction, 0 means no limit
+int32_t tsTsdbMaxTagIndexes = 4;                         // inverted tag indexes of a super table, 0 means disabled
 
 // balance
 int8_t  tsEnableBalance = 1;
@@ -171,6 +184,7 @@ int32_t tsOfflineInterval = 3;            // seconds
 int32_t tsOfflineThreshold = 86400 * 10;  // seconds of 10 days
 int32_t tsMnodeEqualVnodeNum = 4;
 int8_t  tsEnableFlowCtrl = 1;
+int32_t tsFlowCtrlMaxDelay = 100;  // ms, the longest delay of a submit msg by the write pressure, 0 means disabled
 int8_t  tsEnableSlaveQuery = 1;
 int8_t  tsEnableAdjustMaster = 1;
 
@@ -567,6 +581,16 @@ static void doInitGlobalConfig(void) {
   cfg.unitType = TAOS_CFG_UTYPE_NONE;
   taosInitConfigOption(cfg);
 
+  cfg.option = "numOfApplyThreads";
+  cfg.ptr = &tsNumOfApplyThreads;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG;
+  cfg.minValue = 0;
+  cfg.maxValue = 64;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
   cfg.option = "ratioOfQueryCores";
   cfg.ptr = &tsRatioOfQueryCores;
   cfg.valType = TAOS_CFG_VTYPE_FLOAT;
@@ -970,6 +994,26 @@ static void doInitGlobalConfig(void) {
   cfg.unitType = TAOS_CFG_UTYPE_NONE;
   taosInitConfigOption(cfg);
 
+  cfg.option = "zstdLevel";
+  cfg.ptr = &tsZstdLevel;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_ZSTD_LEVEL;
+  cfg.maxValue = TSDB_MAX_ZSTD_LEVEL;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "bloomColumns";
+  cfg.ptr = tsBloomColumns;
+  cfg.valType = TAOS_CFG_VTYPE_STRING;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 0;
+  cfg.ptrLength = tListLen(tsBloomColumns);
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
   cfg.option = "walLevel";
   cfg.ptr = &tsWAL;
   cfg.valType = TAOS_CFG_VTYPE_INT8;
@@ -990,6 +1034,36 @@ static void doInitGlobalConfig(void) {
   cfg.unitType = TAOS_CFG_UTYPE_NONE;
   taosInitConfigOption(cfg);
 
+  cfg.option = "walCompression";
+  cfg.ptr = &tsWalCompression;
+  cfg.valType = TAOS_CFG_VTYPE_INT8;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 2;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "walRestorePipeline";
+  cfg.ptr = &tsWalRestorePipeline;
+  cfg.valType = TAOS_CFG_VTYPE_INT8;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 1;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "walFsyncThread";
+  cfg.ptr = &tsWalFsyncThread;
+  cfg.valType = TAOS_CFG_VTYPE_INT8;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 1;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
   cfg.option = "replica";
   cfg.ptr = &tsReplications;
   cfg.valType = TAOS_CFG_VTYPE_INT32;
@@ -1234,6 +1308,16 @@ static void doInitGlobalConfig(void) {
   cfg.unitType = TAOS_CFG_UTYPE_NONE;
   taosInitConfigOption(cfg);
 
+  cfg.option = "flowCtrlMaxDelay";
+  cfg.ptr = &tsFlowCtrlMaxDelay;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 1000;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_MS;
+  taosInitConfigOption(cfg);
+
   cfg.option = "slaveQuery";
   cfg.ptr = &tsEnableSlaveQuery;
   cfg.valType = TAOS_CFG_VTYPE_INT8;
@@ -1647,6 +1731,78 @@ static void doInitGlobalConfig(void) {
   cfg.unitType = TAOS_CFG_UTYPE_NONE;
   taosInitConfigOption(cfg);
 
+  // dnode-wide cache of decompressed data blocks shared by all vnodes
+  cfg.option = "tsdbBlkCacheSize";
+  cfg.ptr = &tsTsdbBlkCacheSize;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 65536;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_MB;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "tsdbReadAheadBlocks";
+  cfg.ptr = &tsTsdbReadAheadBlocks;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 256;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  // the bytes between two columns of a block read through rather than seeking over, -1 reads each column alone
+  cfg.option = "tsdbReadCoalesceGap";
+  cfg.ptr = &tsTsdbReadCoalesceGap;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = -1;
+  cfg.maxValue = 16 * 1024 * 1024;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_BYTE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "tsdbAutoCompactInterval";
+  cfg.ptr = &tsTsdbAutoCompactInterval;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 86400 * 7;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_SECOND;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "tsdbAutoCompactRatio";
+  cfg.ptr = &tsTsdbAutoCompactRatio;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 1;
+  cfg.maxValue = 100;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_PERCENT;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "tsdbCompactSpeed";
+  cfg.ptr = &tsTsdbCompactSpeed;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 65536;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_MB;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "tsdbMaxTagIndexes";
+  cfg.ptr = &tsTsdbMaxTagIndexes;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 64;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
   cfg.option = "tsdbMetaCompactRatio";
   cfg.ptr = &tsTsdbMetaCompactRatio;
   cfg.valType = TAOS_CFG_VTYPE_INT32;
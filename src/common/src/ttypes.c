@@ -17,6 +17,7 @@
 #include "ttype.h"
 #include "ttokendef.h"
 #include "tscompression.h"
+#include "hashfunc.h"
 
 const int32_t TYPE_BYTES[16] = {
     -1,                      // TSDB_DATA_TYPE_NULL
@@ -328,44 +329,118 @@ static void getStatics_d(const void *pData, int32_t numOfRow, int64_t *min, int6
   SET_DOUBLE_PTR(min, &dmin);
 }
 
-static void getStatics_bin(const void *pData, int32_t numOfRow, int64_t *min, int64_t *max,
-                         int64_t *sum, int16_t *minIndex, int16_t *maxIndex, int16_t *numOfNull) {
-  const char* data = pData;
-  ASSERT(numOfRow <= INT16_MAX);
-  
-  for (int32_t i = 0; i < numOfRow; ++i) {
-    if (isNull(data, TSDB_DATA_TYPE_BINARY)) {
-      (*numOfNull) += 1;
+/**
+ * The first TSDB_VAR_PREFIX_BYTES bytes of a binary, or of a nchar encoded in UTF-8, padded with zero. UTF-8 keeps
+ * the order of the code points, so the prefixes compare by memcmp in the same order as the strings, and a string
+ * out of [prefix(min), prefix(max)] can not be in the block.
+ */
+void getVarDataPrefix(int32_t type, const void *pVal, int32_t len, void *prefix) {
+  uint8_t *dst = prefix;
+
+  memset(dst, 0, TSDB_VAR_PREFIX_BYTES);
+  if (type != TSDB_DATA_TYPE_NCHAR) {
+    memcpy(dst, pVal, MIN(len, TSDB_VAR_PREFIX_BYTES));
+    return;
+  }
+
+  int32_t n = 0;
+  for (int32_t i = 0; i + TSDB_NCHAR_SIZE <= len && n < TSDB_VAR_PREFIX_BYTES; i += TSDB_NCHAR_SIZE) {
+    uint32_t c;
+    uint8_t  buf[4];
+    int32_t  nbytes;
+
+    memcpy(&c, (const char *)pVal + i, TSDB_NCHAR_SIZE);
+    if (c < 0x80) {
+      buf[0] = (uint8_t)c;
+      nbytes = 1;
+    } else if (c < 0x800) {
+      buf[0] = (uint8_t)(0xC0 | (c >> 6));
+      buf[1] = (uint8_t)(0x80 | (c & 0x3F));
+      nbytes = 2;
+    } else if (c < 0x10000) {
+      buf[0] = (uint8_t)(0xE0 | (c >> 12));
+      buf[1] = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+      buf[2] = (uint8_t)(0x80 | (c & 0x3F));
+      nbytes = 3;
+    } else {
+      buf[0] = (uint8_t)(0xF0 | ((c >> 18) & 0x07));
+      buf[1] = (uint8_t)(0x80 | ((c >> 12) & 0x3F));
+      buf[2] = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+      buf[3] = (uint8_t)(0x80 | (c & 0x3F));
+      nbytes = 4;
+    }
+
+    for (int32_t j = 0; j < nbytes && n < TSDB_VAR_PREFIX_BYTES; ++j) {
+      dst[n++] = buf[j];
     }
-    
-    data += varDataTLen(data);
   }
-  
+}
+
+/*
+ * min/max keep the prefixes of the min/max strings and sum keeps the number of distinct values estimated by linear
+ * counting, which is at least 1 if any value is not NULL. Blocks written before have 0 in sum.
+ */
+static void getStatics_var(int32_t type, const void *pData, int32_t numOfRow, int64_t *min, int64_t *max,
+                           int64_t *sum, int16_t *minIndex, int16_t *maxIndex, int16_t *numOfNull) {
+  const char* data = pData;
+  uint8_t     bits[TSDB_VAR_NDV_BITS / 8] = {0};
+  int32_t     numOfSetBits = 0;
+  int32_t     numOfValues = 0;
+  char        prefix[TSDB_VAR_PREFIX_BYTES];
+  ASSERT(numOfRow <= INT16_MAX);
+
   *sum = 0;
   *max = 0;
   *min = 0;
   *minIndex = 0;
   *maxIndex = 0;
-}
 
-static void getStatics_nchr(const void *pData, int32_t numOfRow, int64_t *min, int64_t *max,
-                           int64_t *sum, int16_t *minIndex, int16_t *maxIndex, int16_t *numOfNull) {
-  const char* data = pData;
-  ASSERT(numOfRow <= INT16_MAX);
-  
   for (int32_t i = 0; i < numOfRow; ++i) {
-    if (isNull(data, TSDB_DATA_TYPE_NCHAR)) {
+    if (isNull(data, type)) {
       (*numOfNull) += 1;
+      data += varDataTLen(data);
+      continue;
     }
-    
+
+    getVarDataPrefix(type, varDataVal(data), varDataLen(data), prefix);
+    if (numOfValues == 0 || memcmp(prefix, min, TSDB_VAR_PREFIX_BYTES) < 0) {
+      memcpy(min, prefix, TSDB_VAR_PREFIX_BYTES);
+      *minIndex = i;
+    }
+    if (numOfValues == 0 || memcmp(prefix, max, TSDB_VAR_PREFIX_BYTES) > 0) {
+      memcpy(max, prefix, TSDB_VAR_PREFIX_BYTES);
+      *maxIndex = i;
+    }
+
+    uint32_t h = MurmurHash3_32(varDataVal(data), varDataLen(data)) & (TSDB_VAR_NDV_BITS - 1);
+    if ((bits[h >> 3] & (1 << (h & 7))) == 0) {
+      bits[h >> 3] |= (1 << (h & 7));
+      numOfSetBits++;
+    }
+
+    numOfValues++;
     data += varDataTLen(data);
   }
-  
-  *sum = 0;
-  *max = 0;
-  *min = 0;
-  *minIndex = 0;
-  *maxIndex = 0;
+
+  if (numOfValues > 0) {
+    if (numOfSetBits == TSDB_VAR_NDV_BITS) {
+      *sum = numOfValues;
+    } else {
+      double  est = -TSDB_VAR_NDV_BITS * log((TSDB_VAR_NDV_BITS - numOfSetBits) / (double)TSDB_VAR_NDV_BITS);
+      int64_t ndv = MAX((int64_t)(est + 0.5), 1);
+      *sum = MIN(ndv, numOfValues);
+    }
+  }
+}
+
+static void getStatics_bin(const void *pData, int32_t numOfRow, int64_t *min, int64_t *max,
+                         int64_t *sum, int16_t *minIndex, int16_t *maxIndex, int16_t *numOfNull) {
+  getStatics_var(TSDB_DATA_TYPE_BINARY, pData, numOfRow, min, max, sum, minIndex, maxIndex, numOfNull);
+}
+
+static void getStatics_nchr(const void *pData, int32_t numOfRow, int64_t *min, int64_t *max,
+                           int64_t *sum, int16_t *minIndex, int16_t *maxIndex, int16_t *numOfNull) {
+  getStatics_var(TSDB_DATA_TYPE_NCHAR, pData, numOfRow, min, max, sum, minIndex, maxIndex, numOfNull);
 }
 
 tDataTypeDescriptor tDataTypes[16] = {
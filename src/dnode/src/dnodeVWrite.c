@@ -20,10 +20,12 @@
 #include "tthread.h"
 
 typedef struct {
-  taos_qall qall;
-  taos_qset qset;      // queue set
-  int32_t   workerId;  // worker ID
-  pthread_t thread;    // thread
+  taos_qall    qall;
+  taos_qset    qset;       // queue set
+  int32_t      workerId;   // worker ID
+  int32_t      maxWrites;  // size of pWrites
+  SVWriteMsg **pWrites;    // msgs read in one round
+  pthread_t    thread;     // thread
 } SVWriteWorker;
 
 typedef struct {
@@ -33,6 +35,13 @@ typedef struct {
   pthread_mutex_t mutex;
 } SVWriteWorkerPool;
 
+// msgs of a round waiting for the wal fsync to be responded
+typedef struct {
+  void *      pVnode;
+  int32_t     numOfMsgs;
+  SVWriteMsg *pWrites[];
+} SVWriteBatch;
+
 static SVWriteWorkerPool tsVWriteWP;
 static void *dnodeProcessVWriteQueue(void *pWorker);
 
@@ -65,6 +74,7 @@ void dnodeCleanupVWrite() {
       taosFreeQall(pWorker->qall);
       taosCloseQset(pWorker->qset);
     }
+    tfree(pWorker->pWrites);
   }
 
   pthread_mutex_destroy(&tsVWriteWP.mutex);
@@ -103,6 +113,8 @@ void dnodeDispatchToVWriteQueue(SRpcMsg *pRpcMsg) {
   }
 
   vnodeRelease(pVnode);
+
+  // pCont is taken and set to NULL if the msg is queued, then it is freed with the write msg
   rpcFreeCont(pRpcMsg->pCont);
 }
 
@@ -235,6 +247,55 @@ void dnodeSendRpcVWriteRsp(void *pVnode, void *wparam, int32_t code) {
   }  
 }
 
+static void dnodeRespondVWrite(void *pVnode, SVWriteMsg *pWrite) {
+  if (pWrite->qtype == TAOS_QTYPE_RPC) {
+    dnodeSendRpcVWriteRsp(pVnode, pWrite, pWrite->code);
+  } else {
+    if (pWrite->qtype == TAOS_QTYPE_FWD) {
+      vnodeConfirmForward(pVnode, pWrite->pHead->version, pWrite->code, pWrite->pHead->msgType != TSDB_MSG_TYPE_SUBMIT);
+    }
+    if (pWrite->rspRet.rsp) {
+      rpcFreeCont(pWrite->rspRet.rsp);
+    }
+    vnodeFreeFromWQueue(pVnode, pWrite);
+  }
+}
+
+static void dnodeOnVWritesSynced(void *param, int32_t code) {
+  SVWriteBatch *pBatch = param;
+
+  for (int32_t i = 0; i < pBatch->numOfMsgs; ++i) {
+    SVWriteMsg *pWrite = pBatch->pWrites[i];
+    if (code != 0 && pWrite->code == 0) pWrite->code = code;
+    dnodeRespondVWrite(pBatch->pVnode, pWrite);
+  }
+
+  tfree(pBatch);
+}
+
+static bool dnodeRespondVWritesAfterFsync(void *pVnode, taos_qall qall, int32_t numOfMsgs, bool forceFsync) {
+  SVWriteBatch *pBatch = tmalloc(sizeof(SVWriteBatch) + sizeof(SVWriteMsg *) * numOfMsgs);
+  if (pBatch == NULL) return false;
+
+  SVWriteMsg *pWrite;
+  int32_t     qtype;
+
+  pBatch->pVnode = pVnode;
+  pBatch->numOfMsgs = numOfMsgs;
+  taosResetQitems(qall);
+  for (int32_t i = 0; i < numOfMsgs; ++i) {
+    taosGetQitem(qall, &qtype, (void **)&pWrite);
+    pBatch->pWrites[i] = pWrite;
+  }
+
+  if (!walFsyncAsync(vnodeGetWal(pVnode), forceFsync, dnodeOnVWritesSynced, pBatch)) {
+    tfree(pBatch);
+    return false;
+  }
+
+  return true;
+}
+
 static void *dnodeProcessVWriteQueue(void *wparam) {
   SVWriteWorker *pWorker = wparam;
   SVWriteMsg *   pWrite;
@@ -254,36 +315,52 @@ static void *dnodeProcessVWriteQueue(void *wparam) {
       break;
     }
 
+    if (numOfMsgs > pWorker->maxWrites) {
+      int32_t      maxWrites = MAX(numOfMsgs, pWorker->maxWrites * 2);
+      SVWriteMsg **pWrites = realloc(pWorker->pWrites, sizeof(SVWriteMsg *) * maxWrites);
+      if (pWrites != NULL) {
+        pWorker->pWrites = pWrites;
+        pWorker->maxWrites = maxWrites;
+      }
+    }
+
     bool forceFsync = false;
+    if (numOfMsgs <= pWorker->maxWrites) {
+      for (int32_t i = 0; i < numOfMsgs; ++i) {
+        taosGetQitem(pWorker->qall, &qtype, (void **)&pWrite);
+        dTrace("msg:%p, app:%p type:%s will be processed in vwrite queue, qtype:%s hver:%" PRIu64, pWrite,
+               pWrite->rpcMsg.ahandle, taosMsg[pWrite->pHead->msgType], qtypeStr[qtype], pWrite->pHead->version);
+        pWorker->pWrites[i] = pWrite;
+      }
+
+      // the msgs are written into WAL together
+      vnodeProcessWriteBatch(pVnode, pWorker->pWrites, numOfMsgs);
+    } else {
+      for (int32_t i = 0; i < numOfMsgs; ++i) {
+        taosGetQitem(pWorker->qall, &qtype, (void **)&pWrite);
+        pWrite->code = vnodeProcessWrite(pVnode, pWrite->pHead, qtype, pWrite);
+      }
+    }
+
+    taosResetQitems(pWorker->qall);
     for (int32_t i = 0; i < numOfMsgs; ++i) {
       taosGetQitem(pWorker->qall, &qtype, (void **)&pWrite);
-      dTrace("msg:%p, app:%p type:%s will be processed in vwrite queue, qtype:%s hver:%" PRIu64, pWrite,
-             pWrite->rpcMsg.ahandle, taosMsg[pWrite->walHead.msgType], qtypeStr[qtype], pWrite->walHead.version);
-
-      pWrite->code = vnodeProcessWrite(pVnode, &pWrite->walHead, qtype, pWrite);
       if (pWrite->code <= 0) atomic_add_fetch_32(&pWrite->processedCount, 1);
       if (pWrite->code > 0) pWrite->code = 0;
-      if (pWrite->code == 0 && pWrite->walHead.msgType != TSDB_MSG_TYPE_SUBMIT) forceFsync = true;
+      if (pWrite->code == 0 && pWrite->pHead->msgType != TSDB_MSG_TYPE_SUBMIT) forceFsync = true;
 
       dTrace("msg:%p is processed in vwrite queue, code:0x%x", pWrite, pWrite->code);
     }
 
-    walFsync(vnodeGetWal(pVnode), forceFsync);
+    // the responses are sent after fsync by the wal fsync thread, or here
+    if (!dnodeRespondVWritesAfterFsync(pVnode, pWorker->qall, numOfMsgs, forceFsync)) {
+      walFsync(vnodeGetWal(pVnode), forceFsync);
 
-    // browse all items, and process them one by one
-    taosResetQitems(pWorker->qall);
-    for (int32_t i = 0; i < numOfMsgs; ++i) {
-      taosGetQitem(pWorker->qall, &qtype, (void **)&pWrite);
-      if (qtype == TAOS_QTYPE_RPC) {
-        dnodeSendRpcVWriteRsp(pVnode, pWrite, pWrite->code);
-      } else {
-        if (qtype == TAOS_QTYPE_FWD) {
-          vnodeConfirmForward(pVnode, pWrite->walHead.version, pWrite->code, pWrite->walHead.msgType != TSDB_MSG_TYPE_SUBMIT);
-        }
-        if (pWrite->rspRet.rsp) {
-          rpcFreeCont(pWrite->rspRet.rsp);
-        }
-        vnodeFreeFromWQueue(pVnode, pWrite);
+      // browse all items, and process them one by one
+      taosResetQitems(pWorker->qall);
+      for (int32_t i = 0; i < numOfMsgs; ++i) {
+        taosGetQitem(pWorker->qall, &qtype, (void **)&pWrite);
+        dnodeRespondVWrite(pVnode, pWrite);
       }
     }
   }
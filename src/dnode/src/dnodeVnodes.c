@@ -22,12 +22,18 @@
 #include "dnodeVnodes.h"
 
 typedef struct {
-  pthread_t thread;
-  int32_t   threadIndex;
-  int32_t   failed;
-  int32_t   opened;
-  int32_t   vnodeNum;
-  int32_t * vnodeList;
+  int32_t vgId;
+  int64_t walSize;
+} SOpenVnodeItem;
+
+typedef struct {
+  pthread_t        thread;
+  int32_t          threadIndex;
+  int32_t          failed;
+  int32_t          opened;
+  int32_t          vnodeNum;
+  int32_t *        pNext;  // next item to open, shared by all threads
+  SOpenVnodeItem * vnodeList;
 } SOpenVnodeThread;
 
 extern bool     dnodeExit;
@@ -90,30 +96,44 @@ static void *dnodeOpenVnode(void *param) {
   SOpenVnodeThread *pThread = param;
   char stepDesc[TSDB_STEP_DESC_LEN] = {0};
 
-  dDebug("thread:%d, start to open %d vnodes", pThread->threadIndex, pThread->vnodeNum);
+  dDebug("thread:%d, start to open vnodes", pThread->threadIndex);
   setThreadName("dnodeOpenVnode");
 
-  for (int32_t v = 0; v < pThread->vnodeNum; ++v) {
-    int32_t vgId = pThread->vnodeList[v];
-    snprintf(stepDesc, TSDB_STEP_DESC_LEN, "vgId:%d, start to restore, %d of %d have been opened", vgId, tsOpenVnodes, tsTotalVnodes);
+  // the vnodes are taken one by one, so a thread restoring a large wal does not hold up others
+  while (1) {
+    int32_t v = atomic_fetch_add_32(pThread->pNext, 1);
+    if (v >= pThread->vnodeNum) break;
+
+    int32_t vgId = pThread->vnodeList[v].vgId;
+    snprintf(stepDesc, TSDB_STEP_DESC_LEN, "vgId:%d, start to restore, %d of %d have been opened", vgId, tsOpenVnodes,
+             tsTotalVnodes);
     dnodeReportStep("open-vnodes", stepDesc, 0);
 
+    int64_t st = taosGetTimestampMs();
     if (vnodeOpen(vgId) < 0) {
       dError("vgId:%d, failed to open vnode by thread:%d", vgId, pThread->threadIndex);
       pThread->failed++;
     } else {
-      dDebug("vgId:%d, is opened by thread:%d", vgId, pThread->threadIndex);
+      dDebug("vgId:%d, is opened by thread:%d, wal size:%" PRId64 " elapsed:%" PRId64 "ms", vgId, pThread->threadIndex,
+             pThread->vnodeList[v].walSize, taosGetTimestampMs() - st);
       pThread->opened++;
     }
 
     atomic_add_fetch_32(&tsOpenVnodes, 1);
   }
 
-  dDebug("thread:%d, total vnodes:%d, opened:%d failed:%d", pThread->threadIndex, pThread->vnodeNum, pThread->opened,
-         pThread->failed);
+  dDebug("thread:%d, opened:%d failed:%d", pThread->threadIndex, pThread->opened, pThread->failed);
   return NULL;
 }
 
+static int32_t dnodeCompareOpenVnodeItem(const void *p1, const void *p2) {
+  const SOpenVnodeItem *pItem1 = p1;
+  const SOpenVnodeItem *pItem2 = p2;
+
+  if (pItem1->walSize == pItem2->walSize) return 0;
+  return pItem1->walSize > pItem2->walSize ? -1 : 1;
+}
+
 int32_t dnodeInitVnodes() {
   int32_t vnodeList[TSDB_MAX_VNODES] = {0};
   int32_t numOfVnodes = 0;
@@ -125,36 +145,33 @@ int32_t dnodeInitVnodes() {
     return status;
   }
 
-  int32_t threadNum = tsNumOfCores;
-  int32_t vnodesPerThread = numOfVnodes / threadNum + 1;
-  SOpenVnodeThread *threads = calloc(threadNum, sizeof(SOpenVnodeThread));
+  int32_t threadNum = MIN(tsNumOfCores, numOfVnodes);
+  threadNum = MAX(threadNum, 1);
+  int32_t next = 0;
 
-  if (threads == NULL) {
+  SOpenVnodeItem *  items = calloc(numOfVnodes + 1, sizeof(SOpenVnodeItem));
+  SOpenVnodeThread *threads = calloc(threadNum, sizeof(SOpenVnodeThread));
+  if (items == NULL || threads == NULL) {
+    free(items);
+    free(threads);
     return TSDB_CODE_DND_OUT_OF_MEMORY;
   }
 
-  for (int32_t t = 0; t < threadNum; ++t) {
-    threads[t].threadIndex = t;
-    threads[t].vnodeList = calloc(vnodesPerThread, sizeof(int32_t));
-
-    if (threads[t].vnodeList == NULL) {
-      dError("vnodeList allocation failed");
-      status = TSDB_CODE_DND_OUT_OF_MEMORY;
-      goto DNODE_INIT_VNODES_OUT;
-    }
-  }
-
+  // the vnodes with the largest wals to replay are opened first
   for (int32_t v = 0; v < numOfVnodes; ++v) {
-    int32_t t = v % threadNum;
-    SOpenVnodeThread *pThread = &threads[t];
-    pThread->vnodeList[pThread->vnodeNum++] = vnodeList[v];
+    items[v].vgId = vnodeList[v];
+    items[v].walSize = vnodeGetWalSize(vnodeList[v]);
   }
+  qsort(items, numOfVnodes, sizeof(SOpenVnodeItem), dnodeCompareOpenVnodeItem);
 
   dInfo("start %d threads to open %d vnodes", threadNum, numOfVnodes);
 
   for (int32_t t = 0; t < threadNum; ++t) {
     SOpenVnodeThread *pThread = &threads[t];
-    if (pThread->vnodeNum == 0) continue;
+    pThread->threadIndex = t;
+    pThread->vnodeNum = numOfVnodes;
+    pThread->vnodeList = items;
+    pThread->pNext = &next;
 
     pthread_attr_t thAttr;
     pthread_attr_init(&thAttr);
@@ -170,13 +187,16 @@ int32_t dnodeInitVnodes() {
   int32_t failedVnodes = 0;
   for (int32_t t = 0; t < threadNum; ++t) {
     SOpenVnodeThread *pThread = &threads[t];
-    if (pThread->vnodeNum > 0 && taosCheckPthreadValid(pThread->thread)) {
+    if (taosCheckPthreadValid(pThread->thread)) {
       pthread_join(pThread->thread, NULL);
     }
     openVnodes += pThread->opened;
     failedVnodes += pThread->failed;
   }
 
+  // all the threads may fail to be created
+  failedVnodes += numOfVnodes - openVnodes - failedVnodes;
+
   dInfo("there are total vnodes:%d, opened:%d", numOfVnodes, openVnodes);
 
   if (failedVnodes != 0) {
@@ -184,12 +204,7 @@ int32_t dnodeInitVnodes() {
     status = TSDB_CODE_DND_VNODE_OPEN_FAILED;
   }
 
-DNODE_INIT_VNODES_OUT:
-
-  for (int32_t t = 0; t < threadNum; ++t) {
-    SOpenVnodeThread *pThread = &threads[t];
-    free(pThread->vnodeList);
-  }
+  free(items);
   free(threads);
 
   return status;
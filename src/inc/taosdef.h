@@ -329,9 +329,13 @@ do { \
 #define TSDB_DEFAULT_PRECISION          TSDB_TIME_PRECISION_MILLI
 
 #define TSDB_MIN_COMP_LEVEL             0
-#define TSDB_MAX_COMP_LEVEL             2
+#define TSDB_MAX_COMP_LEVEL             3
 #define TSDB_DEFAULT_COMP_LEVEL         2
 
+#define TSDB_MIN_ZSTD_LEVEL             1
+#define TSDB_MAX_ZSTD_LEVEL             22
+#define TSDB_DEFAULT_ZSTD_LEVEL         3
+
 #define TSDB_MIN_WAL_LEVEL              0
 #define TSDB_MAX_WAL_LEVEL              2
 #define TSDB_DEFAULT_WAL_LEVEL          1
@@ -250,8 +250,10 @@ typedef struct {
   int32_t code;   // errorcode while write data to vnode, such as not created, dropped, no space, invalid table
 } SShellSubmitRspBlock;
 
+enum { TSDB_FLOWCTRL_ACCEPT = 0, TSDB_FLOWCTRL_DELAY = 1, TSDB_FLOWCTRL_REJECT = 2 };
+
 typedef struct {
-  int8_t               extend;
+  int8_t               extend;        // SShellSubmitRspExt follows if set
   int32_t              code;          // 0-success, > 0 error code
   int32_t              numOfRows;     // number of records the client is trying to write
   int32_t              affectedRows;  // number of records actually written
@@ -260,6 +262,11 @@ typedef struct {
   SShellSubmitRspBlock failedBlocks[];
 } SShellSubmitRspMsg;
 
+// sent with TSDB_CODE_VND_IS_FLOWCTRL when a submit msg is rejected by the admission control of the vnode
+typedef struct {
+  int32_t retryAfter;  // ms to wait before resending the msg
+} SShellSubmitRspExt;
+
 typedef struct SSchema {
   uint8_t type;
   char    name[TSDB_COL_NAME_LEN];
@@ -589,6 +596,7 @@ typedef struct {
   uint8_t  replica;
   uint8_t  compact;
   uint8_t  truncate;
+  uint8_t  flowctrl;  // TSDB_FLOWCTRL_*, how the submit msgs are admitted by the master
 } SVnodeLoad;
 
 typedef struct {
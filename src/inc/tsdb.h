@@ -338,6 +338,14 @@ void tsdbRetrieveDataBlockInfo(TsdbQueryHandleT *pQueryHandle, SDataBlockInfo *p
  */
 int32_t tsdbRetrieveDataBlockStatisInfo(TsdbQueryHandleT *pQueryHandle, SDataStatis **pBlockStatis);
 
+/**
+ * Check the bloom filter of current data block for a value of the column, the content for binary/nchar.
+ *
+ * Return false only if the value is definitely not in the block. Cache blocks and blocks without bloom filter of the
+ * column always return true.
+ */
+bool tsdbBlockMayContain(TsdbQueryHandleT pQueryHandle, int16_t colId, const void *pVal, int32_t len);
+
 /**
  *
  * The query condition with primary timestamp is passed to iterator during its constructor function,
@@ -350,6 +358,14 @@ int32_t tsdbRetrieveDataBlockStatisInfo(TsdbQueryHandleT *pQueryHandle, SDataSta
  */
 SArray *tsdbRetrieveDataBlock(TsdbQueryHandleT *pQueryHandle, SArray *pColumnIdList);
 
+/**
+ * Get the dictionary codes of a binary/nchar column in the block returned by the last tsdbRetrieveDataBlock, one code
+ * per row, equal codes meaning equal values.
+ *
+ * Return NULL if the column is not dictionary encoded on disk, or the rows are not exactly those of one file block.
+ */
+const uint8_t *tsdbGetColDictCodes(TsdbQueryHandleT *pQueryHandle, int16_t colId);
+
 /**
  * Get the qualified table id for a super table according to the tag query expression.
  * @param stableid. super table sid
@@ -407,8 +423,43 @@ int64_t tsdbSkipOffset(TsdbQueryHandleT queryHandle);
  */
 void tsdbReportStat(void *repo, int64_t *totalPoints, int64_t *totalStorage, int64_t *compStorage);
 
+typedef struct {
+  int64_t capacity;  // bytes
+  int64_t used;      // bytes
+  int64_t numOfEntries;
+  int64_t hits;
+  int64_t misses;
+  int64_t evictions;
+} STsdbBlkCacheStat;
+
+/**
+ * get the statistics of the dnode-wide decompressed block cache
+ * @param pStat. the statistics to fill
+ */
+void tsdbGetBlkCacheStat(STsdbBlkCacheStat *pStat);
+
+typedef struct {
+  bool    committing;
+  int32_t usedBlocks;  // cache blocks taken from the buffer pool
+  int32_t totalBlocks;
+  int32_t commitLeft;  // ms the ongoing commit is expected to take, 0 if not committing or not known yet
+  int64_t headroom;    // bytes the memtable can take before the writes wait for the commit or the buffer pool
+  int64_t ingestRate;  // bytes/s inserted into the cache
+  int64_t commitRate;  // bytes/s of the cache written by the commits, 0 if not known yet
+} STsdbWritePressure;
+
+/**
+ * get the write pressure of the repository, which the vnode admits the submit msgs with
+ * @param pPressure. the pressure to fill
+ */
+void tsdbGetWritePressure(STsdbRepo *repo, STsdbWritePressure *pPressure);
+
 int  tsdbInitCommitQueue();
 void tsdbDestroyCommitQueue();
+int  tsdbInitApplyPool();
+void tsdbDestroyApplyPool();
+int  tsdbInitBlkCache();
+void tsdbDestroyBlkCache();
 int  tsdbSyncCommit(STsdbRepo *repo);
 void tsdbIncCommitRef(int vgId);
 void tsdbDecCommitRef(int vgId);
@@ -421,6 +472,44 @@ int tsdbSyncRecv(void *pRepo, SOCKET socketFd);
 // For TSDB Compact
 int tsdbCompact(STsdbRepo *pRepo);
 
+typedef struct {
+  int32_t fid;
+  int32_t fragmentation;    // percent the auto compaction compares with tsdbAutoCompactRatio, -1 if not checked yet
+  bool    toPurge;          // rows deleted to purge or blocks to recompress, compacted whatever the fragmentation
+  int64_t numOfBlocks;
+  int64_t numOfSubBlocks;   // blocks with sub-blocks
+  int64_t numOfMergeable;   // small blocks to merge, all but the last one of each table
+  int64_t numOfLastBlocks;  // blocks in .last file
+  int64_t numOfLoads;       // block loads of the queries since the file set is compacted
+  int64_t numOfExtraLoads;  // sub-blocks loaded besides the first one of a block
+  int64_t checkTime;        // ms, the last auto compaction check of the file set, 0 if never
+  int64_t compactTime;      // ms, the last compaction of the file set, 0 if never since the repo is open
+} STsdbFSetCompactStat;
+
+/**
+ * get the fragmentation of the file sets, measured by the last auto compaction check of each, and the block loads of
+ * the queries since
+ * @param aStat. the array of STsdbFSetCompactStat to append to, in fid order
+ */
+int tsdbGetFSetCompactStat(STsdbRepo *pRepo, SArray *aStat);
+
+// For TSDB bulk load
+/**
+ * Load sorted columnar data into new data files directly, bypassing the WAL and the memtable. The data shall be fed
+ * file set by file set in ascending fid order, all rows of a table in a file set contiguously with the keys strictly
+ * increasing. Each file set is installed atomically once the data of the next file set arrives or the handle is
+ * closed, a file set which already exists is rejected. The cached last rows of the tables are not updated.
+ * Nothing is written into the WAL, so the loaded data does not reach the replicas of the vnode, vnodeOpenBulkLoad()
+ * refuses a vnode with replicas.
+ */
+typedef struct STsdbLoadH STsdbLoadH;
+
+STsdbLoadH *tsdbOpenBulkLoad(STsdbRepo *pRepo);
+// pCols is built with the latest schema of the table
+int tsdbBulkLoadData(STsdbLoadH *pLoadh, uint64_t uid, SDataCols *pCols);
+// install the last file set unless there is an error before, or drop it if toInstall is false
+int tsdbCloseBulkLoad(STsdbLoadH *pLoadh, bool toInstall);
+
 // For TSDB delete data
 int tsdbDeleteData(STsdbRepo *pRepo, void *param);
 
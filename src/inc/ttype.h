@@ -42,6 +42,10 @@ typedef struct {
 #define varDataSetLen(v, _len) (((VarDataLenT *)(v))[0] = (VarDataLenT) (_len))
 #define IS_VAR_DATA_TYPE(t) (((t) == TSDB_DATA_TYPE_BINARY) || ((t) == TSDB_DATA_TYPE_NCHAR))
 
+// block statistics of binary/nchar columns, see getVarDataPrefix()
+#define TSDB_VAR_PREFIX_BYTES 8
+#define TSDB_VAR_NDV_BITS     4096
+
 #define varDataNetLen(v)       (htons(((VarDataLenT *)(v))[0]))
 #define varDataNetTLen(v)      (sizeof(VarDataLenT) + varDataNetLen(v))
 
@@ -284,6 +288,7 @@ void  setNullN(void *val, int32_t type, int32_t bytes, int32_t numOfElems);
 const void *getNullValue(int32_t type);
 
 void assignVal(char *val, const char *src, int32_t len, int32_t type);
+void getVarDataPrefix(int32_t type, const void *pVal, int32_t len, void *prefix);
 void tsDataSwap(void *pLeft, void *pRight, int32_t type, int32_t size, void* buf);
 void operateVal(void *dst, void *s1, void *s2, int32_t optr, int32_t type);
 void* getDataMin(int32_t type);
@@ -48,8 +48,18 @@ typedef struct {
   EWalKeep keep;         // keep the wal file when closed
 } SWalCfg;
 
+#define WAL_FSYNC_BUCKETS 16  // bucket i counts the fsyncs below (64 << i) us, the last one counts the rest
+
+typedef struct {
+  int64_t numOfReqs;    // durable write requests done by the fsync threads
+  int64_t numOfFsyncs;  // fsync or syncfs calls made for them
+  int64_t numOfSyncFs;  // syncfs calls, each one for the wals of a disk at once
+  int64_t latency[WAL_FSYNC_BUCKETS];
+} SWalFsyncStat;
+
 typedef void *  twalh;  // WAL HANDLE
 typedef int32_t FWalWrite(void *ahandle, void *pHead, int32_t qtype, void *pMsg);
+typedef void    FWalSynced(void *param, int32_t code);
 
 int32_t  walInit();
 void     walCleanUp();
@@ -61,7 +71,11 @@ int32_t  walRenew(twalh);
 void     walRemoveOneOldFile(twalh);
 void     walRemoveAllOldFiles(twalh);
 int32_t  walWrite(twalh, SWalHead *);
+int32_t  walWriteBatch(twalh, SWalHead **pHeads, int32_t num);
+int32_t  walDecompressHead(SWalHead *pHead, int32_t size);
 void     walFsync(twalh, bool forceFsync);
+bool     walFsyncAsync(twalh, bool forceFsync, FWalSynced *fp, void *param);
+void     walGetFsyncStat(SWalFsyncStat *pStat);
 int32_t  walRestore(twalh, void *pVnode, FWalWrite writeFp);
 int32_t  walGetWalFile(twalh, char *fileName, int64_t *fileId);
 uint64_t walGetVersion(twalh);
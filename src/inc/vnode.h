@@ -55,6 +55,8 @@ typedef struct {
   void *   pVnode;
   SRpcMsg  rpcMsg;
   SRspRet  rspRet;
+  void *   pCont;  // the rpc msg pHead points into, it is held by the msg instead of being copied
+  SWalHead *pHead;  // walHead, or the head in pCont
   char     reserveForSync[24];
   SWalHead walHead;
 } SVWriteMsg;
@@ -73,10 +75,14 @@ extern char *vnodeStatus[];
 int32_t vnodeCreate(SCreateVnodeMsg *pVnodeCfg);
 int32_t vnodeDrop(int32_t vgId);
 int32_t vnodeOpen(int32_t vgId);
+int64_t vnodeGetWalSize(int32_t vgId);
 int32_t vnodeAlter(void *pVnode, SCreateVnodeMsg *pVnodeCfg);
 int32_t vnodeSync(int32_t vgId);
 int32_t vnodeClose(int32_t vgId);
 int32_t vnodeCompact(int32_t vgId);
+// the vnode is held by the bulk load until it is closed, the data is loaded by tsdbBulkLoadData() of pLoadh
+int32_t vnodeOpenBulkLoad(int32_t vgId, void **ppVnode, void **ppLoadh);
+int32_t vnodeCloseBulkLoad(void *pVnode, void *pLoadh, bool toInstall);
 
 // vnodeMgmt
 int32_t vnodeInitMgmt();
@@ -93,6 +99,7 @@ void    vnodeSetAccess(SVgroupAccess *pAccess, int32_t numOfVnodes);
 int32_t vnodeWriteToWQueue(void *pVnode, void *pHead, int32_t qtype, void *pRpcMsg);
 void    vnodeFreeFromWQueue(void *pVnode, SVWriteMsg *pWrite);
 int32_t vnodeProcessWrite(void *pVnode, void *pHead, int32_t qtype, void *pRspRet);
+void    vnodeProcessWriteBatch(void *pVnode, SVWriteMsg **pWrites, int32_t num);
 
 SVnodeStatisInfo vnodeGetStatisInfo();
 
@@ -153,6 +153,7 @@ typedef struct SVgObj {
   int64_t        totalStorage;
   int64_t        compStorage;
   int64_t        pointsWritten;
+  int8_t         flowctrl;
   struct SDbObj *pDb;
   void *         idPool;
 } SVgObj;
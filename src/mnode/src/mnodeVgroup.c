@@ -51,6 +51,12 @@ char* vgroupStatus[] = {
   "updating"
 };
 
+static char* vgroupFlowCtrl[] = {
+  "accept",
+  "delay",
+  "reject"
+};
+
 int64_t        tsVgroupRid = -1;
 static void   *tsVgroupSdb = NULL;
 static int32_t tsVgUpdateSize = 0;
@@ -343,6 +349,7 @@ void mnodeUpdateVgroupStatus(SVgObj *pVgroup, SDnodeObj *pDnode, SVnodeLoad *pVl
     pVgroup->totalStorage = htobe64(pVload->totalStorage);
     pVgroup->compStorage = htobe64(pVload->compStorage);
     pVgroup->pointsWritten = htobe64(pVload->pointsWritten);
+    pVgroup->flowctrl = pVload->flowctrl;
   }
 
   if (pVload->dbCfgVersion != pVgroup->pDb->dbCfgVersion || pVload->replica != pVgroup->numOfVnodes ||
@@ -762,6 +769,12 @@ static int32_t mnodeGetVgroupMeta(STableMetaMsg *pMeta, SShowObj *pShow, void *p
   strcpy(pSchema[cols].name, "compacting");
   pSchema[cols].bytes = htons(pShow->bytes[cols]);
   cols++;
+
+  pShow->bytes[cols] = 6 + VARSTR_HEADER_SIZE;
+  pSchema[cols].type = TSDB_DATA_TYPE_BINARY;
+  strcpy(pSchema[cols].name, "flowctrl");
+  pSchema[cols].bytes = htons(pShow->bytes[cols]);
+  cols++;
   
   
   pMeta->numOfColumns = htons(cols);
@@ -848,6 +861,10 @@ static int32_t mnodeRetrieveVgroups(SShowObj *pShow, char *data, int32_t rows, v
     pWrite = data + pShow->offset[cols] * rows + pShow->bytes[cols] * numOfRows;
     *(int8_t *)pWrite = pVgroup->compact; 
     cols++;
+
+    pWrite = data + pShow->offset[cols] * rows + pShow->bytes[cols] * numOfRows;
+    STR_WITH_MAXSIZE_TO_VARSTR(pWrite, vgroupFlowCtrl[pVgroup->flowctrl % tListLen(vgroupFlowCtrl)], pShow->bytes[cols]);
+    cols++;
     mnodeDecVgroupRef(pVgroup);
     numOfRows++;
   }
@@ -229,6 +229,13 @@ extern "C" {
   #define setThreadName(name)
 #endif
 
+// The disk serves the I/O of the calling thread only when no other one needs it, or as usual again
+#if defined(SYS_ioprio_set)
+  #define setThreadIdleIo(idle) syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, (idle) ? (3 << 13) /* IOPRIO_CLASS_IDLE */ : 0)
+#else
+  #define setThreadIdleIo(idle)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
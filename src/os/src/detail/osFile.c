@@ -14,10 +14,15 @@
  */
 
 #define _DEFAULT_SOURCE
+#define _GNU_SOURCE
 #include "os.h"
 #include "tglobal.h"
 #include "tulog.h"
 
+#ifndef IOV_MAX
+  #define IOV_MAX 1024
+#endif
+
 void taosClose(FileFd fd) {
   close(fd);
   fd = FD_INITIALIZER;
@@ -124,6 +129,42 @@ int64_t taosWrite(FileFd fd, void *buf, int64_t n) {
   return n;
 }
 
+// Write the buffers of iov in order, the iov is modified if it is written partially
+int64_t taosWritev(FileFd fd, struct iovec *iov, int32_t iovcnt) {
+  int64_t total = 0;
+
+#if defined(_TD_WINDOWS_64) || defined(_TD_WINDOWS_32)
+  for (int32_t i = 0; i < iovcnt; ++i) {
+    if (taosWrite(fd, iov[i].iov_base, iov[i].iov_len) < 0) return -1;
+    total += iov[i].iov_len;
+  }
+#else
+  while (iovcnt > 0) {
+    int64_t nwritten = writev(fd, iov, MIN(iovcnt, IOV_MAX));
+    if (nwritten < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    total += nwritten;
+
+    while (iovcnt > 0 && nwritten >= (int64_t)iov->iov_len) {
+      nwritten -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+
+    if (nwritten > 0) {
+      iov->iov_base = (char *)iov->iov_base + nwritten;
+      iov->iov_len -= nwritten;
+    }
+  }
+#endif
+
+  return total;
+}
+
 int64_t taosLSeek(FileFd fd, int64_t offset, int32_t whence) { return (int64_t)lseek(fd, (long)offset, whence); }
 
 int64_t taosCopy(char *from, char *to) {
@@ -377,6 +418,13 @@ int32_t taosFsync(FileFd fd) {
   return FlushFileBuffers(h)-1;
 }
 
+int32_t taosSyncFs(FileFd fd) {
+  errno = ENOSYS;
+  return -1;
+}
+
+int32_t taosReadAhead(FileFd fd, int64_t offset, int64_t count) { return 0; }
+
 int32_t taosRename(char *oldName, char *newName) {
   int32_t code = MoveFileEx(oldName, newName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED);
   if (code < 0) {
@@ -393,6 +441,31 @@ int32_t taosRename(char *oldName, char *newName) {
 int32_t taosFtruncate(FileFd fd, int64_t length) { return ftruncate(fd, length); }
 int32_t taosFsync(FileFd fd) { return fsync(fd); }
 
+// Flush all the files of the file system holding fd, -1 with ENOSYS where the platform can not
+int32_t taosSyncFs(FileFd fd) {
+#if defined(_TD_DARWIN_64)
+  errno = ENOSYS;
+  return -1;
+#else
+  return syncfs(fd);
+#endif
+}
+
+// Ask the kernel to start reading the range into page cache asynchronously, it is only a hint
+int32_t taosReadAhead(FileFd fd, int64_t offset, int64_t count) {
+#if defined(_TD_DARWIN_64)
+  struct radvisory ra = {.ra_offset = (off_t)offset, .ra_count = (int)count};
+  return fcntl(fd, F_RDADVISE, &ra);
+#else
+  int32_t code = posix_fadvise(fd, offset, count, POSIX_FADV_WILLNEED);
+  if (code != 0) {
+    errno = code;
+    return -1;
+  }
+  return 0;
+#endif
+}
+
 int32_t taosRename(char *oldName, char *newName) {
   int32_t code = rename(oldName, newName);
   if (code < 0) {
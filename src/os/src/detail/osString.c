@@ -24,8 +24,23 @@ int64_t taosStr2int64(char *str) {
 
 #if !(defined(_TD_WINDOWS_64) || defined(_TD_WINDOWS_32))
 
+// nchar values in the column buffers are not aligned to wchar_t, which the vectorized wcsncmp of glibc relies on
 int32_t tasoUcs4Compare(void *f1_ucs4, void *f2_ucs4, int32_t bytes) {
-  return wcsncmp((wchar_t *)f1_ucs4, (wchar_t *)f2_ucs4, bytes / TSDB_NCHAR_SIZE);
+  for (int32_t i = 0; i + TSDB_NCHAR_SIZE <= bytes; i += TSDB_NCHAR_SIZE) {
+    int32_t f1, f2;
+    memcpy(&f1, (char *)f1_ucs4 + i, TSDB_NCHAR_SIZE);
+    memcpy(&f2, (char *)f2_ucs4 + i, TSDB_NCHAR_SIZE);
+
+    if (f1 != f2) {
+      return (f1 < f2) ? -1 : 1;
+    }
+
+    if (f1 == 0) {
+      return 0;
+    }
+  }
+
+  return 0;
 }
 
 #endif
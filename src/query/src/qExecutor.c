@@ -2837,14 +2837,19 @@ static void getIntermediateBufInfo(SQueryRuntimeEnv* pRuntimeEnv, int32_t* ps, i
 
 #define IS_PREFILTER_TYPE(_t) ((_t) != TSDB_DATA_TYPE_BINARY && (_t) != TSDB_DATA_TYPE_NCHAR)
 
-static FORCE_INLINE bool doFilterByBlockStatistics(SQueryRuntimeEnv* pRuntimeEnv, SDataStatis *pDataStatis, SQLFunctionCtx *pCtx, int32_t numOfRows) {
+static FORCE_INLINE bool doFilterByBlockStatistics(SQueryRuntimeEnv* pRuntimeEnv, TsdbQueryHandleT pQueryHandle, SDataStatis *pDataStatis, SQLFunctionCtx *pCtx, int32_t numOfRows) {
   SQueryAttr* pQueryAttr = pRuntimeEnv->pQueryAttr;
 
   if (pDataStatis == NULL || pQueryAttr->pFilters == NULL) {
     return true;
   }
 
-  return filterRangeExecute(pQueryAttr->pFilters, pDataStatis, pQueryAttr->numOfCols, numOfRows);
+  if (!filterRangeExecute(pQueryAttr->pFilters, pDataStatis, pQueryAttr->numOfCols, numOfRows)) {
+    return false;
+  }
+
+  // equal conditions the min/max can not exclude, check the bloom filters of the block
+  return filterBloomExecute(pQueryAttr->pFilters, tsdbBlockMayContain, pQueryHandle);
 }
 
 static bool overlapWithTimeWindow(SQueryAttr* pQueryAttr, SDataBlockInfo* pBlockInfo) {
@@ -3177,6 +3182,11 @@ FORCE_INLINE int32_t getColumnDataFromId(void *param, int32_t id, void **data) {
 }
 
 
+static int32_t getColumnDictCodesFromId(void *param, int32_t id, void **data) {
+  *data = (void *)tsdbGetColDictCodes(param, (int16_t)id);
+  return TSDB_CODE_SUCCESS;
+}
+
 int32_t loadDataBlockOnDemand(SQueryRuntimeEnv* pRuntimeEnv, STableScanInfo* pTableScanInfo, SSDataBlock* pBlock,
                               uint32_t* status) {
   *status = BLK_DATA_NO_NEEDED;
@@ -3306,7 +3316,7 @@ int32_t loadDataBlockOnDemand(SQueryRuntimeEnv* pRuntimeEnv, STableScanInfo* pTa
     }
 
     // current block has been discard due to filter applied
-    if (!doFilterByBlockStatistics(pRuntimeEnv, pBlock->pBlockStatis, pTableScanInfo->pCtx, pBlockInfo->rows)) {
+    if (!doFilterByBlockStatistics(pRuntimeEnv, pTableScanInfo->pQueryHandle, pBlock->pBlockStatis, pTableScanInfo->pCtx, pBlockInfo->rows)) {
       pCost->discardBlocks += 1;
       qDebug("QInfo:0x%"PRIx64" data block discard, brange:%" PRId64 "-%" PRId64 ", rows:%d", pQInfo->qId, pBlockInfo->window.skey,
              pBlockInfo->window.ekey, pBlockInfo->rows);
@@ -3324,6 +3334,7 @@ int32_t loadDataBlockOnDemand(SQueryRuntimeEnv* pRuntimeEnv, STableScanInfo* pTa
     if (pQueryAttr->pFilters != NULL) {
       SColumnDataParam param = {.numOfCols = pBlock->info.numOfCols, .pDataBlock = pBlock->pDataBlock};
       filterSetColFieldData(pQueryAttr->pFilters, &param, getColumnDataFromId);
+      filterSetColDictCodes(pQueryAttr->pFilters, pTableScanInfo->pQueryHandle, getColumnDictCodesFromId);
     }
 
     if (pQueryAttr->pFilters != NULL || pRuntimeEnv->pTsBuf != NULL) {
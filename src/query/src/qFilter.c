@@ -2647,6 +2647,7 @@ int32_t filterGenerateComInfo(SFilterInfo *info) {
     info->cunits[i].rfunc = filterGetRangeCompFuncFromOptrs(unit->compare.optr, unit->compare.optr2);
     info->cunits[i].optr = FILTER_UNIT_OPTR(unit);
     info->cunits[i].colData = NULL;
+    info->cunits[i].codes = NULL;
     info->cunits[i].colId = FILTER_UNIT_COL_ID(info, unit);
     
     if (unit->right.type == FLD_TYPE_VALUE) {
@@ -2676,12 +2677,87 @@ int32_t filterUpdateComUnits(SFilterInfo *info) {
     SFilterUnit *unit = &info->units[i];
 
     info->cunits[i].colData = FILTER_UNIT_COL_DATA(info, unit, 0);
+    info->cunits[i].codes = NULL;
   }
 
   return TSDB_CODE_SUCCESS;
 }
 
 
+/*
+ * Check a binary/nchar unit against the prefixes of the min/max strings of the block. Return -1 if no row matches,
+ * 1 if all rows match and 0 if unknown.
+ */
+static int32_t filterVarUnitByPrefix(SFilterComUnit *cunit, SDataStatis *pDataStatis) {
+  char  valPrefix[TSDB_VAR_PREFIX_BYTES];
+  char *minPrefix = (char *)&pDataStatis->min;
+  char *maxPrefix = (char *)&pDataStatis->max;
+  void *lower = NULL, *upper = NULL;
+
+  // blocks written before have no prefix statistics
+  if (pDataStatis->sum <= 0 || cunit->valData == NULL) {
+    return 0;
+  }
+
+  if (cunit->optr == TSDB_RELATION_IN) {
+    SHashObj *pHash = (SHashObj *)cunit->valData;
+    void *    p = taosHashIterate(pHash, NULL);
+    while (p) {
+      getVarDataPrefix(cunit->dataType, taosHashGetDataKey(pHash, p), (int32_t)taosHashGetDataKeyLen(pHash, p),
+                       valPrefix);
+      if (memcmp(valPrefix, minPrefix, TSDB_VAR_PREFIX_BYTES) >= 0 &&
+          memcmp(valPrefix, maxPrefix, TSDB_VAR_PREFIX_BYTES) <= 0) {
+        taosHashCancelIterate(pHash, p);
+        return 0;
+      }
+
+      p = taosHashIterate(pHash, p);
+    }
+
+    return -1;
+  }
+
+  switch (cunit->optr) {
+    case TSDB_RELATION_EQUAL:
+      lower = upper = cunit->valData;
+      break;
+    case TSDB_RELATION_GREATER:
+    case TSDB_RELATION_GREATER_EQUAL:
+      lower = cunit->valData;
+      // rfunc 0~3 are ranges with both bounds, the upper one in valData2
+      if (cunit->rfunc >= 0 && cunit->rfunc <= 3) {
+        upper = cunit->valData2;
+      }
+      break;
+    case TSDB_RELATION_LESS:
+    case TSDB_RELATION_LESS_EQUAL:
+      upper = cunit->valData;
+      break;
+    default:
+      return 0;
+  }
+
+  bool all = (cunit->optr != TSDB_RELATION_EQUAL) && (pDataStatis->numOfNull <= 0);
+
+  if (lower) {
+    getVarDataPrefix(cunit->dataType, varDataVal(lower), varDataLen(lower), valPrefix);
+    if (memcmp(valPrefix, maxPrefix, TSDB_VAR_PREFIX_BYTES) > 0) {
+      return -1;
+    }
+    all = all && (memcmp(valPrefix, minPrefix, TSDB_VAR_PREFIX_BYTES) < 0);
+  }
+
+  if (upper) {
+    getVarDataPrefix(cunit->dataType, varDataVal(upper), varDataLen(upper), valPrefix);
+    if (memcmp(valPrefix, minPrefix, TSDB_VAR_PREFIX_BYTES) < 0) {
+      return -1;
+    }
+    all = all && (memcmp(valPrefix, maxPrefix, TSDB_VAR_PREFIX_BYTES) > 0);
+  }
+
+  return all ? 1 : 0;
+}
+
 int32_t filterRmUnitByRange(SFilterInfo *info, SDataStatis *pDataStatis, int32_t numOfCols, int32_t numOfRows) {
   int32_t rmUnit = 0;
 
@@ -2691,7 +2767,7 @@ int32_t filterRmUnitByRange(SFilterInfo *info, SDataStatis *pDataStatis, int32_t
     int32_t index = -1;
     SFilterComUnit *cunit = &info->cunits[k];
 
-    if (FILTER_NO_MERGE_DATA_TYPE(cunit->dataType)) {
+    if (cunit->dataType == TSDB_DATA_TYPE_JSON) {
       continue;
     }
 
@@ -2732,6 +2808,16 @@ int32_t filterRmUnitByRange(SFilterInfo *info, SDataStatis *pDataStatis, int32_t
       }
     }
 
+    if (FILTER_NO_MERGE_DATA_TYPE(cunit->dataType)) {
+      int32_t res = filterVarUnitByPrefix(cunit, &pDataStatis[index]);
+      if (res != 0) {
+        info->blkUnitRes[k] = res;
+        rmUnit = 1;
+      }
+
+      continue;
+    }
+
     if (cunit->optr == TSDB_RELATION_ISNULL || cunit->optr == TSDB_RELATION_NOTNULL
      || cunit->optr == TSDB_RELATION_IN || cunit->optr == TSDB_RELATION_LIKE || cunit->optr == TSDB_RELATION_MATCH
      || cunit->optr == TSDB_RELATION_NOT_EQUAL || cunit->optr == TSDB_RELATION_CONTAINS) {
@@ -3122,14 +3208,30 @@ bool filterExecuteImplMisc(void *pinfo, int32_t numOfRows, int8_t** p, SDataStat
     *p = calloc(numOfRows, sizeof(int8_t));
   }
   
+  uint32_t uidx = info->groups[0].unitIdxs[0];
+  uint8_t *codes = info->cunits[uidx].codes;
+  int8_t   codeRes[UINT8_MAX + 1];
+
+  if (codes != NULL) {
+    memset(codeRes, -1, sizeof(codeRes));
+  }
+
   for (int32_t i = 0; i < numOfRows; ++i) {
-    uint32_t uidx = info->groups[0].unitIdxs[0];
     void *colData = (char *)info->cunits[uidx].colData + info->cunits[uidx].dataSize * i;
     if (colData == NULL || isNull(colData, info->cunits[uidx].dataType)) {
       (*p)[i] = 0;
       all = false;
       continue;
     }
+
+    // rows with the same dictionary code hold the same value, compare each distinct value only once
+    if (codes != NULL && codeRes[codes[i]] >= 0) {
+      (*p)[i] = codeRes[codes[i]];
+      if ((*p)[i] == 0) {
+        all = false;
+      }
+      continue;
+    }
     // match/nmatch for nchar type need convert from ucs4 to mbs
 
     if(info->cunits[uidx].dataType == TSDB_DATA_TYPE_NCHAR && (info->cunits[uidx].optr == TSDB_RELATION_MATCH || info->cunits[uidx].optr == TSDB_RELATION_NMATCH)){
@@ -3148,6 +3250,10 @@ bool filterExecuteImplMisc(void *pinfo, int32_t numOfRows, int8_t** p, SDataStat
       (*p)[i] = filterDoCompare(gDataCompare[info->cunits[uidx].func], info->cunits[uidx].optr, colData, info->cunits[uidx].valData);
     }
 
+    if (codes != NULL) {
+      codeRes[codes[i]] = (*p)[i];
+    }
+
     if ((*p)[i] == 0) {
       all = false;
     }
@@ -3336,6 +3442,31 @@ int32_t filterSetColFieldData(SFilterInfo *info, void *param, filer_get_col_from
   return TSDB_CODE_SUCCESS;
 }
 
+/*
+ * Set the dictionary codes of the binary/nchar columns of = and in units, after filterSetColFieldData set their data.
+ */
+int32_t filterSetColDictCodes(SFilterInfo *info, void *param, filer_get_col_from_id fp) {
+  CHK_LRET(info == NULL, TSDB_CODE_QRY_APP_ERROR, "info NULL");
+
+  if (FILTER_ALL_RES(info) || FILTER_EMPTY_RES(info)) {
+    return TSDB_CODE_SUCCESS;
+  }
+
+  for (uint32_t i = 0; i < info->unitNum; ++i) {
+    SFilterComUnit *cunit = &info->cunits[i];
+    void           *codes = NULL;
+
+    if (!IS_VAR_DATA_TYPE(cunit->dataType) || (cunit->optr != TSDB_RELATION_EQUAL && cunit->optr != TSDB_RELATION_IN)) {
+      continue;
+    }
+
+    (*fp)(param, cunit->colId, &codes);
+    cunit->codes = codes;
+  }
+
+  return TSDB_CODE_SUCCESS;
+}
+
 int32_t filterSetJsonColFieldData(SFilterInfo *info, void *param, filer_get_col_from_name fp) {
   CHK_LRET(info == NULL, TSDB_CODE_QRY_APP_ERROR, "info NULL");
   CHK_LRET(info->fields[FLD_TYPE_COLUMN].num <= 0, TSDB_CODE_QRY_APP_ERROR, "no column fileds");
@@ -3494,10 +3625,103 @@ bool filterRangeExecute(SFilterInfo *info, SDataStatis *pDataStatis, int32_t num
     CHK_RET(!ret, ret);
   }
 
+  // binary/nchar columns are not merged into colRange, check their units by the prefix statistics
+  if (ret && info->cunits != NULL) {
+    for (uint32_t g = 0; g < info->groupNum; ++g) {
+      SFilterGroup *group = &info->groups[g];
+      ret = true;
+
+      for (uint32_t u = 0; u < group->unitNum && ret; ++u) {
+        SFilterComUnit *cunit = &info->cunits[group->unitIdxs[u]];
+        if (!IS_VAR_DATA_TYPE(cunit->dataType)) {
+          continue;
+        }
+
+        for (int32_t i = 0; i < numOfCols; ++i) {
+          if (pDataStatis[i].colId == cunit->colId) {
+            ret = filterVarUnitByPrefix(cunit, &pDataStatis[i]) >= 0;
+            break;
+          }
+        }
+      }
+
+      if (ret) {
+        break;
+      }
+    }
+  }
+
   return ret;
 }
 
 
+// Check if the value of an equal/in unit may be in the block, true if the unit can not be checked
+static bool filterBloomUnitMayMatch(SFilterComUnit *cunit, filter_bloom_func func, void *param) {
+  if (cunit->valData == NULL || cunit->dataType == TSDB_DATA_TYPE_FLOAT || cunit->dataType == TSDB_DATA_TYPE_DOUBLE ||
+      cunit->dataType == TSDB_DATA_TYPE_JSON) {
+    return true;
+  }
+
+  if (cunit->optr == TSDB_RELATION_EQUAL) {
+    if (IS_VAR_DATA_TYPE(cunit->dataType)) {
+      return (*func)(param, cunit->colId, varDataVal(cunit->valData), varDataLen(cunit->valData));
+    }
+
+    return (*func)(param, cunit->colId, cunit->valData, tDataTypes[cunit->dataType].bytes);
+  }
+
+  if (cunit->optr == TSDB_RELATION_IN && IS_VAR_DATA_TYPE(cunit->dataType)) {
+    void *p = taosHashIterate((SHashObj *)cunit->valData, NULL);
+    while (p) {
+      void * key = taosHashGetDataKey((SHashObj *)cunit->valData, p);
+      size_t keyLen = taosHashGetDataKeyLen((SHashObj *)cunit->valData, p);
+
+      if ((*func)(param, cunit->colId, key, (int32_t)keyLen)) {
+        taosHashCancelIterate((SHashObj *)cunit->valData, p);
+        return true;
+      }
+
+      p = taosHashIterate((SHashObj *)cunit->valData, p);
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Check the equal/in conditions against the bloom filters of the block by func. Return false if no group of the
+ * filter can be satisfied, that is the block can be discarded.
+ */
+bool filterBloomExecute(SFilterInfo *info, filter_bloom_func func, void *param) {
+  if (FILTER_EMPTY_RES(info)) {
+    return false;
+  }
+
+  if (FILTER_ALL_RES(info) || info->cunits == NULL) {
+    return true;
+  }
+
+  for (uint32_t g = 0; g < info->groupNum; ++g) {
+    SFilterGroup *group = &info->groups[g];
+    bool          match = true;
+
+    for (uint32_t u = 0; u < group->unitNum; ++u) {
+      if (!filterBloomUnitMayMatch(&info->cunits[group->unitIdxs[u]], func, param)) {
+        match = false;
+        break;
+      }
+    }
+
+    if (match) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 
 int32_t filterGetTimeRange(SFilterInfo *info, STimeWindow       *win) {
   SFilterRange ra = {0};
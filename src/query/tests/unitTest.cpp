@@ -910,3 +910,29 @@ TEST(testCase, getTempFilePath_test) {
   printf("%s\n", path);
 }
 
+
+TEST(testCase, varDataPrefix_test) {
+  char p1[TSDB_VAR_PREFIX_BYTES], p2[TSDB_VAR_PREFIX_BYTES];
+
+  // shorter strings are smaller, bytes after the prefix are ignored
+  getVarDataPrefix(TSDB_DATA_TYPE_BINARY, "ab", 2, p1);
+  getVarDataPrefix(TSDB_DATA_TYPE_BINARY, "ab0", 3, p2);
+  EXPECT_LT(memcmp(p1, p2, TSDB_VAR_PREFIX_BYTES), 0);
+
+  getVarDataPrefix(TSDB_DATA_TYPE_BINARY, "abcdefgh1", 9, p1);
+  getVarDataPrefix(TSDB_DATA_TYPE_BINARY, "abcdefgh2", 9, p2);
+  EXPECT_EQ(memcmp(p1, p2, TSDB_VAR_PREFIX_BYTES), 0);
+
+  // nchar keeps the order of the code points, 8 ascii characters fit in the prefix
+  int32_t w1[9] = {'w', '0', '0', '0', '0', '0', '0', '1', 0x4E2D};
+  int32_t w2[9] = {'w', '0', '0', '0', '0', '0', '0', '2', 'a'};
+  getVarDataPrefix(TSDB_DATA_TYPE_NCHAR, w1, sizeof(w1), p1);
+  getVarDataPrefix(TSDB_DATA_TYPE_NCHAR, w2, sizeof(w2), p2);
+  EXPECT_LT(memcmp(p1, p2, TSDB_VAR_PREFIX_BYTES), 0);
+
+  int32_t w3[2] = {'z', 0};
+  int32_t w4[2] = {0x4E2D, 0};
+  getVarDataPrefix(TSDB_DATA_TYPE_NCHAR, w3, sizeof(int32_t), p1);
+  getVarDataPrefix(TSDB_DATA_TYPE_NCHAR, w4, sizeof(int32_t), p2);
+  EXPECT_LT(memcmp(p1, p2, TSDB_VAR_PREFIX_BYTES), 0);
+}
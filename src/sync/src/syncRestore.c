@@ -92,6 +92,12 @@ static int32_t syncRestoreWal(SSyncPeer *pPeer, uint64_t *wver) {
       break;
     }
 
+    // the records are read from the wal files of the master as they are
+    if (walDecompressHead(pHead, SYNC_MAX_SIZE) != 0) {
+      sError("%s, failed to decompress walcont, len:%d hver:%" PRIu64, pPeer->id, pHead->len, pHead->version);
+      break;
+    }
+
     sTrace("%s, restore a record, qtype:wal len:%d hver:%" PRIu64, pPeer->id, pHead->len, pHead->version);
 
     if (lastVer == pHead->version) {
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TD_TSDB_APPLY_H_
+#define _TD_TSDB_APPLY_H_
+
+/**
+ * The dnode-wide apply threads, numOfApplyThreads of them, help the write worker of a vnode to insert the blocks of a
+ * big submit msg into the memtable. The blocks are split by table, so each skip list is still written by one thread.
+ * The commits use them to merge and encode the blocks of the tables of a file set in parallel as well.
+ */
+#define TSDB_APPLY_MIN_ROWS 1024  // a submit msg with less rows is inserted by the write worker alone
+
+typedef void (*FApplyTask)(void *param, int index);
+
+int tsdbGetApplyThreads();
+int tsdbApplyInParallel(FApplyTask fp, void *param, int numOfTasks);
+
+#endif /* _TD_TSDB_APPLY_H_ */
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TD_TSDB_BLK_CACHE_H_
+#define _TD_TSDB_BLK_CACHE_H_
+
+/**
+ * Dnode-wide LRU cache of decompressed column data read from .data/.last files.
+ *
+ * Blocks in .data/.last files are never modified in place: commit and delete only append to them, while compact,
+ * retention migration and sync always write a file with a new version in its name. So (vgId, fid, ftype, file
+ * version, block offset, colId) identifies immutable column content, and entries only need to be dropped when the
+ * file itself leaves the FS or the repository is closed.
+ */
+typedef struct {
+  int32_t  vgId;
+  int32_t  fid;
+  uint32_t fver;  // version in the file name, not the file format version
+  int16_t  colId;
+  int8_t   ftype;
+  int8_t   reserved;
+  int64_t  offset;  // offset of the SBlock in the file
+} SBlkCacheKey;
+
+static FORCE_INLINE void tsdbInitBlkCacheKey(SBlkCacheKey *pKey, int vgId, int fid, TSDB_FILE_T ftype, uint32_t fver,
+                                             int64_t offset, int16_t colId) {
+  memset(pKey, 0, sizeof(*pKey));
+  pKey->vgId = vgId;
+  pKey->fid = fid;
+  pKey->fver = fver;
+  pKey->colId = colId;
+  pKey->ftype = (int8_t)ftype;
+  pKey->offset = offset;
+}
+
+bool tsdbBlkCacheEnabled();
+int  tsdbBlkCacheGet(const SBlkCacheKey *pKey, SDataCol *pDataCol, int numOfRows, int maxPoints);
+void tsdbBlkCachePut(const SBlkCacheKey *pKey, const SDataCol *pDataCol, int numOfRows);
+void tsdbBlkCacheRemoveDFile(int vgId, int fid, TSDB_FILE_T ftype, uint32_t fver);
+void tsdbBlkCacheRemoveRepo(int vgId);
+
+#endif /* _TD_TSDB_BLK_CACHE_H_ */
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TD_TSDB_BLOOM_H_
+#define _TD_TSDB_BLOOM_H_
+
+/**
+ * Per-block bloom filters of the columns whose type is listed in the bloomColumns config, used to skip blocks on
+ * equality lookups the min/max statistics can not exclude.
+ *
+ * The bloom part follows the aggregate part of a block in .smad/.smal, and such blocks are marked with
+ * TSDB_SBLK_VER_2. The filter of a column starts with TSDB_BLOOM_BITS_PER_KEY bits for each row and is folded in
+ * half while it is less than a quarter full, so a low cardinality column only takes a few bytes.
+ */
+#define TSDB_BLOOM_BITS_PER_KEY 10
+#define TSDB_BLOOM_HASHES 6
+#define TSDB_BLOOM_MIN_BITS 64
+
+typedef struct {
+  int16_t  colId;
+  int16_t  reserved;
+  uint32_t offset;     // offset of the bits from the beginning of the bloom part
+  uint32_t numOfBits;  // power of 2
+} SBlockBloomCol;
+
+typedef struct {
+  int32_t        len;  // bytes of the bloom part, including the checksum
+  int16_t        numOfCols;
+  int16_t        numOfHashes;
+  SBlockBloomCol cols[];
+} SBlockBloom;
+
+bool tsdbBloomEnabled(int8_t type);
+int  tsdbBuildBlockBloom(SDataCols *pDataCols, int rowsToWrite, void **ppBuf, int offset);
+bool tsdbBlockBloomMayContain(SBlockBloom *pBloom, int16_t colId, const void *pVal, int32_t len);
+
+#endif /* _TD_TSDB_BLOOM_H_ */
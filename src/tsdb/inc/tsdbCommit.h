@@ -41,6 +41,7 @@ int tsdbWriteBlockIdx(SDFile *pHeadf, SArray *pIdxA, void **ppBuf);
 int   tsdbWriteBlockImpl(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile *pDFileAggr, SDataCols *pDataCols,
                          SBlock *pBlock, bool isLast, bool isSuper, void **ppBuf, void **ppCBuf, void **ppExBuf);
 int   tsdbApplyRtn(STsdbRepo *pRepo);
+int   tsdbCommitTombs(STsdbRepo *pRepo, SArray *aUpd);
 
 // commit control command 
 int tsdbCommitControl(STsdbRepo* pRepo, SControlDataInfo* pCtlDataInfo);
@@ -24,6 +24,7 @@ typedef enum {
   COMMIT_CONFIG_REQ,
 } TSDB_REQ_T;
 
-int tsdbScheduleCommit(STsdbRepo *pRepo, void* param, TSDB_REQ_T req);
+int  tsdbScheduleCommit(STsdbRepo *pRepo, void* param, TSDB_REQ_T req);
+bool tsdbCommitQueueBusy();
 
 #endif /* _TD_TSDB_COMMIT_QUEUE_H_ */
\ No newline at end of file
@@ -19,7 +19,24 @@
 extern "C" {
 #endif
 
-void *tsdbCompactImpl(STsdbRepo *pRepo);
+// Block loads of the queries in a FSET since it is compacted, the read amplification of its fragmentation
+typedef struct {
+  int64_t nLoads;
+  int64_t nExtraLoads;  // sub-blocks loaded besides the first one of a block
+} STsdbFSetReadStat;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  SHashObj *      pReadStat;   // fid -> STsdbFSetReadStat
+  SHashObj *      pFSetStat;   // fid -> STsdbFSetCompactStat of the last check or compaction
+  int64_t         lastCheck;   // ms, the last time auto compaction was checked
+} STsdbCompactStat;
+
+int   tsdbInitCompactStat(STsdbCompactStat *pStat);
+void  tsdbDestroyCompactStat(STsdbCompactStat *pStat);
+void  tsdbAddFSetReadStat(STsdbRepo *pRepo, int fid, int64_t nLoads, int64_t nExtraLoads);
+bool  tsdbShouldAutoCompact(STsdbRepo *pRepo);
+void *tsdbCompactImpl(STsdbRepo *pRepo, bool autoCompact);
 
 #ifdef __cplusplus
 }
@@ -27,20 +27,63 @@ typedef struct {
   TSKEY keyLast;
 } SMergeInfo;
 
-typedef struct {
-  STable *           pTable;
-  SSkipListIterator *pIter;
-} SCommitIter;
+#define TSDB_INGEST_SAMPLE_MS 1000
 
+// Ingest and commit rates of a repo, in bytes of the cache
+typedef struct {
+  int64_t sampleTime;   // ms, the start of the current ingest sample
+  int64_t sampleBytes;  // bytes inserted since sampleTime
+  int64_t ingestRate;   // bytes/s, moving average of the samples
+  int64_t commitRate;   // bytes/s, moving average of the commits
+  int64_t commitStart;  // ms, the start of the ongoing commit
+  int64_t commitBytes;  // bytes of the memtable being committed
+} STsdbWriteStat;
+
+#define TSDB_DATA_CHUNK_MIN_ROWS 16
+#define TSDB_DATA_CHUNK_MAX_ROWS 4096
+
+// Rows of a table appended in key order, a chunk is never changed once the next one is linked
+typedef struct STableDataChunk {
+  struct STableDataChunk *prev;
+  struct STableDataChunk *next;
+  int32_t                 capacity;
+  int32_t                 nRows;
+  SMemRow                 rows[];
+} STableDataChunk;
+
+/**
+ * While the keys of a table arrive strictly increasing, the rows are appended to the chunks and the skip list is
+ * empty. The first out-of-order or duplicate key moves the rows into the skip list, which holds all rows of the table
+ * from then on.
+ */
 struct STableData {
-  uint64_t   uid;
-  TSKEY      keyFirst;
-  TSKEY      keyLast;
-  int64_t    numOfRows;
-  SSkipList* pData;
+  uint64_t         uid;
+  TSKEY            keyFirst;
+  TSKEY            keyLast;
+  int64_t          numOfRows;
+  SSkipList*       pData;
+  STableDataChunk* pFirstChunk;
+  STableDataChunk* pLastChunk;
+  int8_t           inSkipList;
+  int32_t          applyTask;  // task inserting the table while a submit msg is inserted in parallel
   T_REF_DECLARE()
 };
 
+// Iterator over either representation of a STableData, can be saved and restored by value
+typedef struct {
+  int32_t           order;
+  bool              inSkipList;
+  bool              valid;   // the chunk iterator is on a row
+  STableDataChunk*  pChunk;  // NULL if no more rows in the chunks
+  int32_t           index;
+  SSkipListIterator slIter;
+} STableDataIter;
+
+typedef struct {
+  STable *        pTable;
+  STableDataIter *pIter;
+} SCommitIter;
+
 enum { TSDB_UPDATE_META, TSDB_DROP_META };
 
 #ifdef WINDOWS
@@ -66,30 +109,33 @@ int   tsdbUnRefMemTable(STsdbRepo* pRepo, SMemTable* pMemTable);
 int   tsdbTakeMemSnapshot(STsdbRepo* pRepo, SMemSnapshot* pSnapshot, SArray* pATable);
 void  tsdbUnTakeMemSnapShot(STsdbRepo* pRepo, SMemSnapshot* pSnapshot);
 void* tsdbAllocBytes(STsdbRepo* pRepo, int bytes);
+int64_t tsdbGetMemUsedBytes(STsdbRepo* pRepo, SMemTable* pMemTable);
 // if pCtrlData is NULL, force must be true
 int   tsdbAsyncCommit(STsdbRepo* pRepo, SControlDataInfo* pCtlDataInfo);
 int   tsdbSyncCommitConfig(STsdbRepo* pRepo);
-int   tsdbLoadDataFromCache(STable* pTable, SSkipListIterator* pIter, TSKEY maxKey, int maxRowsToRead, SDataCols* pCols,
+STableDataIter* tsdbCreateTableDataIter(STableData* pTableData, int32_t order);
+STableDataIter* tsdbCreateTableDataIterFromKey(STableData* pTableData, TSKEY key, int32_t order);
+bool            tsdbTableDataIterNext(STableDataIter* pIter);
+SMemRow         tsdbTableDataIterGet(STableDataIter* pIter);
+void*           tsdbDestroyTableDataIter(STableDataIter* pIter);
+int   tsdbLoadDataFromCache(STable* pTable, STableDataIter* pIter, TSKEY maxKey, int maxRowsToRead, SDataCols* pCols,
                             TKEY* filterKeys, int nFilterKeys, bool keepDup, SMergeInfo* pMergeInfo);
 void* tsdbCommitData(STsdbRepo* pRepo, bool end);
 
-static FORCE_INLINE SMemRow tsdbNextIterRow(SSkipListIterator* pIter) {
+static FORCE_INLINE SMemRow tsdbNextIterRow(STableDataIter* pIter) {
   if (pIter == NULL) return NULL;
 
-  SSkipListNode* node = tSkipListIterGet(pIter);
-  if (node == NULL) return NULL;
-
-  return (SMemRow)SL_GET_NODE_DATA(node);
+  return tsdbTableDataIterGet(pIter);
 }
 
-static FORCE_INLINE TSKEY tsdbNextIterKey(SSkipListIterator* pIter) {
+static FORCE_INLINE TSKEY tsdbNextIterKey(STableDataIter* pIter) {
   SMemRow row = tsdbNextIterRow(pIter);
   if (row == NULL) return TSDB_DATA_TIMESTAMP_NULL;
 
   return memRowKey(row);
 }
 
-static FORCE_INLINE TKEY tsdbNextIterTKey(SSkipListIterator* pIter) {
+static FORCE_INLINE TKEY tsdbNextIterTKey(STableDataIter* pIter) {
   SMemRow row = tsdbNextIterRow(pIter);
   if (row == NULL) return TKEY_NULL;
 
@@ -26,6 +26,13 @@ typedef struct jsonMapValue{
 
 #pragma  pack (pop)
 
+// A deleted key range of a table, masked on read until the rows are purged from the data files
+typedef struct {
+  TSKEY   skey;
+  TSKEY   ekey;
+  int64_t version;  // FS version when the range was deleted
+} STableTomb;
+
 typedef struct STable {
   STableId       tableId;
   ETableType     type;
@@ -37,6 +44,7 @@ typedef struct STable {
   SKVRow         tagVal;
   SSkipList*     pIndex;         // For TSDB_SUPER_TABLE, it is the skiplist index
   SHashObj*      jsonKeyMap;     // For json tag key  {"key":[t1, t2, t3]}
+  struct STagStore* pTagStore;   // For TSDB_SUPER_TABLE not of json tag, the tags of the child tables in columns
   void*          eventHandler;   // TODO
   void*          streamHandler;  // TODO
   TSKEY          lastKey;
@@ -51,9 +59,16 @@ typedef struct STable {
   bool           hasRestoreLastColumn;
   int            lastColSVersion;
   int16_t        cacheLastConfigVersion;
+  SArray*        aTomb;  // STableTomb sorted by skey, NULL if no deleted range to mask
   T_REF_DECLARE()
 } STable;
 
+// New tombstones of a table, written in a FS transaction and set to the table when the transaction ends
+typedef struct {
+  STable* pTable;
+  SArray* aTomb;
+} STableTombUpd;
+
 typedef struct {
   pthread_rwlock_t rwLock;
 
@@ -99,6 +114,17 @@ int        tsdbUpdateLastColSchema(STable *pTable, STSchema *pNewSchema);
 STSchema*  tsdbGetTableLatestSchema(STable *pTable);
 void       tsdbFreeLastColumns(STable* pTable);
 int        tsdbCompareJsonMapValue(const void* a, const void* b);
+int        tsdbEncodeTableRecord(void** buf, STable* pTable, SArray* aTomb);
+int        tsdbEncodeTableTombs(void** buf, SArray* aTomb);
+int        tsdbGetTableTombs(STable* pTable, SArray** paTomb);
+void       tsdbSetTableTombs(STable* pTable, SArray* aTomb);
+int        tsdbAddTomb(SArray* aTomb, TSKEY skey, TSKEY ekey, int64_t txnVer);
+int        tsdbCutTombs(SArray* aTomb, TSKEY skey, TSKEY ekey);
+bool       tsdbTombsOverlap(SArray* aTomb, TSKEY skey, TSKEY ekey);
+bool       tsdbTombsCover(SArray* aTomb, TSKEY skey, TSKEY ekey);
+STableTombUpd* tsdbGetTombUpd(SArray* aUpd, STable* pTable);
+void       tsdbApplyTombUpds(SArray* aUpd);
+void       tsdbClearTombUpds(SArray* aUpd);
 void*      tsdbGetJsonTagValue(STable* pTable, char* key, int32_t keyLen, int16_t* colId);
 
 static FORCE_INLINE int tsdbCompareSchemaVersion(const void *key1, const void *key2) {
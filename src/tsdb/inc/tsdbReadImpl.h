@@ -68,7 +68,7 @@ typedef struct {
 
 /**
  * aggrStat;   // only valid when blkVer > 0. 0 - no aggr part in .data/.last/.smad/.smal, 1 - has aggr in .smad/.smal
- * blkVer;     // 0 - original block, 1 - block since importing .smad/.smal
+ * blkVer;     // 0 - original block, 1 - block since importing .smad/.smal, 2 - block with bloom part in .smad/.smal
  * aggrOffset; // only valid when blkVer > 0 and aggrStat > 0
  */
 #define SBlockFieldsP1   \
@@ -88,6 +88,7 @@ typedef struct {
 typedef enum {
   TSDB_SBLK_VER_0 = 0,
   TSDB_SBLK_VER_1,
+  TSDB_SBLK_VER_2,  // same layout as VER_1, the aggregate part in .smad/.smal is followed by the bloom part
 } ESBlockVer;
 
 #define SBlockVerLatest TSDB_SBLK_VER_1
@@ -161,6 +162,13 @@ typedef struct {
 
 typedef void SAggrBlkData;  // SBlockCol cols[];
 
+typedef struct {
+  int64_t   offset;  // file offset of the column data
+  int32_t   len;
+  SDataCol *pDataCol;
+  SBlockCol blockCol;
+} SReadColInfo;
+
 struct SReadH {
   STsdbRepo * pRepo;
   SDFileSet   rSet;     // FSET to read
@@ -175,6 +183,13 @@ struct SReadH {
   void *      pBuf;   // buffer
   void *      pCBuf;  // compression buffer
   void *      pExBuf;  // extra buffer
+  void *      pColInfo;  // SReadColInfo array of columns to load
+  bool        useBlkCache;  // set by queries, the reads of commit and compaction neither hit nor fill the block cache
+  uint32_t    dataVer;  // version in .data file name, used as block cache key
+  uint32_t    lastVer;  // version in .last file name, used as block cache key
+  void *      pBloom;       // SBlockBloom of the block at bloomOffset
+  int64_t     bloomOffset;  // offset of the loaded bloom part, negative in .smal and 0 if none
+  SArray *    aTomb;        // STableTomb masked from the loaded block data, NULL to load all rows
 };
 
 #define TSDB_READ_REPO(rh) ((rh)->pRepo)
@@ -227,6 +242,9 @@ int   tsdbLoadBlockData(SReadH *pReadh, SBlock *pBlock, SBlockInfo *pBlockInfo);
 int   tsdbLoadBlockDataCols(SReadH *pReadh, SBlock *pBlock, SBlockInfo *pBlkInfo, int16_t *colIds, int numOfColsIds);
 int   tsdbLoadBlockStatis(SReadH *pReadh, SBlock *pBlock);
 int   tsdbLoadBlockOffset(SReadH *pReadh, SBlock *pBlock);
+int   tsdbLoadBlockBloom(SReadH *pReadh, SBlock *pBlock);
+int64_t tsdbReadAheadBlock(SReadH *pReadh, SBlock *pBlock, SBlockInfo *pBlkInfo, int numOfColIds);
+int   tsdbCoalesceColReads(SReadColInfo *pCols, int nCols, int64_t maxGap, int64_t *pLen);
 int   tsdbEncodeSBlockIdx(void **buf, SBlockIdx *pIdx);
 void *tsdbDecodeSBlockIdx(void *buf, SBlockIdx *pIdx);
 void  tsdbGetBlockStatis(SReadH *pReadh, SDataStatis *pStatis, int numOfCols, SBlock *pBlock);
@@ -254,7 +272,7 @@ static FORCE_INLINE int tsdbMakeRoom(void **ppBuf, size_t size) {
 
 static FORCE_INLINE SBlockCol *tsdbGetSBlockCol(SBlock *pBlock, SBlockCol **pDestBlkCol, SBlockCol *pBlkCols,
                                                 int colIdx) {
-  if (pBlock->blkVer == SBlockVerLatest) {
+  if (pBlock->blkVer > TSDB_SBLK_VER_0) {
     *pDestBlkCol = pBlkCols + colIdx;
     return *pDestBlkCol;
   }
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TD_TSDB_TAG_STORE_H_
+#define _TD_TSDB_TAG_STORE_H_
+
+/**
+ * The tags of the child tables of a super table in columns, so that a tag condition the tag index can not serve is
+ * evaluated on all the tables by one filter pass instead of one pass per table.
+ *
+ * The tables are kept in tid order, and a column is filled on the first query on it. The store is invalidated when a
+ * child table is added, removed or has its tags changed, and built again by the next query. The tables and the columns
+ * filled are kept in a snapshot referred by the queries, so the filter runs without the mutex of the store.
+ *
+ * The tables qualified are returned in tid order by both the store and the indexes. The tables filtered one by one on
+ * the skip list come in the order of the first tag instead, so the callers do not depend on the order: a query without
+ * order by does not order its tables, and createTableGroup() sorts them when grouped by tags.
+ *
+ * A tag column queried by = or in also gets an inverted index, up to tsdbMaxTagIndexes columns of a super table. The
+ * lists of the values are combined by the AND/OR groups of the condition, then only the tables listed are filtered.
+ * Unlike the store, the indexes are kept up to date when a child table is added, removed or has its tags changed.
+ */
+typedef struct {
+  int16_t colId;
+  int8_t  type;
+  int16_t bytes;  // the width of the column in the filter, including the header of var data
+  char*   data;   // numOfTables values, a missing tag is set to NULL value
+} STagStoreCol;
+
+typedef struct {
+  int16_t   colId;
+  int8_t    type;
+  SHashObj* map;  // tag value -> SArray of STable *, sorted by tid
+} STagIndex;
+
+// Neither the tables nor a column filled change, a column missing is appended under the mutex of the store
+typedef struct {
+  T_REF_DECLARE()
+  int16_t  tversion;  // tag schema version it is built with
+  int32_t  numOfTables;
+  STable** tables;
+  SArray*  aCol;  // STagStoreCol
+} STagStoreSnap;
+
+typedef struct STagStore {
+  pthread_mutex_t mutex;   // queries build it under the read lock of meta
+  STagStoreSnap*  pSnap;   // NULL if invalidated
+  SArray*         aIndex;  // STagIndex, changed under the write lock of meta, or the mutex with the read lock
+} STagStore;
+
+int  tsdbInitTagStore(STable* pSuper);
+void tsdbFreeTagStore(STable* pSuper);
+void tsdbInvalidateTagStore(STable* pSuper);
+int  tsdbQueryTagStore(STable* pSuper, void* filterInfo, SArray* res);
+bool tsdbHasTagIndex(STable* pSuper, int16_t colId);
+void tsdbAddToTagIndexes(STable* pSuper, STable* pTable);
+void tsdbRemoveFromTagIndexes(STable* pSuper, STable* pTable);
+
+#endif /* _TD_TSDB_TAG_STORE_H_ */
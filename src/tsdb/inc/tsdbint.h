@@ -52,6 +52,8 @@ extern "C" {
 #include "tsdbLog.h"
 // Meta
 #include "tsdbMeta.h"
+// Tag store
+#include "tsdbTagStore.h"
 // Buffer
 #include "tsdbBuffer.h"
 // MemTable
@@ -62,6 +64,10 @@ extern "C" {
 #include "tsdbFS.h"
 // ReadImpl
 #include "tsdbReadImpl.h"
+// Block cache
+#include "tsdbBlkCache.h"
+// Bloom
+#include "tsdbBloom.h"
 // Commit
 #include "tsdbCommit.h"
 // Compact
@@ -70,6 +76,8 @@ extern "C" {
 #include "tsdbDelete.h"
 // Commit Queue
 #include "tsdbCommitQueue.h"
+// Apply
+#include "tsdbApply.h"
 
 #include "tsdbRowMergeBuf.h"
 // Main definitions
@@ -98,8 +106,13 @@ struct STsdbRepo {
   int32_t         code;  // Commit code
 
   SMergeBuf       mergeBuf;  //used when update=2
+  bool            parallelApply;  // the blocks of a submit msg are being inserted by the apply threads
+  pthread_mutex_t allocMutex;     // protect the buffer blocks of mem while parallelApply
+  STsdbWriteStat  writeStat;
   int8_t          compactState;  // compact state: inCompact/noCompact/waitingCompact?
   int8_t          deleteState;  // truncate state: inTruncate/noTruncate/waitingTruncate
+  int8_t          inBulkLoad;   // a bulk load handle is open
+  STsdbCompactStat compactStat;
 
   pthread_t*      pthread;
 };
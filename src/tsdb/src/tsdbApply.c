@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tsdbint.h"
+
+typedef struct {
+  FApplyTask      fp;
+  void *          param;
+  int             numOfTasks;
+  int             nextTask;
+  int             doneTasks;
+  int             numOfHelpers;  // apply threads running the tasks of the job
+  pthread_mutex_t mutex;
+  pthread_cond_t  allDone;
+} SApplyJob;
+
+typedef struct SApplyReq {
+  struct SApplyReq *next;
+  SApplyJob *       pJob;
+} SApplyReq;
+
+typedef struct {
+  bool            stop;
+  pthread_mutex_t lock;
+  pthread_cond_t  queueNotEmpty;
+  int             nthreads;
+  SApplyReq *     head;
+  SApplyReq *     tail;
+  pthread_t *     threads;
+} SApplyPool;
+
+static void *tsdbLoopApply(void *arg);
+static bool  tsdbRunApplyTask(SApplyJob *pJob);
+
+static SApplyPool tsApplyPool = {0};
+
+int tsdbInitApplyPool() {
+  SApplyPool *pPool = &tsApplyPool;
+
+  pPool->stop = false;
+  pPool->nthreads = 0;
+  pPool->head = NULL;
+  pPool->tail = NULL;
+
+  if (tsNumOfApplyThreads <= 0) return 0;
+
+  pPool->threads = (pthread_t *)calloc(tsNumOfApplyThreads, sizeof(pthread_t));
+  if (pPool->threads == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pthread_mutex_init(&(pPool->lock), NULL);
+  pthread_cond_init(&(pPool->queueNotEmpty), NULL);
+
+  for (int i = 0; i < tsNumOfApplyThreads; i++) {
+    if (pthread_create(pPool->threads + i, NULL, tsdbLoopApply, NULL) != 0) {
+      tsdbError("failed to create apply thread since %s", strerror(errno));
+      break;
+    }
+    pPool->nthreads++;
+  }
+
+  tsdbInfo("%d apply threads are launched", pPool->nthreads);
+  return 0;
+}
+
+void tsdbDestroyApplyPool() {
+  SApplyPool *pPool = &tsApplyPool;
+
+  if (pPool->threads == NULL) return;
+
+  pthread_mutex_lock(&(pPool->lock));
+  pPool->stop = true;
+  pthread_cond_broadcast(&(pPool->queueNotEmpty));
+  pthread_mutex_unlock(&(pPool->lock));
+
+  for (int i = 0; i < pPool->nthreads; i++) {
+    pthread_join(pPool->threads[i], NULL);
+  }
+
+  tfree(pPool->threads);
+  pPool->nthreads = 0;
+  pthread_cond_destroy(&(pPool->queueNotEmpty));
+  pthread_mutex_destroy(&(pPool->lock));
+}
+
+int tsdbGetApplyThreads() { return tsApplyPool.nthreads; }
+
+/**
+ * Call fp(param, index) for each index in [0, numOfTasks). The caller takes tasks too, and returns after all of them
+ * are done. Return -1 if the tasks can not be handed to the apply threads, then none of them is called.
+ */
+int tsdbApplyInParallel(FApplyTask fp, void *param, int numOfTasks) {
+  SApplyPool *pPool = &tsApplyPool;
+  SApplyJob   job = {.fp = fp, .param = param, .numOfTasks = numOfTasks};
+  int         numOfReqs = MIN(numOfTasks - 1, pPool->nthreads);
+
+  if (numOfReqs <= 0) {
+    for (int i = 0; i < numOfTasks; i++) {
+      (*fp)(param, i);
+    }
+    return 0;
+  }
+
+  SApplyReq *pReqs = (SApplyReq *)calloc(numOfReqs, sizeof(SApplyReq));
+  if (pReqs == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pthread_mutex_init(&job.mutex, NULL);
+  pthread_cond_init(&job.allDone, NULL);
+
+  // each request lets one apply thread take tasks of the job until none is left
+  pthread_mutex_lock(&(pPool->lock));
+  for (int i = 0; i < numOfReqs; i++) {
+    pReqs[i].pJob = &job;
+    if (pPool->tail == NULL) {
+      pPool->head = pReqs + i;
+    } else {
+      pPool->tail->next = pReqs + i;
+    }
+    pPool->tail = pReqs + i;
+  }
+  pthread_cond_broadcast(&(pPool->queueNotEmpty));
+  pthread_mutex_unlock(&(pPool->lock));
+
+  while (tsdbRunApplyTask(&job)) {
+  }
+
+  // take the requests not picked up yet out of the queue, then wait for the apply threads helping with the job
+  pthread_mutex_lock(&(pPool->lock));
+  SApplyReq **ppReq = &pPool->head;
+  pPool->tail = NULL;
+  while (*ppReq != NULL) {
+    if ((*ppReq)->pJob == &job) {
+      *ppReq = (*ppReq)->next;
+    } else {
+      pPool->tail = *ppReq;
+      ppReq = &(*ppReq)->next;
+    }
+  }
+  pthread_mutex_unlock(&(pPool->lock));
+
+  pthread_mutex_lock(&job.mutex);
+  while (job.doneTasks < job.numOfTasks || job.numOfHelpers > 0) {
+    pthread_cond_wait(&job.allDone, &job.mutex);
+  }
+  pthread_mutex_unlock(&job.mutex);
+
+  pthread_cond_destroy(&job.allDone);
+  pthread_mutex_destroy(&job.mutex);
+  free(pReqs);
+
+  return 0;
+}
+
+// Run the next task of the job, return false if all of them are taken
+static bool tsdbRunApplyTask(SApplyJob *pJob) {
+  int index = atomic_fetch_add_32(&pJob->nextTask, 1);
+  if (index >= pJob->numOfTasks) return false;
+
+  (*pJob->fp)(pJob->param, index);
+
+  pthread_mutex_lock(&pJob->mutex);
+  pJob->doneTasks++;
+  pthread_cond_signal(&pJob->allDone);
+  pthread_mutex_unlock(&pJob->mutex);
+
+  return true;
+}
+
+static void *tsdbLoopApply(void *arg) {
+  SApplyPool *pPool = &tsApplyPool;
+
+  setThreadName("tsdbApply");
+
+  while (true) {
+    pthread_mutex_lock(&(pPool->lock));
+    while (pPool->head == NULL && !pPool->stop) {
+      pthread_cond_wait(&(pPool->queueNotEmpty), &(pPool->lock));
+    }
+
+    if (pPool->head == NULL) {
+      pthread_mutex_unlock(&(pPool->lock));
+      break;
+    }
+
+    SApplyReq *pReq = pPool->head;
+    SApplyJob *pJob = pReq->pJob;
+    pPool->head = pReq->next;
+    if (pPool->head == NULL) pPool->tail = NULL;
+
+    pthread_mutex_lock(&pJob->mutex);
+    pJob->numOfHelpers++;
+    pthread_mutex_unlock(&pJob->mutex);
+    pthread_mutex_unlock(&(pPool->lock));
+
+    while (tsdbRunApplyTask(pJob)) {
+    }
+
+    pthread_mutex_lock(&pJob->mutex);
+    pJob->numOfHelpers--;
+    pthread_cond_signal(&pJob->allDone);
+    pthread_mutex_unlock(&pJob->mutex);
+  }
+
+  return NULL;
+}
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tsdbint.h"
+
+extern int32_t tsTsdbBlkCacheSize;
+
+typedef struct {
+  int32_t  vgId;
+  int32_t  fid;
+  uint32_t fver;
+  int8_t   ftype;
+  int8_t   reserved[3];
+} SBlkCacheFileKey;
+
+typedef struct {
+  SBlkCacheKey key;
+  SList *      pFileList;  // entries of the same file, each node holds the SListNode * of an entry in the LRU list
+  SListNode *  pFileNode;  // node of this entry in pFileList
+  int32_t      len;
+  int32_t      nCodes;  // dictionary codes stored after the column data, 0 if there are none
+  char         data[];
+} SBlkCacheEntry;
+
+typedef struct {
+  pthread_mutex_t lock;
+  bool            inited;
+  int64_t         capacity;  // bytes
+  int64_t         used;      // bytes
+  SHashObj *      map;       // SBlkCacheKey -> SListNode *
+  SHashObj *      files;     // SBlkCacheFileKey -> SList * of the entries of the file
+  SList *         lru;       // head is the least recently used entry
+  int64_t         hits;
+  int64_t         misses;
+  int64_t         evictions;
+} SBlkCache;
+
+static FORCE_INLINE void tsdbInitBlkCacheFileKey(SBlkCacheFileKey *pKey, int vgId, int fid, int8_t ftype,
+                                                 uint32_t fver) {
+  memset(pKey, 0, sizeof(*pKey));
+  pKey->vgId = vgId;
+  pKey->fid = fid;
+  pKey->fver = fver;
+  pKey->ftype = ftype;
+}
+
+#define TSDB_BLK_CACHE_ENTRY(n) ((SBlkCacheEntry *)((n)->data))
+#define TSDB_BLK_CACHE_FILE_NODE_SIZE (sizeof(SListNode) + sizeof(SListNode *))
+#define TSDB_BLK_CACHE_NODE_SIZE(len, nCodes) \
+  (sizeof(SListNode) + sizeof(SBlkCacheEntry) + (len) + (nCodes) + TSDB_BLK_CACHE_FILE_NODE_SIZE)
+
+static SBlkCache tsBlkCache = {0};
+
+static void tsdbBlkCacheRemoveNode(SBlkCache *pCache, SListNode *pNode);
+static int  tsdbBlkCacheAddToFile(SBlkCache *pCache, SListNode *pNode);
+static void tsdbBlkCacheEvict(SBlkCache *pCache, int64_t size);
+
+int tsdbInitBlkCache() {
+  SBlkCache *pCache = &tsBlkCache;
+
+  if (tsTsdbBlkCacheSize <= 0) {
+    tsdbDebug("tsdb block cache is disabled");
+    return 0;
+  }
+
+  pCache->capacity = (int64_t)tsTsdbBlkCacheSize * 1024 * 1024;
+  pCache->used = 0;
+  pCache->hits = 0;
+  pCache->misses = 0;
+  pCache->evictions = 0;
+
+  pCache->map = taosHashInit(1024, taosGetDefaultHashFunction(TSDB_DATA_TYPE_BINARY), true, HASH_NO_LOCK);
+  if (pCache->map == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pCache->files = taosHashInit(64, taosGetDefaultHashFunction(TSDB_DATA_TYPE_BINARY), true, HASH_NO_LOCK);
+  pCache->lru = tdListNew(0);
+  if (pCache->files == NULL || pCache->lru == NULL) {
+    taosHashCleanup(pCache->map);
+    taosHashCleanup(pCache->files);
+    tdListFree(pCache->lru);
+    pCache->map = NULL;
+    pCache->files = NULL;
+    pCache->lru = NULL;
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pthread_mutex_init(&(pCache->lock), NULL);
+  pCache->inited = true;
+
+  tsdbInfo("tsdb block cache is initialized, capacity:%" PRId64 " bytes", pCache->capacity);
+  return 0;
+}
+
+void tsdbDestroyBlkCache() {
+  SBlkCache *pCache = &tsBlkCache;
+
+  if (!pCache->inited) return;
+
+  pthread_mutex_lock(&(pCache->lock));
+  pCache->inited = false;
+  tsdbInfo("tsdb block cache is destroyed, hits:%" PRId64 " misses:%" PRId64 " evictions:%" PRId64, pCache->hits,
+           pCache->misses, pCache->evictions);
+  taosHashCleanup(pCache->map);
+  pCache->map = NULL;
+  SList **ppFileList = taosHashIterate(pCache->files, NULL);
+  while (ppFileList != NULL) {
+    tdListFree(*ppFileList);
+    ppFileList = taosHashIterate(pCache->files, ppFileList);
+  }
+  taosHashCleanup(pCache->files);
+  pCache->files = NULL;
+  tdListFree(pCache->lru);
+  pCache->lru = NULL;
+  pCache->used = 0;
+  pthread_mutex_unlock(&(pCache->lock));
+
+  pthread_mutex_destroy(&(pCache->lock));
+}
+
+void tsdbGetBlkCacheStat(STsdbBlkCacheStat *pStat) {
+  SBlkCache *pCache = &tsBlkCache;
+
+  memset(pStat, 0, sizeof(*pStat));
+  if (!pCache->inited) return;
+
+  pthread_mutex_lock(&(pCache->lock));
+  pStat->capacity = pCache->capacity;
+  pStat->used = pCache->used;
+  pStat->numOfEntries = listNEles(pCache->lru);
+  pStat->hits = pCache->hits;
+  pStat->misses = pCache->misses;
+  pStat->evictions = pCache->evictions;
+  pthread_mutex_unlock(&(pCache->lock));
+}
+
+bool tsdbBlkCacheEnabled() { return tsBlkCache.inited; }
+
+/**
+ * Copy the cached column data to pDataCol. Return 0 on hit and -1 on miss.
+ */
+int tsdbBlkCacheGet(const SBlkCacheKey *pKey, SDataCol *pDataCol, int numOfRows, int maxPoints) {
+  SBlkCache *pCache = &tsBlkCache;
+
+  if (!pCache->inited) return -1;
+
+  pthread_mutex_lock(&(pCache->lock));
+
+  SListNode **ppNode = taosHashGet(pCache->map, pKey, sizeof(*pKey));
+  if (ppNode == NULL) {
+    pCache->misses++;
+    pthread_mutex_unlock(&(pCache->lock));
+    return -1;
+  }
+
+  SListNode *     pNode = *ppNode;
+  SBlkCacheEntry *pEntry = TSDB_BLK_CACHE_ENTRY(pNode);
+
+  if (tdAllocMemForCol(pDataCol, maxPoints) < 0 || pEntry->len > pDataCol->spaceSize) {
+    pthread_mutex_unlock(&(pCache->lock));
+    return -1;
+  }
+
+  // Move to the MRU end
+  tdListPopNode(pCache->lru, pNode);
+  tdListAppendNode(pCache->lru, pNode);
+
+  memcpy(pDataCol->pData, pEntry->data, pEntry->len);
+  pDataCol->len = pEntry->len;
+  pDataCol->codes = NULL;
+  if (pEntry->nCodes == numOfRows) {
+    pDataCol->codes = POINTER_SHIFT(pDataCol->dataOff, sizeof(VarDataOffsetT) * maxPoints);
+    memcpy(pDataCol->codes, pEntry->data + pEntry->len, numOfRows);
+  }
+  pCache->hits++;
+
+  pthread_mutex_unlock(&(pCache->lock));
+
+  if (IS_VAR_DATA_TYPE(pDataCol->type)) {
+    dataColSetOffset(pDataCol, numOfRows);
+  }
+
+  return 0;
+}
+
+void tsdbBlkCachePut(const SBlkCacheKey *pKey, const SDataCol *pDataCol, int numOfRows) {
+  SBlkCache *pCache = &tsBlkCache;
+
+  if (!pCache->inited) return;
+
+  int32_t nCodes = (pDataCol->codes != NULL) ? numOfRows : 0;
+  int64_t size = TSDB_BLK_CACHE_NODE_SIZE(pDataCol->len, nCodes);
+  if (size > pCache->capacity) return;
+
+  SListNode *pNode = (SListNode *)malloc(size);
+  if (pNode == NULL) return;
+
+  SBlkCacheEntry *pEntry = TSDB_BLK_CACHE_ENTRY(pNode);
+  pEntry->key = *pKey;
+  pEntry->len = pDataCol->len;
+  pEntry->nCodes = nCodes;
+  memcpy(pEntry->data, pDataCol->pData, pDataCol->len);
+  if (nCodes > 0) memcpy(pEntry->data + pDataCol->len, pDataCol->codes, nCodes);
+
+  pthread_mutex_lock(&(pCache->lock));
+
+  if (taosHashGet(pCache->map, pKey, sizeof(*pKey)) != NULL) {
+    // Another query has loaded the same column concurrently
+    pthread_mutex_unlock(&(pCache->lock));
+    free(pNode);
+    return;
+  }
+
+  tsdbBlkCacheEvict(pCache, size);
+
+  if (taosHashPut(pCache->map, pKey, sizeof(*pKey), (void *)(&pNode), sizeof(pNode)) < 0) {
+    pthread_mutex_unlock(&(pCache->lock));
+    free(pNode);
+    return;
+  }
+
+  if (tsdbBlkCacheAddToFile(pCache, pNode) < 0) {
+    taosHashRemove(pCache->map, pKey, sizeof(*pKey));
+    pthread_mutex_unlock(&(pCache->lock));
+    free(pNode);
+    return;
+  }
+
+  tdListAppendNode(pCache->lru, pNode);
+  pCache->used += size;
+
+  pthread_mutex_unlock(&(pCache->lock));
+}
+
+void tsdbBlkCacheRemoveDFile(int vgId, int fid, TSDB_FILE_T ftype, uint32_t fver) {
+  SBlkCache *      pCache = &tsBlkCache;
+  SBlkCacheFileKey fkey;
+  int              nRemoved = 0;
+
+  if (!pCache->inited) return;
+
+  tsdbInitBlkCacheFileKey(&fkey, vgId, fid, (int8_t)ftype, fver);
+
+  pthread_mutex_lock(&(pCache->lock));
+
+  // only the entries of the file are visited, the last one removed frees the list
+  SList **ppFileList = taosHashGet(pCache->files, &fkey, sizeof(fkey));
+  if (ppFileList != NULL) {
+    SList *pFileList = *ppFileList;
+    nRemoved = listNEles(pFileList);
+    for (int i = 0; i < nRemoved; i++) {
+      tsdbBlkCacheRemoveNode(pCache, *(SListNode **)(listHead(pFileList)->data));
+    }
+  }
+
+  pthread_mutex_unlock(&(pCache->lock));
+
+  if (nRemoved > 0) {
+    tsdbDebug("vgId:%d %d cached blocks of fid %d ftype %d ver %u are removed", vgId, nRemoved, fid, ftype, fver);
+  }
+}
+
+void tsdbBlkCacheRemoveRepo(int vgId) {
+  SBlkCache *pCache = &tsBlkCache;
+  SListIter  iter;
+  SListNode *pNode;
+
+  if (!pCache->inited) return;
+
+  pthread_mutex_lock(&(pCache->lock));
+
+  tdListInitIter(pCache->lru, &iter, TD_LIST_FORWARD);
+  while ((pNode = tdListNext(&iter)) != NULL) {
+    if (TSDB_BLK_CACHE_ENTRY(pNode)->key.vgId == vgId) {
+      tsdbBlkCacheRemoveNode(pCache, pNode);
+    }
+  }
+
+  pthread_mutex_unlock(&(pCache->lock));
+}
+
+// ASSUMPTIONS: the cache should be locked when calling these functions
+static int tsdbBlkCacheAddToFile(SBlkCache *pCache, SListNode *pNode) {
+  SBlkCacheEntry * pEntry = TSDB_BLK_CACHE_ENTRY(pNode);
+  SBlkCacheFileKey fkey;
+  SList *          pFileList = NULL;
+
+  tsdbInitBlkCacheFileKey(&fkey, pEntry->key.vgId, pEntry->key.fid, pEntry->key.ftype, pEntry->key.fver);
+
+  SList **ppFileList = taosHashGet(pCache->files, &fkey, sizeof(fkey));
+  if (ppFileList != NULL) {
+    pFileList = *ppFileList;
+  } else {
+    pFileList = tdListNew(sizeof(SListNode *));
+    if (pFileList == NULL) return -1;
+    if (taosHashPut(pCache->files, &fkey, sizeof(fkey), (void *)(&pFileList), sizeof(pFileList)) < 0) {
+      tdListFree(pFileList);
+      return -1;
+    }
+  }
+
+  SListNode *pFileNode = (SListNode *)malloc(TSDB_BLK_CACHE_FILE_NODE_SIZE);
+  if (pFileNode == NULL) {
+    if (isListEmpty(pFileList)) {
+      taosHashRemove(pCache->files, &fkey, sizeof(fkey));
+      tdListFree(pFileList);
+    }
+    return -1;
+  }
+
+  memcpy(pFileNode->data, &pNode, sizeof(pNode));
+  tdListAppendNode(pFileList, pFileNode);
+  pEntry->pFileList = pFileList;
+  pEntry->pFileNode = pFileNode;
+
+  return 0;
+}
+
+static void tsdbBlkCacheRemoveNode(SBlkCache *pCache, SListNode *pNode) {
+  SBlkCacheEntry *pEntry = TSDB_BLK_CACHE_ENTRY(pNode);
+
+  tdListPopNode(pEntry->pFileList, pEntry->pFileNode);
+  free(pEntry->pFileNode);
+  if (isListEmpty(pEntry->pFileList)) {
+    SBlkCacheFileKey fkey;
+    tsdbInitBlkCacheFileKey(&fkey, pEntry->key.vgId, pEntry->key.fid, pEntry->key.ftype, pEntry->key.fver);
+    taosHashRemove(pCache->files, &fkey, sizeof(fkey));
+    tdListFree(pEntry->pFileList);
+  }
+
+  taosHashRemove(pCache->map, &(pEntry->key), sizeof(pEntry->key));
+  tdListPopNode(pCache->lru, pNode);
+  pCache->used -= TSDB_BLK_CACHE_NODE_SIZE(pEntry->len, pEntry->nCodes);
+  free(pNode);
+}
+
+static void tsdbBlkCacheEvict(SBlkCache *pCache, int64_t size) {
+  while (pCache->used + size > pCache->capacity) {
+    SListNode *pNode = listHead(pCache->lru);
+    if (pNode == NULL) break;
+
+    tsdbBlkCacheRemoveNode(pCache, pNode);
+    pCache->evictions++;
+  }
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tsdbint.h"
+#include "hashfunc.h"
+
+extern char tsBloomColumns[];
+
+static pthread_once_t tsdbBloomOnce = PTHREAD_ONCE_INIT;
+static bool           tsdbBloomTypes[TSDB_DATA_TYPE_JSON] = {0};
+
+static void     tsdbInitBloomTypes();
+static uint32_t tsdbBloomAdd(uint8_t *bits, uint32_t numOfBits, uint32_t h);
+static uint32_t tsdbBloomFold(uint8_t *bits, uint32_t numOfBits);
+static uint32_t tsdbBloomCountBits(const uint8_t *bits, uint32_t numOfBits);
+
+bool tsdbBloomEnabled(int8_t type) {
+  pthread_once(&tsdbBloomOnce, tsdbInitBloomTypes);
+  return type > TSDB_DATA_TYPE_NULL && type < TSDB_DATA_TYPE_JSON && tsdbBloomTypes[type];
+}
+
+/**
+ * Build the bloom part of a block at offset of *ppBuf. Return the bytes of the bloom part, 0 if no column has bloom
+ * filter and -1 on failure.
+ */
+int tsdbBuildBlockBloom(SDataCols *pDataCols, int rowsToWrite, void **ppBuf, int offset) {
+  uint32_t maxBits = TSDB_BLOOM_MIN_BITS;
+  int      nCols = 0;
+
+  while (maxBits < (uint32_t)rowsToWrite * TSDB_BLOOM_BITS_PER_KEY) {
+    maxBits *= 2;
+  }
+
+  for (int ncol = 1; ncol < pDataCols->numOfCols; ncol++) {
+    SDataCol *pDataCol = pDataCols->cols + ncol;
+    if (tsdbBloomEnabled(pDataCol->type) && !isAllRowsNull(pDataCol)) nCols++;
+  }
+
+  if (nCols == 0) return 0;
+
+  size_t size = sizeof(SBlockBloom) + (sizeof(SBlockBloomCol) + maxBits / 8) * nCols + sizeof(TSCKSUM);
+  if (tsdbMakeRoom(ppBuf, offset + size) < 0) return -1;
+
+  SBlockBloom *pBloom = (SBlockBloom *)POINTER_SHIFT(*ppBuf, offset);
+  uint32_t     len = (uint32_t)(sizeof(SBlockBloom) + sizeof(SBlockBloomCol) * nCols);
+
+  pBloom->numOfCols = 0;
+  pBloom->numOfHashes = TSDB_BLOOM_HASHES;
+
+  for (int ncol = 1; ncol < pDataCols->numOfCols; ncol++) {
+    SDataCol *pDataCol = pDataCols->cols + ncol;
+    if (!tsdbBloomEnabled(pDataCol->type) || isAllRowsNull(pDataCol)) continue;
+
+    SBlockBloomCol *pBloomCol = pBloom->cols + pBloom->numOfCols;
+    uint8_t *       bits = (uint8_t *)POINTER_SHIFT(pBloom, len);
+    uint32_t        numOfBits = maxBits;
+    uint32_t        nSetBits = 0;
+
+    memset(bits, 0, maxBits / 8);
+    for (int row = 0; row < rowsToWrite; row++) {
+      const void *pVal = tdGetColDataOfRow(pDataCol, row);
+      if (isNull(pVal, pDataCol->type)) continue;
+
+      uint32_t h = IS_VAR_DATA_TYPE(pDataCol->type) ? MurmurHash3_32(varDataVal(pVal), varDataLen(pVal))
+                                                    : MurmurHash3_32(pVal, tDataTypes[pDataCol->type].bytes);
+      nSetBits += tsdbBloomAdd(bits, numOfBits, h);
+    }
+
+    // Halve the filter while it is less than a quarter full, folding does not add set bits, so the halved one is
+    // still less than half full
+    while (numOfBits > TSDB_BLOOM_MIN_BITS && nSetBits * 4 < numOfBits) {
+      numOfBits = tsdbBloomFold(bits, numOfBits);
+      nSetBits = tsdbBloomCountBits(bits, numOfBits);
+    }
+
+    pBloomCol->colId = pDataCol->colId;
+    pBloomCol->reserved = 0;
+    pBloomCol->offset = len;
+    pBloomCol->numOfBits = numOfBits;
+
+    pBloom->numOfCols++;
+    len += numOfBits / 8;
+  }
+
+  len += sizeof(TSCKSUM);
+  pBloom->len = len;
+  taosCalcChecksumAppend(0, (uint8_t *)pBloom, len);
+
+  return len;
+}
+
+/**
+ * Check if the value, the bytes of a fixed length type or the content of binary/nchar, may be in the column of the
+ * block. Return true if the column has no bloom filter.
+ */
+bool tsdbBlockBloomMayContain(SBlockBloom *pBloom, int16_t colId, const void *pVal, int32_t len) {
+  for (int i = 0; i < pBloom->numOfCols; i++) {
+    SBlockBloomCol *pBloomCol = pBloom->cols + i;
+    if (pBloomCol->colId != colId) continue;
+
+    const uint8_t *bits = (const uint8_t *)POINTER_SHIFT(pBloom, pBloomCol->offset);
+    uint32_t       h = MurmurHash3_32(pVal, len);
+    uint32_t       delta = (h >> 17) | (h << 15);
+
+    for (int j = 0; j < pBloom->numOfHashes; j++) {
+      uint32_t pos = h & (pBloomCol->numOfBits - 1);
+      if ((bits[pos >> 3] & (1 << (pos & 7))) == 0) return false;
+      h += delta;
+    }
+
+    return true;
+  }
+
+  return true;
+}
+
+static void tsdbInitBloomTypes() {
+  const char *p = tsBloomColumns;
+
+  while (*p) {
+    while (*p == ' ' || *p == '|') p++;
+
+    const char *e = p;
+    while (*e && *e != '|' && *e != ' ') e++;
+
+    for (int type = TSDB_DATA_TYPE_BOOL; type < TSDB_DATA_TYPE_JSON; type++) {
+      // float and double are compared by value, +0.0 and -0.0 have different bits
+      if (type == TSDB_DATA_TYPE_FLOAT || type == TSDB_DATA_TYPE_DOUBLE) continue;
+
+      if (e > p && tDataTypes[type].nameLen == e - p && strncasecmp(tDataTypes[type].name, p, e - p) == 0) {
+        tsdbBloomTypes[type] = true;
+      }
+    }
+
+    p = e;
+  }
+}
+
+// Set the bits of the hash and return the number of bits newly set
+static uint32_t tsdbBloomAdd(uint8_t *bits, uint32_t numOfBits, uint32_t h) {
+  uint32_t delta = (h >> 17) | (h << 15);
+  uint32_t nSet = 0;
+
+  for (int j = 0; j < TSDB_BLOOM_HASHES; j++) {
+    uint32_t pos = h & (numOfBits - 1);
+    if ((bits[pos >> 3] & (1 << (pos & 7))) == 0) {
+      bits[pos >> 3] |= (1 << (pos & 7));
+      nSet++;
+    }
+    h += delta;
+  }
+
+  return nSet;
+}
+
+// A bit at pos of the folded filter is set if pos or pos + numOfBits / 2 is set, the probe masks the hash with the
+// new size
+static uint32_t tsdbBloomFold(uint8_t *bits, uint32_t numOfBits) {
+  uint32_t half = numOfBits / 2;
+
+  for (uint32_t i = 0; i < half / 8; i++) {
+    bits[i] |= bits[i + half / 8];
+  }
+
+  return half;
+}
+
+static uint32_t tsdbBloomCountBits(const uint8_t *bits, uint32_t numOfBits) {
+  uint32_t n = 0;
+
+  for (uint32_t i = 0; i < numOfBits / 8; i++) {
+    uint8_t b = bits[i];
+    while (b) {
+      b &= (b - 1);
+      n++;
+    }
+  }
+
+  return n;
+}
@@ -0,0 +1,613 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tsdbint.h"
+
+/*
+ * The file set being loaded is written under temporary names out of the commit, so the commits of the memtable go on.
+ * It is renamed and installed by a FS transaction at the end, with the commits blocked only for that while.
+ */
+#define TSDB_LOAD_FILE_VER UINT32_MAX
+
+typedef struct {
+  STable *pTable;
+  SArray *aSupBlk;  // SBlock array of the table in the file set
+} STableLoadH;
+
+struct STsdbLoadH {
+  STsdbRepo *pRepo;
+  SRtn       rtn;
+  int32_t    code;       // the first error, the handle refuses all data after an error
+  int        fid;        // fid of the file set being loaded, TSDB_IVLD_FID if none
+  TSKEY      maxKey;     // max key of the file set
+  SDiskID    did;
+  SDFileSet  wSet;
+  SArray *   aTable;     // STableLoadH array of the file set, in loading order
+  SHashObj * pLoaded;    // tids loaded in the file set
+  STableLoadH *pCurTable;
+  SDataCols *pDataCols;  // rows of the current table not written yet
+  SArray *   aBlkIdx;
+  int64_t    rows;       // rows of the file set
+  void *     pBuf;
+  void *     pCBuf;
+  void *     pExBuf;
+};
+
+#define TSDB_LOAD_REPO(pLoadh) ((pLoadh)->pRepo)
+#define TSDB_LOAD_WSET(pLoadh) (&((pLoadh)->wSet))
+#define TSDB_LOAD_HEAD_FILE(pLoadh) TSDB_DFILE_IN_SET(TSDB_LOAD_WSET(pLoadh), TSDB_FILE_HEAD)
+#define TSDB_LOAD_DATA_FILE(pLoadh) TSDB_DFILE_IN_SET(TSDB_LOAD_WSET(pLoadh), TSDB_FILE_DATA)
+#define TSDB_LOAD_LAST_FILE(pLoadh) TSDB_DFILE_IN_SET(TSDB_LOAD_WSET(pLoadh), TSDB_FILE_LAST)
+#define TSDB_LOAD_SMAD_FILE(pLoadh) TSDB_DFILE_IN_SET(TSDB_LOAD_WSET(pLoadh), TSDB_FILE_SMAD)
+#define TSDB_LOAD_SMAL_FILE(pLoadh) TSDB_DFILE_IN_SET(TSDB_LOAD_WSET(pLoadh), TSDB_FILE_SMAL)
+
+static void    tsdbDestroyLoadH(STsdbLoadH *pLoadh);
+static STable *tsdbLoadGetTable(STsdbLoadH *pLoadh, uint64_t uid);
+static int     tsdbLoadCheckData(STsdbLoadH *pLoadh, STable *pTable, SDataCols *pCols);
+static bool    tsdbLoadHasFSet(STsdbRepo *pRepo, int fid);
+static int     tsdbLoadStartFSet(STsdbLoadH *pLoadh, int fid);
+static int     tsdbLoadEndFSet(STsdbLoadH *pLoadh);
+static void    tsdbLoadDropFSet(STsdbLoadH *pLoadh);
+static void    tsdbLoadClearTables(STsdbLoadH *pLoadh);
+static int     tsdbLoadSetTable(STsdbLoadH *pLoadh, STable *pTable);
+static int     tsdbLoadFlushTable(STsdbLoadH *pLoadh);
+static int     tsdbLoadWriteBlock(STsdbLoadH *pLoadh, bool isLast);
+static int     tsdbLoadWriteHead(STsdbLoadH *pLoadh);
+static int     tsdbLoadInstallFSet(STsdbLoadH *pLoadh);
+static int     tsdbLoadCutTombs(STsdbLoadH *pLoadh, SArray *aTombUpd);
+static int     tsdbLoadTableCmpFn(const void *p1, const void *p2);
+
+STsdbLoadH *tsdbOpenBulkLoad(STsdbRepo *pRepo) {
+  STsdbCfg *  pCfg = REPO_CFG(pRepo);
+  STsdbLoadH *pLoadh;
+
+  // The meta file holds the tables of the installed file sets, it is created by the first commit
+  if (REPO_FS(pRepo)->cstatus->pmf == NULL) {
+    terrno = TSDB_CODE_TDB_INVALID_ACTION;
+    tsdbError("vgId:%d failed to open bulk load since no meta file, commit the tables first", REPO_ID(pRepo));
+    return NULL;
+  }
+
+  if (atomic_val_compare_exchange_8(&(pRepo->inBulkLoad), 0, 1) != 0) {
+    terrno = TSDB_CODE_TDB_INVALID_ACTION;
+    tsdbError("vgId:%d failed to open bulk load since another one is open", REPO_ID(pRepo));
+    return NULL;
+  }
+
+  pLoadh = (STsdbLoadH *)calloc(1, sizeof(*pLoadh));
+  if (pLoadh == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    atomic_store_8(&(pRepo->inBulkLoad), 0);
+    return NULL;
+  }
+
+  pLoadh->pRepo = pRepo;
+  pLoadh->fid = TSDB_IVLD_FID;
+  TSDB_FSET_SET_CLOSED(TSDB_LOAD_WSET(pLoadh));
+  tsdbGetRtnSnap(pRepo, &(pLoadh->rtn));
+
+  pLoadh->aTable = taosArrayInit(1024, sizeof(STableLoadH));
+  pLoadh->pLoaded = taosHashInit(1024, taosGetDefaultHashFunction(TSDB_DATA_TYPE_INT), false, HASH_NO_LOCK);
+  pLoadh->aBlkIdx = taosArrayInit(1024, sizeof(SBlockIdx));
+  pLoadh->pDataCols = tdNewDataCols(0, pCfg->maxRowsPerFileBlock);
+  if (pLoadh->aTable == NULL || pLoadh->pLoaded == NULL || pLoadh->aBlkIdx == NULL || pLoadh->pDataCols == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    tsdbDestroyLoadH(pLoadh);
+    return NULL;
+  }
+
+  tsdbInfo("vgId:%d bulk load is opened", REPO_ID(pRepo));
+  return pLoadh;
+}
+
+int tsdbBulkLoadData(STsdbLoadH *pLoadh, uint64_t uid, SDataCols *pCols) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+  STsdbCfg * pCfg = REPO_CFG(pRepo);
+  int        defaultRows = TSDB_DEFAULT_BLOCK_ROWS(pCfg->maxRowsPerFileBlock);
+  STable *   pTable;
+
+  if (pLoadh->code != TSDB_CODE_SUCCESS) {
+    terrno = pLoadh->code;
+    return -1;
+  }
+
+  if (pCols->numOfRows <= 0) return 0;
+
+  if ((pTable = tsdbLoadGetTable(pLoadh, uid)) == NULL) {
+    return -1;
+  }
+
+  if (tsdbLoadCheckData(pLoadh, pTable, pCols) < 0) {
+    tsdbUnRefTable(pTable);
+    return -1;
+  }
+
+  int ridx = 0;
+  while (ridx < pCols->numOfRows) {
+    int fid = TSDB_KEY_FID(dataColsKeyAt(pCols, ridx), pCfg->daysPerFile, pCfg->precision);
+
+    if (fid != pLoadh->fid && (tsdbLoadEndFSet(pLoadh) < 0 || tsdbLoadStartFSet(pLoadh, fid) < 0)) {
+      goto _err;
+    }
+
+    if (tsdbLoadSetTable(pLoadh, pTable) < 0) {
+      goto _err;
+    }
+
+    // Append the rows of the batch in the file set to the pending block, write it once it is full
+    while (ridx < pCols->numOfRows && dataColsKeyAt(pCols, ridx) <= pLoadh->maxKey) {
+      int rowsToMerge = 0;
+      int rowsLeft = defaultRows - pLoadh->pDataCols->numOfRows;
+      while (rowsToMerge < rowsLeft && ridx + rowsToMerge < pCols->numOfRows &&
+             dataColsKeyAt(pCols, ridx + rowsToMerge) <= pLoadh->maxKey) {
+        rowsToMerge++;
+      }
+
+      if (tdMergeDataCols(pLoadh->pDataCols, pCols, rowsToMerge, &ridx, false) < 0) {
+        terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+        goto _err;
+      }
+
+      if (pLoadh->pDataCols->numOfRows >= defaultRows && tsdbLoadWriteBlock(pLoadh, false) < 0) {
+        goto _err;
+      }
+    }
+  }
+
+  tsdbUnRefTable(pTable);
+  return 0;
+
+_err:
+  pLoadh->code = terrno;
+  tsdbUnRefTable(pTable);
+  return -1;
+}
+
+int tsdbCloseBulkLoad(STsdbLoadH *pLoadh, bool toInstall) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+  int        code = 0;
+
+  if (pLoadh->code != TSDB_CODE_SUCCESS) {
+    terrno = pLoadh->code;
+    code = -1;
+  } else if (toInstall) {
+    code = tsdbLoadEndFSet(pLoadh);
+  }
+
+  tsdbLoadDropFSet(pLoadh);
+  tsdbDestroyLoadH(pLoadh);
+
+  tsdbInfo("vgId:%d bulk load is closed, %s", REPO_ID(pRepo), (code == 0) ? "succeed" : tstrerror(terrno));
+  return code;
+}
+
+static void tsdbDestroyLoadH(STsdbLoadH *pLoadh) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+
+  tsdbLoadClearTables(pLoadh);
+  taosArrayDestroy(&pLoadh->aTable);
+  taosHashCleanup(pLoadh->pLoaded);
+  taosArrayDestroy(&pLoadh->aBlkIdx);
+  tdFreeDataCols(pLoadh->pDataCols);
+  taosTZfree(pLoadh->pBuf);
+  taosTZfree(pLoadh->pCBuf);
+  taosTZfree(pLoadh->pExBuf);
+  free(pLoadh);
+
+  atomic_store_8(&(pRepo->inBulkLoad), 0);
+}
+
+static STable *tsdbLoadGetTable(STsdbLoadH *pLoadh, uint64_t uid) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+  STable *   pTable;
+
+  if (tsdbRLockRepoMeta(pRepo) < 0) return NULL;
+
+  pTable = tsdbGetTableByUid(pRepo->tsdbMeta, uid);
+  if (pTable == NULL || TABLE_TYPE(pTable) == TSDB_SUPER_TABLE) {
+    tsdbUnlockRepoMeta(pRepo);
+    terrno = TSDB_CODE_TDB_INVALID_TABLE_ID;
+    tsdbError("vgId:%d failed to load table uid %" PRIu64 " since %s", REPO_ID(pRepo), uid, tstrerror(terrno));
+    return NULL;
+  }
+  tsdbRefTable(pTable);
+
+  if (tsdbUnlockRepoMeta(pRepo) < 0) {
+    tsdbUnRefTable(pTable);
+    return NULL;
+  }
+
+  return pTable;
+}
+
+// The batch is rejected as a whole before any row of it is loaded
+static int tsdbLoadCheckData(STsdbLoadH *pLoadh, STable *pTable, SDataCols *pCols) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+  STsdbCfg * pCfg = REPO_CFG(pRepo);
+  STSchema * pSchema = tsdbGetTableSchemaImpl(pTable, true, true, -1, -1);
+  TSKEY      now = taosGetTimestamp(pCfg->precision);
+  TSKEY      maxKey = now + tsTickPerDay[pCfg->precision] * pCfg->daysPerFile;
+
+  if (pSchema == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  bool matched = (pCols->numOfCols == schemaNCols(pSchema));
+  for (int i = 0; matched && i < pCols->numOfCols; i++) {
+    STColumn *pCol = schemaColAt(pSchema, i);
+    matched = (pCols->cols[i].colId == colColId(pCol) && pCols->cols[i].type == colType(pCol));
+  }
+  tdFreeSchema(pSchema);
+
+  if (!matched) {
+    terrno = TSDB_CODE_TDB_IVD_TB_SCHEMA_VERSION;
+    tsdbError("vgId:%d failed to load table %s since the columns mismatch the schema", REPO_ID(pRepo),
+              TABLE_CHAR_NAME(pTable));
+    return -1;
+  }
+
+  if (dataColsKeyFirst(pCols) < pLoadh->rtn.minKey || dataColsKeyLast(pCols) > maxKey) {
+    terrno = TSDB_CODE_TDB_TIMESTAMP_OUT_OF_RANGE;
+    tsdbError("vgId:%d failed to load table %s since keys %" PRId64 " to %" PRId64 " out of range %" PRId64
+              " to %" PRId64,
+              REPO_ID(pRepo), TABLE_CHAR_NAME(pTable), dataColsKeyFirst(pCols), dataColsKeyLast(pCols),
+              pLoadh->rtn.minKey, maxKey);
+    return -1;
+  }
+
+  // The file sets are loaded in fid order, and the rows of a table in a file set are contiguous
+  int     fid = TSDB_KEY_FID(dataColsKeyFirst(pCols), pCfg->daysPerFile, pCfg->precision);
+  int32_t tid = TABLE_TID(pTable);
+  if (pLoadh->fid != TSDB_IVLD_FID && fid < pLoadh->fid) {
+    terrno = TSDB_CODE_TDB_INVALID_ACTION;
+    tsdbError("vgId:%d failed to load table %s since FSET %d is loaded after FSET %d", REPO_ID(pRepo),
+              TABLE_CHAR_NAME(pTable), fid, pLoadh->fid);
+    return -1;
+  }
+
+  bool isCurTable = (pLoadh->pCurTable != NULL && pLoadh->pCurTable->pTable == pTable);
+  if (fid == pLoadh->fid && !isCurTable && taosHashGet(pLoadh->pLoaded, &tid, sizeof(tid)) != NULL) {
+    terrno = TSDB_CODE_TDB_INVALID_ACTION;
+    tsdbError("vgId:%d failed to load table %s since its rows in FSET %d are not contiguous", REPO_ID(pRepo),
+              TABLE_CHAR_NAME(pTable), fid);
+    return -1;
+  }
+
+  // The keys go on from the rows of the table loaded before
+  TSKEY lastKey = TSKEY_INITIAL_VAL;
+  if (isCurTable) {
+    if (pLoadh->pDataCols->numOfRows > 0) {
+      lastKey = dataColsKeyLast(pLoadh->pDataCols);
+    } else if (taosArrayGetSize(pLoadh->pCurTable->aSupBlk) > 0) {
+      lastKey = ((SBlock *)taosArrayGetLast(pLoadh->pCurTable->aSupBlk))->keyLast;
+    }
+  }
+
+  for (int i = 0; i < pCols->numOfRows; i++) {
+    TSKEY key = dataColsKeyAt(pCols, i);
+    if (key <= lastKey) {
+      terrno = TSDB_CODE_TDB_INVALID_ACTION;
+      tsdbError("vgId:%d failed to load table %s since key %" PRId64 " is not after %" PRId64, REPO_ID(pRepo),
+                TABLE_CHAR_NAME(pTable), key, lastKey);
+      return -1;
+    }
+    lastKey = key;
+  }
+
+  return 0;
+}
+
+static bool tsdbLoadHasFSet(STsdbRepo *pRepo, int fid) {
+  STsdbFS *pfs = REPO_FS(pRepo);
+  bool     found = false;
+
+  tsdbRLockFS(pfs);
+  for (size_t i = 0; i < taosArrayGetSize(pfs->cstatus->df); i++) {
+    SDFileSet *pSet = (SDFileSet *)taosArrayGet(pfs->cstatus->df, i);
+    if (pSet->fid == fid) {
+      found = true;
+      break;
+    }
+  }
+  tsdbUnLockFS(pfs);
+
+  return found;
+}
+
+static int tsdbLoadStartFSet(STsdbLoadH *pLoadh, int fid) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+  STsdbCfg * pCfg = REPO_CFG(pRepo);
+  TSKEY      minKey;
+
+  if (tsdbLoadHasFSet(pRepo, fid)) {
+    terrno = TSDB_CODE_TDB_FILE_ALREADY_EXISTS;
+    tsdbError("vgId:%d failed to load FSET %d since it has data already", REPO_ID(pRepo), fid);
+    return -1;
+  }
+
+  tfsAllocDisk(tsdbGetFidLevel(fid, &(pLoadh->rtn)), &(pLoadh->did.level), &(pLoadh->did.id));
+  if (pLoadh->did.level == TFS_UNDECIDED_LEVEL) {
+    terrno = TSDB_CODE_TDB_NO_AVAIL_DISK;
+    tsdbError("vgId:%d failed to load FSET %d since %s", REPO_ID(pRepo), fid, tstrerror(terrno));
+    return -1;
+  }
+
+  tsdbInitDFileSet(TSDB_LOAD_WSET(pLoadh), pLoadh->did, REPO_ID(pRepo), fid, TSDB_LOAD_FILE_VER,
+                   TSDB_LATEST_FSET_VER);
+  if (tsdbCreateDFileSet(TSDB_LOAD_WSET(pLoadh), true) < 0) {
+    tsdbError("vgId:%d failed to load FSET %d since %s", REPO_ID(pRepo), fid, tstrerror(terrno));
+    return -1;
+  }
+
+  pLoadh->fid = fid;
+  tsdbGetFidKeyRange(pCfg->daysPerFile, pCfg->precision, fid, &minKey, &(pLoadh->maxKey));
+  pLoadh->rows = 0;
+
+  tsdbDebug("vgId:%d start to load FSET %d on level %d id %d", REPO_ID(pRepo), fid, pLoadh->did.level,
+            pLoadh->did.id);
+  return 0;
+}
+
+// Finish the file set being loaded and install it
+static int tsdbLoadEndFSet(STsdbLoadH *pLoadh) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+
+  if (pLoadh->fid == TSDB_IVLD_FID) return 0;
+
+  if (tsdbLoadFlushTable(pLoadh) < 0 || tsdbLoadWriteHead(pLoadh) < 0 ||
+      tsdbUpdateDFileSetHeader(TSDB_LOAD_WSET(pLoadh)) < 0) {
+    tsdbError("vgId:%d failed to load FSET %d since %s", REPO_ID(pRepo), pLoadh->fid, tstrerror(terrno));
+    return -1;
+  }
+
+  TSDB_FSET_FSYNC(TSDB_LOAD_WSET(pLoadh));
+  tsdbCloseDFileSet(TSDB_LOAD_WSET(pLoadh));
+
+  if (tsdbLoadInstallFSet(pLoadh) < 0) {
+    tsdbError("vgId:%d failed to install loaded FSET %d since %s", REPO_ID(pRepo), pLoadh->fid, tstrerror(terrno));
+    return -1;
+  }
+
+  tsdbInfo("vgId:%d FSET %d is loaded, %" PRId64 " rows of %d tables", REPO_ID(pRepo), pLoadh->fid, pLoadh->rows,
+           (int)taosArrayGetSize(pLoadh->aTable));
+
+  tsdbLoadClearTables(pLoadh);
+  pLoadh->fid = TSDB_IVLD_FID;
+  return 0;
+}
+
+// Remove the files of the file set being loaded if it is not installed
+static void tsdbLoadDropFSet(STsdbLoadH *pLoadh) {
+  if (pLoadh->fid == TSDB_IVLD_FID) return;
+
+  tsdbCloseDFileSet(TSDB_LOAD_WSET(pLoadh));
+  tsdbRemoveDFileSet(TSDB_LOAD_WSET(pLoadh));
+  tsdbLoadClearTables(pLoadh);
+  pLoadh->fid = TSDB_IVLD_FID;
+}
+
+static void tsdbLoadClearTables(STsdbLoadH *pLoadh) {
+  if (pLoadh->aTable == NULL) return;
+
+  for (size_t i = 0; i < taosArrayGetSize(pLoadh->aTable); i++) {
+    STableLoadH *pTh = (STableLoadH *)taosArrayGet(pLoadh->aTable, i);
+    tsdbUnRefTable(pTh->pTable);
+    taosArrayDestroy(&pTh->aSupBlk);
+  }
+
+  taosArrayClear(pLoadh->aTable);
+  taosHashClear(pLoadh->pLoaded);
+  pLoadh->pCurTable = NULL;
+  tdResetDataCols(pLoadh->pDataCols);
+}
+
+static int tsdbLoadSetTable(STsdbLoadH *pLoadh, STable *pTable) {
+  int32_t    tid = TABLE_TID(pTable);
+  STableLoadH th;
+
+  if (pLoadh->pCurTable != NULL && pLoadh->pCurTable->pTable == pTable) return 0;
+
+  if (tsdbLoadFlushTable(pLoadh) < 0) return -1;
+  ASSERT(taosHashGet(pLoadh->pLoaded, &tid, sizeof(tid)) == NULL);
+
+  STSchema *pSchema = tsdbGetTableSchemaImpl(pTable, true, true, -1, -1);
+  if (pSchema == NULL || tdInitDataCols(pLoadh->pDataCols, pSchema) < 0) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    tdFreeSchema(pSchema);
+    return -1;
+  }
+  tdFreeSchema(pSchema);
+
+  th.pTable = pTable;
+  th.aSupBlk = taosArrayInit(16, sizeof(SBlock));
+  if (th.aSupBlk == NULL || taosHashPut(pLoadh->pLoaded, &tid, sizeof(tid), &tid, sizeof(tid)) != 0 ||
+      taosArrayPush(pLoadh->aTable, &th) == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    taosArrayDestroy(&th.aSupBlk);
+    return -1;
+  }
+
+  tsdbRefTable(pTable);
+  pLoadh->pCurTable = (STableLoadH *)taosArrayGetLast(pLoadh->aTable);
+  return 0;
+}
+
+// Write the rows left of the current table, they are the last block of it in the file set
+static int tsdbLoadFlushTable(STsdbLoadH *pLoadh) {
+  STsdbCfg *pCfg = REPO_CFG(TSDB_LOAD_REPO(pLoadh));
+
+  if (pLoadh->pCurTable == NULL || pLoadh->pDataCols->numOfRows == 0) return 0;
+
+  return tsdbLoadWriteBlock(pLoadh, pLoadh->pDataCols->numOfRows < pCfg->minRowsPerFileBlock);
+}
+
+static int tsdbLoadWriteBlock(STsdbLoadH *pLoadh, bool isLast) {
+  STsdbRepo *  pRepo = TSDB_LOAD_REPO(pLoadh);
+  STableLoadH *pTh = pLoadh->pCurTable;
+  SBlock       block;
+
+  if (tsdbWriteBlockImpl(pRepo, pTh->pTable, isLast ? TSDB_LOAD_LAST_FILE(pLoadh) : TSDB_LOAD_DATA_FILE(pLoadh),
+                         isLast ? TSDB_LOAD_SMAL_FILE(pLoadh) : TSDB_LOAD_SMAD_FILE(pLoadh), pLoadh->pDataCols, &block,
+                         isLast, true, &(pLoadh->pBuf), &(pLoadh->pCBuf), &(pLoadh->pExBuf)) < 0) {
+    return -1;
+  }
+
+  if (taosArrayPush(pTh->aSupBlk, (void *)(&block)) == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pLoadh->rows += pLoadh->pDataCols->numOfRows;
+  tdResetDataCols(pLoadh->pDataCols);
+  return 0;
+}
+
+static int tsdbLoadWriteHead(STsdbLoadH *pLoadh) {
+  SBlockIdx blkIdx;
+
+  // The block indexes are searched by tid
+  taosArraySort(pLoadh->aTable, tsdbLoadTableCmpFn);
+  pLoadh->pCurTable = NULL;
+  taosArrayClear(pLoadh->aBlkIdx);
+
+  for (size_t i = 0; i < taosArrayGetSize(pLoadh->aTable); i++) {
+    STableLoadH *pTh = (STableLoadH *)taosArrayGet(pLoadh->aTable, i);
+
+    if (tsdbWriteBlockInfoImpl(TSDB_LOAD_HEAD_FILE(pLoadh), pTh->pTable, pTh->aSupBlk, NULL, &(pLoadh->pBuf),
+                               &blkIdx) < 0) {
+      return -1;
+    }
+
+    if ((blkIdx.numOfBlocks > 0) && (taosArrayPush(pLoadh->aBlkIdx, (void *)(&blkIdx)) == NULL)) {
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+  }
+
+  return tsdbWriteBlockIdx(TSDB_LOAD_HEAD_FILE(pLoadh), pLoadh->aBlkIdx, &(pLoadh->pBuf));
+}
+
+static int tsdbLoadInstallFSet(STsdbLoadH *pLoadh) {
+  STsdbRepo *pRepo = TSDB_LOAD_REPO(pLoadh);
+  STsdbFS *  pfs = REPO_FS(pRepo);
+  SDFileSet *pWSet = TSDB_LOAD_WSET(pLoadh);
+  SDFileSet  fset;
+  SFSIter    fsIter;
+  SDFileSet *pSet;
+  int64_t    storage = 0;
+  bool       installed = false;
+
+  for (TSDB_FILE_T ftype = 0; ftype < tsdbGetNFiles(pWSet); ftype++) {
+    storage += TSDB_DFILE_IN_SET(pWSet, ftype)->info.size;
+  }
+
+  tsem_wait(&(pRepo->readyToCommit));
+
+  // A commit may have created the file set while it is being loaded
+  if (tsdbLoadHasFSet(pRepo, pLoadh->fid)) {
+    tsem_post(&(pRepo->readyToCommit));
+    terrno = TSDB_CODE_TDB_FILE_ALREADY_EXISTS;
+    return -1;
+  }
+
+  tsdbStartFSTxn(pRepo, pLoadh->rows, storage);
+  tsdbUpdateMFile(pfs, pfs->cstatus->pmf);
+
+  // The rows loaded are not masked by the tombstones of the rows deleted before
+  SArray *aTombUpd = taosArrayInit(4, sizeof(STableTombUpd));
+  if (aTombUpd == NULL || tsdbLoadCutTombs(pLoadh, aTombUpd) < 0 || tsdbCommitTombs(pRepo, aTombUpd) < 0) {
+    if (aTombUpd == NULL) terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    tsdbClearTombUpds(aTombUpd);
+    taosArrayDestroy(&aTombUpd);
+    tsdbEndFSTxnWithError(pfs);
+    tsem_post(&(pRepo->readyToCommit));
+    return -1;
+  }
+
+  tsdbInitDFileSet(&fset, pLoadh->did, REPO_ID(pRepo), pLoadh->fid, FS_TXN_VERSION(pfs), TSDB_LATEST_FSET_VER);
+  for (TSDB_FILE_T ftype = 0; ftype < tsdbGetNFiles(pWSet); ftype++) {
+    SDFile *pDFile = TSDB_DFILE_IN_SET(&fset, ftype);
+
+    if (tfsrename(TSDB_FILE_F(TSDB_DFILE_IN_SET(pWSet, ftype)), TSDB_FILE_F(pDFile)) < 0) {
+      terrno = TAOS_SYSTEM_ERROR(errno);
+      tsdbRemoveDFileSet(&fset);
+      tsdbClearTombUpds(aTombUpd);
+      taosArrayDestroy(&aTombUpd);
+      tsdbEndFSTxnWithError(pfs);
+      tsem_post(&(pRepo->readyToCommit));
+      return -1;
+    }
+    pDFile->info = TSDB_DFILE_IN_SET(pWSet, ftype)->info;
+  }
+
+  // Keep the file sets in fid order
+  tsdbFSIterInit(&fsIter, pfs, TSDB_FS_ITER_FORWARD);
+  while ((pSet = tsdbFSIterNext(&fsIter))) {
+    if (!installed && pSet->fid > pLoadh->fid) {
+      if (tsdbUpdateDFileSet(pfs, &fset) < 0) break;
+      installed = true;
+    }
+    if (tsdbUpdateDFileSet(pfs, pSet) < 0) break;
+  }
+
+  // There were no files of the FSET, so the tombstones cut mask nothing even if the FSET is not installed. They are
+  // cut before it is visible to the queries.
+  tsdbApplyTombUpds(aTombUpd);
+  taosArrayDestroy(&aTombUpd);
+
+  if (pSet != NULL || (!installed && tsdbUpdateDFileSet(pfs, &fset) < 0) || tsdbEndFSTxn(pRepo) < 0) {
+    if (FS_IN_TXN(pfs)) tsdbEndFSTxnWithError(pfs);
+    tsdbRemoveDFileSet(&fset);
+    tsem_post(&(pRepo->readyToCommit));
+    return -1;
+  }
+
+  tsem_post(&(pRepo->readyToCommit));
+  return 0;
+}
+
+static int tsdbLoadCutTombs(STsdbLoadH *pLoadh, SArray *aTombUpd) {
+  STsdbCfg *pCfg = REPO_CFG(TSDB_LOAD_REPO(pLoadh));
+  TSKEY     minKey, maxKey;
+
+  tsdbGetFidKeyRange(pCfg->daysPerFile, pCfg->precision, pLoadh->fid, &minKey, &maxKey);
+
+  for (size_t i = 0; i < taosArrayGetSize(pLoadh->aTable); i++) {
+    STable *pTable = ((STableLoadH *)taosArrayGet(pLoadh->aTable, i))->pTable;
+
+    if (!tsdbTombsOverlap(pTable->aTomb, minKey, maxKey)) continue;
+
+    STableTombUpd *pUpd = tsdbGetTombUpd(aTombUpd, pTable);
+    if (pUpd == NULL || tsdbCutTombs(pUpd->aTomb, minKey, maxKey) < 0) {
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int tsdbLoadTableCmpFn(const void *p1, const void *p2) {
+  int32_t tid1 = TABLE_TID(((STableLoadH *)p1)->pTable);
+  int32_t tid2 = TABLE_TID(((STableLoadH *)p2)->pTable);
+
+  if (tid1 < tid2) {
+    return -1;
+  } else if (tid1 > tid2) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
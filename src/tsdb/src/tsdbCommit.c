@@ -17,8 +17,28 @@
 extern int32_t tsTsdbMetaCompactRatio;
 
 #define TSDB_MAX_SUBBLOCKS 8
+#define TSDB_COMMIT_TABLES_PER_LANE 16  // tables of a round of a parallel commit, per lane
 
+// A block encoded by a lane, it is appended to the files by the commit thread
 typedef struct {
+  int8_t  inSub;    // the SBlock is in aSubBlk rather than in aSupBlk
+  int32_t idx;      // index of the SBlock in the array, -1 before the block is added
+  int32_t len;      // length of the data part, followed by the aggregate part in the buffer
+  int32_t aggrLen;  // length of the aggregate part, 0 if no aggregate part
+} SCommitNewBlk;
+
+// The output of a table in a round of a parallel commit
+typedef struct {
+  int     tid;
+  int     code;
+  SArray *aSupBlk;  // Table super-block array
+  SArray *aSubBlk;  // table sub-block array
+  SArray *aNewBlk;  // SCommitNewBlk array
+  void *  pBuf;     // the encoded blocks one after another
+  int64_t size;
+} SCommitTable;
+
+typedef struct SCommitH {
   SRtn         rtn;     // retention snapshot
   SFSIter      fsIter;  // tsdb file iterator
   int          niters;  // memory iterators
@@ -35,6 +55,14 @@ typedef struct {
   SArray *     aSupBlk;  // Table super-block array
   SArray *     aSubBlk;  // table sub-block array
   SDataCols *  pDataCols;
+  SArray *     aTombUpd;  // STableTombUpd of the tables whose deleted rows are purged, sorted by tid
+  // parallel commit, only if the apply threads are there
+  int              nLanes;
+  struct SCommitH *lanes;      // each lane reads and encodes tables of a round
+  SCommitTable *   tables;     // tables of the round in tid order
+  int              nTables;
+  int              nextTable;  // the next table of the round to be taken by a lane
+  SCommitTable *   pOut;       // not NULL for a lane, the table to encode the blocks to
 } SCommitH;
 
 /*
@@ -64,9 +92,9 @@ static int  tsdbCommitMeta(STsdbRepo *pRepo);
 static int  tsdbUpdateMetaRecord(STsdbFS *pfs, SMFile *pMFile, uint64_t uid, void *cont, int contLen, bool compact);
 static int  tsdbDropMetaRecord(STsdbFS *pfs, SMFile *pMFile, uint64_t uid);
 static int  tsdbCompactMetaFile(STsdbRepo *pRepo, STsdbFS *pfs, SMFile *pMFile);
-static int  tsdbCommitTSData(STsdbRepo *pRepo);
+static int  tsdbCommitTSData(STsdbRepo *pRepo, SArray *aTombUpd);
 static void tsdbStartCommit(STsdbRepo *pRepo);
-static void tsdbEndCommit(STsdbRepo *pRepo, int eno, bool end);
+static void tsdbEndCommit(STsdbRepo *pRepo, int eno, bool end, SArray *aTombUpd);
 static int  tsdbCommitToFile(SCommitH *pCommith, SDFileSet *pSet, int fid);
 static int  tsdbCreateCommitIters(SCommitH *pCommith);
 static void tsdbDestroyCommitIters(SCommitH *pCommith);
@@ -77,8 +105,21 @@ static int  tsdbGetFidLevel(int fid, SRtn *pRtn);
 static int  tsdbNextCommitFid(SCommitH *pCommith);
 static int  tsdbCommitToTable(SCommitH *pCommith, int tid);
 static int  tsdbSetCommitTable(SCommitH *pCommith, STable *pTable);
+static bool tsdbShouldPurgeTable(SCommitH *pCommith, STable *pTable, TSKEY nextKey);
 static int  tsdbComparKeyBlock(const void *arg1, const void *arg2);
-static int  tsdbWriteBlockInfo(SCommitH *pCommih);
+static int  tsdbCompressColFOR(SDataCol *pDataCol, int rowsToWrite, void *tptr, int flen, int tsize, int8_t compression,
+                               void **ppCBuf);
+static int  tsdbCompressColDict(SDataCol *pDataCol, int rowsToWrite, void *tptr, int flen, void *pCBuf, int cbufSize);
+static int  tsdbEncodeBlock(STsdbRepo *pRepo, STable *pTable, SDataCols *pDataCols, SBlock *pBlock, bool isLast,
+                            bool isSuper, void **ppBuf, void **ppCBuf, void **ppExBuf, int *pAggrLen);
+static int  tsdbAppendBlock(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile *pDFileAggr, SBlock *pBlock,
+                            void *pData, void *pAggrData, int aggrLen);
+static int  tsdbWriteBlockInfo(SCommitH *pCommih, STable *pTable, SArray *aSupBlk, SArray *aSubBlk);
+static int  tsdbInitCommitLanes(SCommitH *pCommith);
+static void tsdbDestroyCommitLanes(SCommitH *pCommith);
+static int  tsdbCommitToTablesInParallel(SCommitH *pCommith, SDFileSet *pSet);
+static void tsdbCommitTablesOfLane(void *param, int index);
+static int  tsdbAppendCommitTable(SCommitH *pCommith, SCommitTable *pOut);
 static int  tsdbCommitMemData(SCommitH *pCommith, SCommitIter *pIter, TSKEY keyLimit, bool toData);
 static int  tsdbMergeMemData(SCommitH *pCommith, SCommitIter *pIter, int bidx);
 static int  tsdbMoveBlock(SCommitH *pCommith, int bidx);
@@ -94,16 +135,24 @@ static void tsdbLoadAndMergeFromCache(SDataCols *pDataCols, int *iter, SCommitIt
                                       TSKEY maxKey, int maxRows, int8_t update);
 
 void *tsdbCommitData(STsdbRepo *pRepo, bool end) {
+  SArray *aTombUpd = NULL;
+
   if (pRepo->imem == NULL) {
     return NULL;
   }
   tsdbStartCommit(pRepo);
 
   if (tsShortcutFlag & TSDB_SHORTCUT_RB_TSDB_COMMIT) {
-    tsdbEndCommit(pRepo, terrno, end);
+    tsdbEndCommit(pRepo, terrno, end, NULL);
     return NULL;
   }
 
+  aTombUpd = taosArrayInit(0, sizeof(STableTombUpd));
+  if (aTombUpd == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    goto _err;
+  }
+
   // Commit to update meta file
   if (tsdbCommitMeta(pRepo) < 0) {
     tsdbError("vgId:%d error occurs while committing META data since %s", REPO_ID(pRepo), tstrerror(terrno));
@@ -111,19 +160,25 @@ void *tsdbCommitData(STsdbRepo *pRepo, bool end) {
   }
 
   // Create the iterator to read from cache
-  if (tsdbCommitTSData(pRepo) < 0) {
+  if (tsdbCommitTSData(pRepo, aTombUpd) < 0) {
     tsdbError("vgId:%d error occurs while committing TS data since %s", REPO_ID(pRepo), tstrerror(terrno));
     goto _err;
   }
 
-  tsdbEndCommit(pRepo, TSDB_CODE_SUCCESS, end);
+  // The tombstones of the purged rows are removed
+  if (tsdbCommitTombs(pRepo, aTombUpd) < 0) {
+    tsdbError("vgId:%d error occurs while committing tombstones since %s", REPO_ID(pRepo), tstrerror(terrno));
+    goto _err;
+  }
+
+  tsdbEndCommit(pRepo, TSDB_CODE_SUCCESS, end, aTombUpd);
   return NULL;
 
 _err:
   ASSERT(terrno != TSDB_CODE_SUCCESS);
   pRepo->code = terrno;
 
-  tsdbEndCommit(pRepo, terrno, end);
+  tsdbEndCommit(pRepo, terrno, end, aTombUpd);
   return NULL;
 }
 
@@ -304,6 +359,41 @@ static int tsdbInitCommitMetaFile(STsdbRepo *pRepo, SMFile* pMf, bool open) {
   return 0;
 }
 
+// The record of an act has no tombstone, the ones of the table are appended to it, or they are lost with the record
+static int tsdbUpdateTableActRecord(STsdbRepo *pRepo, SMFile *pMFile, uint64_t uid, SActCont *pCont) {
+  STsdbFS *pfs = REPO_FS(pRepo);
+  STable * pTable = NULL;
+  void *   pBuf = NULL;
+  int      tlen;
+  int      code;
+
+  // tombstones are only changed by the commit thread, so they are read without the table lock
+  if (tsdbRLockRepoMeta(pRepo) < 0) return -1;
+  pTable = tsdbGetTableByUid(pRepo->tsdbMeta, uid);
+  if (pTable == NULL || pTable->aTomb == NULL) {
+    tsdbUnlockRepoMeta(pRepo);
+    return tsdbUpdateMetaRecord(pfs, pMFile, uid, (void *)(pCont->cont), pCont->len, false);
+  }
+
+  tlen = pCont->len + tsdbEncodeTableTombs(NULL, pTable->aTomb);
+  pBuf = malloc(tlen);
+  if (pBuf == NULL) {
+    tsdbUnlockRepoMeta(pRepo);
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  void *ptr = POINTER_SHIFT(pBuf, pCont->len - sizeof(TSCKSUM));
+  memcpy(pBuf, pCont->cont, pCont->len - sizeof(TSCKSUM));
+  tsdbEncodeTableTombs(&ptr, pTable->aTomb);
+  taosCalcChecksumAppend(0, (uint8_t *)pBuf, tlen);
+  tsdbUnlockRepoMeta(pRepo);
+
+  code = tsdbUpdateMetaRecord(pfs, pMFile, uid, pBuf, tlen, false);
+  free(pBuf);
+  return code;
+}
+
 static int tsdbCommitMeta(STsdbRepo *pRepo) {
   STsdbFS *  pfs = REPO_FS(pRepo);
   SMemTable *pMem = pRepo->imem;
@@ -339,7 +429,7 @@ static int tsdbCommitMeta(STsdbRepo *pRepo) {
     pAct = (SActObj *)pNode->data;
     if (pAct->act == TSDB_UPDATE_META) {
       pCont = (SActCont *)POINTER_SHIFT(pAct, sizeof(SActObj));
-      if (tsdbUpdateMetaRecord(pfs, &mf, pAct->uid, (void *)(pCont->cont), pCont->len, false) < 0) {
+      if (tsdbUpdateTableActRecord(pRepo, &mf, pAct->uid, pCont) < 0) {
         tsdbError("vgId:%d failed to update META record, uid %" PRIu64 " since %s", REPO_ID(pRepo), pAct->uid,
                   tstrerror(terrno));
         tsdbCloseMFile(&mf);
@@ -379,6 +469,78 @@ static int tsdbCommitMeta(STsdbRepo *pRepo) {
   return 0;
 }
 
+/**
+ * Write the records of the tables with their new tombstones, in the FS transaction of a commit, a delete or a
+ * compaction. The meta file of the transaction is appended, or the current one if the transaction has not set it.
+ */
+int tsdbCommitTombs(STsdbRepo *pRepo, SArray *aUpd) {
+  STsdbFS *  pfs = REPO_FS(pRepo);
+  STsdbMeta *pMeta = pRepo->tsdbMeta;
+  SMFile *   pOMFile = (pfs->nstatus->pmf != NULL) ? pfs->nstatus->pmf : pfs->cstatus->pmf;
+  SMFile     mf;
+  void *     pBuf = NULL;
+
+  if (taosArrayGetSize(aUpd) == 0) return 0;
+
+  // there are tables, so there is the meta file
+  ASSERT(pOMFile != NULL);
+  tsdbInitMFileEx(&mf, pOMFile);
+  if (tsdbOpenMFile(&mf, O_WRONLY) < 0) {
+    tsdbError("vgId:%d failed to open META file since %s", REPO_ID(pRepo), tstrerror(terrno));
+    return -1;
+  }
+
+  for (size_t i = 0; i < taosArrayGetSize(aUpd); i++) {
+    STableTombUpd *pUpd = taosArrayGet(aUpd, i);
+    STable *       pTable = pUpd->pTable;
+    int            tlen;
+
+    // the record of a table dropped would bring it back
+    if (tsdbRLockRepoMeta(pRepo) < 0) goto _err;
+    bool dropped = (TABLE_TID(pTable) >= pMeta->maxTables || pMeta->tables[TABLE_TID(pTable)] != pTable);
+    tsdbUnlockRepoMeta(pRepo);
+    if (dropped) continue;
+
+    TSDB_RLOCK_TABLE(pTable);
+    tlen = tsdbEncodeTableRecord(NULL, pTable, pUpd->aTomb);
+    if (tsdbMakeRoom(&pBuf, tlen) < 0) {
+      TSDB_RUNLOCK_TABLE(pTable);
+      goto _err;
+    }
+    void *ptr = pBuf;
+    tsdbEncodeTableRecord(&ptr, pTable, pUpd->aTomb);
+    TSDB_RUNLOCK_TABLE(pTable);
+
+    if (tsdbUpdateMetaRecord(pfs, &mf, TABLE_UID(pTable), pBuf, tlen, false) < 0) {
+      tsdbError("vgId:%d failed to update META record, uid %" PRIu64 " since %s", REPO_ID(pRepo), TABLE_UID(pTable),
+                tstrerror(terrno));
+      goto _err;
+    }
+  }
+
+  if (tsdbUpdateMFileHeader(&mf) < 0) {
+    tsdbError("vgId:%d failed to update META file header since %s", REPO_ID(pRepo), tstrerror(terrno));
+    goto _err;
+  }
+
+  TSDB_FILE_FSYNC(&mf);
+  tsdbCloseMFile(&mf);
+  if (pfs->nstatus->pmf != NULL) {
+    tsdbInitMFileEx(pfs->nstatus->pmf, &mf);
+  } else {
+    tsdbUpdateMFile(pfs, &mf);
+  }
+
+  taosTZfree(pBuf);
+  return 0;
+
+_err:
+  tsdbCloseMFile(&mf);
+  tsdbApplyMFileChange(&mf, pOMFile);
+  taosTZfree(pBuf);
+  return -1;
+}
+
 int tsdbEncodeKVRecord(void **buf, SKVRecord *pRecord) {
   int tlen = 0;
   tlen += taosEncodeFixedU64(buf, pRecord->uid);
@@ -609,7 +771,7 @@ _err:
 }
 
 // =================== Commit Time-Series Data
-static int tsdbCommitTSData(STsdbRepo *pRepo) {
+static int tsdbCommitTSData(STsdbRepo *pRepo, SArray *aTombUpd) {
   SMemTable *pMem = pRepo->imem;
   SCommitH   commith;
   SDFileSet *pSet = NULL;
@@ -629,6 +791,7 @@ static int tsdbCommitTSData(STsdbRepo *pRepo) {
   if (tsdbInitCommitH(&commith, pRepo) < 0) {
     return -1;
   }
+  commith.aTombUpd = aTombUpd;
 
   // Skip expired memory data and expired FSET
   tsdbSeekCommitIter(&commith, commith.rtn.minKey);
@@ -698,14 +861,30 @@ static void tsdbStartCommit(STsdbRepo *pRepo) {
   pRepo->code = TSDB_CODE_SUCCESS;
 }
 
-static void tsdbEndCommit(STsdbRepo *pRepo, int eno, bool end) {
+static void tsdbEndCommit(STsdbRepo *pRepo, int eno, bool end, SArray *aTombUpd) {
   if (eno != TSDB_CODE_SUCCESS) {
     tsdbEndFSTxnWithError(REPO_FS(pRepo));
   } else {
     tsdbEndFSTxn(pRepo);
   }
 
-  tsdbInfo("vgId:%d commit over, %s", REPO_ID(pRepo), (eno == TSDB_CODE_SUCCESS) ? "succeed" : "failed");
+  // the tombstones are cut with the files purged, before the memory data committed is released
+  if (eno == TSDB_CODE_SUCCESS) {
+    tsdbApplyTombUpds(aTombUpd);
+  } else {
+    tsdbClearTombUpds(aTombUpd);
+  }
+  taosArrayDestroy(&aTombUpd);
+
+  STsdbWriteStat *pStat = &pRepo->writeStat;
+  int64_t         elapsed = taosGetTimestampMs() - pStat->commitStart;
+  if (eno == TSDB_CODE_SUCCESS && pStat->commitBytes > 0) {
+    int64_t rate = pStat->commitBytes * 1000 / MAX(elapsed, 1);
+    pStat->commitRate = (pStat->commitRate == 0) ? rate : (pStat->commitRate + rate) / 2;
+  }
+
+  tsdbInfo("vgId:%d commit over, %s, %" PRId64 " bytes of cache in %" PRId64 "ms", REPO_ID(pRepo),
+           (eno == TSDB_CODE_SUCCESS) ? "succeed" : "failed", pStat->commitBytes, elapsed);
 
   // notify
   if (end && pRepo->appH.notifyStatus) {
@@ -743,23 +922,46 @@ static int tsdbCommitToFile(SCommitH *pCommith, SDFileSet *pSet, int fid) {
   tsdbResetCommitFile(pCommith);
   tsdbGetFidKeyRange(pCfg->daysPerFile, pCfg->precision, fid, &(pCommith->minKey), &(pCommith->maxKey));
 
+  // The tables to purge in the FSET, the tombstones in it are gone with the commit
+  for (int tid = 1; tid < pCommith->niters; tid++) {
+    SCommitIter *pIter = pCommith->iters + tid;
+
+    if (pIter->pTable == NULL || !tsdbShouldPurgeTable(pCommith, pIter->pTable, tsdbNextIterKey(pIter->pIter))) {
+      continue;
+    }
+
+    STableTombUpd *pUpd = tsdbGetTombUpd(pCommith->aTombUpd, pIter->pTable);
+    if (pUpd == NULL || tsdbCutTombs(pUpd->aTomb, pCommith->minKey, pCommith->maxKey) < 0) {
+      return -1;
+    }
+  }
+
   // Set and open files
   if (tsdbSetAndOpenCommitFile(pCommith, pSet, fid) < 0) {
     return -1;
   }
 
   // Loop to commit each table data
-  for (int tid = 1; tid < pCommith->niters; tid++) {
-    SCommitIter *pIter = pCommith->iters + tid;
-
-    if (pIter->pTable == NULL) continue;
-
-    if (tsdbCommitToTable(pCommith, tid) < 0) {
+  if (pCommith->nLanes > 1) {
+    if (tsdbCommitToTablesInParallel(pCommith, pSet) < 0) {
       tsdbCloseCommitFile(pCommith, true);
       // revert the file change
       tsdbApplyDFileSetChange(TSDB_COMMIT_WRITE_FSET(pCommith), pSet);
       return -1;
     }
+  } else {
+    for (int tid = 1; tid < pCommith->niters; tid++) {
+      SCommitIter *pIter = pCommith->iters + tid;
+
+      if (pIter->pTable == NULL) continue;
+
+      if (tsdbCommitToTable(pCommith, tid) < 0) {
+        tsdbCloseCommitFile(pCommith, true);
+        // revert the file change
+        tsdbApplyDFileSetChange(TSDB_COMMIT_WRITE_FSET(pCommith), pSet);
+        return -1;
+      }
+    }
   }
 
   if (tsdbWriteBlockIdx(TSDB_COMMIT_HEAD_FILE(pCommith), pCommith->aBlkIdx, (void **)(&(TSDB_COMMIT_BUF(pCommith)))) <
@@ -789,6 +991,211 @@ static int tsdbCommitToFile(SCommitH *pCommith, SDFileSet *pSet, int fid) {
   return 0;
 }
 
+/**
+ * A commit with the apply threads goes through the tables of a FSET in rounds. The lanes, one for each apply thread
+ * and one for the commit thread, take the tables of a round, merge and encode their blocks in memory. Then the commit
+ * thread appends the blocks to the files and writes the block info table by table in tid order, so the files are the
+ * same as the ones of a commit by one thread.
+ */
+static int tsdbInitCommitLanes(SCommitH *pCommith) {
+  STsdbRepo *pRepo = TSDB_COMMIT_REPO(pCommith);
+  STsdbCfg * pCfg = REPO_CFG(pRepo);
+  int        nTables = 0;
+
+  pCommith->nLanes = 0;
+  if (tsdbGetApplyThreads() <= 0) return 0;
+
+  for (int tid = 1; tid < pCommith->niters; tid++) {
+    if (pCommith->iters[tid].pTable != NULL) nTables++;
+  }
+  if (nTables < 2) return 0;
+
+  int nLanes = MIN(tsdbGetApplyThreads() + 1, nTables);
+  int nSlots = nLanes * TSDB_COMMIT_TABLES_PER_LANE;
+
+  pCommith->lanes = (SCommitH *)calloc(nLanes, sizeof(SCommitH));
+  pCommith->tables = (SCommitTable *)calloc(nSlots, sizeof(SCommitTable));
+  if (pCommith->lanes == NULL || pCommith->tables == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+  pCommith->nLanes = nLanes;
+
+  for (int i = 0; i < nLanes; i++) {
+    SCommitH *pLane = pCommith->lanes + i;
+
+    TSDB_FSET_SET_CLOSED(TSDB_COMMIT_WRITE_FSET(pLane));
+    if (tsdbInitReadH(&(pLane->readh), pRepo) < 0) return -1;
+
+    pLane->rtn = pCommith->rtn;
+    pLane->niters = pCommith->niters;
+    pLane->iters = pCommith->iters;
+    pLane->pDataCols = tdNewDataCols(0, pCfg->maxRowsPerFileBlock);
+    if (pLane->pDataCols == NULL) {
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+  }
+
+  for (int i = 0; i < nSlots; i++) {
+    SCommitTable *pOut = pCommith->tables + i;
+
+    pOut->aSupBlk = taosArrayInit(64, sizeof(SBlock));
+    pOut->aSubBlk = taosArrayInit(64, sizeof(SBlock));
+    pOut->aNewBlk = taosArrayInit(64, sizeof(SCommitNewBlk));
+    if (pOut->aSupBlk == NULL || pOut->aSubBlk == NULL || pOut->aNewBlk == NULL) {
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+  }
+
+  tsdbDebug("vgId:%d commit %d tables with %d lanes", REPO_ID(pRepo), nTables, nLanes);
+
+  return 0;
+}
+
+static void tsdbDestroyCommitLanes(SCommitH *pCommith) {
+  if (pCommith->tables != NULL) {
+    for (int i = 0; i < pCommith->nLanes * TSDB_COMMIT_TABLES_PER_LANE; i++) {
+      SCommitTable *pOut = pCommith->tables + i;
+
+      pOut->aSupBlk = taosArrayDestroy(&pOut->aSupBlk);
+      pOut->aSubBlk = taosArrayDestroy(&pOut->aSubBlk);
+      pOut->aNewBlk = taosArrayDestroy(&pOut->aNewBlk);
+      pOut->pBuf = taosTZfree(pOut->pBuf);
+    }
+  }
+
+  if (pCommith->lanes != NULL) {
+    for (int i = 0; i < pCommith->nLanes; i++) {
+      SCommitH *pLane = pCommith->lanes + i;
+
+      // the iterators and the arrays of blocks are not owned by the lane
+      pLane->pDataCols = tdFreeDataCols(pLane->pDataCols);
+      if (pLane->readh.pRepo != NULL) tsdbDestroyReadH(&(pLane->readh));
+    }
+  }
+
+  tfree(pCommith->lanes);
+  tfree(pCommith->tables);
+  pCommith->nLanes = 0;
+}
+
+static int tsdbCommitToTablesInParallel(SCommitH *pCommith, SDFileSet *pSet) {
+  int code = 0;
+  int tid = 1;
+
+  for (int i = 0; i < pCommith->nLanes; i++) {
+    SCommitH *pLane = pCommith->lanes + i;
+
+    pLane->isRFileSet = pCommith->isRFileSet;
+    pLane->isDFileSame = pCommith->isDFileSame;
+    pLane->isLFileSame = pCommith->isLFileSame;
+    pLane->minKey = pCommith->minKey;
+    pLane->maxKey = pCommith->maxKey;
+
+    if (pLane->isRFileSet) {
+      if (tsdbSetAndOpenReadFSet(&(pLane->readh), pSet) < 0) {
+        code = -1;
+        break;
+      }
+
+      if (taosArrayAddAll(pLane->readh.aBlkIdx, pCommith->readh.aBlkIdx) == NULL) {
+        terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+        code = -1;
+        break;
+      }
+    }
+  }
+
+  while (code == 0 && tid < pCommith->niters) {
+    pCommith->nTables = 0;
+    pCommith->nextTable = 0;
+    for (; tid < pCommith->niters && pCommith->nTables < pCommith->nLanes * TSDB_COMMIT_TABLES_PER_LANE; tid++) {
+      if (pCommith->iters[tid].pTable == NULL) continue;
+      pCommith->tables[pCommith->nTables++].tid = tid;
+    }
+
+    if (tsdbApplyInParallel(tsdbCommitTablesOfLane, pCommith, pCommith->nLanes) < 0) {
+      for (int i = 0; i < pCommith->nLanes; i++) {
+        tsdbCommitTablesOfLane(pCommith, i);
+      }
+    }
+
+    for (int i = 0; i < pCommith->nTables; i++) {
+      if (tsdbAppendCommitTable(pCommith, pCommith->tables + i) < 0) {
+        code = -1;
+        break;
+      }
+    }
+  }
+
+  for (int i = 0; i < pCommith->nLanes; i++) {
+    SCommitH *pLane = pCommith->lanes + i;
+    if (pLane->isRFileSet) {
+      tsdbCloseAndUnsetFSet(&(pLane->readh));
+    }
+  }
+
+  return code;
+}
+
+static void tsdbCommitTablesOfLane(void *param, int index) {
+  SCommitH *pCommith = (SCommitH *)param;
+  SCommitH *pLane = pCommith->lanes + index;
+
+  while (true) {
+    int i = atomic_fetch_add_32(&(pCommith->nextTable), 1);
+    if (i >= pCommith->nTables) break;
+
+    SCommitTable *pOut = pCommith->tables + i;
+    pLane->pOut = pOut;
+    pLane->aSupBlk = pOut->aSupBlk;
+    pLane->aSubBlk = pOut->aSubBlk;
+
+    pOut->code = (tsdbCommitToTable(pLane, pOut->tid) < 0) ? terrno : TSDB_CODE_SUCCESS;
+  }
+
+  pLane->pOut = NULL;
+  pLane->aSupBlk = NULL;
+  pLane->aSubBlk = NULL;
+}
+
+// Append the blocks encoded by a lane to the files and write the block info of the table
+static int tsdbAppendCommitTable(SCommitH *pCommith, SCommitTable *pOut) {
+  STsdbRepo *pRepo = TSDB_COMMIT_REPO(pCommith);
+  STable *   pTable = pCommith->iters[pOut->tid].pTable;
+  int64_t    pos = 0;
+
+  if (pOut->code != TSDB_CODE_SUCCESS) {
+    terrno = pOut->code;
+    tsdbError("vgId:%d failed to commit table %d since %s", REPO_ID(pRepo), pOut->tid, tstrerror(terrno));
+    return -1;
+  }
+
+  for (size_t i = 0; i < taosArrayGetSize(pOut->aNewBlk); i++) {
+    SCommitNewBlk *pNewBlk = taosArrayGet(pOut->aNewBlk, i);
+    SBlock *       pBlock = taosArrayGet(pNewBlk->inSub ? pOut->aSubBlk : pOut->aSupBlk, pNewBlk->idx);
+    void *         pData = POINTER_SHIFT(pOut->pBuf, pos);
+
+    ASSERT(pNewBlk->idx >= 0);
+    if (tsdbAppendBlock(pRepo, pTable, pBlock->last ? TSDB_COMMIT_LAST_FILE(pCommith) : TSDB_COMMIT_DATA_FILE(pCommith),
+                        pBlock->last ? TSDB_COMMIT_SMAL_FILE(pCommith) : TSDB_COMMIT_SMAD_FILE(pCommith), pBlock, pData,
+                        POINTER_SHIFT(pData, pNewBlk->len), pNewBlk->aggrLen) < 0) {
+      return -1;
+    }
+    pos += pNewBlk->len + pNewBlk->aggrLen;
+  }
+
+  if (tsdbWriteBlockInfo(pCommith, pTable, pOut->aSupBlk, pOut->aSubBlk) < 0) {
+    tsdbError("vgId:%d failed to write SBlockInfo part into file %s since %s", REPO_ID(pRepo),
+              TSDB_FILE_FULL_NAME(TSDB_COMMIT_HEAD_FILE(pCommith)), tstrerror(terrno));
+    return -1;
+  }
+
+  return 0;
+}
+
 static int tsdbCreateCommitIters(SCommitH *pCommith) {
   STsdbRepo *pRepo = TSDB_COMMIT_REPO(pCommith);
   SMemTable *pMem = pRepo->imem;
@@ -816,12 +1223,12 @@ static int tsdbCreateCommitIters(SCommitH *pCommith) {
   for (int i = 0; i < pMem->maxTables; i++) {
     if ((pCommith->iters[i].pTable != NULL) && (pMem->tData[i] != NULL) &&
         (TABLE_UID(pCommith->iters[i].pTable) == pMem->tData[i]->uid)) {
-      if ((pCommith->iters[i].pIter = tSkipListCreateIter(pMem->tData[i]->pData)) == NULL) {
+      if ((pCommith->iters[i].pIter = tsdbCreateTableDataIter(pMem->tData[i], TSDB_ORDER_ASC)) == NULL) {
         terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
         return -1;
       }
 
-      tSkipListIterNext(pCommith->iters[i].pIter);
+      tsdbTableDataIterNext(pCommith->iters[i].pIter);
     }
   }
 
@@ -834,7 +1241,7 @@ static void tsdbDestroyCommitIters(SCommitH *pCommith) {
   for (int i = 1; i < pCommith->niters; i++) {
     if (pCommith->iters[i].pTable != NULL) {
       tsdbUnRefTable(pCommith->iters[i].pTable);
-      tSkipListDestroyIter(pCommith->iters[i].pIter);
+      tsdbDestroyTableDataIter(pCommith->iters[i].pIter);
     }
   }
 
@@ -902,10 +1309,16 @@ static int tsdbInitCommitH(SCommitH *pCommith, STsdbRepo *pRepo) {
     return -1;
   }
 
+  if (tsdbInitCommitLanes(pCommith) < 0) {
+    tsdbDestroyCommitH(pCommith);
+    return -1;
+  }
+
   return 0;
 }
 
 static void tsdbDestroyCommitH(SCommitH *pCommith) {
+  tsdbDestroyCommitLanes(pCommith);
   pCommith->pDataCols = tdFreeDataCols(pCommith->pDataCols);
   pCommith->aSubBlk = taosArrayDestroy(&pCommith->aSubBlk);
   pCommith->aSupBlk = taosArrayDestroy(&pCommith->aSupBlk);
@@ -952,6 +1365,9 @@ static int tsdbCommitToTable(SCommitH *pCommith, int tid) {
     return -1;
   }
 
+  // the deleted rows are dropped from the blocks rewritten, see tsdbCommitToFile
+  pCommith->readh.aTomb = tsdbShouldPurgeTable(pCommith, pIter->pTable, nextKey) ? pIter->pTable->aTomb : NULL;
+
   // No disk data and no memory data, just return
   if (pCommith->readh.pBlkIdx == NULL && (nextKey == TSDB_DATA_TIMESTAMP_NULL || nextKey > pCommith->maxKey)) {
     TSDB_RUNLOCK_TABLE(pIter->pTable);
@@ -1029,7 +1445,10 @@ static int tsdbCommitToTable(SCommitH *pCommith, int tid) {
 
   TSDB_RUNLOCK_TABLE(pIter->pTable);
 
-  if (tsdbWriteBlockInfo(pCommith) < 0) {
+  // the commit thread writes the block info of a lane's table after the blocks
+  if (pCommith->pOut != NULL) return 0;
+
+  if (tsdbWriteBlockInfo(pCommith, pCommith->pTable, pCommith->aSupBlk, pCommith->aSubBlk) < 0) {
     tsdbError("vgId:%d failed to write SBlockInfo part into file %s since %s", TSDB_COMMIT_REPO_ID(pCommith),
               TSDB_FILE_FULL_NAME(TSDB_COMMIT_HEAD_FILE(pCommith)), tstrerror(terrno));
     return -1;
@@ -1058,6 +1477,16 @@ static int tsdbSetCommitTable(SCommitH *pCommith, STable *pTable) {
   return 0;
 }
 
+/**
+ * Rows committed to a deleted range would be masked by the tombstones, so the deleted rows of a table in a FSET are
+ * purged when it has memory data to commit to the FSET, then the tombstones in the FSET are cut. The tombstones are
+ * only changed by the commit thread, and not before the FS transaction ends, so they are read without the table lock.
+ */
+static bool tsdbShouldPurgeTable(SCommitH *pCommith, STable *pTable, TSKEY nextKey) {
+  return nextKey != TSDB_DATA_TIMESTAMP_NULL && nextKey <= pCommith->maxKey &&
+         tsdbTombsOverlap(pTable->aTomb, pCommith->minKey, pCommith->maxKey);
+}
+
 static int tsdbComparKeyBlock(const void *arg1, const void *arg2) {
   TSKEY   key = *(TSKEY *)arg1;
   SBlock *pBlock = (SBlock *)arg2;
@@ -1071,12 +1500,73 @@ static int tsdbComparKeyBlock(const void *arg1, const void *arg2) {
   }
 }
 
+/**
+ * Choose frame of reference + bit-packing for an integer column if it is smaller than what the type's codec put in
+ * tptr, and return the final compressed length. The choice is recorded in the column data itself, so it is made per
+ * column per block.
+ */
+static int tsdbCompressColFOR(SDataCol *pDataCol, int rowsToWrite, void *tptr, int flen, int tsize, int8_t compression,
+                              void **ppCBuf) {
+  int8_t type = pDataCol->type;
+
+  // unsigned integers are compressed as the signed ones of the same width
+  if (IS_UNSIGNED_NUMERIC_TYPE(type)) type = type - TSDB_DATA_TYPE_UTINYINT + TSDB_DATA_TYPE_TINYINT;
+  if (!IS_SIGNED_NUMERIC_TYPE(type)) return flen;
+
+  int forLen = tsGetINTForSize((char *)pDataCol->pData, rowsToWrite, type);
+  if (forLen < 0 || forLen > tsize) return flen;
+
+  if (!IS_TWO_STAGE_COMP(compression)) {
+    if (forLen >= flen) return flen;
+    return tsCompressIntegerFOR((char *)pDataCol->pData, rowsToWrite, tptr, tsize, compression, *ppCBuf, type);
+  }
+
+  // the size after the second stage is only known by compressing, so compress behind the first stage buffer
+  if (tsdbMakeRoom(ppCBuf, tsize * 2) < 0) return flen;
+
+  char *output = POINTER_SHIFT(*ppCBuf, tsize);
+  int   len = tsCompressIntegerFOR((char *)pDataCol->pData, rowsToWrite, output, tsize, compression, *ppCBuf, type);
+  if (len <= 0 || len >= flen) return flen;
+
+  memcpy(tptr, output, len);
+  return len;
+}
+
+/**
+ * Choose dictionary encoding for a binary or nchar column if it has few distinct values and is smaller than the LZ4
+ * output in tptr, and return the final compressed length.
+ */
+static int tsdbCompressColDict(SDataCol *pDataCol, int rowsToWrite, void *tptr, int flen, void *pCBuf, int cbufSize) {
+  if (!IS_VAR_DATA_TYPE(pDataCol->type)) return flen;
+
+  int dlen = tsCompressStringDictImp((char *)pDataCol->pData, dataColGetNEleLen(pDataCol, rowsToWrite), rowsToWrite,
+                                     pCBuf, MIN(flen - 1, cbufSize));
+  if (dlen < 0) return flen;
+
+  memcpy(tptr, pCBuf, dlen);
+  return dlen;
+}
+
 int tsdbWriteBlockImpl(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile *pDFileAggr, SDataCols *pDataCols,
                        SBlock *pBlock, bool isLast, bool isSuper, void **ppBuf, void **ppCBuf, void **ppExBuf) {
+  int aggrLen = 0;
+
+  if (tsdbEncodeBlock(pRepo, pTable, pDataCols, pBlock, isLast, isSuper, ppBuf, ppCBuf, ppExBuf, &aggrLen) < 0) {
+    return -1;
+  }
+
+  return tsdbAppendBlock(pRepo, pTable, pDFile, pDFileAggr, pBlock, *ppBuf, *ppExBuf, aggrLen);
+}
+
+/**
+ * Encode the data part of a block into *ppBuf and the aggregate part into *ppExBuf, pBlock is set except the offsets
+ * in the files. The length of the data part is pBlock->len, and the one of the aggregate part is *pAggrLen.
+ */
+static int tsdbEncodeBlock(STsdbRepo *pRepo, STable *pTable, SDataCols *pDataCols, SBlock *pBlock, bool isLast,
+                           bool isSuper, void **ppBuf, void **ppCBuf, void **ppExBuf, int *pAggrLen) {
   STsdbCfg *  pCfg = REPO_CFG(pRepo);
   SBlockData *pBlockData;
   SAggrBlkData *pAggrBlkData = NULL;
-  int64_t     offset = 0, offsetAggr = 0;
   int         rowsToWrite = pDataCols->numOfRows;
 
   ASSERT(rowsToWrite > 0 && rowsToWrite <= pCfg->maxRowsPerFileBlock);
@@ -1156,7 +1646,7 @@ int tsdbWriteBlockImpl(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile
     pBlockCol = pBlockData->cols + tcol;
     tptr = POINTER_SHIFT(pBlockData, lsize);
 
-    if (pCfg->compression == TWO_STAGE_COMP &&
+    if ((IS_TWO_STAGE_COMP(pCfg->compression) || IS_VAR_DATA_TYPE(pDataCol->type)) &&
         tsdbMakeRoom(ppCBuf, tlen + COMP_OVERFLOW_BYTES) < 0) {
       return -1;
     }
@@ -1166,6 +1656,9 @@ int tsdbWriteBlockImpl(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile
       flen = (*(tDataTypes[pDataCol->type].compFunc))((char *)pDataCol->pData, tlen, rowsToWrite, tptr,
                                                       tlen + COMP_OVERFLOW_BYTES, pCfg->compression, *ppCBuf,
                                                       tlen + COMP_OVERFLOW_BYTES);
+      flen = tsdbCompressColFOR(pDataCol, rowsToWrite, tptr, flen, tlen + COMP_OVERFLOW_BYTES, pCfg->compression,
+                                ppCBuf);
+      flen = tsdbCompressColDict(pDataCol, rowsToWrite, tptr, flen, *ppCBuf, tlen + COMP_OVERFLOW_BYTES);
     } else {
       flen = tlen;
       memcpy(tptr, pDataCol->pData, flen);
@@ -1175,7 +1668,6 @@ int tsdbWriteBlockImpl(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile
     ASSERT(flen > 0);
     flen += sizeof(TSCKSUM);
     taosCalcChecksumAppend(0, (uint8_t *)tptr, flen);
-    tsdbUpdateDFileMagic(pDFile, POINTER_SHIFT(tptr, flen - sizeof(TSCKSUM)));
 
     if (ncol != 0) {
       tsdbSetBlockColOffset(pBlockCol, toffset);
@@ -1194,28 +1686,24 @@ int tsdbWriteBlockImpl(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile
   pBlockData->numOfCols = nColsNotAllNull;
 
   taosCalcChecksumAppend(0, (uint8_t *)pBlockData, tsize);
-  tsdbUpdateDFileMagic(pDFile, POINTER_SHIFT(pBlockData, tsize - sizeof(TSCKSUM)));
-
-  // Write the whole block to file
-  if (tsdbAppendDFile(pDFile, (void *)pBlockData, lsize, &offset) < lsize) {
-    return -1;
-  }
 
   uint32_t aggrStatus = nColsNotAllNull > 0 ? 1 : 0;
+  int      bloomLen = 0;
+  *pAggrLen = 0;
   if (aggrStatus > 0) {
-
     taosCalcChecksumAppend(0, (uint8_t *)pAggrBlkData, tsizeAggr);
-    tsdbUpdateDFileMagic(pDFileAggr, POINTER_SHIFT(pAggrBlkData, tsizeAggr - sizeof(TSCKSUM)));
 
-    // Write the whole block to file
-    if (tsdbAppendDFile(pDFileAggr, (void *)pAggrBlkData, tsizeAggr, &offsetAggr) < tsizeAggr) {
+    // The bloom part, if any, follows the aggregate part
+    bloomLen = tsdbBuildBlockBloom(pDataCols, rowsToWrite, ppExBuf, tsizeAggr);
+    if (bloomLen < 0) {
       return -1;
     }
+    *pAggrLen = tsizeAggr + bloomLen;
   }
 
   // Update pBlock membership variables
   pBlock->last = isLast;
-  pBlock->offset = offset;
+  pBlock->offset = 0;
   pBlock->algorithm = pCfg->compression;
   pBlock->numOfRows = rowsToWrite;
   pBlock->len = lsize;
@@ -1226,32 +1714,100 @@ int tsdbWriteBlockImpl(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile
   pBlock->keyLast = dataColsKeyLast(pDataCols);
   // since blkVer1
   pBlock->aggrStat = aggrStatus;
-  pBlock->blkVer = SBlockVerLatest;
+  pBlock->blkVer = (bloomLen > 0) ? TSDB_SBLK_VER_2 : SBlockVerLatest;
+  pBlock->aggrOffset = 0;
+
+  return 0;
+}
+
+// Append a block encoded by tsdbEncodeBlock to the files, and set the offsets of pBlock
+static int tsdbAppendBlock(STsdbRepo *pRepo, STable *pTable, SDFile *pDFile, SDFile *pDFileAggr, SBlock *pBlock,
+                           void *pData, void *pAggrData, int aggrLen) {
+  SBlockData *pBlockData = (SBlockData *)pData;
+  int32_t     tsize = (int32_t)tsdbBlockStatisSize(pBlock->numOfCols, SBlockVerLatest);
+  int64_t     offset = 0, offsetAggr = 0;
+
+  // The magic goes over the checksums in the order they are calculated: the key column, the other columns, the head
+  tsdbUpdateDFileMagic(pDFile, POINTER_SHIFT(pData, tsize + pBlock->keyLen - sizeof(TSCKSUM)));
+  for (int i = 0; i < pBlock->numOfCols; i++) {
+    SBlockCol *pBlockCol = pBlockData->cols + i;
+    tsdbUpdateDFileMagic(
+        pDFile, POINTER_SHIFT(pData, tsize + tsdbGetBlockColOffset(pBlockCol) + pBlockCol->len - sizeof(TSCKSUM)));
+  }
+  tsdbUpdateDFileMagic(pDFile, POINTER_SHIFT(pData, tsize - sizeof(TSCKSUM)));
+
+  // Write the whole block to file
+  if (tsdbAppendDFile(pDFile, pData, pBlock->len, &offset) < pBlock->len) {
+    return -1;
+  }
+
+  if (aggrLen > 0) {
+    int32_t tsizeAggr = (int32_t)tsdbBlockAggrSize(pBlock->numOfCols, SBlockVerLatest);
+
+    tsdbUpdateDFileMagic(pDFileAggr, POINTER_SHIFT(pAggrData, tsizeAggr - sizeof(TSCKSUM)));
+    if (aggrLen > tsizeAggr) {
+      tsdbUpdateDFileMagic(pDFileAggr, POINTER_SHIFT(pAggrData, aggrLen - sizeof(TSCKSUM)));
+    }
+
+    // Write the whole block to file
+    if (tsdbAppendDFile(pDFileAggr, pAggrData, aggrLen, &offsetAggr) < aggrLen) {
+      return -1;
+    }
+  }
+
+  pBlock->offset = offset;
   pBlock->aggrOffset = (uint64_t)offsetAggr;
 
   tsdbDebug("vgId:%d tid:%d a block of data is written to file %s, offset %" PRId64
             " numOfRows %d len %d numOfCols %" PRId16 " keyFirst %" PRId64 " keyLast %" PRId64,
-            REPO_ID(pRepo), TABLE_TID(pTable), TSDB_FILE_FULL_NAME(pDFile), offset, rowsToWrite, pBlock->len,
+            REPO_ID(pRepo), TABLE_TID(pTable), TSDB_FILE_FULL_NAME(pDFile), offset, pBlock->numOfRows, pBlock->len,
             pBlock->numOfCols, pBlock->keyFirst, pBlock->keyLast);
 
   return 0;
 }
 
+// A lane keeps the encoded block in the output of the table, to be appended by the commit thread
+static int tsdbEncodeCommitBlock(SCommitH *pCommith, SDataCols *pDataCols, SBlock *pBlock, bool isLast, bool isSuper) {
+  SCommitTable *pOut = pCommith->pOut;
+  SCommitNewBlk newBlk = {.inSub = 0, .idx = -1};
+
+  if (tsdbEncodeBlock(TSDB_COMMIT_REPO(pCommith), TSDB_COMMIT_TABLE(pCommith), pDataCols, pBlock, isLast, isSuper,
+                      (void **)(&(TSDB_COMMIT_BUF(pCommith))), (void **)(&(TSDB_COMMIT_COMP_BUF(pCommith))),
+                      (void **)(&(TSDB_COMMIT_EXBUF(pCommith))), &(newBlk.aggrLen)) < 0) {
+    return -1;
+  }
+  newBlk.len = pBlock->len;
+
+  if (tsdbMakeRoom(&(pOut->pBuf), pOut->size + newBlk.len + newBlk.aggrLen) < 0) return -1;
+  memcpy(POINTER_SHIFT(pOut->pBuf, pOut->size), TSDB_COMMIT_BUF(pCommith), newBlk.len);
+  memcpy(POINTER_SHIFT(pOut->pBuf, pOut->size + newBlk.len), TSDB_COMMIT_EXBUF(pCommith), newBlk.aggrLen);
+
+  if (taosArrayPush(pOut->aNewBlk, &newBlk) == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+  pOut->size += newBlk.len + newBlk.aggrLen;
+
+  return 0;
+}
+
 static int tsdbWriteBlock(SCommitH *pCommith, SDFile *pDFile, SDataCols *pDataCols, SBlock *pBlock, bool isLast,
                           bool isSuper) {
+  if (pCommith->pOut != NULL) {
+    return tsdbEncodeCommitBlock(pCommith, pDataCols, pBlock, isLast, isSuper);
+  }
+
   return tsdbWriteBlockImpl(TSDB_COMMIT_REPO(pCommith), TSDB_COMMIT_TABLE(pCommith), pDFile,
                             isLast ? TSDB_COMMIT_SMAL_FILE(pCommith) : TSDB_COMMIT_SMAD_FILE(pCommith), pDataCols,
                             pBlock, isLast, isSuper, (void **)(&(TSDB_COMMIT_BUF(pCommith))),
                             (void **)(&(TSDB_COMMIT_COMP_BUF(pCommith))), (void **)(&(TSDB_COMMIT_EXBUF(pCommith))));
 }
 
-static int tsdbWriteBlockInfo(SCommitH *pCommih) {
+static int tsdbWriteBlockInfo(SCommitH *pCommih, STable *pTable, SArray *aSupBlk, SArray *aSubBlk) {
   SDFile *  pHeadf = TSDB_COMMIT_HEAD_FILE(pCommih);
   SBlockIdx blkIdx;
-  STable *  pTable = TSDB_COMMIT_TABLE(pCommih);
 
-  if (tsdbWriteBlockInfoImpl(pHeadf, pTable, pCommih->aSupBlk, pCommih->aSubBlk, (void **)(&(TSDB_COMMIT_BUF(pCommih))),
-                             &blkIdx) < 0) {
+  if (tsdbWriteBlockInfoImpl(pHeadf, pTable, aSupBlk, aSubBlk, (void **)(&(TSDB_COMMIT_BUF(pCommih))), &blkIdx) < 0) {
     return -1;
   }
 
@@ -1318,23 +1874,26 @@ static int tsdbMergeMemData(SCommitH *pCommith, SCommitIter *pIter, int bidx) {
     keyLimit = pBlock[1].keyFirst - 1;
   }
 
-  SSkipListIterator titer = *(pIter->pIter);
+  STableDataIter titer = *(pIter->pIter);
   if (tsdbLoadBlockDataCols(&(pCommith->readh), pBlock, NULL, &colId, 1) < 0) return -1;
 
   tsdbLoadDataFromCache(pIter->pTable, &titer, keyLimit, INT32_MAX, NULL, pCommith->readh.pDCols[0]->cols[0].pData,
                         pCommith->readh.pDCols[0]->numOfRows, pCfg->update, &mInfo);
 
+  // the deleted rows in a block can not be kept under a sub-block
+  bool masked = tsdbTombsOverlap(pCommith->readh.aTomb, pBlock->keyFirst, pBlock->keyLast);
+
   if (mInfo.nOperations == 0) {
     // no new data to insert (all updates denied)
     if (tsdbMoveBlock(pCommith, bidx) < 0) {
       return -1;
     }
     *(pIter->pIter) = titer;
-  } else if (pBlock->numOfRows + mInfo.rowsInserted - mInfo.rowsDeleteSucceed == 0) {
+  } else if (pCommith->readh.pDCols[0]->numOfRows + mInfo.rowsInserted - mInfo.rowsDeleteSucceed == 0) {
     // Ignore the block
     ASSERT(0);
     *(pIter->pIter) = titer;
-  } else if (tsdbCanAddSubBlock(pCommith, pBlock, &mInfo)) {
+  } else if (!masked && tsdbCanAddSubBlock(pCommith, pBlock, &mInfo)) {
     // Add a sub-block
     tsdbLoadDataFromCache(pIter->pTable, pIter->pIter, keyLimit, INT32_MAX, pCommith->pDataCols,
                           pCommith->readh.pDCols[0]->cols[0].pData, pCommith->readh.pDCols[0]->numOfRows, pCfg->update,
@@ -1387,7 +1946,13 @@ static int tsdbMoveBlock(SCommitH *pCommith, int bidx) {
     isSameFile = pCommith->isDFileSame;
   }
 
-  if (isSameFile) {
+  if (tsdbTombsOverlap(pCommith->readh.aTomb, pBlock->keyFirst, pBlock->keyLast)) {
+    // rewrite the rows left after the deleted ones are dropped
+    if (tsdbLoadBlockData(&(pCommith->readh), pBlock, NULL) < 0) return -1;
+    if (pCommith->readh.pDCols[0]->numOfRows == 0) return 0;
+    if (tsdbWriteBlock(pCommith, pDFile, pCommith->readh.pDCols[0], &block, pBlock->last, true) < 0) return -1;
+    if (tsdbCommitAddBlock(pCommith, &block, NULL, 0) < 0) return -1;
+  } else if (isSameFile) {
     if (pBlock->numOfSubBlocks == 1) {
       if (tsdbCommitAddBlock(pCommith, pBlock, NULL, 0) < 0) {
         return -1;
@@ -1411,6 +1976,16 @@ static int tsdbMoveBlock(SCommitH *pCommith, int bidx) {
 }
 
 static int tsdbCommitAddBlock(SCommitH *pCommith, const SBlock *pSupBlock, const SBlock *pSubBlocks, int nSubBlocks) {
+  if (pCommith->pOut != NULL) {
+    // the block just encoded is the super block, or the last one of the sub-blocks
+    SCommitNewBlk *pNewBlk = taosArrayGetLast(pCommith->pOut->aNewBlk);
+    if (pNewBlk != NULL && pNewBlk->idx < 0) {
+      pNewBlk->inSub = (pSubBlocks != NULL);
+      pNewBlk->idx = (int32_t)(pNewBlk->inSub ? taosArrayGetSize(pCommith->aSubBlk) + nSubBlocks - 1
+                                              : taosArrayGetSize(pCommith->aSupBlk));
+    }
+  }
+
   if (taosArrayPush(pCommith->aSupBlk, pSupBlock) == NULL) {
     terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
     return -1;
@@ -1497,7 +2072,7 @@ static void tsdbLoadAndMergeFromCache(SDataCols *pDataCols, int *iter, SCommitIt
 
       tdAppendMemRowToDataCol(row, pSchema, pTarget, true, 0);
 
-      tSkipListIterNext(pCommitIter->pIter);
+      tsdbTableDataIterNext(pCommitIter->pIter);
     } else {
       if (update != TD_ROW_OVERWRITE_UPDATE) {
         //copy disk data
@@ -1521,7 +2096,7 @@ static void tsdbLoadAndMergeFromCache(SDataCols *pDataCols, int *iter, SCommitIt
                                 update != TD_ROW_PARTIAL_UPDATE ? 0 : -1);
       }
       (*iter)++;
-      tSkipListIterNext(pCommitIter->pIter);
+      tsdbTableDataIterNext(pCommitIter->pIter);
     }
 
     if (pTarget->numOfRows >= maxRows) break;
@@ -1539,6 +2114,10 @@ static void tsdbResetCommitTable(SCommitH *pCommith) {
   taosArrayClear(pCommith->aSubBlk);
   taosArrayClear(pCommith->aSupBlk);
   pCommith->pTable = NULL;
+  if (pCommith->pOut != NULL) {
+    taosArrayClear(pCommith->pOut->aNewBlk);
+    pCommith->pOut->size = 0;
+  }
 }
 
 static int tsdbSetAndOpenCommitFile(SCommitH *pCommith, SDFileSet *pSet, int fid) {
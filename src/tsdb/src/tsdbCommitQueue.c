@@ -116,6 +116,17 @@ int tsdbScheduleCommit(STsdbRepo *pRepo, void *param, TSDB_REQ_T req) {
   return 0;
 }
 
+// Whether requests are waiting for a commit thread, which the long tasks on the threads give way to
+bool tsdbCommitQueueBusy() {
+  SCommitQueue *pQueue = &tsCommitQueue;
+
+  pthread_mutex_lock(&(pQueue->lock));
+  bool busy = (listNEles(pQueue->queue) > 0);
+  pthread_mutex_unlock(&(pQueue->lock));
+
+  return busy;
+}
+
 static void tsdbApplyRepoConfig(STsdbRepo *pRepo) {
   pthread_mutex_lock(&pRepo->save_mutex);
 
@@ -189,9 +200,21 @@ static void *tsdbLoopCommit(void *arg) {
     param = ((SReq *)pNode->data)->param;
 
     if (req == COMMIT_REQ) {
-      tsdbCommitData(pRepo, true);
+      // the fragmented FSETs are compacted before the next commit may start, unless the commit failed
+      bool autoCompact = tsdbShouldAutoCompact(pRepo);
+      tsdbCommitData(pRepo, !autoCompact);
+      if (autoCompact) {
+        if (pRepo->appH.notifyStatus) {
+          pRepo->appH.notifyStatus(pRepo->appH.appH, TSDB_STATUS_COMMIT_OVER, pRepo->code);
+        }
+        if (pRepo->code == TSDB_CODE_SUCCESS) {
+          tsdbCompactImpl(pRepo, true);
+        } else {
+          tsem_post(&(pRepo->readyToCommit));
+        }
+      }
     } else if (req == COMPACT_REQ) {
-      tsdbCompactImpl(pRepo);
+      tsdbCompactImpl(pRepo, false);
     } else if (req == COMMIT_BOTH_REQ) {
       SControlDataInfo* pCtlDataInfo = (SControlDataInfo* )param;
       if(!pCtlDataInfo->memNull) {
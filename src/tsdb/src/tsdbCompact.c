@@ -30,6 +30,11 @@ typedef struct {
   SArray *   aBlkIdx;
   SArray *   aSupBlk;
   SDataCols *pDataCols;
+  SArray *   aTombUpd;  // STableTombUpd, tombstones cut by the file sets purged
+  bool       autoCompact;
+  bool       yielded;  // auto compaction gives way to the next commit, the FSETs left are kept as they are
+  int64_t    startMs;
+  int64_t    written;  // bytes written, to limit the speed of auto compaction
 } SCompactH;
 
 #define TSDB_COMPACT_WSET(pComph) (&((pComph)->wSet))
@@ -44,12 +49,19 @@ typedef struct {
 #define TSDB_COMPACT_EXBUF(pComph) TSDB_READ_EXBUF(&((pComph)->readh))
 
 static int  tsdbAsyncCompact(STsdbRepo *pRepo);
-static void tsdbStartCompact(STsdbRepo *pRepo);
-static void tsdbEndCompact(STsdbRepo *pRepo, int eno);
+static void tsdbStartCompact(STsdbRepo *pRepo, bool autoCompact);
+static void tsdbEndCompact(STsdbRepo *pRepo, int eno, SArray *aTombUpd);
 static int  tsdbCompactMeta(STsdbRepo *pRepo);
-static int  tsdbCompactTSData(STsdbRepo *pRepo);
+static int  tsdbCompactTSData(STsdbRepo *pRepo, SArray *aTombUpd, bool autoCompact);
 static int  tsdbCompactFSet(SCompactH *pComph, SDFileSet *pSet);
 static bool tsdbShouldCompact(SCompactH *pComph);
+static bool tsdbShouldAutoCompactFSet(SCompactH *pComph);
+static bool tsdbCompactShouldYield(SCompactH *pComph);
+static void tsdbLimitCompactSpeed(SCompactH *pComph, int64_t bytes);
+static void tsdbSetFSetCompactTime(STsdbRepo *pRepo, int fid);
+static void tsdbRemoveFSetStat(STsdbRepo *pRepo, int fid);
+static int  tsdbCompareFSetCompactStat(const void *a, const void *b);
+static int  tsdbCutCompactTombs(SCompactH *pComph, int fid);
 static int  tsdbInitCompactH(SCompactH *pComph, STsdbRepo *pRepo);
 static void tsdbDestroyCompactH(SCompactH *pComph);
 static int  tsdbInitCompTbArray(SCompactH *pComph);
@@ -62,9 +74,117 @@ static int  tsdbWriteBlockToRightFile(SCompactH *pComph, STable *pTable, SDataCo
                                       void **ppCBuf, void **ppExBuf);
 
 enum { TSDB_NO_COMPACT, TSDB_IN_COMPACT, TSDB_WAITING_COMPACT};
+
+#define TSDB_COMPACT_SLEEP_MS 50  // auto compaction sleeps no longer at a time, to see the requests waiting
 int tsdbCompact(STsdbRepo *pRepo) { return tsdbAsyncCompact(pRepo); }
 
-void *tsdbCompactImpl(STsdbRepo *pRepo) {
+int tsdbInitCompactStat(STsdbCompactStat *pStat) {
+  memset(pStat, 0, sizeof(*pStat));
+
+  pStat->pReadStat = taosHashInit(64, taosGetDefaultHashFunction(TSDB_DATA_TYPE_INT), false, HASH_NO_LOCK);
+  pStat->pFSetStat = taosHashInit(64, taosGetDefaultHashFunction(TSDB_DATA_TYPE_INT), true, HASH_NO_LOCK);
+  if (pStat->pReadStat == NULL || pStat->pFSetStat == NULL) {
+    taosHashCleanup(pStat->pReadStat);
+    taosHashCleanup(pStat->pFSetStat);
+    pStat->pReadStat = NULL;
+    pStat->pFSetStat = NULL;
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pthread_mutex_init(&(pStat->mutex), NULL);
+  pStat->lastCheck = taosGetTimestampMs();
+  return 0;
+}
+
+void tsdbDestroyCompactStat(STsdbCompactStat *pStat) {
+  if (pStat->pReadStat == NULL) return;
+  taosHashCleanup(pStat->pReadStat);
+  taosHashCleanup(pStat->pFSetStat);
+  pStat->pReadStat = NULL;
+  pStat->pFSetStat = NULL;
+  pthread_mutex_destroy(&(pStat->mutex));
+}
+
+void tsdbAddFSetReadStat(STsdbRepo *pRepo, int fid, int64_t nLoads, int64_t nExtraLoads) {
+  STsdbCompactStat *pStat = &(pRepo->compactStat);
+
+  if (nLoads <= 0) return;
+
+  pthread_mutex_lock(&(pStat->mutex));
+  STsdbFSetReadStat *pFStat = (STsdbFSetReadStat *)taosHashGet(pStat->pReadStat, &fid, sizeof(fid));
+  if (pFStat != NULL) {
+    pFStat->nLoads += nLoads;
+    pFStat->nExtraLoads += nExtraLoads;
+  } else {
+    STsdbFSetReadStat fstat = {.nLoads = nLoads, .nExtraLoads = nExtraLoads};
+    taosHashPut(pStat->pReadStat, &fid, sizeof(fid), &fstat, sizeof(fstat));
+  }
+  pthread_mutex_unlock(&(pStat->mutex));
+}
+
+int tsdbGetFSetCompactStat(STsdbRepo *pRepo, SArray *aStat) {
+  STsdbCompactStat *pStat = &(pRepo->compactStat);
+  size_t            nStats = taosArrayGetSize(aStat);
+
+  pthread_mutex_lock(&(pStat->mutex));
+
+  STsdbFSetCompactStat *pFStat = taosHashIterate(pStat->pFSetStat, NULL);
+  while (pFStat != NULL) {
+    if (taosArrayPush(aStat, pFStat) == NULL) {
+      taosHashCancelIterate(pStat->pFSetStat, pFStat);
+      pthread_mutex_unlock(&(pStat->mutex));
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+    pFStat = taosHashIterate(pStat->pFSetStat, pFStat);
+  }
+
+  // the file sets read but not checked yet
+  STsdbFSetReadStat *pRStat = taosHashIterate(pStat->pReadStat, NULL);
+  while (pRStat != NULL) {
+    int32_t fid = *(int32_t *)taosHashGetDataKey(pStat->pReadStat, pRStat);
+    if (taosHashGet(pStat->pFSetStat, &fid, sizeof(fid)) == NULL) {
+      STsdbFSetCompactStat fstat = {.fid = fid, .fragmentation = -1};
+      if (taosArrayPush(aStat, &fstat) == NULL) {
+        taosHashCancelIterate(pStat->pReadStat, pRStat);
+        pthread_mutex_unlock(&(pStat->mutex));
+        terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+        return -1;
+      }
+    }
+    pRStat = taosHashIterate(pStat->pReadStat, pRStat);
+  }
+
+  for (size_t i = nStats; i < taosArrayGetSize(aStat); i++) {
+    STsdbFSetCompactStat *p = taosArrayGet(aStat, i);
+    STsdbFSetReadStat *   pRead = taosHashGet(pStat->pReadStat, &(p->fid), sizeof(p->fid));
+    p->numOfLoads = (pRead == NULL) ? 0 : pRead->nLoads;
+    p->numOfExtraLoads = (pRead == NULL) ? 0 : pRead->nExtraLoads;
+  }
+
+  pthread_mutex_unlock(&(pStat->mutex));
+
+  qsort(TARRAY_GET_ELEM(aStat, nStats), taosArrayGetSize(aStat) - nStats, sizeof(STsdbFSetCompactStat),
+        tsdbCompareFSetCompactStat);
+  return 0;
+}
+
+// Called by the commit thread only, before a commit
+bool tsdbShouldAutoCompact(STsdbRepo *pRepo) {
+  STsdbCompactStat *pStat = &(pRepo->compactStat);
+  int64_t           now = taosGetTimestampMs();
+
+  if (tsTsdbAutoCompactInterval <= 0 || pRepo->code != TSDB_CODE_SUCCESS) return false;
+  // a manual compaction is waiting
+  if (pRepo->compactState != TSDB_NO_COMPACT) return false;
+  if (now - pStat->lastCheck < (int64_t)tsTsdbAutoCompactInterval * 1000) return false;
+
+  pStat->lastCheck = now;
+  return true;
+}
+
+void *tsdbCompactImpl(STsdbRepo *pRepo, bool autoCompact) {
   // Check if there are files in TSDB FS to compact
   if (REPO_FS(pRepo)->cstatus->pmf == NULL) {
     pRepo->compactState = TSDB_NO_COMPACT;
@@ -73,24 +193,40 @@ void *tsdbCompactImpl(STsdbRepo *pRepo) {
     return NULL;
   }
 
-  tsdbStartCompact(pRepo);
+  SArray *aTombUpd = taosArrayInit(16, sizeof(STableTombUpd));
+
+  tsdbStartCompact(pRepo, autoCompact);
+
+  if (aTombUpd == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    goto _err;
+  }
 
   if (tsdbCompactMeta(pRepo) < 0) {
     tsdbError("vgId:%d failed to compact META data since %s", REPO_ID(pRepo), tstrerror(terrno));
     goto _err;
   }
 
-  if (tsdbCompactTSData(pRepo) < 0) {
+  if (autoCompact) setThreadIdleIo(true);
+  if (tsdbCompactTSData(pRepo, aTombUpd, autoCompact) < 0) {
+    if (autoCompact) setThreadIdleIo(false);
     tsdbError("vgId:%d failed to compact TS data since %s", REPO_ID(pRepo), tstrerror(terrno));
     goto _err;
   }
+  if (autoCompact) setThreadIdleIo(false);
 
-  tsdbEndCompact(pRepo, TSDB_CODE_SUCCESS);
+  if (tsdbCommitTombs(pRepo, aTombUpd) < 0) {
+    tsdbError("vgId:%d failed to commit tombstones since %s", REPO_ID(pRepo), tstrerror(terrno));
+    goto _err;
+  }
+
+  tsdbEndCompact(pRepo, TSDB_CODE_SUCCESS, aTombUpd);
   return NULL;
 
 _err:
-  pRepo->code = terrno;
-  tsdbEndCompact(pRepo, terrno);
+  // the files of an auto compaction failed are kept as they are, the writes go on
+  if (!autoCompact) pRepo->code = terrno;
+  tsdbEndCompact(pRepo, terrno, aTombUpd);
   return NULL;
 }
 
@@ -108,20 +244,30 @@ static int tsdbAsyncCompact(STsdbRepo *pRepo) {
   return code;
 }
 
-static void tsdbStartCompact(STsdbRepo *pRepo) {
+static void tsdbStartCompact(STsdbRepo *pRepo, bool autoCompact) {
   assert(pRepo->compactState != TSDB_IN_COMPACT);
-  tsdbInfo("vgId:%d start to compact!", REPO_ID(pRepo));
+  tsdbInfo("vgId:%d start to compact%s!", REPO_ID(pRepo), autoCompact ? " automatically" : "");
   tsdbStartFSTxn(pRepo, 0, 0);
-  pRepo->code = TSDB_CODE_SUCCESS;
+  // auto compaction only follows a commit succeeded, and does not clear the error of one either
+  if (!autoCompact) pRepo->code = TSDB_CODE_SUCCESS;
   pRepo->compactState = TSDB_IN_COMPACT;
 }
 
-static void tsdbEndCompact(STsdbRepo *pRepo, int eno) {
+static void tsdbEndCompact(STsdbRepo *pRepo, int eno, SArray *aTombUpd) {
   if (eno != TSDB_CODE_SUCCESS) {
     tsdbEndFSTxnWithError(REPO_FS(pRepo));
   } else {
     tsdbEndFSTxn(pRepo);
   }
+
+  // the tombstones of the rows purged are dropped before the next commit may start
+  if (eno == TSDB_CODE_SUCCESS) {
+    tsdbApplyTombUpds(aTombUpd);
+  } else {
+    tsdbClearTombUpds(aTombUpd);
+  }
+  taosArrayDestroy(&aTombUpd);
+
   pRepo->compactState = TSDB_NO_COMPACT;
   tsdbInfo("vgId:%d compact over, %s", REPO_ID(pRepo), (eno == TSDB_CODE_SUCCESS) ? "succeed" : "failed");
   tsem_post(&(pRepo->readyToCommit));
@@ -133,7 +279,7 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
   return 0;
 }
 
-  static int tsdbCompactTSData(STsdbRepo *pRepo) {
+  static int tsdbCompactTSData(STsdbRepo *pRepo, SArray *aTombUpd, bool autoCompact) {
     SCompactH  compactH;
     SDFileSet *pSet = NULL;
 
@@ -148,12 +294,16 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
     if (tsdbInitCompactH(&compactH, pRepo) < 0) {
       return -1;
     }
+    compactH.aTombUpd = aTombUpd;
+    compactH.autoCompact = autoCompact;
+    compactH.startMs = taosGetTimestampMs();
 
     while ((pSet = tsdbFSIterNext(&(compactH.fsIter)))) {
       // Remove those expired files
       if (pSet->fid < compactH.rtn.minFid) {
         tsdbInfo("vgId:%d FSET %d on level %d disk id %d expires, remove it", REPO_ID(pRepo), pSet->fid,
                 TSDB_FSET_LEVEL(pSet), TSDB_FSET_ID(pSet));
+        tsdbRemoveFSetStat(pRepo, pSet->fid);
         continue;
       }
 
@@ -163,6 +313,14 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
         continue;
       }
 
+      if (tsdbCompactShouldYield(&compactH)) {
+        if (tsdbApplyRtnOnFSet(pRepo, pSet, &(compactH.rtn)) < 0) {
+          tsdbDestroyCompactH(&compactH);
+          return -1;
+        }
+        continue;
+      }
+
       if (tsdbCompactFSet(&compactH, pSet) < 0) {
         tsdbDestroyCompactH(&compactH);
         tsdbError("vgId:%d failed to compact FSET %d since %s", REPO_ID(pRepo), pSet->fid, tstrerror(terrno));
@@ -186,7 +344,7 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
       return -1;
     }
 
-    if (!tsdbShouldCompact(pComph)) {
+    if (!(pComph->autoCompact ? tsdbShouldAutoCompactFSet(pComph) : tsdbShouldCompact(pComph))) {
       tsdbDebug("vgId:%d no need to compact FSET %d", REPO_ID(pRepo), pSet->fid);
       if (tsdbApplyRtnOnFSet(TSDB_COMPACT_REPO(pComph), pSet, &(pComph->rtn)) < 0) {
         tsdbCompactFSetEnd(pComph);
@@ -218,14 +376,56 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
       }
 
       tsdbCloseDFileSet(TSDB_COMPACT_WSET(pComph));
+
+      if (pComph->yielded) {
+        tsdbInfo("vgId:%d FSET %d not compacted, give way to the commit", REPO_ID(pRepo), pSet->fid);
+        tsdbRemoveDFileSet(TSDB_COMPACT_WSET(pComph));
+        if (tsdbApplyRtnOnFSet(TSDB_COMPACT_REPO(pComph), pSet, &(pComph->rtn)) < 0) {
+          tsdbCompactFSetEnd(pComph);
+          return -1;
+        }
+        tsdbCompactFSetEnd(pComph);
+        return 0;
+      }
+
       tsdbUpdateDFileSet(REPO_FS(pRepo), TSDB_COMPACT_WSET(pComph));
       tsdbDebug("vgId:%d FSET %d compact over", REPO_ID(pRepo), pSet->fid);
+
+      // the read amplification is measured again on the compacted FSET
+      tsdbSetFSetCompactTime(pRepo, pSet->fid);
+    }
+
+    // no row masked is left in the FSET either way
+    if (tsdbCutCompactTombs(pComph, pSet->fid) < 0) {
+      tsdbCompactFSetEnd(pComph);
+      return -1;
     }
 
     tsdbCompactFSetEnd(pComph);
     return 0;
   }
 
+  static int tsdbCutCompactTombs(SCompactH *pComph, int fid) {
+    STsdbCfg *pCfg = REPO_CFG(TSDB_COMPACT_REPO(pComph));
+    TSKEY     minKey, maxKey;
+
+    tsdbGetFidKeyRange(pCfg->daysPerFile, pCfg->precision, fid, &minKey, &maxKey);
+
+    for (size_t i = 0; i < taosArrayGetSize(pComph->tbArray); i++) {
+      STableCompactH *pTh = (STableCompactH *)taosArrayGet(pComph->tbArray, i);
+
+      if (pTh->pTable == NULL || !tsdbTombsOverlap(pTh->pTable->aTomb, minKey, maxKey)) continue;
+
+      STableTombUpd *pUpd = tsdbGetTombUpd(pComph->aTombUpd, pTh->pTable);
+      if (pUpd == NULL || tsdbCutTombs(pUpd->aTomb, minKey, maxKey) < 0) {
+        terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+
   static bool tsdbShouldCompact(SCompactH *pComph) {
     if (tsdbForceCompactFile) {
       return true;
@@ -242,7 +442,21 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
     int     tblocks = 0;       // total blocks
     int     nSubBlocks = 0;    // # of blocks with sub-blocks
     int     nSmallBlocks = 0;  // # of blocks with rows < defaultRows
+    int     nRecompBlocks = 0; // # of blocks not compressed by the current compression of the repo
     int64_t tsize = 0;
+    TSKEY   minKey, maxKey;
+
+    // Purge the rows deleted
+    tsdbGetFidKeyRange(pCfg->daysPerFile, pCfg->precision, TSDB_READ_FSET(pReadh)->fid, &minKey, &maxKey);
+    for (size_t i = 0; i < taosArrayGetSize(pComph->tbArray); i++) {
+      pTh = (STableCompactH *)taosArrayGet(pComph->tbArray, i);
+
+      if (pTh->pTable == NULL || pTh->pBlkIdx == NULL) continue;
+      if (tsdbTombsOverlap(pTh->pTable->aTomb, minKey, maxKey)) {
+        tsdbDebug("vgId:%d FSET %d has rows deleted, purge them", REPO_ID(pRepo), TSDB_READ_FSET(pReadh)->fid);
+        return true;
+      }
+    }
 
     for (size_t i = 0; i < taosArrayGetSize(pComph->tbArray); i++) {
       pTh = (STableCompactH *)taosArrayGet(pComph->tbArray, i);
@@ -257,6 +471,10 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
           nSmallBlocks++;
         }
 
+        if (pBlock->algorithm != pCfg->compression) {
+          nRecompBlocks++;
+        }
+
         if (pBlock->numOfSubBlocks > 1) {
           nSubBlocks++;
           for (int k = 0; k < pBlock->numOfSubBlocks; k++) {
@@ -271,10 +489,94 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
       }
     }
 
+    // Recompress the old file sets after the compression is altered, e.g. to zstd for cold data
+    if (nRecompBlocks > 0) {
+      tsdbDebug("vgId:%d %d blocks of FSET %d are not compressed by %d, recompress them", REPO_ID(pRepo), nRecompBlocks,
+                TSDB_READ_FSET(pReadh)->fid, pCfg->compression);
+      return true;
+    }
+
     return (((nSubBlocks * 1.0 / tblocks) > 0.33) || ((nSmallBlocks * 1.0 / tblocks) > 0.33) ||
             (tsize * 1.0 / (pDataF->info.size + pLastF->info.size - 2 * TSDB_FILE_HEAD_SIZE) < 0.85));
   }
 
+  // The fragmentation of a FSET is the max percent of its blocks with sub-blocks, of its small blocks to merge and of
+  // the extra sub-blocks loaded by the queries, all of which go away after the FSET is compacted. The FSET is compacted
+  // anyway if it has rows deleted to purge or blocks to recompress. The measures are kept for tsdbGetFSetCompactStat().
+  static bool tsdbShouldAutoCompactFSet(SCompactH *pComph) {
+    STsdbRepo *     pRepo = TSDB_COMPACT_REPO(pComph);
+    STsdbCfg *      pCfg = REPO_CFG(pRepo);
+    SReadH *        pReadh = &(pComph->readh);
+    int             fid = TSDB_READ_FSET(pReadh)->fid;
+    int             defaultRows = TSDB_DEFAULT_BLOCK_ROWS(pCfg->maxRowsPerFileBlock);
+    SDFile *        pDataF = TSDB_READ_DATA_FILE(pReadh);
+    SDFile *        pLastF = TSDB_READ_LAST_FILE(pReadh);
+    STableCompactH *pTh;
+    TSKEY           minKey, maxKey;
+    bool            hasDeleted = false;
+    bool            toRecompress = false;
+
+    STsdbFSetCompactStat fstat = {.fid = fid};
+    STsdbFSetReadStat    rstat = {0};
+
+    tsdbGetFidKeyRange(pCfg->daysPerFile, pCfg->precision, fid, &minKey, &maxKey);
+    for (size_t i = 0; i < taosArrayGetSize(pComph->tbArray); i++) {
+      pTh = (STableCompactH *)taosArrayGet(pComph->tbArray, i);
+
+      if (pTh->pTable == NULL || pTh->pBlkIdx == NULL) continue;
+      if (tsdbTombsOverlap(pTh->pTable->aTomb, minKey, maxKey)) hasDeleted = true;
+
+      int nSmallBlocks = 0;
+      for (size_t bidx = 0; bidx < pTh->pBlkIdx->numOfBlocks; bidx++) {
+        SBlock *pBlock = pTh->pInfo->blocks + bidx;
+
+        fstat.numOfBlocks++;
+        if (pBlock->numOfSubBlocks > 1) fstat.numOfSubBlocks++;
+        if (pBlock->last) fstat.numOfLastBlocks++;
+        if (pBlock->numOfRows < defaultRows) nSmallBlocks++;
+        if (pBlock->algorithm != pCfg->compression) toRecompress = true;
+      }
+      if (nSmallBlocks > 1) fstat.numOfMergeable += nSmallBlocks - 1;
+    }
+
+    pthread_mutex_lock(&(pRepo->compactStat.mutex));
+    STsdbFSetReadStat *pFStat = (STsdbFSetReadStat *)taosHashGet(pRepo->compactStat.pReadStat, &fid, sizeof(fid));
+    if (pFStat != NULL) rstat = *pFStat;
+    pthread_mutex_unlock(&(pRepo->compactStat.mutex));
+
+    if (fstat.numOfBlocks > 0) {
+      fstat.fragmentation = (int32_t)MAX(fstat.numOfSubBlocks * 100 / fstat.numOfBlocks,
+                                         fstat.numOfMergeable * 100 / fstat.numOfBlocks);
+      if (rstat.nLoads > 0) {
+        int32_t readScore = (int32_t)MIN(rstat.nExtraLoads * 100 / rstat.nLoads, 100);
+        fstat.fragmentation = MAX(fstat.fragmentation, readScore);
+      }
+    }
+    fstat.toPurge = hasDeleted || toRecompress;
+    fstat.checkTime = taosGetTimestampMs();
+
+    pthread_mutex_lock(&(pRepo->compactStat.mutex));
+    STsdbFSetCompactStat *pOld = taosHashGet(pRepo->compactStat.pFSetStat, &fid, sizeof(fid));
+    if (pOld != NULL) fstat.compactTime = pOld->compactTime;
+    taosHashPut(pRepo->compactStat.pFSetStat, &fid, sizeof(fid), &fstat, sizeof(fstat));
+    pthread_mutex_unlock(&(pRepo->compactStat.mutex));
+
+    if (hasDeleted) {
+      tsdbDebug("vgId:%d FSET %d has rows deleted, purge them", REPO_ID(pRepo), fid);
+    } else if (toRecompress) {
+      tsdbDebug("vgId:%d FSET %d is not compressed by %d, recompress it", REPO_ID(pRepo), fid, pCfg->compression);
+    }
+
+    tsdbInfo("vgId:%d FSET %d has %" PRId64 " blocks, %" PRId64 " with sub-blocks, %" PRId64 " small to merge, %" PRId64
+             " in .last, data size %" PRIu64 " last size %" PRIu64 ", %" PRId64 " block loads with %" PRId64
+             " extra, fragmentation %d%%",
+             REPO_ID(pRepo), fid, fstat.numOfBlocks, fstat.numOfSubBlocks, fstat.numOfMergeable, fstat.numOfLastBlocks,
+             pDataF->info.size, pLastF->info.size, rstat.nLoads, rstat.nExtraLoads, fstat.fragmentation);
+
+    if (fstat.toPurge) return true;
+    return fstat.numOfBlocks > 0 && fstat.fragmentation >= tsTsdbAutoCompactRatio;
+  }
+
   static int tsdbInitCompactH(SCompactH *pComph, STsdbRepo *pRepo) {
     STsdbCfg *pCfg = REPO_CFG(pRepo);
 
@@ -441,6 +743,7 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
       STSchema *      pSchema;
 
       if (pTh->pTable == NULL || pTh->pBlkIdx == NULL) continue;
+      if (tsdbCompactShouldYield(pComph)) return 0;
 
       pSchema = tsdbGetTableSchemaImpl(pTh->pTable, true, true, -1, -1);
       taosArrayClear(pComph->aSupBlk);
@@ -452,17 +755,22 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
       }
       tdFreeSchema(pSchema);
 
+      // The rows deleted are masked on load and not written back
+      pReadh->aTomb = pTh->pTable->aTomb;
+
       // Loop to compact each block data
       for (int i = 0; i < pTh->pBlkIdx->numOfBlocks; i++) {
         SBlock *pBlock = pTh->pInfo->blocks + i;
 
+        if (tsdbTombsCover(pReadh->aTomb, pBlock->keyFirst, pBlock->keyLast)) continue;
+
         // Load the block data
         if (tsdbLoadBlockData(pReadh, pBlock, pTh->pInfo) < 0) {
           return -1;
         }
 
         // Merge pComph->pDataCols and pReadh->pDCols[0] and write data to file
-        if (pComph->pDataCols->numOfRows == 0 && pBlock->numOfRows >= defaultRows) {
+        if (pComph->pDataCols->numOfRows == 0 && pReadh->pDCols[0]->numOfRows >= defaultRows) {
           if (tsdbWriteBlockToRightFile(pComph, pTh->pTable, pReadh->pDCols[0], ppBuf, ppCBuf, ppExBuf) < 0) {
             return -1;
           }
@@ -539,6 +847,79 @@ static int tsdbCompactMeta(STsdbRepo *pRepo) {
       return -1;
     }
 
+    tsdbLimitCompactSpeed(pComph, block.len);
     return 0;
   }
 
+  static bool tsdbCompactShouldYield(SCompactH *pComph) {
+    STsdbRepo *pRepo = TSDB_COMPACT_REPO(pComph);
+
+    if (!pComph->autoCompact) return false;
+    if (pComph->yielded) return true;
+
+    // the commits of the other vnodes wait for the thread
+    if (tsdbCommitQueueBusy()) {
+      tsdbInfo("vgId:%d auto compaction yields, requests are waiting for the commit thread", REPO_ID(pRepo));
+      pComph->yielded = true;
+      return true;
+    }
+
+    // a full memtable would block the writes until the compaction ends, give way to the commit before half full
+    int64_t memRoom = (int64_t)(pRepo->config.totalBlocks / 3) * pRepo->pPool->bufBlockSize;
+    if (tsdbLockRepo(pRepo) < 0) return false;
+    int64_t usedBytes = tsdbGetMemUsedBytes(pRepo, pRepo->mem);
+    if (tsdbUnlockRepo(pRepo) < 0) return false;
+
+    if (usedBytes * 2 >= memRoom) {
+      tsdbInfo("vgId:%d auto compaction yields, %" PRId64 " bytes of cache to commit", REPO_ID(pRepo), usedBytes);
+      pComph->yielded = true;
+    }
+
+    return pComph->yielded;
+  }
+
+  // The sleep is cut short once a request waits for the commit thread, then the compaction yields at the next table
+  static void tsdbLimitCompactSpeed(SCompactH *pComph, int64_t bytes) {
+    pComph->written += bytes;
+    if (!pComph->autoCompact || tsTsdbCompactSpeed <= 0) return;
+
+    int64_t expectMs = pComph->written * 1000 / ((int64_t)tsTsdbCompactSpeed * 1024 * 1024);
+    int64_t elapsed = taosGetTimestampMs() - pComph->startMs;
+    while (expectMs > elapsed && !tsdbCompactShouldYield(pComph)) {
+      taosMsleep((int32_t)MIN(expectMs - elapsed, TSDB_COMPACT_SLEEP_MS));
+      elapsed = taosGetTimestampMs() - pComph->startMs;
+    }
+  }
+
+  static void tsdbSetFSetCompactTime(STsdbRepo *pRepo, int fid) {
+    STsdbCompactStat *pStat = &(pRepo->compactStat);
+
+    pthread_mutex_lock(&(pStat->mutex));
+    taosHashRemove(pStat->pReadStat, &fid, sizeof(fid));
+    STsdbFSetCompactStat *pFStat = taosHashGet(pStat->pFSetStat, &fid, sizeof(fid));
+    if (pFStat != NULL) {
+      pFStat->compactTime = taosGetTimestampMs();
+    } else {
+      STsdbFSetCompactStat fstat = {.fid = fid, .fragmentation = -1, .compactTime = taosGetTimestampMs()};
+      taosHashPut(pStat->pFSetStat, &fid, sizeof(fid), &fstat, sizeof(fstat));
+    }
+    pthread_mutex_unlock(&(pStat->mutex));
+  }
+
+  static void tsdbRemoveFSetStat(STsdbRepo *pRepo, int fid) {
+    STsdbCompactStat *pStat = &(pRepo->compactStat);
+
+    pthread_mutex_lock(&(pStat->mutex));
+    taosHashRemove(pStat->pReadStat, &fid, sizeof(fid));
+    taosHashRemove(pStat->pFSetStat, &fid, sizeof(fid));
+    pthread_mutex_unlock(&(pStat->mutex));
+  }
+
+  static int tsdbCompareFSetCompactStat(const void *a, const void *b) {
+    int32_t fid1 = ((const STsdbFSetCompactStat *)a)->fid;
+    int32_t fid2 = ((const STsdbFSetCompactStat *)b)->fid;
+
+    if (fid1 < fid2) return -1;
+    if (fid1 > fid2) return 1;
+    return 0;
+  }
@@ -37,6 +37,7 @@ static void tsdbScanAndTryFixDFilesHeader(STsdbRepo *pRepo, int32_t *nExpired);
 static int  tsdbProcessExpiredFS(STsdbRepo *pRepo);
 static int  tsdbCreateMeta(STsdbRepo *pRepo);
 static int  tsdbFetchTFileSet(STsdbRepo *pRepo, SArray **fArray);
+static void tsdbPurgeBlkCache(STsdbRepo *pRepo, SFSStatus *pFrom, SFSStatus *pTo);
 
 // For backward compatibility
 // ================== CURRENT file header info
@@ -351,7 +352,8 @@ int tsdbOpenFS(STsdbRepo *pRepo) {
 }
 
 void tsdbCloseFS(STsdbRepo *pRepo) {
-  // Do nothing
+  // Cached blocks would be stale if the vgId is reused by a new repository
+  tsdbBlkCacheRemoveRepo(REPO_ID(pRepo));
 }
 
 // Start a new transaction to modify the file system
@@ -393,6 +395,7 @@ int tsdbEndFSTxn(STsdbRepo *pRepo) {
 
   // Apply actual change to each file and SDFileSet
   tsdbApplyFSTxnOnDisk(pfs->nstatus, pfs->cstatus);
+  tsdbPurgeBlkCache(pRepo, pfs->nstatus, pfs->cstatus);
 
   pfs->intxn = false;
   return 0;
@@ -551,6 +554,27 @@ static void tsdbApplyFSTxnOnDisk(SFSStatus *pFrom, SFSStatus *pTo) {
   }
 }
 
+// Drop cached blocks of .data/.last files which are no longer in the FS
+static void tsdbPurgeBlkCache(STsdbRepo *pRepo, SFSStatus *pFrom, SFSStatus *pTo) {
+  static const TSDB_FILE_T ftypes[] = {TSDB_FILE_DATA, TSDB_FILE_LAST};
+
+  if (!tsdbBlkCacheEnabled()) return;
+
+  for (size_t i = 0; i < taosArrayGetSize(pFrom->df); i++) {
+    SDFileSet *pSetFrom = taosArrayGet(pFrom->df, i);
+    SDFileSet *pSetTo = taosArraySearch(pTo->df, (void *)(&(pSetFrom->fid)), tsdbComparFidFSet, TD_EQ);
+
+    for (int j = 0; j < tListLen(ftypes); j++) {
+      SDFile *pDFileFrom = TSDB_DFILE_IN_SET(pSetFrom, ftypes[j]);
+      if (pSetTo != NULL && tfsIsSameFile(TSDB_FILE_F(pDFileFrom), TSDB_FILE_F(TSDB_DFILE_IN_SET(pSetTo, ftypes[j])))) {
+        continue;
+      }
+
+      tsdbBlkCacheRemoveDFile(REPO_ID(pRepo), pSetFrom->fid, ftypes[j], tsdbGetDFileNameVer(pDFileFrom));
+    }
+  }
+}
+
 // ================== SFSIter
 // ASSUMPTIONS: the FS Should be read locked when calling these functions
 void tsdbFSIterInit(SFSIter *pIter, STsdbFS *pfs, int direction) {
@@ -699,6 +699,17 @@ int tsdbParseDFilename(const char *fname, int *vid, int *fid, TSDB_FILE_T *ftype
   return 0;
 }
 
+uint32_t tsdbGetDFileNameVer(SDFile *pDFile) {
+  char        bname[TSDB_FILENAME_LEN];
+  int         vid, fid;
+  TSDB_FILE_T ftype;
+  uint32_t    ver;
+
+  tfsbasename(TSDB_FILE_F(pDFile), bname);
+  tsdbParseDFilename(bname, &vid, &fid, &ftype, &ver);
+  return ver;
+}
+
 static void tsdbGetFilename(int vid, int fid, uint32_t ver, TSDB_FILE_T ftype, char *fname) {
   ASSERT(ftype != TSDB_FILE_MAX);
 
@@ -22,7 +22,7 @@
 #define IS_VALID_PRECISION(precision) \
   (((precision) >= TSDB_TIME_PRECISION_MILLI) && ((precision) <= TSDB_TIME_PRECISION_NANO))
 #define TSDB_DEFAULT_COMPRESSION TWO_STAGE_COMP
-#define IS_VALID_COMPRESSION(compression) (((compression) >= NO_COMPRESSION) && ((compression) <= TWO_STAGE_COMP))
+#define IS_VALID_COMPRESSION(compression) (((compression) >= NO_COMPRESSION) && ((compression) <= TWO_STAGE_COMP_ZSTD))
 
 static int32_t    tsdbCheckAndSetDefaultCfg(STsdbCfg *pCfg);
 static STsdbRepo *tsdbNewRepo(STsdbCfg *pCfg, STsdbAppH *pAppH);
@@ -596,6 +596,14 @@ static STsdbRepo *tsdbNewRepo(STsdbCfg *pCfg, STsdbAppH *pAppH) {
     tsdbFreeRepo(pRepo);
     return NULL;
   }
+
+  code = pthread_mutex_init(&(pRepo->allocMutex), NULL);
+  if (code != 0) {
+    terrno = TAOS_SYSTEM_ERROR(code);
+    tsdbFreeRepo(pRepo);
+    return NULL;
+  }
+  pRepo->parallelApply = false;
   pRepo->config_changed = false;
   pRepo->cacheLastConfigVersion = 0;
 
@@ -607,6 +615,11 @@ static STsdbRepo *tsdbNewRepo(STsdbCfg *pCfg, STsdbAppH *pAppH) {
     return NULL;
   }
 
+  if (tsdbInitCompactStat(&(pRepo->compactStat)) < 0) {
+    tsdbFreeRepo(pRepo);
+    return NULL;
+  }
+
   pRepo->tsdbMeta = tsdbNewMeta(pCfg);
   if (pRepo->tsdbMeta == NULL) {
     tsdbError("vgId:%d failed to create meta since %s", REPO_ID(pRepo), tstrerror(terrno));
@@ -640,7 +653,9 @@ static void tsdbFreeRepo(STsdbRepo *pRepo) {
     // tsdbFreeMemTable(pRepo->mem);
     // tsdbFreeMemTable(pRepo->imem);
     tsem_destroy(&(pRepo->readyToCommit));
+    tsdbDestroyCompactStat(&(pRepo->compactStat));
     pthread_mutex_destroy(&pRepo->mutex);
+    pthread_mutex_destroy(&pRepo->allocMutex);
     free(pRepo);
   }
 }
@@ -761,7 +776,7 @@ static int tsdbRestoreLastColumns(STsdbRepo *pRepo, STable *pTable, SReadH* pRea
       }
 
       // OK,let's load row from backward to get not-null column
-      for (int32_t rowId = pBlock->numOfRows - 1; rowId >= 0; rowId--) {
+      for (int32_t rowId = pReadh->pDCols[0]->numOfRows - 1; rowId >= 0; rowId--) {
         SDataCol *pDataCol = pReadh->pDCols[0]->cols + i;
         const void* pColData = tdGetColDataOfRow(pDataCol, rowId);
         // tdAppendColVal(memRowDataBody(row), pColData, pCol->type, pCol->offset);
@@ -813,15 +828,29 @@ out:
   return err;
 }
 
+// Return 1 if all the rows of the table in the file set are deleted, the last row is then in an older one
 int tsdbRestoreLastRow(STsdbRepo *pRepo, STable *pTable, SReadH* pReadh, SBlockIdx *pIdx, bool onlyKey) {
   if (tsdbLoadBlockInfo(pReadh, NULL, NULL) < 0) {
     return -1;
   }
 
-  SBlock* pBlock = pReadh->pBlkInfo->blocks + pIdx->numOfBlocks - 1;
+  SBlock* pBlock = NULL;
+  for (int i = pIdx->numOfBlocks - 1; i >= 0; i--) {
+    SBlock *pLoad = pReadh->pBlkInfo->blocks + i;
+    if (tsdbTombsCover(pReadh->aTomb, pLoad->keyFirst, pLoad->keyLast)) continue;
 
-  if (tsdbLoadBlockData(pReadh, pBlock, NULL) < 0) {
-    return -1;
+    if (tsdbLoadBlockData(pReadh, pLoad, NULL) < 0) {
+      return -1;
+    }
+
+    if (pReadh->pDCols[0]->numOfRows > 0) {
+      pBlock = pLoad;
+      break;
+    }
+  }
+
+  if (pBlock == NULL) {
+    return 1;
   }
 
   // Get the data in row
@@ -837,7 +866,7 @@ int tsdbRestoreLastRow(STsdbRepo *pRepo, STable *pTable, SReadH* pReadh, SBlockI
   for (int icol = 0; icol < schemaNCols(pSchema); icol++) {
     STColumn *pCol = schemaColAt(pSchema, icol);
     SDataCol *pDataCol = pReadh->pDCols[0]->cols + icol;
-    tdAppendColVal(memRowDataBody(lastRow), tdGetColDataOfRow(pDataCol, pBlock->numOfRows - 1), pCol->type,
+    tdAppendColVal(memRowDataBody(lastRow), tdGetColDataOfRow(pDataCol, pReadh->pDCols[0]->numOfRows - 1), pCol->type,
                    pCol->offset);
   }
 
@@ -910,10 +939,15 @@ int tsdbRestoreInfo(STsdbRepo *pRepo) {
 
       TSKEY      lastKey = tsdbGetTableLastKeyImpl(pTable);
       SBlockIdx *pIdx = readh.pBlkIdx;
+      readh.aTomb = pTable->aTomb;
       if (pIdx && lastKey < pIdx->maxKey) {
-        pTable->lastKey = pIdx->maxKey;
+        // the max key may be deleted, the last key is then restored with the last row
+        if (pTable->aTomb == NULL) {
+          pTable->lastKey = pIdx->maxKey;
+        }
 
-        if (CACHE_LAST_ROW(pCfg) && tsdbRestoreLastRow(pRepo, pTable, &readh, pIdx, false) != 0) {
+        if ((CACHE_LAST_ROW(pCfg) || pTable->aTomb != NULL) &&
+            tsdbRestoreLastRow(pRepo, pTable, &readh, pIdx, !CACHE_LAST_ROW(pCfg)) < 0) {
           tsdbDestroyReadH(&readh);
           return -1;
         }
@@ -981,18 +1015,25 @@ int32_t tsdbLoadLastCache(STsdbRepo *pRepo, STable *pTable, bool force) {
     return -1;
   }
 
+  if (tsdbGetTableTombs(pTable, &readh.aTomb) < 0) {
+    tsdbDestroyReadH(&readh);
+    return -1;
+  }
+
   tsdbRLockFS(REPO_FS(pRepo));
   tsdbFSIterInit(&fsiter, REPO_FS(pRepo), TSDB_FS_ITER_BACKWARD);
 
   while ((cacheLastRowTableNum > 0 || cacheLastColTableNum > 0) && (pSet = tsdbFSIterNext(&fsiter)) != NULL) {
     if (tsdbSetAndOpenReadFSet(&readh, pSet) < 0) {
       tsdbUnLockFS(REPO_FS(pRepo));
+      taosArrayDestroy(&readh.aTomb);
       tsdbDestroyReadH(&readh);
       return -1;
     }
 
     if (tsdbLoadBlockIdx(&readh) < 0) {
       tsdbUnLockFS(REPO_FS(pRepo));
+      taosArrayDestroy(&readh.aTomb);
       tsdbDestroyReadH(&readh);
       return -1;
     }
@@ -1001,6 +1042,7 @@ int32_t tsdbLoadLastCache(STsdbRepo *pRepo, STable *pTable, bool force) {
 
     if (tsdbSetReadTable(&readh, pTable) < 0) {
       tsdbUnLockFS(REPO_FS(pRepo));
+      taosArrayDestroy(&readh.aTomb);
       tsdbDestroyReadH(&readh);
       return -1;
     }
@@ -1008,18 +1050,23 @@ int32_t tsdbLoadLastCache(STsdbRepo *pRepo, STable *pTable, bool force) {
     SBlockIdx *pIdx = readh.pBlkIdx;
 
     if (pIdx && (cacheLastRowTableNum > 0) && (pTable->lastRow == NULL || force)) {
-      if (tsdbRestoreLastRow(pRepo, pTable, &readh, pIdx, onlyKey) != 0) {
+      int code = tsdbRestoreLastRow(pRepo, pTable, &readh, pIdx, onlyKey);
+      if (code < 0) {
         tsdbUnLockFS(REPO_FS(pRepo));
+        taosArrayDestroy(&readh.aTomb);
         tsdbDestroyReadH(&readh);
         return -1;
       }
-      cacheLastRowTableNum -= 1;
+      if (code == 0) {
+        cacheLastRowTableNum -= 1;
+      }
     }
 
     // restore NULL columns
     if (pIdx && (cacheLastColTableNum > 0) && !pTable->hasRestoreLastColumn) {
       if (tsdbRestoreLastColumns(pRepo, pTable, &readh) != 0) {
         tsdbUnLockFS(REPO_FS(pRepo));
+        taosArrayDestroy(&readh.aTomb);
         tsdbDestroyReadH(&readh);
         return -1;
       }
@@ -1029,14 +1076,19 @@ int32_t tsdbLoadLastCache(STsdbRepo *pRepo, STable *pTable, bool force) {
     }
   }
 
-  if ( cacheLastRowTableNum > 0 && readh.pBlkIdx == NULL) {
+  if (cacheLastRowTableNum > 0) {
     // table no data, so reset lastKey
     TSDB_WLOCK_TABLE(pTable);
     pTable->lastKey = TSKEY_INITIAL_VAL;
+    if (force) {
+      taosTZfree(pTable->lastRow);
+      pTable->lastRow = NULL;
+    }
     TSDB_WUNLOCK_TABLE(pTable);
   }
 
   tsdbUnLockFS(REPO_FS(pRepo));
+  taosArrayDestroy(&readh.aTomb);
   tsdbDestroyReadH(&readh);
 
   return 0;
@@ -1134,11 +1186,15 @@ UNUSED_FUNC int tsdbCacheLastData(STsdbRepo *pRepo, STsdbCfg* oldCfg) {
       if (pIdx && cacheLastRowTableNum > 0 && pTable->lastRow == NULL) {                
         pTable->lastKey = pIdx->maxKey;
 
-        if (tsdbRestoreLastRow(pRepo, pTable, &readh, pIdx, false) != 0) {
+        readh.aTomb = pTable->aTomb;
+        int code = tsdbRestoreLastRow(pRepo, pTable, &readh, pIdx, false);
+        if (code < 0) {
           tsdbDestroyReadH(&readh);
           return -1;
         }
-        cacheLastRowTableNum -= 1;
+        if (code == 0) {
+          cacheLastRowTableNum -= 1;
+        }
       }
       
       // restore NULL columns
@@ -34,9 +34,36 @@ typedef struct {
   void *  pMsg;
 } SSubmitMsgIter;
 
+typedef struct {
+  SSubmitBlk *pBlock;
+  STable *    pTable;
+  STableData *pTableData;  // NULL if the block has no row
+  TSKEY       firstKey;
+  SMemRow     lastRow;
+  int32_t     points;
+  int64_t     dsize;
+  int32_t     code;  // terrno of the thread inserting the block
+} SInsertBlkInfo;
+
+typedef struct {
+  STsdbRepo *     pRepo;
+  int32_t         numOfBlocks;
+  int32_t         numOfTasks;
+  SInsertBlkInfo *pInfos;
+} SInsertJob;
+
 static SMemTable *  tsdbNewMemTable(STsdbRepo *pRepo);
 static void         tsdbFreeMemTable(SMemTable *pMemTable);
-static STableData*  tsdbNewTableData(STsdbCfg *pCfg, STable *pTable);
+static STableData*  tsdbNewTableData(STsdbRepo *pRepo, STable *pTable);
+static void *       tsdbAllocBytesImp(STsdbRepo *pRepo, int bytes);
+static void *       tsdbAllocSkipListNode(void *param, int32_t bytes);
+static void *       tsdbAllocAlignedBytes(STsdbRepo *pRepo, int bytes);
+static STableDataIter *tsdbNewTableDataIter(STableData *pTableData, const TSKEY *pKey, int32_t order);
+static void         tsdbSeekTableDataChunks(STableDataIter *pIter, STableData *pTableData, const TSKEY *pKey);
+static int32_t      tsdbSearchTableDataChunk(STableDataChunk *pChunk, int32_t nRows, TSKEY key, bool upper);
+static int          tsdbAppendRowToTableData(STsdbRepo *pRepo, STableData *pTableData, SMemRow row);
+static void *       tsdbGetTableDataChunkNext(void *iter);
+static void         tsdbMoveTableDataToSkipList(STableData *pTableData);
 static void         tsdbFreeTableData(STableData *pTableData);
 static char *       tsdbGetTsTupleKey(const void *data);
 static int          tsdbAdjustMemMaxTables(SMemTable *pMemTable, int maxTables);
@@ -45,11 +72,18 @@ static int          tsdbInitSubmitBlkIter(SSubmitBlk *pBlock, SSubmitBlkIter *pI
 static SMemRow      tsdbGetSubmitBlkNext(SSubmitBlkIter *pIter);
 static int          tsdbScanAndConvertSubmitMsg(STsdbRepo *pRepo, SSubmitMsg *pMsg);
 static int          tsdbInsertDataToTable(STsdbRepo *pRepo, SSubmitBlk *pBlock, int32_t *affectedrows);
+static STableData * tsdbGetTableDataToInsert(STsdbRepo *pRepo, SSubmitBlk *pBlock);
+static int          tsdbInsertBlockToTableData(STsdbRepo *pRepo, SInsertBlkInfo *pInfo);
+static int          tsdbUpdateInsertInfo(STsdbRepo *pRepo, SInsertBlkInfo *pInfo, int32_t *pAffectedRows);
+static bool         tsdbShouldInsertInParallel(STsdbRepo *pRepo, SSubmitMsg *pMsg);
+static int          tsdbInsertDataInParallel(STsdbRepo *pRepo, SSubmitMsg *pMsg, int32_t *pAffectedRows,
+                                             int32_t *pNumOfRows);
 static int          tsdbInitSubmitMsgIter(SSubmitMsg *pMsg, SSubmitMsgIter *pIter);
 static int          tsdbGetSubmitMsgNext(SSubmitMsgIter *pIter, SSubmitBlk **pPBlock);
 static int          tsdbCheckTableSchema(STsdbRepo *pRepo, SSubmitBlk *pBlock, STable *pTable);
 static int          tsdbUpdateTableLatestInfo(STsdbRepo *pRepo, STable *pTable, SMemRow row);
 static int32_t      tsdbInsertControlData(STsdbRepo* pRepo, SSubmitBlk* pBlock, SShellSubmitRspMsg *pRsp, tsem_t** pSem);
+static void         tsdbUpdateIngestRate(STsdbRepo *pRepo, int64_t bytes);
 
 static FORCE_INLINE int tsdbCheckRowRange(STsdbRepo *pRepo, STable *pTable, SMemRow row, TSKEY minKey, TSKEY maxKey,
                                           TSKEY now);
@@ -60,6 +94,7 @@ int32_t tsdbInsertData(STsdbRepo *repo, SSubmitMsg *pMsg, SShellSubmitRspMsg *pR
   SSubmitBlk *   pBlock = NULL;
   int32_t        affectedrows = 0, numOfRows = 0;
   int32_t        ret = TSDB_CODE_SUCCESS;
+  int64_t        usedBytes = tsdbGetMemUsedBytes(pRepo, pRepo->mem);
 
   if (tsdbScanAndConvertSubmitMsg(pRepo, pMsg) < 0) {
     if (terrno != TSDB_CODE_TDB_TABLE_RECONFIGURE) {
@@ -68,6 +103,11 @@ int32_t tsdbInsertData(STsdbRepo *repo, SSubmitMsg *pMsg, SShellSubmitRspMsg *pR
     return -1;
   }
 
+  if (tsdbShouldInsertInParallel(pRepo, pMsg)) {
+    if (tsdbInsertDataInParallel(pRepo, pMsg, &affectedrows, &numOfRows) < 0) return -1;
+    goto _rsp;
+  }
+
   tsdbInitSubmitMsgIter(pMsg, &msgIter);
   while (true) {
     tsdbGetSubmitMsgNext(&msgIter, &pBlock);
@@ -86,15 +126,60 @@ int32_t tsdbInsertData(STsdbRepo *repo, SSubmitMsg *pMsg, SShellSubmitRspMsg *pR
     numOfRows += pBlock->numOfRows;
   }
 
+_rsp:
   if (pRsp != NULL) {
     pRsp->affectedRows = htonl(affectedrows);
     pRsp->numOfRows = htonl(numOfRows);
   }
 
+  tsdbUpdateIngestRate(pRepo, tsdbGetMemUsedBytes(pRepo, pRepo->mem) - usedBytes);
+
   if (tsdbCheckCommit(pRepo) < 0) return -1;
   return ret;
 }
 
+void tsdbGetWritePressure(STsdbRepo *repo, STsdbWritePressure *pPressure) {
+  STsdbRepo *     pRepo = repo;
+  STsdbWriteStat *pStat = &pRepo->writeStat;
+  STsdbBufPool *  pPool = pRepo->pPool;
+  int64_t         now = taosGetTimestampMs();
+
+  memset(pPressure, 0, sizeof(*pPressure));
+  if (tsdbLockRepo(pRepo) < 0) return;
+
+  int64_t freeBytes = (int64_t)listNEles(pPool->bufBlockList) * pPool->bufBlockSize;
+  int64_t memRoom = (int64_t)(pRepo->config.totalBlocks / 3) * pPool->bufBlockSize;
+
+  if (pRepo->mem != NULL) {
+    STsdbBufBlock *pBufBlock = tsdbGetCurrBufBlock(pRepo);
+    if (pBufBlock != NULL) freeBytes += pBufBlock->remain;
+    memRoom = (pRepo->mem->extraBuffList != NULL) ? 0 : (memRoom - tsdbGetMemUsedBytes(pRepo, pRepo->mem));
+  }
+
+  // the memtable being full waits for the ongoing commit, otherwise a new commit starts at once
+  pPressure->committing = (pRepo->imem != NULL);
+  pPressure->headroom = pPressure->committing ? MIN(memRoom, freeBytes) : freeBytes;
+  if (pPressure->headroom < 0) pPressure->headroom = 0;
+
+  pPressure->totalBlocks = pPool->nBufBlocks;
+  pPressure->usedBlocks = pPool->nBufBlocks - listNEles(pPool->bufBlockList);
+  pPressure->commitRate = pStat->commitRate;
+  if (pPressure->committing && pStat->commitRate > 0) {
+    int64_t left = pStat->commitBytes * 1000 / pStat->commitRate - (now - pStat->commitStart);
+    pPressure->commitLeft = (int32_t)MAX(left, 1);
+  }
+
+  tsdbUnlockRepo(pRepo);
+
+  // the average is not updated once the writes stop
+  int64_t elapsed = now - pStat->sampleTime;
+  if (elapsed >= TSDB_INGEST_SAMPLE_MS * 2) {
+    pPressure->ingestRate = pStat->sampleBytes * 1000 / elapsed;
+  } else {
+    pPressure->ingestRate = pStat->ingestRate;
+  }
+}
+
 // ---------------- INTERNAL FUNCTIONS ----------------
 int tsdbRefMemTable(STsdbRepo *pRepo, SMemTable *pMemTable) {
   if (pMemTable == NULL) return 0;
@@ -230,6 +315,16 @@ void tsdbUnTakeMemSnapShot(STsdbRepo *pRepo, SMemSnapshot *pSnapshot) {
 }
 
 void *tsdbAllocBytes(STsdbRepo *pRepo, int bytes) {
+  if (!pRepo->parallelApply) return tsdbAllocBytesImp(pRepo, bytes);
+
+  pthread_mutex_lock(&pRepo->allocMutex);
+  void *ptr = tsdbAllocBytesImp(pRepo, bytes);
+  pthread_mutex_unlock(&pRepo->allocMutex);
+
+  return ptr;
+}
+
+static void *tsdbAllocBytesImp(STsdbRepo *pRepo, int bytes) {
   STsdbCfg *     pCfg = &pRepo->config;
   STsdbBufBlock *pBufBlock = NULL;
   void *         ptr = NULL;
@@ -291,6 +386,19 @@ void *tsdbAllocBytes(STsdbRepo *pRepo, int bytes) {
   return ptr;
 }
 
+// bytes of the buffer blocks taken by the memtable, the memory from the system is not counted
+int64_t tsdbGetMemUsedBytes(STsdbRepo *pRepo, SMemTable *pMemTable) {
+  if (pMemTable == NULL) return 0;
+
+  SListNode *pNode = listTail(pMemTable->bufBlockList);
+  if (pNode == NULL) return 0;
+
+  STsdbBufBlock *pBufBlock = NULL;
+  tdListNodeGetData(pMemTable->bufBlockList, pNode, (void *)(&pBufBlock));
+
+  return (int64_t)(listNEles(pMemTable->bufBlockList) - 1) * pRepo->pPool->bufBlockSize + pBufBlock->offset;
+}
+
 int tsdbSyncCommitConfig(STsdbRepo* pRepo) {
   ASSERT(pRepo->config_changed == true);
   tsem_wait(&(pRepo->readyToCommit));
@@ -339,6 +447,9 @@ int tsdbAsyncCommit(STsdbRepo *pRepo, SControlDataInfo* pCtlDataInfo) {
     // has data in mem
     pRepo->imem = pRepo->mem;
     pRepo->mem = NULL;
+    // the commit takes the time waiting in the commit queue too
+    pRepo->writeStat.commitBytes = tsdbGetMemUsedBytes(pRepo, pRepo->imem);
+    pRepo->writeStat.commitStart = taosGetTimestampMs();
     if(pCtlDataInfo == NULL) {
       if (tsdbScheduleCommit(pRepo, NULL, COMMIT_REQ) < 0)
         post = true;
@@ -392,7 +503,7 @@ int tsdbSyncCommit(STsdbRepo *repo) {
  * 
  * The function tries to procceed AS MUCH AS POSSIBLE.
  */
-int tsdbLoadDataFromCache(STable *pTable, SSkipListIterator *pIter, TSKEY maxKey, int maxRowsToRead, SDataCols *pCols,
+int tsdbLoadDataFromCache(STable *pTable, STableDataIter *pIter, TSKEY maxKey, int maxRowsToRead, SDataCols *pCols,
                           TKEY *filterKeys, int nFilterKeys, bool keepDup, SMergeInfo *pMergeInfo) {
   ASSERT(maxRowsToRead > 0 && nFilterKeys >= 0);
   if (pIter == NULL) return 0;
@@ -452,7 +563,7 @@ int tsdbLoadDataFromCache(STable *pTable, SSkipListIterator *pIter, TSKEY maxKey
         tsdbAppendTableRowToCols(pTable, pCols, &pSchema, row);
       }
 
-      tSkipListIterNext(pIter);
+      tsdbTableDataIterNext(pIter);
       row = tsdbNextIterRow(pIter);
       if (row == NULL || memRowKey(row) > maxKey) {
         rowKey = INT64_MAX;
@@ -482,7 +593,7 @@ int tsdbLoadDataFromCache(STable *pTable, SSkipListIterator *pIter, TSKEY maxKey
         }
       }
 
-      tSkipListIterNext(pIter);
+      tsdbTableDataIterNext(pIter);
       row = tsdbNextIterRow(pIter);
       if (row == NULL || memRowKey(row) > maxKey) {
         rowKey = INT64_MAX;
@@ -504,6 +615,65 @@ int tsdbLoadDataFromCache(STable *pTable, SSkipListIterator *pIter, TSKEY maxKey
   return 0;
 }
 
+STableDataIter *tsdbCreateTableDataIter(STableData *pTableData, int32_t order) {
+  return tsdbNewTableDataIter(pTableData, NULL, order);
+}
+
+// Create an iterator whose first row is the first one not less than key for ascending order, or the last one not
+// greater than key for descending order
+STableDataIter *tsdbCreateTableDataIterFromKey(STableData *pTableData, TSKEY key, int32_t order) {
+  return tsdbNewTableDataIter(pTableData, &key, order);
+}
+
+bool tsdbTableDataIterNext(STableDataIter *pIter) {
+  if (pIter->inSkipList) return tSkipListIterNext(&(pIter->slIter));
+
+  pIter->valid = false;
+  if (pIter->pChunk == NULL) return false;
+
+  if (pIter->order == TSDB_ORDER_ASC) {
+    pIter->index++;
+    while (true) {
+      if (pIter->index < atomic_load_32(&(pIter->pChunk->nRows))) break;
+
+      STableDataChunk *pNext = atomic_load_ptr(&(pIter->pChunk->next));
+      if (pNext == NULL) {
+        pIter->pChunk = NULL;
+        return false;
+      }
+
+      // rows may be appended to the chunk before the next one is linked
+      if (pIter->index < atomic_load_32(&(pIter->pChunk->nRows))) break;
+
+      pIter->pChunk = pNext;
+      pIter->index = 0;
+    }
+  } else {
+    if (--pIter->index < 0) {
+      pIter->pChunk = pIter->pChunk->prev;
+      if (pIter->pChunk == NULL) return false;
+      pIter->index = pIter->pChunk->nRows - 1;
+    }
+  }
+
+  pIter->valid = true;
+  return true;
+}
+
+SMemRow tsdbTableDataIterGet(STableDataIter *pIter) {
+  if (pIter->inSkipList) {
+    SSkipListNode *node = tSkipListIterGet(&(pIter->slIter));
+    return (node == NULL) ? NULL : (SMemRow)SL_GET_NODE_DATA(node);
+  }
+
+  return pIter->valid ? pIter->pChunk->rows[pIter->index] : NULL;
+}
+
+void *tsdbDestroyTableDataIter(STableDataIter *pIter) {
+  tfree(pIter);
+  return NULL;
+}
+
 // ---------------- LOCAL FUNCTIONS ----------------
 static SMemTable* tsdbNewMemTable(STsdbRepo *pRepo) {
   STsdbMeta *pMeta = pRepo->tsdbMeta;
@@ -559,7 +729,8 @@ static void tsdbFreeMemTable(SMemTable* pMemTable) {
   }
 }
 
-static STableData *tsdbNewTableData(STsdbCfg *pCfg, STable *pTable) {
+static STableData *tsdbNewTableData(STsdbRepo *pRepo, STable *pTable) {
+  STsdbCfg *  pCfg = &pRepo->config;
   STableData *pTableData = (STableData *)calloc(1, sizeof(*pTableData));
   if (pTableData == NULL) {
     terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
@@ -586,6 +757,9 @@ static STableData *tsdbNewTableData(STsdbCfg *pCfg, STable *pTable) {
     return NULL;
   }
 
+  // the nodes live in the buffer blocks of the memtable with the rows, and are released by recycling the blocks
+  tSkipListSetNodeAllocator(pTableData->pData, tsdbAllocSkipListNode, pRepo);
+
   T_REF_INC(pTableData);
 
   return pTableData;
@@ -601,6 +775,166 @@ static void tsdbFreeTableData(STableData *pTableData) {
   }
 }
 
+static void *tsdbAllocSkipListNode(void *param, int32_t bytes) {
+  return tsdbAllocAlignedBytes((STsdbRepo *)param, bytes);
+}
+
+// Rows in the buffer blocks have any length, pad the allocation to keep the pointers in it aligned
+static void *tsdbAllocAlignedBytes(STsdbRepo *pRepo, int bytes) {
+  void *ptr = tsdbAllocBytes(pRepo, bytes + sizeof(void *) - 1);
+  if (ptr == NULL) return NULL;
+
+  return (void *)ALIGN_NUM((uintptr_t)ptr, sizeof(void *));
+}
+
+static STableDataIter *tsdbNewTableDataIter(STableData *pTableData, const TSKEY *pKey, int32_t order) {
+  ASSERT(order == TSDB_ORDER_ASC || order == TSDB_ORDER_DESC);
+
+  STableDataIter *pIter = (STableDataIter *)calloc(1, sizeof(*pIter));
+  if (pIter == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return NULL;
+  }
+
+  pIter->order = order;
+  pIter->inSkipList = (atomic_load_8(&(pTableData->inSkipList)) != 0);
+
+  if (pIter->inSkipList) {
+    TKEY               tkey = (pKey == NULL) ? 0 : keyToTkey(*pKey);
+    const char *       val = (pKey == NULL) ? NULL : (const char *)&tkey;
+    SSkipListIterator *pSlIter = tSkipListCreateIterFromVal(pTableData->pData, val, TSDB_DATA_TYPE_TIMESTAMP, order);
+    if (pSlIter == NULL) {
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      free(pIter);
+      return NULL;
+    }
+
+    pIter->slIter = *pSlIter;
+    tSkipListDestroyIter(pSlIter);
+  } else {
+    tsdbSeekTableDataChunks(pIter, pTableData, pKey);
+  }
+
+  return pIter;
+}
+
+// Position the iterator right before the row it starts with
+static void tsdbSeekTableDataChunks(STableDataIter *pIter, STableData *pTableData, const TSKEY *pKey) {
+  STableDataChunk *pChunk = atomic_load_ptr(&(pTableData->pFirstChunk));
+  STableDataChunk *pNext = NULL;
+
+  pIter->pChunk = NULL;
+  if (pChunk == NULL) return;
+
+  if (pIter->order == TSDB_ORDER_ASC) {
+    if (pKey == NULL) {
+      pIter->pChunk = pChunk;
+      pIter->index = -1;
+      return;
+    }
+
+    // a chunk is full and never changed once the next one is linked
+    while ((pNext = atomic_load_ptr(&(pChunk->next))) != NULL && memRowKey(pChunk->rows[pChunk->nRows - 1]) < *pKey) {
+      pChunk = pNext;
+    }
+
+    int32_t nRows = atomic_load_32(&(pChunk->nRows));
+    int32_t index = tsdbSearchTableDataChunk(pChunk, nRows, *pKey, false);
+    if (index == nRows && pNext == NULL) return;
+
+    pIter->pChunk = pChunk;
+    pIter->index = index - 1;
+  } else {
+    if (pKey == NULL) {
+      pNext = atomic_load_ptr(&(pTableData->pLastChunk));
+      if (pNext != NULL) pChunk = pNext;
+      pIter->pChunk = pChunk;
+      pIter->index = atomic_load_32(&(pChunk->nRows));
+      return;
+    }
+
+    while ((pNext = atomic_load_ptr(&(pChunk->next))) != NULL && memRowKey(pNext->rows[0]) <= *pKey) {
+      pChunk = pNext;
+    }
+
+    pIter->pChunk = pChunk;
+    pIter->index = tsdbSearchTableDataChunk(pChunk, atomic_load_32(&(pChunk->nRows)), *pKey, true);
+  }
+}
+
+// Return the index of the first row whose key is greater than (upper) or not less than (!upper) key
+static int32_t tsdbSearchTableDataChunk(STableDataChunk *pChunk, int32_t nRows, TSKEY key, bool upper) {
+  int32_t lo = 0;
+  int32_t hi = nRows;
+
+  while (lo < hi) {
+    int32_t mid = lo + (hi - lo) / 2;
+    TSKEY   midKey = memRowKey(pChunk->rows[mid]);
+    if (midKey < key || (upper && midKey == key)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+static int tsdbAppendRowToTableData(STsdbRepo *pRepo, STableData *pTableData, SMemRow row) {
+  STableDataChunk *pChunk = pTableData->pLastChunk;
+
+  if (pChunk != NULL && pChunk->nRows < pChunk->capacity) {
+    pChunk->rows[pChunk->nRows] = row;
+    atomic_store_32(&(pChunk->nRows), pChunk->nRows + 1);
+    return 0;
+  }
+
+  // start with small chunks, a memtable may hold a few rows of many tables
+  int32_t capacity = (pChunk == NULL) ? TSDB_DATA_CHUNK_MIN_ROWS : MIN(pChunk->capacity * 2, TSDB_DATA_CHUNK_MAX_ROWS);
+
+  STableDataChunk *pNew =
+      (STableDataChunk *)tsdbAllocAlignedBytes(pRepo, (int)(sizeof(STableDataChunk) + sizeof(SMemRow) * capacity));
+  if (pNew == NULL) return -1;
+
+  pNew->prev = pChunk;
+  pNew->next = NULL;
+  pNew->capacity = capacity;
+  pNew->rows[0] = row;
+  pNew->nRows = 1;
+
+  if (pChunk == NULL) {
+    atomic_store_ptr(&(pTableData->pFirstChunk), pNew);
+  } else {
+    atomic_store_ptr(&(pChunk->next), pNew);
+  }
+  atomic_store_ptr(&(pTableData->pLastChunk), pNew);
+
+  return 0;
+}
+
+static void *tsdbGetTableDataChunkNext(void *iter) {
+  STableDataIter *pIter = (STableDataIter *)iter;
+  return tsdbTableDataIterNext(pIter) ? tsdbTableDataIterGet(pIter) : NULL;
+}
+
+// Move the appended rows of a table into its skip list, called by the writer before it puts a key out of order
+static void tsdbMoveTableDataToSkipList(STableData *pTableData) {
+  STableDataIter iter = {0};
+
+  ASSERT(!pTableData->inSkipList && SL_SIZE(pTableData->pData) == 0 && pTableData->pData->insertHandleFn == NULL);
+
+  iter.order = TSDB_ORDER_ASC;
+  iter.pChunk = pTableData->pFirstChunk;
+  iter.index = -1;
+  if (iter.pChunk != NULL) {
+    // the rows are sorted and stored already, keep them as they are
+    tSkipListPutBatchByIter(pTableData->pData, &iter, tsdbGetTableDataChunkNext);
+  }
+
+  // readers iterating the chunks go on with the rows before the move
+  atomic_store_8(&(pTableData->inSkipList), 1);
+}
+
 static char *tsdbGetTsTupleKey(const void *data) { return memRowKeys((SMemRow)data); }
 
 static int tsdbAdjustMemMaxTables(SMemTable *pMemTable, int maxTables) {
@@ -830,19 +1164,12 @@ static void tsdbSetupSkipListHookFns(SSkipList* pSkipList, STsdbRepo *pRepo, STa
   pSkipList->insertHandleFn->args[7] = pLastRow;
 }
 
-static int tsdbInsertDataToTable(STsdbRepo* pRepo, SSubmitBlk* pBlock, int32_t *pAffectedRows) {
-
-  STsdbMeta       *pMeta = pRepo->tsdbMeta;
-  int32_t          points = 0;
-  STable          *pTable = NULL;
-  SSubmitBlkIter   blkIter = {0};
-  SMemTable       *pMemTable = NULL;
-  STableData      *pTableData = NULL;
-  STsdbCfg        *pCfg = &(pRepo->config);
-
-  tsdbInitSubmitBlkIter(pBlock, &blkIter);
-  if(blkIter.row == NULL) return 0;
-  TSKEY firstRowKey = memRowKey(blkIter.row);
+// Get the data of the table in mem to insert the block into, the data is created if it is not there yet
+static STableData *tsdbGetTableDataToInsert(STsdbRepo *pRepo, SSubmitBlk *pBlock) {
+  STsdbMeta  *pMeta = pRepo->tsdbMeta;
+  STable     *pTable = NULL;
+  SMemTable  *pMemTable = NULL;
+  STableData *pTableData = NULL;
 
   tsdbAllocBytes(pRepo, 0);
   pMemTable = pRepo->mem;
@@ -857,7 +1184,7 @@ static int tsdbInsertDataToTable(STsdbRepo* pRepo, SSubmitBlk* pBlock, int32_t *
 
   if (TABLE_TID(pTable) >= pMemTable->maxTables) {
     if (tsdbAdjustMemMaxTables(pMemTable, pMeta->maxTables) < 0) {
-      return -1;
+      return NULL;
     }
   }
   pTableData = pMemTable->tData[TABLE_TID(pTable)];
@@ -870,11 +1197,11 @@ static int tsdbInsertDataToTable(STsdbRepo* pRepo, SSubmitBlk* pBlock, int32_t *
       taosWUnLockLatch(&(pMemTable->latch));
     }
 
-    pTableData = tsdbNewTableData(pCfg, pTable);
+    pTableData = tsdbNewTableData(pRepo, pTable);
     if (pTableData == NULL) {
       tsdbError("vgId:%d failed to insert data to table %s uid %" PRId64 " tid %d since %s", REPO_ID(pRepo),
                 TABLE_CHAR_NAME(pTable), TABLE_UID(pTable), TABLE_TID(pTable), tstrerror(terrno));
-      return -1;
+      return NULL;
     }
 
     pRepo->mem->tData[TABLE_TID(pTable)] = pTableData;
@@ -882,34 +1209,219 @@ static int tsdbInsertDataToTable(STsdbRepo* pRepo, SSubmitBlk* pBlock, int32_t *
 
   ASSERT((pTableData != NULL) && pTableData->uid == TABLE_UID(pTable));
 
-  SMemRow lastRow = NULL;
-  int64_t osize = SL_SIZE(pTableData->pData);
-  tsdbSetupSkipListHookFns(pTableData->pData, pRepo, pTable, &points, &lastRow);
-  tSkipListPutBatchByIter(pTableData->pData, &blkIter, (iter_next_fn_t)tsdbGetSubmitBlkNext);
-  int64_t dsize = SL_SIZE(pTableData->pData) - osize;
-  (*pAffectedRows) += points;
+  return pTableData;
+}
+
+// Put the rows of the block into the data of the table. Only the table data is changed, so the blocks of different
+// tables can be inserted by different threads
+static int tsdbInsertBlockToTableData(STsdbRepo *pRepo, SInsertBlkInfo *pInfo) {
+  STable *       pTable = pInfo->pTable;
+  STableData *   pTableData = pInfo->pTableData;
+  SSubmitBlkIter blkIter = {0};
+
+  tsdbInitSubmitBlkIter(pInfo->pBlock, &blkIter);
+  if (blkIter.row == NULL) return 0;
+  pInfo->firstKey = memRowKey(blkIter.row);
+
+  if (!pTableData->inSkipList) {
+    STableDataChunk *pChunk = pTableData->pLastChunk;
+    TSKEY            appendKey = (pChunk == NULL) ? INT64_MIN : memRowKey(pChunk->rows[pChunk->nRows - 1]);
+
+    while (blkIter.row != NULL && memRowKey(blkIter.row) > appendKey) {
+      SMemRow row = tsdbInsertDupKeyMerge(tsdbGetSubmitBlkNext(&blkIter), NULL, pRepo, NULL, NULL, pTable,
+                                          &pInfo->points, &pInfo->lastRow);
+      if (row == NULL || tsdbAppendRowToTableData(pRepo, pTableData, row) < 0) {
+        tsdbError("vgId:%d failed to append data to table %s uid %" PRId64 " tid %d since %s", REPO_ID(pRepo),
+                  TABLE_CHAR_NAME(pTable), TABLE_UID(pTable), TABLE_TID(pTable), tstrerror(terrno));
+        return -1;
+      }
+
+      appendKey = memRowKey(row);
+      pInfo->dsize++;
+    }
+
+    if (blkIter.row != NULL) tsdbMoveTableDataToSkipList(pTableData);
+  }
+
+  if (blkIter.row != NULL) {
+    int64_t osize = SL_SIZE(pTableData->pData);
+    tsdbSetupSkipListHookFns(pTableData->pData, pRepo, pTable, &pInfo->points, &pInfo->lastRow);
+    tSkipListPutBatchByIter(pTableData->pData, &blkIter, (iter_next_fn_t)tsdbGetSubmitBlkNext);
+    pInfo->dsize += SL_SIZE(pTableData->pData) - osize;
+  }
+
+  return 0;
+}
+
+// Update the key range, row count, last row and statistics after the block is inserted
+static int tsdbUpdateInsertInfo(STsdbRepo *pRepo, SInsertBlkInfo *pInfo, int32_t *pAffectedRows) {
+  SMemTable * pMemTable = pRepo->mem;
+  STable *    pTable = pInfo->pTable;
+  STableData *pTableData = pInfo->pTableData;
+
+  (*pAffectedRows) += pInfo->points;
 
-  if(lastRow != NULL) {
-    TSKEY lastRowKey = memRowKey(lastRow);
-    if (pMemTable->keyFirst > firstRowKey) pMemTable->keyFirst = firstRowKey;
-    pMemTable->numOfRows += dsize;
+  if (pInfo->lastRow != NULL) {
+    TSKEY lastRowKey = memRowKey(pInfo->lastRow);
+    if (pMemTable->keyFirst > pInfo->firstKey) pMemTable->keyFirst = pInfo->firstKey;
+    pMemTable->numOfRows += pInfo->dsize;
 
-    if (pTableData->keyFirst > firstRowKey) pTableData->keyFirst = firstRowKey;
-    pTableData->numOfRows += dsize;
+    if (pTableData->keyFirst > pInfo->firstKey) pTableData->keyFirst = pInfo->firstKey;
+    pTableData->numOfRows += pInfo->dsize;
     if (pMemTable->keyLast < lastRowKey) pMemTable->keyLast = lastRowKey;
     if (pTableData->keyLast < lastRowKey) pTableData->keyLast = lastRowKey;
-    if (tsdbUpdateTableLatestInfo(pRepo, pTable, lastRow) < 0) {
+    if (tsdbUpdateTableLatestInfo(pRepo, pTable, pInfo->lastRow) < 0) {
       return -1;
     }
   }
 
-  STSchema *pSchema = tsdbGetTableSchemaByVersion(pTable, pBlock->sversion, -1);
-  pRepo->stat.pointsWritten += points * schemaNCols(pSchema);
-  pRepo->stat.totalStorage += points * schemaVLen(pSchema);
+  STSchema *pSchema = tsdbGetTableSchemaByVersion(pTable, pInfo->pBlock->sversion, -1);
+  pRepo->stat.pointsWritten += pInfo->points * schemaNCols(pSchema);
+  pRepo->stat.totalStorage += pInfo->points * schemaVLen(pSchema);
 
   return 0;
 }
 
+static int tsdbInsertDataToTable(STsdbRepo* pRepo, SSubmitBlk* pBlock, int32_t *pAffectedRows) {
+  SInsertBlkInfo info = {.pBlock = pBlock};
+
+  // no row
+  if (pBlock->dataLen <= 0) return 0;
+
+  info.pTableData = tsdbGetTableDataToInsert(pRepo, pBlock);
+  if (info.pTableData == NULL) return -1;
+  info.pTable = pRepo->tsdbMeta->tables[pBlock->tid];
+
+  if (tsdbInsertBlockToTableData(pRepo, &info) < 0) return -1;
+
+  return tsdbUpdateInsertInfo(pRepo, &info, pAffectedRows);
+}
+
+// A msg of many rows for more than one table is worth the apply threads, except for update=2, which merges rows with
+// the shared merge buffer
+static bool tsdbShouldInsertInParallel(STsdbRepo *pRepo, SSubmitMsg *pMsg) {
+  SSubmitMsgIter msgIter = {0};
+  SSubmitBlk *   pBlock = NULL;
+  int32_t        tid = -1;
+  int32_t        numOfRows = 0;
+  bool           multiTables = false;
+
+  if (tsdbGetApplyThreads() <= 0 || pRepo->config.update == TD_ROW_PARTIAL_UPDATE) return false;
+
+  tsdbInitSubmitMsgIter(pMsg, &msgIter);
+  while (true) {
+    tsdbGetSubmitMsgNext(&msgIter, &pBlock);
+    if (pBlock == NULL) break;
+    if (IS_CONTROL_BLOCK(pBlock)) return false;
+
+    if (tid >= 0 && pBlock->tid != tid) multiTables = true;
+    tid = pBlock->tid;
+    numOfRows += pBlock->numOfRows;
+  }
+
+  return multiTables && numOfRows >= TSDB_APPLY_MIN_ROWS;
+}
+
+static void tsdbInsertBlocksOfTask(void *param, int index) {
+  SInsertJob *pJob = (SInsertJob *)param;
+
+  for (int32_t i = 0; i < pJob->numOfBlocks; i++) {
+    SInsertBlkInfo *pInfo = pJob->pInfos + i;
+    if (pInfo->pTableData == NULL || pInfo->pTableData->applyTask != index) continue;
+
+    if (tsdbInsertBlockToTableData(pJob->pRepo, pInfo) < 0) {
+      pInfo->code = terrno;
+    }
+  }
+}
+
+/**
+ * Insert the blocks of the msg with the apply threads. The tables are prepared by this thread and split into tasks
+ * with about the same rows, all blocks of a table go to the same task in the msg order. The apply threads only put
+ * rows into the tables of their tasks, and the key range, last row and statistics are updated here afterwards.
+ */
+static int tsdbInsertDataInParallel(STsdbRepo *pRepo, SSubmitMsg *pMsg, int32_t *pAffectedRows, int32_t *pNumOfRows) {
+  SSubmitMsgIter msgIter = {0};
+  SSubmitBlk *   pBlock = NULL;
+  SInsertJob     job = {.pRepo = pRepo};
+  int            code = 0;
+
+  job.pInfos = (SInsertBlkInfo *)calloc(pMsg->numOfBlocks, sizeof(SInsertBlkInfo));
+  if (job.pInfos == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  tsdbInitSubmitMsgIter(pMsg, &msgIter);
+  while (job.numOfBlocks < pMsg->numOfBlocks) {
+    tsdbGetSubmitMsgNext(&msgIter, &pBlock);
+    if (pBlock == NULL) break;
+
+    SInsertBlkInfo *pInfo = job.pInfos + job.numOfBlocks++;
+    pInfo->pBlock = pBlock;
+    (*pNumOfRows) += pBlock->numOfRows;
+    if (pBlock->dataLen <= 0) continue;
+
+    pInfo->pTableData = tsdbGetTableDataToInsert(pRepo, pBlock);
+    if (pInfo->pTableData == NULL) {
+      free(job.pInfos);
+      return -1;
+    }
+    pInfo->pTable = pRepo->tsdbMeta->tables[pBlock->tid];
+    pInfo->pTableData->applyTask = -1;
+  }
+
+  job.numOfTasks = MIN(tsdbGetApplyThreads() + 1, job.numOfBlocks);
+  int32_t *taskRows = (int32_t *)calloc(job.numOfTasks, sizeof(int32_t));
+  if (taskRows == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    free(job.pInfos);
+    return -1;
+  }
+
+  // a new table goes to the task with the least rows
+  for (int32_t i = 0; i < job.numOfBlocks; i++) {
+    SInsertBlkInfo *pInfo = job.pInfos + i;
+    if (pInfo->pTableData == NULL) continue;
+
+    if (pInfo->pTableData->applyTask < 0) {
+      int32_t task = 0;
+      for (int32_t t = 1; t < job.numOfTasks; t++) {
+        if (taskRows[t] < taskRows[task]) task = t;
+      }
+      pInfo->pTableData->applyTask = task;
+    }
+    taskRows[pInfo->pTableData->applyTask] += pInfo->pBlock->numOfRows;
+  }
+  free(taskRows);
+
+  tsdbDebug("vgId:%d insert %d blocks of %d rows by %d tasks", REPO_ID(pRepo), job.numOfBlocks, *pNumOfRows,
+            job.numOfTasks);
+
+  pRepo->parallelApply = true;
+  if (tsdbApplyInParallel(tsdbInsertBlocksOfTask, &job, job.numOfTasks) < 0) {
+    for (int32_t t = 0; t < job.numOfTasks; t++) {
+      tsdbInsertBlocksOfTask(&job, t);
+    }
+  }
+  pRepo->parallelApply = false;
+
+  for (int32_t i = 0; i < job.numOfBlocks; i++) {
+    SInsertBlkInfo *pInfo = job.pInfos + i;
+    if (pInfo->pTableData == NULL) continue;
+
+    if (pInfo->code != 0) {
+      terrno = pInfo->code;
+      code = -1;
+    }
+
+    // the rows put before a failure are in the table and counted as well
+    if (tsdbUpdateInsertInfo(pRepo, pInfo, pAffectedRows) < 0) code = -1;
+  }
+
+  free(job.pInfos);
+  return code;
+}
 
 static int tsdbInitSubmitMsgIter(SSubmitMsg *pMsg, SSubmitMsgIter *pIter) {
   if (pMsg == NULL) {
@@ -1143,6 +1655,22 @@ int32_t tsdbTableGroupInfo(STableGroupInfo* pTableGroup, int32_t * ptids) {
 }
 
 // Control Data
+static void tsdbUpdateIngestRate(STsdbRepo *pRepo, int64_t bytes) {
+  STsdbWriteStat *pStat = &pRepo->writeStat;
+  int64_t         now = taosGetTimestampMs();
+
+  if (bytes > 0) pStat->sampleBytes += bytes;
+
+  int64_t elapsed = now - pStat->sampleTime;
+  if (elapsed < TSDB_INGEST_SAMPLE_MS) return;
+
+  // a sample after the writes stop for a while starts the average over
+  int64_t rate = pStat->sampleBytes * 1000 / elapsed;
+  pStat->ingestRate = (elapsed >= TSDB_INGEST_SAMPLE_MS * 2) ? rate : (pStat->ingestRate + rate) / 2;
+  pStat->sampleTime = now;
+  pStat->sampleBytes = 0;
+}
+
 int32_t tsdbInsertControlData(STsdbRepo* pRepo, SSubmitBlk* pBlock, SShellSubmitRspMsg *pRsp, tsem_t** ppSem) {
   int32_t ret = TSDB_CODE_SUCCESS;
   SControlData* pCtlData = (SControlData* )pBlock->data;
@@ -39,6 +39,7 @@ static int     tsdbEncodeTableName(void **buf, tstr *name);
 static void *  tsdbDecodeTableName(void *buf, tstr **name);
 static int     tsdbEncodeTable(void **buf, STable *pTable);
 static void *  tsdbDecodeTable(void *buf, STable **pRTable);
+static void *  tsdbDecodeTableTombs(void *buf, STable *pTable);
 static int     tsdbGetTableEncodeSize(int8_t act, STable *pTable);
 static void *  tsdbInsertTableAct(STsdbRepo *pRepo, int8_t act, void *buf, STable *pTable);
 static int     tsdbRemoveTableFromStore(STsdbRepo *pRepo, STable *pTable);
@@ -398,8 +399,10 @@ int tsdbUpdateTableTagValue(STsdbRepo *repo, SUpdateTableTagValMsg *pMsg) {
   // STColumn *pCol = bsearch(&(pMsg->colId), pMsg->data, pMsg->numOfTags, sizeof(STColumn), colIdCompar);
   // ASSERT(pCol != NULL);
 
+  // the inverted tag indexes are updated under the write lock of meta, as queries may create them meanwhile
+  tsdbWLockRepoMeta(pRepo);
+  tsdbRemoveFromTagIndexes(pTable->pSuper, pTable);
   if (isChangeIndexCol) {
-    tsdbWLockRepoMeta(pRepo);
     tsdbRemoveTableFromIndex(pMeta, pTable);
   }
   TSDB_WLOCK_TABLE(pTable);
@@ -410,10 +413,12 @@ int tsdbUpdateTableTagValue(STsdbRepo *repo, SUpdateTableTagValMsg *pMsg) {
     tdSetKVRowDataOfCol(&(pTable->tagVal), pMsg->colId, pMsg->type, POINTER_SHIFT(pMsg->data, pMsg->schemaLen));
   }
   TSDB_WUNLOCK_TABLE(pTable);
+  tsdbInvalidateTagStore(pTable->pSuper);
   if (isChangeIndexCol) {
     tsdbAddTableIntoIndex(pMeta, pTable, false);
-    tsdbUnlockRepoMeta(pRepo);
   }
+  tsdbAddToTagIndexes(pTable->pSuper, pTable);
+  tsdbUnlockRepoMeta(pRepo);
 
   // Update on file
   int tlen1 = (pNewSchema) ? tsdbGetTableEncodeSize(TSDB_UPDATE_META, pTable->pSuper) : 0;
@@ -775,7 +780,13 @@ int tsdbRestoreTable(STsdbRepo *pRepo, void *cont, int contLen) {
     return -1;
   }
 
-  tsdbDecodeTable(cont, &pTable);
+  void *pEnd = tsdbDecodeTable(cont, &pTable);
+
+  // the tombstones are appended to the record of a table with deleted ranges
+  if (POINTER_DISTANCE(pEnd, cont) < contLen - (int)sizeof(TSCKSUM) && tsdbDecodeTableTombs(pEnd, pTable) == NULL) {
+    tsdbFreeTable(pTable);
+    return -1;
+  }
 
   if (tsdbAddTableToMeta(pRepo, pTable, false, false) < 0) {
     tsdbFreeTable(pTable);
@@ -787,6 +798,190 @@ int tsdbRestoreTable(STsdbRepo *pRepo, void *cont, int contLen) {
   return 0;
 }
 
+int tsdbEncodeTableRecord(void **buf, STable *pTable, SArray *aTomb) {
+  void *pStart = (buf == NULL) ? NULL : *buf;
+  int   tlen = tsdbEncodeTable(buf, pTable) + tsdbEncodeTableTombs(buf, aTomb);
+
+  if (buf != NULL) {
+    taosCalcChecksumAppend(0, (uint8_t *)pStart, tlen + sizeof(TSCKSUM));
+    *buf = POINTER_SHIFT(*buf, sizeof(TSCKSUM));
+  }
+
+  return tlen + sizeof(TSCKSUM);
+}
+
+int tsdbGetTableTombs(STable *pTable, SArray **paTomb) {
+  int code = 0;
+
+  *paTomb = NULL;
+  TSDB_RLOCK_TABLE(pTable);
+  if (pTable->aTomb != NULL && (*paTomb = taosArrayDup(pTable->aTomb)) == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    code = -1;
+  }
+  TSDB_RUNLOCK_TABLE(pTable);
+
+  return code;
+}
+
+void tsdbSetTableTombs(STable *pTable, SArray *aTomb) {
+  if (aTomb != NULL && taosArrayGetSize(aTomb) == 0) {
+    taosArrayDestroy(&aTomb);
+  }
+
+  TSDB_WLOCK_TABLE(pTable);
+  SArray *aOld = pTable->aTomb;
+  pTable->aTomb = aTomb;
+  TSDB_WUNLOCK_TABLE(pTable);
+
+  taosArrayDestroy(&aOld);
+}
+
+// Add [skey, ekey] to the tombstones, the ranges it overlaps or adjoins are merged into one
+int tsdbAddTomb(SArray *aTomb, TSKEY skey, TSKEY ekey, int64_t txnVer) {
+  STableTomb tomb = {.skey = skey, .ekey = ekey, .version = txnVer};
+  size_t     nTombs = taosArrayGetSize(aTomb);
+  size_t     i = 0, j;
+
+  while (i < nTombs && ((STableTomb *)taosArrayGet(aTomb, i))->ekey < skey &&
+         ((STableTomb *)taosArrayGet(aTomb, i))->ekey + 1 < skey) {
+    i++;
+  }
+
+  for (j = i; j < nTombs; j++) {
+    STableTomb *pTomb = taosArrayGet(aTomb, j);
+    if (pTomb->skey > ekey && pTomb->skey - 1 > ekey) break;
+
+    tomb.skey = MIN(tomb.skey, pTomb->skey);
+    tomb.ekey = MAX(tomb.ekey, pTomb->ekey);
+    tomb.version = MAX(tomb.version, pTomb->version);
+  }
+
+  for (; j > i; j--) {
+    taosArrayRemove(aTomb, i);
+  }
+
+  if (taosArrayInsert(aTomb, i, &tomb) == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  return 0;
+}
+
+// Remove [skey, ekey] from the tombstones once the rows in it are purged
+int tsdbCutTombs(SArray *aTomb, TSKEY skey, TSKEY ekey) {
+  for (size_t i = 0; i < taosArrayGetSize(aTomb);) {
+    STableTomb *pTomb = taosArrayGet(aTomb, i);
+
+    if (pTomb->ekey < skey || pTomb->skey > ekey) {
+      i++;
+    } else if (pTomb->skey >= skey && pTomb->ekey <= ekey) {
+      taosArrayRemove(aTomb, i);
+    } else if (pTomb->skey < skey && pTomb->ekey > ekey) {
+      STableTomb tail = *pTomb;
+      tail.skey = ekey + 1;
+      pTomb->ekey = skey - 1;
+      if (taosArrayInsert(aTomb, i + 1, &tail) == NULL) {
+        terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+        return -1;
+      }
+      i += 2;
+    } else {
+      if (pTomb->skey < skey) {
+        pTomb->ekey = skey - 1;
+      } else {
+        pTomb->skey = ekey + 1;
+      }
+      i++;
+    }
+  }
+
+  return 0;
+}
+
+static int tsdbTombCompare(const void *key, const void *tomb) {
+  TSKEY             k = *(TSKEY *)key;
+  const STableTomb *pTomb = (const STableTomb *)tomb;
+
+  if (k < pTomb->skey) return -1;
+  if (k > pTomb->ekey) return 1;
+  return 0;
+}
+
+bool tsdbTombsOverlap(SArray *aTomb, TSKEY skey, TSKEY ekey) {
+  if (aTomb == NULL) return false;
+
+  // the first tombstone ending at or after skey
+  STableTomb *pTomb = taosArraySearch(aTomb, &skey, tsdbTombCompare, TD_GE);
+  return pTomb != NULL && pTomb->skey <= ekey;
+}
+
+bool tsdbTombsCover(SArray *aTomb, TSKEY skey, TSKEY ekey) {
+  if (aTomb == NULL) return false;
+
+  STableTomb *pTomb = taosArraySearch(aTomb, &skey, tsdbTombCompare, TD_EQ);
+  return pTomb != NULL && pTomb->ekey >= ekey;
+}
+
+// Get the update of the table in aUpd sorted by tid, a new one starts from the current tombstones of the table
+STableTombUpd *tsdbGetTombUpd(SArray *aUpd, STable *pTable) {
+  size_t l = 0, r = taosArrayGetSize(aUpd);
+
+  while (l < r) {
+    size_t         m = (l + r) / 2;
+    STableTombUpd *pUpd = taosArrayGet(aUpd, m);
+
+    if (TABLE_TID(pUpd->pTable) == TABLE_TID(pTable)) return pUpd;
+    if (TABLE_TID(pUpd->pTable) < TABLE_TID(pTable)) {
+      l = m + 1;
+    } else {
+      r = m;
+    }
+  }
+
+  STableTombUpd upd = {.pTable = pTable, .aTomb = NULL};
+  if (tsdbGetTableTombs(pTable, &upd.aTomb) < 0) return NULL;
+  if (upd.aTomb == NULL && (upd.aTomb = taosArrayInit(1, sizeof(STableTomb))) == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return NULL;
+  }
+
+  STableTombUpd *pUpd = taosArrayInsert(aUpd, l, &upd);
+  if (pUpd == NULL) {
+    taosArrayDestroy(&upd.aTomb);
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return NULL;
+  }
+
+  tsdbRefTable(pTable);
+  return pUpd;
+}
+
+void tsdbApplyTombUpds(SArray *aUpd) {
+  if (aUpd == NULL) return;
+
+  for (size_t i = 0; i < taosArrayGetSize(aUpd); i++) {
+    STableTombUpd *pUpd = taosArrayGet(aUpd, i);
+    tsdbSetTableTombs(pUpd->pTable, pUpd->aTomb);
+    tsdbUnRefTable(pUpd->pTable);
+  }
+
+  taosArrayClear(aUpd);
+}
+
+void tsdbClearTombUpds(SArray *aUpd) {
+  if (aUpd == NULL) return;
+
+  for (size_t i = 0; i < taosArrayGetSize(aUpd); i++) {
+    STableTombUpd *pUpd = taosArrayGet(aUpd, i);
+    taosArrayDestroy(&pUpd->aTomb);
+    tsdbUnRefTable(pUpd->pTable);
+  }
+
+  taosArrayClear(aUpd);
+}
+
 void tsdbOrgMeta(STsdbRepo *pRepo) {
   STsdbMeta *pMeta = pRepo->tsdbMeta;
 
@@ -794,6 +989,7 @@ void tsdbOrgMeta(STsdbRepo *pRepo) {
     STable *pTable = pMeta->tables[i];
     if (pTable != NULL && pTable->type == TSDB_CHILD_TABLE) {
       tsdbAddTableIntoIndex(pMeta, pTable, true);
+      tsdbAddToTagIndexes(pTable->pSuper, pTable);
     }
   }
 }
@@ -877,6 +1073,7 @@ static STable *tsdbCreateTableFromCfg(STableCfg *pCfg, bool isSuper, STable *pST
         terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
         goto _err;
       }
+      if (tsdbInitTagStore(pTable) < 0) goto _err;
     }
   } else {
     pTable->type = pCfg->type;
@@ -940,6 +1137,7 @@ static void tsdbFreeTable(STable *pTable) {
 
       if (TABLE_TYPE(pTable) == TSDB_SUPER_TABLE) {
         tdFreeSchema(pTable->tagSchema);
+        tsdbFreeTagStore(pTable);
       }
     }
 
@@ -951,6 +1149,7 @@ static void tsdbFreeTable(STable *pTable) {
     tfree(pTable->sql);
 
     tsdbFreeLastColumns(pTable);
+    taosArrayDestroy(&pTable->aTomb);
     free(pTable);
   }
 }
@@ -981,6 +1180,7 @@ static int tsdbAddTableToMeta(STsdbRepo *pRepo, STable *pTable, bool addIdx, boo
                   TABLE_CHAR_NAME(pTable), tstrerror(terrno));
         goto _err;
       }
+      tsdbAddToTagIndexes(pTable->pSuper, pTable);
     }
     ASSERT(TABLE_TID(pTable) < pMeta->maxTables);
     pMeta->tables[TABLE_TID(pTable)] = pTable;
@@ -1043,6 +1243,7 @@ static void tsdbRemoveTableFromMeta(STsdbRepo *pRepo, STable *pTable, bool rmFro
   } else {
     pMeta->tables[pTable->tableId.tid] = NULL;
     if (TABLE_TYPE(pTable) == TSDB_CHILD_TABLE && rmFromIdx) {
+      tsdbRemoveFromTagIndexes(pTable->pSuper, pTable);
       tsdbRemoveTableFromIndex(pMeta, pTable);
     }
 
@@ -1155,6 +1356,7 @@ static int tsdbAddTableIntoIndex(STsdbMeta *pMeta, STable *pTable, bool refSuper
     }
   }else{
     tSkipListPut(pSTable->pIndex, (void *)pTable);
+    tsdbInvalidateTagStore(pSTable);
   }
 
   return 0;
@@ -1217,6 +1419,7 @@ static int tsdbRemoveTableFromIndex(STsdbMeta *pMeta, STable *pTable) {
     }
 
     taosArrayDestroy(&res);
+    tsdbInvalidateTagStore(pSTable);
   }
   return 0;
 }
@@ -1425,6 +1628,45 @@ static int tsdbEncodeTable(void **buf, STable *pTable) {
   return tlen;
 }
 
+int tsdbEncodeTableTombs(void **buf, SArray *aTomb) {
+  uint32_t nTombs = (uint32_t)taosArrayGetSize(aTomb);
+  int      tlen = 0;
+
+  // no tail at all, so a table without tombstones is encoded as before
+  if (nTombs == 0) return 0;
+
+  tlen += taosEncodeFixedU32(buf, nTombs);
+  for (uint32_t i = 0; i < nTombs; i++) {
+    STableTomb *pTomb = taosArrayGet(aTomb, i);
+    tlen += taosEncodeFixedI64(buf, pTomb->skey);
+    tlen += taosEncodeFixedI64(buf, pTomb->ekey);
+    tlen += taosEncodeFixedI64(buf, pTomb->version);
+  }
+
+  return tlen;
+}
+
+static void *tsdbDecodeTableTombs(void *buf, STable *pTable) {
+  uint32_t nTombs = 0;
+
+  buf = taosDecodeFixedU32(buf, &nTombs);
+  pTable->aTomb = taosArrayInit(nTombs, sizeof(STableTomb));
+  if (pTable->aTomb == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < nTombs; i++) {
+    STableTomb tomb;
+    buf = taosDecodeFixedI64(buf, &tomb.skey);
+    buf = taosDecodeFixedI64(buf, &tomb.ekey);
+    buf = taosDecodeFixedI64(buf, &tomb.version);
+    taosArrayPush(pTable->aTomb, &tomb);
+  }
+
+  return buf;
+}
+
 static void *tsdbDecodeTable(void *buf, STable **pRTable) {
   STable *pTable = tsdbNewTable();
   if (pTable == NULL) return NULL;
@@ -1467,7 +1709,7 @@ static void *tsdbDecodeTable(void *buf, STable **pRTable) {
       }else{
         pTable->pIndex = tSkipListCreate(TSDB_SUPER_TABLE_SL_LEVEL, colType(pCol), (uint8_t)(colBytes(pCol)), NULL,
                                        SL_ALLOW_DUP_KEY, getTagIndexKey);
-        if (pTable->pIndex == NULL) {
+        if (pTable->pIndex == NULL || tsdbInitTagStore(pTable) < 0) {
           terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
           tsdbFreeTable(pTable);
           return NULL;
@@ -28,6 +28,8 @@
 #include "qFilter.h"
 #include "cJSON.h"
 
+extern int32_t tsTsdbReadAheadBlocks;
+
 #define EXTRA_BYTES 2
 #define ASCENDING_TRAVERSE(o)   (o == TSDB_ORDER_ASC)
 #define QH_GET_NUM_OF_COLS(handle) ((size_t)(taosArrayGetSize((handle)->pColumns)))
@@ -72,6 +74,7 @@ typedef struct SDataBlockLoadInfo {
   int32_t     slot;
   int32_t     tid;
   SArray*     pLoadedCols;
+  bool        masked;     // rows in the tombstones are dropped, the SBlock then describes the kept rows
 } SDataBlockLoadInfo;
 
 typedef struct SLoadCompBlockInfo {
@@ -95,8 +98,9 @@ typedef struct STableCheckInfo {
   int32_t       numOfBlocks:29; // number of qualified data blocks not the original blocks
   uint8_t        chosen:2;       // indicate which iterator should move forward
   bool          initBuf;        // whether to initialize the in-memory skip list iterator or not
-  SSkipListIterator* iter;      // mem buffer skip list iterator
-  SSkipListIterator* iiter;     // imem buffer skip list iterator
+  STableDataIter*    iter;      // mem buffer iterator
+  STableDataIter*    iiter;     // imem buffer iterator
+  SArray*       aTomb;          // STableTomb of the table when the query starts, NULL if none
 } STableCheckInfo;
 
 typedef struct STableBlockInfo {
@@ -117,6 +121,8 @@ typedef struct SIOCostSummary {
   int64_t checkForNextTime;
   int64_t headFileLoad;
   int64_t headFileLoadTime;
+  int64_t readAheadBlocks;
+  int64_t readAheadBytes;
 } SIOCostSummary;
 
 typedef struct STsdbQueryHandle {
@@ -146,6 +152,7 @@ typedef struct STsdbQueryHandle {
   SFSIter        fileIter;
   SReadH         rhelper;
   STableBlockInfo* pDataBlockInfo;
+  int32_t        readAheadSlot;    // the farthest block slot in current file which has been read ahead
   SDataCols     *pDataCols;        // in order to hold current file data block
   int32_t        allocSize;        // allocated data block size
   SMemRef       *pMemRef;
@@ -156,6 +163,10 @@ typedef struct STsdbQueryHandle {
   SArray        *prev;             // previous row which is before than time window
   SArray        *next;             // next row which is after the query time window
   SIOCostSummary cost;
+  int32_t        statFid;          // FSET of the block loads below, reported to the repo to measure its fragmentation
+  int64_t        statLoads;
+  int64_t        statExtraLoads;
+  SDataCols*     pCodeCols;        // file block whose rows are exactly the rows last retrieved, for the dictionary codes
   
   // callback
   readover_callback readover_cb;
@@ -196,6 +207,7 @@ static void tsdbInitDataBlockLoadInfo(SDataBlockLoadInfo* pBlockLoadInfo) {
   pBlockLoadInfo->slot = -1;
   pBlockLoadInfo->tid = -1;
   pBlockLoadInfo->fileGroup = NULL;
+  pBlockLoadInfo->masked = false;
 }
 
 static void tsdbInitCompBlockLoadInfo(SLoadCompBlockInfo* pCompBlockLoadInfo) {
@@ -318,6 +330,12 @@ static SArray* createCheckInfoFromTableGroup(STsdbQueryHandle* pQueryHandle, STa
       info.tableId.tid = info.pTableObj->tableId.tid;
       info.tableId.uid = info.pTableObj->tableId.uid;
 
+      if (tsdbGetTableTombs(info.pTableObj, &info.aTomb) < 0) {
+        destroyTableCheckInfo(pTableCheckInfo);
+        taosArrayDestroy(&pTable);
+        return NULL;
+      }
+
       if (ASCENDING_TRAVERSE(pQueryHandle->order)) {
         if (info.lastKey == INT64_MIN || info.lastKey < pQueryHandle->window.skey) {
           info.lastKey = pQueryHandle->window.skey;
@@ -353,8 +371,8 @@ static void resetCheckInfo(STsdbQueryHandle* pQueryHandle) {
   for (int32_t i = 0; i < numOfTables; ++i) {
     STableCheckInfo* pCheckInfo = (STableCheckInfo*) taosArrayGet(pQueryHandle->pTableCheckInfo, i);
     pCheckInfo->lastKey = pQueryHandle->window.skey;
-    pCheckInfo->iter    = tSkipListDestroyIter(pCheckInfo->iter);
-    pCheckInfo->iiter   = tSkipListDestroyIter(pCheckInfo->iiter);
+    pCheckInfo->iter    = tsdbDestroyTableDataIter(pCheckInfo->iter);
+    pCheckInfo->iiter   = tsdbDestroyTableDataIter(pCheckInfo->iiter);
     pCheckInfo->initBuf = false;
 
     if (ASCENDING_TRAVERSE(pQueryHandle->order)) {
@@ -373,6 +391,12 @@ static SArray* createCheckInfoFromCheckInfo(STableCheckInfo* pCheckInfo, TSKEY s
   STableCheckInfo info = { .lastKey = skey, .pTableObj = pCheckInfo->pTableObj};
 
   info.tableId = pCheckInfo->tableId;
+  if (pCheckInfo->aTomb != NULL && (info.aTomb = taosArrayDup(pCheckInfo->aTomb)) == NULL) {
+    taosArrayDestroy(&pNew);
+    taosArrayDestroy(&pTable);
+    return NULL;
+  }
+
   taosArrayPush(pNew, &info);
   taosArrayPush(pTable, &pCheckInfo->pTableObj);
 
@@ -453,6 +477,7 @@ static STsdbQueryHandle* tsdbQueryTablesImpl(STsdbRepo* tsdb, STsdbQueryCond* pC
   if (tsdbInitReadH(&pQueryHandle->rhelper, (STsdbRepo*)tsdb) != 0) {
     goto _end;
   }
+  pQueryHandle->rhelper.useBlkCache = true;
 
   assert(pCond != NULL && pMemRef != NULL);
   setQueryTimewindow(pQueryHandle, pCond);
@@ -792,18 +817,14 @@ static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCh
   if (pMemT && pCheckInfo->tableId.tid < pMemT->maxTables) {
     pMem = pMemT->tData[pCheckInfo->tableId.tid];
     if (pMem != NULL && pMem->uid == pCheckInfo->tableId.uid) { // check uid
-      TKEY tLastKey = keyToTkey(pCheckInfo->lastKey);
-      pCheckInfo->iter =
-          tSkipListCreateIterFromVal(pMem->pData, (const char*)&tLastKey, TSDB_DATA_TYPE_TIMESTAMP, order);
+      pCheckInfo->iter = tsdbCreateTableDataIterFromKey(pMem, pCheckInfo->lastKey, order);
     }
   }
 
   if (pIMemT && pCheckInfo->tableId.tid < pIMemT->maxTables) {
     pIMem = pIMemT->tData[pCheckInfo->tableId.tid];
     if (pIMem != NULL && pIMem->uid == pCheckInfo->tableId.uid) { // check uid
-      TKEY tLastKey = keyToTkey(pCheckInfo->lastKey);
-      pCheckInfo->iiter =
-          tSkipListCreateIterFromVal(pIMem->pData, (const char*)&tLastKey, TSDB_DATA_TYPE_TIMESTAMP, order);
+      pCheckInfo->iiter = tsdbCreateTableDataIterFromKey(pIMem, pCheckInfo->lastKey, order);
     }
   }
 
@@ -812,17 +833,16 @@ static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCh
     return false;
   }
 
-  bool memEmpty  = (pCheckInfo->iter == NULL) || (pCheckInfo->iter != NULL && !tSkipListIterNext(pCheckInfo->iter));
-  bool imemEmpty = (pCheckInfo->iiter == NULL) || (pCheckInfo->iiter != NULL && !tSkipListIterNext(pCheckInfo->iiter));
+  bool memEmpty  = (pCheckInfo->iter == NULL) || !tsdbTableDataIterNext(pCheckInfo->iter);
+  bool imemEmpty = (pCheckInfo->iiter == NULL) || !tsdbTableDataIterNext(pCheckInfo->iiter);
   if (memEmpty && imemEmpty) { // buffer is empty
     return false;
   }
 
   if (!memEmpty) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iter);
-    assert(node != NULL);
+    SMemRow row = tsdbTableDataIterGet(pCheckInfo->iter);
+    assert(row != NULL);
 
-    SMemRow row = (SMemRow)SL_GET_NODE_DATA(node);
     TSKEY   key = memRowKey(row);  // first timestamp in buffer
     tsdbDebug("%p uid:%" PRId64 ", tid:%d check data in mem from skey:%" PRId64 ", order:%d, ts range in buf:%" PRId64
               "-%" PRId64 ", lastKey:%" PRId64 ", numOfRows:%"PRId64", 0x%"PRIx64,
@@ -841,10 +861,9 @@ static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCh
   }
 
   if (!imemEmpty) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iiter);
-    assert(node != NULL);
+    SMemRow row = tsdbTableDataIterGet(pCheckInfo->iiter);
+    assert(row != NULL);
 
-    SMemRow row = (SMemRow)SL_GET_NODE_DATA(node);
     TSKEY   key = memRowKey(row);  // first timestamp in buffer
     tsdbDebug("%p uid:%" PRId64 ", tid:%d check data in imem from skey:%" PRId64 ", order:%d, ts range in buf:%" PRId64
               "-%" PRId64 ", lastKey:%" PRId64 ", numOfRows:%"PRId64", 0x%"PRIx64,
@@ -865,24 +884,18 @@ static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCh
 }
 
 static void destroyTableMemIterator(STableCheckInfo* pCheckInfo) {
-  tSkipListDestroyIter(pCheckInfo->iter);
-  tSkipListDestroyIter(pCheckInfo->iiter);
+  tsdbDestroyTableDataIter(pCheckInfo->iter);
+  tsdbDestroyTableDataIter(pCheckInfo->iiter);
 }
 
 static TSKEY extractFirstTraverseKey(STableCheckInfo* pCheckInfo, int32_t order, int32_t update) {
   SMemRow rmem = NULL, rimem = NULL;
   if (pCheckInfo->iter) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iter);
-    if (node != NULL) {
-      rmem = (SMemRow)SL_GET_NODE_DATA(node);
-    }
+    rmem = tsdbTableDataIterGet(pCheckInfo->iter);
   }
 
   if (pCheckInfo->iiter) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iiter);
-    if (node != NULL) {
-      rimem = (SMemRow)SL_GET_NODE_DATA(node);
-    }
+    rimem = tsdbTableDataIterGet(pCheckInfo->iiter);
   }
 
   if (rmem == NULL && rimem == NULL) {
@@ -905,12 +918,12 @@ static TSKEY extractFirstTraverseKey(STableCheckInfo* pCheckInfo, int32_t order,
   if (r1 == r2) {
     if(update == TD_ROW_DISCARD_UPDATE){
       pCheckInfo->chosen = CHECKINFO_CHOSEN_IMEM;
-      tSkipListIterNext(pCheckInfo->iter);
+      tsdbTableDataIterNext(pCheckInfo->iter);
       return r2;
     }
     else if(update == TD_ROW_OVERWRITE_UPDATE) {
       pCheckInfo->chosen = CHECKINFO_CHOSEN_MEM;
-      tSkipListIterNext(pCheckInfo->iiter);
+      tsdbTableDataIterNext(pCheckInfo->iiter);
       return r1;
     } else {
       pCheckInfo->chosen = CHECKINFO_CHOSEN_BOTH;
@@ -940,17 +953,11 @@ static TSKEY extractFirstTraverseKey(STableCheckInfo* pCheckInfo, int32_t order,
 static SMemRow getSMemRowInTableMem(STableCheckInfo* pCheckInfo, int32_t order, int32_t update, SMemRow* extraRow) {
   SMemRow rmem = NULL, rimem = NULL;
   if (pCheckInfo->iter) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iter);
-    if (node != NULL) {
-      rmem = (SMemRow)SL_GET_NODE_DATA(node);
-    }
+    rmem = tsdbTableDataIterGet(pCheckInfo->iter);
   }
 
   if (pCheckInfo->iiter) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iiter);
-    if (node != NULL) {
-      rimem = (SMemRow)SL_GET_NODE_DATA(node);
-    }
+    rimem = tsdbTableDataIterGet(pCheckInfo->iiter);
   }
 
   if (rmem == NULL && rimem == NULL) {
@@ -972,11 +979,11 @@ static SMemRow getSMemRowInTableMem(STableCheckInfo* pCheckInfo, int32_t order,
 
   if (r1 == r2) {
     if (update == TD_ROW_DISCARD_UPDATE) {
-      tSkipListIterNext(pCheckInfo->iter);
+      tsdbTableDataIterNext(pCheckInfo->iter);
       pCheckInfo->chosen = CHECKINFO_CHOSEN_IMEM;
       return rimem;
     } else if(update == TD_ROW_OVERWRITE_UPDATE){
-      tSkipListIterNext(pCheckInfo->iiter);
+      tsdbTableDataIterNext(pCheckInfo->iiter);
       pCheckInfo->chosen = CHECKINFO_CHOSEN_MEM;
       return rmem;
     } else {
@@ -1009,7 +1016,7 @@ static bool moveToNextRowInMem(STableCheckInfo* pCheckInfo) {
   bool hasNext = false;
   if (pCheckInfo->chosen == CHECKINFO_CHOSEN_MEM) {
     if (pCheckInfo->iter != NULL) {
-      hasNext = tSkipListIterNext(pCheckInfo->iter);
+      hasNext = tsdbTableDataIterNext(pCheckInfo->iter);
     }
 
     if (hasNext) {
@@ -1017,11 +1024,11 @@ static bool moveToNextRowInMem(STableCheckInfo* pCheckInfo) {
     }
 
     if (pCheckInfo->iiter != NULL) {
-      return tSkipListIterGet(pCheckInfo->iiter) != NULL;
+      return tsdbTableDataIterGet(pCheckInfo->iiter) != NULL;
     }
   } else if (pCheckInfo->chosen == CHECKINFO_CHOSEN_IMEM){
     if (pCheckInfo->iiter != NULL) {
-      hasNext = tSkipListIterNext(pCheckInfo->iiter);
+      hasNext = tsdbTableDataIterNext(pCheckInfo->iiter);
     }
 
     if (hasNext) {
@@ -1029,14 +1036,14 @@ static bool moveToNextRowInMem(STableCheckInfo* pCheckInfo) {
     }
 
     if (pCheckInfo->iter != NULL) {
-      return tSkipListIterGet(pCheckInfo->iter) != NULL;
+      return tsdbTableDataIterGet(pCheckInfo->iter) != NULL;
     }
   } else {
     if (pCheckInfo->iter != NULL) {
-      hasNext = tSkipListIterNext(pCheckInfo->iter);
+      hasNext = tsdbTableDataIterNext(pCheckInfo->iter);
     }
     if (pCheckInfo->iiter != NULL) {
-      hasNext = tSkipListIterNext(pCheckInfo->iiter) || hasNext;
+      hasNext = tsdbTableDataIterNext(pCheckInfo->iiter) || hasNext;
     }
   }
 
@@ -1376,10 +1383,10 @@ static void shrinkBlocksByQuery(STsdbQueryHandle *pQueryHandle, STableCheckInfo
     end += 1;
   }
 
-  // calc offset can skip blocks number
+  // calc offset can skip blocks number, not for the tables with deleted rows counted in the blocks
   int32_t nSkip = 0;
   SArray *pArray = NULL;
-  if(pQueryHandle->offset > 0) {
+  if(pQueryHandle->offset > 0 && pCheckInfo->aTomb == NULL) {
      nSkip = offsetSkipBlock(pQueryHandle, pCompInfo, s, e, start, end, &pArray, order);
   }
 
@@ -1393,6 +1400,24 @@ static void shrinkBlocksByQuery(STsdbQueryHandle *pQueryHandle, STableCheckInfo
 
   if(pArray)
     taosArrayDestroy(&pArray);
+
+  // discard the blocks deleted as a whole
+  if (pCheckInfo->aTomb != NULL) {
+    int32_t numOfBlocks = 0;
+    for (int32_t i = 0; i < pCheckInfo->numOfBlocks; ++i) {
+      SBlock* pBlock = &pCompInfo->blocks[i];
+      if (tsdbTombsCover(pCheckInfo->aTomb, pBlock->keyFirst, pBlock->keyLast)) {
+        continue;
+      }
+
+      if (numOfBlocks != i) {
+        pCompInfo->blocks[numOfBlocks] = *pBlock;
+      }
+      numOfBlocks++;
+    }
+
+    pCheckInfo->numOfBlocks = numOfBlocks;
+  }
 }
 
 // load one table (tsd_index point to) need load blocks info and put into pCheckInfo->pCompInfo->blocks
@@ -1446,6 +1471,9 @@ static int32_t getFileCompInfo(STsdbQueryHandle* pQueryHandle, int32_t* numOfBlo
   int32_t code = TSDB_CODE_SUCCESS;
   *numOfBlocks = 0;
 
+  // the SBlocks of the loaded data block are overwritten
+  tsdbInitDataBlockLoadInfo(&pQueryHandle->dataBlockLoadInfo);
+
   pQueryHandle->cost.headFileLoad += 1;
   int64_t s = taosGetTimestampUs();
 
@@ -1473,7 +1501,65 @@ static int32_t getFileCompInfo(STsdbQueryHandle* pQueryHandle, int32_t* numOfBlo
   return code;
 }
 
+// issue read ahead of the following blocks in current file, so the I/O overlaps with processing of current block
+static void readAheadFileDataBlocks(STsdbQueryHandle* pQueryHandle) {
+  if (tsTsdbReadAheadBlocks <= 0 || pQueryHandle->pDataBlockInfo == NULL) {
+    return;
+  }
+
+  SQueryFilePos* cur = &pQueryHandle->cur;
+  int32_t step = ASCENDING_TRAVERSE(pQueryHandle->order)? 1 : -1;
+  int32_t end  = cur->slot + step * tsTsdbReadAheadBlocks;
+  int32_t numOfCols = (int32_t)QH_GET_NUM_OF_COLS(pQueryHandle);
+
+  int32_t slot = cur->slot + step;
+  if ((pQueryHandle->readAheadSlot - cur->slot) * step > 0) {
+    slot = pQueryHandle->readAheadSlot + step;
+  }
+
+  for (; (end - slot) * step >= 0 && slot >= 0 && slot < pQueryHandle->numOfBlocks; slot += step) {
+    STableBlockInfo* pBlockInfo = &pQueryHandle->pDataBlockInfo[slot];
+
+    pQueryHandle->cost.readAheadBytes += tsdbReadAheadBlock(&pQueryHandle->rhelper, pBlockInfo->compBlock,
+                                                            pBlockInfo->pTableCheckInfo->pCompInfo, numOfCols);
+    pQueryHandle->cost.readAheadBlocks += 1;
+    pQueryHandle->readAheadSlot = slot;
+  }
+}
+
+static bool isDataBlockLoaded(STsdbQueryHandle* pQueryHandle, STableCheckInfo* pCheckInfo, int32_t slotIndex) {
+  SDataBlockLoadInfo* pBlockLoadInfo = &pQueryHandle->dataBlockLoadInfo;
+
+  return pBlockLoadInfo->fileGroup != NULL && pBlockLoadInfo->slot == slotIndex &&
+         pBlockLoadInfo->fileGroup->fid == pQueryHandle->cur.fid &&
+         pBlockLoadInfo->tid == pCheckInfo->pTableObj->tableId.tid;
+}
+
+// rows of the current block masked by the tombstones are only dropped when it is loaded, the whole block can not be
+// returned without being copied, nor described by its statistics
+static bool isMaskedDataBlock(STsdbQueryHandle* pQueryHandle, STableCheckInfo* pCheckInfo, SBlock* pBlock) {
+  if (isDataBlockLoaded(pQueryHandle, pCheckInfo, pQueryHandle->cur.slot)) {
+    return pQueryHandle->dataBlockLoadInfo.masked;
+  }
+
+  return tsdbTombsOverlap(pCheckInfo->aTomb, pBlock->keyFirst, pBlock->keyLast);
+}
+
+static void flushFSetReadStat(STsdbQueryHandle* pQueryHandle) {
+  tsdbAddFSetReadStat(pQueryHandle->pTsdb, pQueryHandle->statFid, pQueryHandle->statLoads, pQueryHandle->statExtraLoads);
+  pQueryHandle->statLoads = 0;
+  pQueryHandle->statExtraLoads = 0;
+}
+
 static int32_t doLoadFileDataBlock(STsdbQueryHandle* pQueryHandle, SBlock* pBlock, STableCheckInfo* pCheckInfo, int32_t slotIndex) {
+  // the block stays in the buffer until another one is loaded, and a masked block can not be loaded again since its
+  // SBlock has been updated to the kept rows
+  if (isDataBlockLoaded(pQueryHandle, pCheckInfo, slotIndex)) {
+    return TSDB_CODE_SUCCESS;
+  }
+
+  readAheadFileDataBlocks(pQueryHandle);
+
   int64_t st = taosGetTimestampUs();
 
   STSchema *pSchema = tsdbGetTableSchema(pCheckInfo->pTableObj);
@@ -1500,6 +1586,7 @@ static int32_t doLoadFileDataBlock(STsdbQueryHandle* pQueryHandle, SBlock* pBloc
 
   int16_t* colIds = pQueryHandle->defaultLoadColumn->pData;
 
+  pQueryHandle->rhelper.aTomb = pCheckInfo->aTomb;
   int32_t ret = tsdbLoadBlockDataCols(&(pQueryHandle->rhelper), pBlock, pCheckInfo->pCompInfo, colIds, (int)(QH_GET_NUM_OF_COLS(pQueryHandle)));
   if (ret != TSDB_CODE_SUCCESS) {
     int32_t c = terrno;
@@ -1514,8 +1601,9 @@ static int32_t doLoadFileDataBlock(STsdbQueryHandle* pQueryHandle, SBlock* pBloc
   pBlockLoadInfo->tid = pCheckInfo->pTableObj->tableId.tid;
 
   SDataCols* pCols = pQueryHandle->rhelper.pDCols[0];
-  assert(pCols->numOfRows != 0 && pCols->numOfRows <= pBlock->numOfRows);
+  assert((pCols->numOfRows != 0 || pCheckInfo->aTomb != NULL) && pCols->numOfRows <= pBlock->numOfRows);
 
+  pBlockLoadInfo->masked = (pCols->numOfRows < pBlock->numOfRows);
   pBlock->numOfRows = pCols->numOfRows;
 
   // Convert from TKEY to TSKEY for primary timestamp column if current block has timestamp before 1970-01-01T00:00:00Z
@@ -1526,15 +1614,29 @@ static int32_t doLoadFileDataBlock(STsdbQueryHandle* pQueryHandle, SBlock* pBloc
     }
   }
 
+  if (pBlockLoadInfo->masked && pBlock->numOfRows > 0) {
+    TSKEY* keys = pCols->cols[0].pData;
+    pBlock->keyFirst = keys[0];
+    pBlock->keyLast = keys[pBlock->numOfRows - 1];
+  }
+
   int64_t elapsedTime = (taosGetTimestampUs() - st);
   pQueryHandle->cost.blockLoadTime += elapsedTime;
 
+  if (pQueryHandle->pFileGroup->fid != pQueryHandle->statFid) {
+    flushFSetReadStat(pQueryHandle);
+    pQueryHandle->statFid = pQueryHandle->pFileGroup->fid;
+  }
+  pQueryHandle->statLoads += 1;
+  pQueryHandle->statExtraLoads += pBlock->numOfSubBlocks - 1;
+
   tsdbDebug("%p load file block into buffer, index:%d, brange:%"PRId64"-%"PRId64", rows:%d, elapsed time:%"PRId64 " us, 0x%"PRIx64,
       pQueryHandle, slotIndex, pBlock->keyFirst, pBlock->keyLast, pBlock->numOfRows, elapsedTime, pQueryHandle->qId);
   return TSDB_CODE_SUCCESS;
 
 _error:
   pBlock->numOfRows = 0;
+  tsdbInitDataBlockLoadInfo(&pQueryHandle->dataBlockLoadInfo);
 
   tsdbError("%p error occurs in loading file block, index:%d, brange:%"PRId64"-%"PRId64", rows:%d, 0x%"PRIx64,
             pQueryHandle, slotIndex, pBlock->keyFirst, pBlock->keyLast, pBlock->numOfRows, pQueryHandle->qId);
@@ -1606,8 +1708,10 @@ static int32_t handleDataMergeIfNeeded(STsdbQueryHandle* pQueryHandle, SBlock* p
     assert(pQueryHandle->outputCapacity >= binfo.rows);
     int32_t endPos = getEndPosInDataBlock(pQueryHandle, &binfo);
 
-    if ((cur->pos == 0 && endPos == binfo.rows -1 && ASCENDING_TRAVERSE(pQueryHandle->order)) ||
-        (cur->pos == (binfo.rows - 1) && endPos == 0 && (!ASCENDING_TRAVERSE(pQueryHandle->order)))) {
+    bool whole = (cur->pos == 0 && endPos == binfo.rows - 1 && ASCENDING_TRAVERSE(pQueryHandle->order)) ||
+                 (cur->pos == (binfo.rows - 1) && endPos == 0 && (!ASCENDING_TRAVERSE(pQueryHandle->order)));
+
+    if (whole && !isMaskedDataBlock(pQueryHandle, pCheckInfo, pBlock)) {
       pQueryHandle->realNumOfRows = binfo.rows;
 
       cur->rows = binfo.rows;
@@ -1641,14 +1745,45 @@ static int32_t handleDataMergeIfNeeded(STsdbQueryHandle* pQueryHandle, SBlock* p
   return code;
 }
 
+// no row of a masked block is left in the query range
+static bool isMaskedDataBlockExhausted(STsdbQueryHandle* pQueryHandle, STableCheckInfo* pCheckInfo, SBlock* pBlock) {
+  if (pBlock->numOfRows == 0) {
+    return true;
+  }
+
+  if (ASCENDING_TRAVERSE(pQueryHandle->order)) {
+    return pCheckInfo->lastKey > pBlock->keyLast || pQueryHandle->window.ekey < pBlock->keyFirst;
+  } else {
+    return pCheckInfo->lastKey < pBlock->keyFirst || pQueryHandle->window.ekey > pBlock->keyLast;
+  }
+}
+
 static int32_t loadFileDataBlock(STsdbQueryHandle* pQueryHandle, SBlock* pBlock, STableCheckInfo* pCheckInfo, bool* exists) {
   SQueryFilePos* cur = &pQueryHandle->cur;
   int32_t code = TSDB_CODE_SUCCESS;
   bool asc = ASCENDING_TRAVERSE(pQueryHandle->order);
 
+  // a block overlapping the tombstones is loaded to drop the deleted rows before anything else
+  if (tsdbTombsOverlap(pCheckInfo->aTomb, pBlock->keyFirst, pBlock->keyLast)) {
+    if ((code = doLoadFileDataBlock(pQueryHandle, pBlock, pCheckInfo, cur->slot)) != TSDB_CODE_SUCCESS) {
+      *exists = false;
+      return code;
+    }
+
+    if (isMaskedDataBlockExhausted(pQueryHandle, pCheckInfo, pBlock)) {
+      pQueryHandle->realNumOfRows = 0;
+      cur->rows = 0;
+      cur->mixBlock = true;
+      cur->blockCompleted = true;
+      *exists = false;
+      return code;
+    }
+  }
+
   if (asc) {
     // query ended in/started from current block
-    if (pQueryHandle->window.ekey < pBlock->keyLast || pCheckInfo->lastKey > pBlock->keyFirst) {
+    if (pQueryHandle->window.ekey < pBlock->keyLast || pCheckInfo->lastKey > pBlock->keyFirst ||
+        isMaskedDataBlock(pQueryHandle, pCheckInfo, pBlock)) {
       if ((code = doLoadFileDataBlock(pQueryHandle, pBlock, pCheckInfo, cur->slot)) != TSDB_CODE_SUCCESS) {
         *exists = false;
         return code;
@@ -1671,7 +1806,8 @@ static int32_t loadFileDataBlock(STsdbQueryHandle* pQueryHandle, SBlock* pBlock,
       code = handleDataMergeIfNeeded(pQueryHandle, pBlock, pCheckInfo);
     }
   } else {  //desc order, query ended in current block
-    if (pQueryHandle->window.ekey > pBlock->keyFirst || pCheckInfo->lastKey < pBlock->keyLast) {
+    if (pQueryHandle->window.ekey > pBlock->keyFirst || pCheckInfo->lastKey < pBlock->keyLast ||
+        isMaskedDataBlock(pQueryHandle, pCheckInfo, pBlock)) {
       if ((code = doLoadFileDataBlock(pQueryHandle, pBlock, pCheckInfo, cur->slot)) != TSDB_CODE_SUCCESS) {
         *exists = false;
         return code;
@@ -2725,6 +2861,7 @@ static int32_t getFirstFileDataBlock(STsdbQueryHandle* pQueryHandle, bool* exist
   assert(pQueryHandle->pFileGroup != NULL && pQueryHandle->numOfBlocks > 0);
   cur->slot = ASCENDING_TRAVERSE(pQueryHandle->order)? 0:pQueryHandle->numOfBlocks-1;
   cur->fid = pQueryHandle->pFileGroup->fid;
+  pQueryHandle->readAheadSlot = cur->slot;
 
   STableBlockInfo* pBlockInfo = &pQueryHandle->pDataBlockInfo[cur->slot];
   return getDataBlockRv(pQueryHandle, pBlockInfo, exists);
@@ -3744,8 +3881,9 @@ int32_t tsdbRetrieveDataBlockStatisInfo(TsdbQueryHandleT* pQueryHandle, SDataSta
   STableBlockInfo* pBlockInfo = &pHandle->pDataBlockInfo[c->slot];
   assert((c->slot >= 0 && c->slot < pHandle->numOfBlocks) || ((c->slot == pHandle->numOfBlocks) && (c->slot == 0)));
 
-  // file block with sub-blocks has no statistics data
-  if (pBlockInfo->compBlock->numOfSubBlocks > 1) {
+  // file block with sub-blocks has no statistics data, nor does a block with deleted rows
+  if (pBlockInfo->compBlock->numOfSubBlocks > 1 ||
+      isMaskedDataBlock(pHandle, pBlockInfo->pTableCheckInfo, pBlockInfo->compBlock)) {
     *pBlockStatis = NULL;
     return TSDB_CODE_SUCCESS;
   }
@@ -3791,6 +3929,44 @@ int32_t tsdbRetrieveDataBlockStatisInfo(TsdbQueryHandleT* pQueryHandle, SDataSta
   return TSDB_CODE_SUCCESS;
 }
 
+bool tsdbBlockMayContain(TsdbQueryHandleT pQueryHandle, int16_t colId, const void* pVal, int32_t len) {
+  STsdbQueryHandle* pHandle = (STsdbQueryHandle*) pQueryHandle;
+
+  SQueryFilePos* c = &pHandle->cur;
+  if (c->mixBlock || c->slot < 0 || c->slot >= pHandle->numOfBlocks) {
+    return true;
+  }
+
+  SBlock* pBlock = pHandle->pDataBlockInfo[c->slot].compBlock;
+  if (pBlock->numOfSubBlocks > 1) {
+    return true;
+  }
+
+  // a failure to load the bloom part only costs the chance to skip the block
+  if (tsdbLoadBlockBloom(&pHandle->rhelper, pBlock) != TSDB_STATIS_OK) {
+    return true;
+  }
+
+  return tsdbBlockBloomMayContain(pHandle->rhelper.pBloom, colId, pVal, len);
+}
+
+const uint8_t* tsdbGetColDictCodes(TsdbQueryHandleT* pQueryHandle, int16_t colId) {
+  STsdbQueryHandle* pHandle = (STsdbQueryHandle*) pQueryHandle;
+  SDataCols*        pCols = pHandle->pCodeCols;
+
+  if (pCols == NULL) {
+    return NULL;
+  }
+
+  for (int32_t i = 0; i < pCols->numOfCols; ++i) {
+    if (pCols->cols[i].colId == colId) {
+      return pCols->cols[i].codes;
+    }
+  }
+
+  return NULL;
+}
+
 SArray* tsdbRetrieveDataBlock(TsdbQueryHandleT* pQueryHandle, SArray* pIdList) {
   /**
    * In the following two cases, the data has been loaded to SColumnInfoData.
@@ -3798,6 +3974,8 @@ SArray* tsdbRetrieveDataBlock(TsdbQueryHandleT* pQueryHandle, SArray* pIdList) {
    */
   STsdbQueryHandle* pHandle = (STsdbQueryHandle*)pQueryHandle;
 
+  pHandle->pCodeCols = NULL;
+
   if (pHandle->cur.fid == INT32_MIN) {
     return pHandle->pColumns;
   } else {
@@ -3824,6 +4002,9 @@ SArray* tsdbRetrieveDataBlock(TsdbQueryHandleT* pQueryHandle, SArray* pIdList) {
 
         // todo refactor
         int32_t numOfRows = doCopyRowsFromFileBlock(pHandle, pHandle->outputCapacity, 0, 0, pBlock->numOfRows - 1);
+        if (numOfRows == pHandle->rhelper.pDCols[0]->numOfRows) {
+          pHandle->pCodeCols = pHandle->rhelper.pDCols[0];
+        }
 
         // if the buffer is not full in case of descending order query, move the data in the front of the buffer
         if (!ASCENDING_TRAVERSE(pHandle->order) && numOfRows < pHandle->outputCapacity) {
@@ -4250,6 +4431,7 @@ static void* destroyTableCheckInfo(SArray* pTableCheckInfo) {
     destroyTableMemIterator(p);
 
     tfree(p->pCompInfo);
+    taosArrayDestroy(&p->aTomb);
   }
 
   taosArrayDestroy(&pTableCheckInfo);
@@ -4282,14 +4464,16 @@ void tsdbCleanupQueryHandle(TsdbQueryHandleT queryHandle) {
 
   tdFreeDataCols(pQueryHandle->pDataCols);
   pQueryHandle->pDataCols = NULL;
+  flushFSetReadStat(pQueryHandle);
 
   pQueryHandle->prev = doFreeColumnInfoData(pQueryHandle->prev);
   pQueryHandle->next = doFreeColumnInfoData(pQueryHandle->next);
 
   SIOCostSummary* pCost = &pQueryHandle->cost;
 
-  tsdbDebug("%p :io-cost summary: head-file read cnt:%"PRIu64", head-file time:%"PRIu64" us, statis-info:%"PRId64" us, datablock:%" PRId64" us, check data:%"PRId64" us, 0x%"PRIx64,
-      pQueryHandle, pCost->headFileLoad, pCost->headFileLoadTime, pCost->statisInfoLoadTime, pCost->blockLoadTime, pCost->checkForNextTime, pQueryHandle->qId);
+  tsdbDebug("%p :io-cost summary: head-file read cnt:%"PRIu64", head-file time:%"PRIu64" us, statis-info:%"PRId64" us, datablock:%" PRId64" us, check data:%"PRId64" us, read-ahead blocks:%"PRId64" bytes:%"PRId64", 0x%"PRIx64,
+      pQueryHandle, pCost->headFileLoad, pCost->headFileLoadTime, pCost->statisInfoLoadTime, pCost->blockLoadTime, pCost->checkForNextTime,
+      pCost->readAheadBlocks, pCost->readAheadBytes, pQueryHandle->qId);
 
   tfree(pQueryHandle);
 }
@@ -4388,7 +4572,14 @@ static void queryIndexedColumn(SSkipList* pSkipList, void* filterInfo, SArray* r
   tsdbDebug("filter index column end");
 }
 
-static void queryIndexlessColumn(SSkipList* pSkipList, void* filterInfo, SArray* res) {
+static void queryIndexlessColumn(STable* pTable, void* filterInfo, SArray* res) {
+  SSkipList* pSkipList = pTable->pIndex;
+
+  // all the tables in one filter pass on the columnar tags
+  if (tsdbQueryTagStore(pTable, filterInfo, res) == 0) {
+    return;
+  }
+
   SSkipListIterator* iter = tSkipListCreateIter(pSkipList);
   int8_t *addToResult = NULL;
 
@@ -4514,7 +4705,7 @@ static int32_t tsdbQueryTableList(STable* pTable, SArray* pRes, void* filterInfo
     if (indexQuery) {
       queryIndexedColumn(pSkipList, filterInfo, pRes);
     } else {
-      queryIndexlessColumn(pSkipList, filterInfo, pRes);
+      queryIndexlessColumn(pTable, filterInfo, pRes);
     }
   }
 
@@ -17,6 +17,8 @@
 
 #define TSDB_KEY_COL_OFFSET 0
 
+extern int32_t tsTsdbReadCoalesceGap;
+
 static void tsdbResetReadTable(SReadH *pReadh);
 static void tsdbResetReadFile(SReadH *pReadh);
 static int  tsdbLoadBlockDataImpl(SReadH *pReadh, SBlock *pBlock, SDataCols *pDataCols);
@@ -24,9 +26,10 @@ static int  tsdbCheckAndDecodeColumnData(SDataCol *pDataCol, void *content, int3
                                          int maxPoints, char *buffer, int bufferSize);
 static int  tsdbLoadBlockDataColsImpl(SReadH *pReadh, SBlock *pBlock, SDataCols *pDataCols, int16_t *colIds,
                                       int numOfColIds);
-static int  tsdbLoadColData(SReadH *pReadh, SDFile *pDFile, SBlock *pBlock, SBlockCol *pBlockCol, SDataCol *pDataCol);
+static int  tsdbLoadColsData(SReadH *pReadh, SDFile *pDFile, SBlock *pBlock, SReadColInfo *pCols, int nCols);
 static int  tsdbLoadBlockStatisFromDFile(SReadH *pReadh, SBlock *pBlock);
 static int  tsdbLoadBlockStatisFromAggr(SReadH *pReadh, SBlock *pBlock);
+static int  tsdbMaskBlockData(SReadH *pReadh);
 
 int tsdbInitReadH(SReadH *pReadh, STsdbRepo *pRepo) {
   ASSERT(pReadh != NULL && pRepo != NULL);
@@ -64,6 +67,8 @@ int tsdbInitReadH(SReadH *pReadh, STsdbRepo *pRepo) {
 void tsdbDestroyReadH(SReadH *pReadh) {
   if (pReadh == NULL) return;
   pReadh->pExBuf = taosTZfree(pReadh->pExBuf);
+  pReadh->pBloom = taosTZfree(pReadh->pBloom);
+  pReadh->pColInfo = taosTZfree(pReadh->pColInfo);
   pReadh->pCBuf = taosTZfree(pReadh->pCBuf);
   pReadh->pBuf = taosTZfree(pReadh->pBuf);
   pReadh->pDCols[0] = tdFreeDataCols(pReadh->pDCols[0]);
@@ -91,6 +96,11 @@ int tsdbSetAndOpenReadFSet(SReadH *pReadh, SDFileSet *pSet) {
     return -1;
   }
 
+  if (pReadh->useBlkCache && tsdbBlkCacheEnabled()) {
+    pReadh->dataVer = tsdbGetDFileNameVer(TSDB_READ_DATA_FILE(pReadh));
+    pReadh->lastVer = tsdbGetDFileNameVer(TSDB_READ_LAST_FILE(pReadh));
+  }
+
   return 0;
 }
 
@@ -393,6 +403,10 @@ int tsdbLoadBlockData(SReadH *pReadh, SBlock *pBlock, SBlockInfo *pBlkInfo) {
   ASSERT(dataColsKeyFirst(pReadh->pDCols[0]) == pBlock->keyFirst);
   ASSERT(dataColsKeyLast(pReadh->pDCols[0]) == pBlock->keyLast);
 
+  if (pReadh->aTomb != NULL && tsdbTombsOverlap(pReadh->aTomb, pBlock->keyFirst, pBlock->keyLast)) {
+    return tsdbMaskBlockData(pReadh);
+  }
+
   return 0;
 }
 
@@ -420,6 +434,10 @@ int tsdbLoadBlockDataCols(SReadH *pReadh, SBlock *pBlock, SBlockInfo *pBlkInfo,
   ASSERT(dataColsKeyFirst(pReadh->pDCols[0]) == pBlock->keyFirst);
   ASSERT(dataColsKeyLast(pReadh->pDCols[0]) == pBlock->keyLast);
 
+  if (pReadh->aTomb != NULL && tsdbTombsOverlap(pReadh->aTomb, pBlock->keyFirst, pBlock->keyLast)) {
+    return tsdbMaskBlockData(pReadh);
+  }
+
   return 0;
 }
 
@@ -515,6 +533,99 @@ int tsdbLoadBlockOffset(SReadH *pReadh, SBlock *pBlock) {
   return tsdbLoadBlockStatisFromDFile(pReadh, pBlock);
 }
 
+/**
+ * Load the bloom part of the block to pReadh->pBloom. Return TSDB_STATIS_NONE if the block has no bloom part.
+ */
+int tsdbLoadBlockBloom(SReadH *pReadh, SBlock *pBlock) {
+  ASSERT(pBlock->numOfSubBlocks <= 1);
+
+  if (pBlock->blkVer < TSDB_SBLK_VER_2 || !pBlock->aggrStat) return TSDB_STATIS_NONE;
+
+  SDFile *pDFileAggr = pBlock->last ? TSDB_READ_SMAL_FILE(pReadh) : TSDB_READ_SMAD_FILE(pReadh);
+  int64_t offset = pBlock->aggrOffset + tsdbBlockAggrSize(pBlock->numOfCols, (uint32_t)pBlock->blkVer);
+  int64_t key = pBlock->last ? -offset : offset;
+
+  if (pReadh->bloomOffset == key) return TSDB_STATIS_OK;
+  pReadh->bloomOffset = 0;
+
+  if (tsdbSeekDFile(pDFileAggr, offset, SEEK_SET) < 0) {
+    tsdbError("vgId:%d failed to load block bloom part while seek file %s to offset %" PRId64 " since %s",
+              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFileAggr), offset, tstrerror(terrno));
+    return -1;
+  }
+
+  if (tsdbMakeRoom(&(pReadh->pBloom), sizeof(SBlockBloom)) < 0) return -1;
+
+  int64_t nread = tsdbReadDFile(pDFileAggr, pReadh->pBloom, sizeof(SBlockBloom));
+  if (nread < 0) {
+    tsdbError("vgId:%d failed to load block bloom part while read file %s since %s, offset:%" PRId64,
+              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFileAggr), tstrerror(terrno), offset);
+    return -1;
+  }
+
+  int32_t len = ((SBlockBloom *)pReadh->pBloom)->len;
+  if (nread < sizeof(SBlockBloom) || len < sizeof(SBlockBloom) + sizeof(TSCKSUM)) {
+    terrno = TSDB_CODE_TDB_FILE_CORRUPTED;
+    tsdbError("vgId:%d block bloom part in file %s is corrupted, offset:%" PRId64 " read bytes: %" PRId64
+              " len: %d",
+              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFileAggr), offset, nread, len);
+    return -1;
+  }
+
+  if (tsdbMakeRoom(&(pReadh->pBloom), len) < 0) return -1;
+
+  nread = tsdbReadDFile(pDFileAggr, POINTER_SHIFT(pReadh->pBloom, sizeof(SBlockBloom)), len - sizeof(SBlockBloom));
+  if (nread < 0) {
+    tsdbError("vgId:%d failed to load block bloom part while read file %s since %s, offset:%" PRId64 " len :%d",
+              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFileAggr), tstrerror(terrno), offset, len);
+    return -1;
+  }
+
+  if (nread < len - sizeof(SBlockBloom) || !taosCheckChecksumWhole((uint8_t *)(pReadh->pBloom), (uint32_t)len)) {
+    terrno = TSDB_CODE_TDB_FILE_CORRUPTED;
+    tsdbError("vgId:%d block bloom part in file %s is corrupted, offset:%" PRId64 " len :%d",
+              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFileAggr), offset, len);
+    return -1;
+  }
+
+  pReadh->bloomOffset = key;
+  return TSDB_STATIS_OK;
+}
+
+/**
+ * Hint the kernel to read the block (and its sub-blocks) in background, so the I/O of following blocks overlaps with
+ * the decompression and computing of the current one. If only a small part of the columns is queried, only the
+ * SBlockData part and the key column are read ahead. Return the number of bytes hinted.
+ */
+int64_t tsdbReadAheadBlock(SReadH *pReadh, SBlock *pBlock, SBlockInfo *pBlkInfo, int numOfColIds) {
+  SBlock *iBlock = pBlock;
+  int64_t nbytes = 0;
+
+  if (pBlock->numOfSubBlocks > 1) {
+    iBlock = (SBlock *)POINTER_SHIFT((pBlkInfo != NULL) ? pBlkInfo : pReadh->pBlkInfo, pBlock->offset);
+  }
+
+  for (int i = 0; i < pBlock->numOfSubBlocks; i++, iBlock++) {
+    SDFile *pDFile = (iBlock->last) ? TSDB_READ_LAST_FILE(pReadh) : TSDB_READ_DATA_FILE(pReadh);
+    int64_t len = iBlock->len;
+
+    if (numOfColIds * 2 <= iBlock->numOfCols) {
+      len = tsdbBlockStatisSize(iBlock->numOfCols, (uint32_t)iBlock->blkVer) + iBlock->keyLen;
+    }
+
+    if (taosReadAhead(TSDB_FILE_FD(pDFile), iBlock->offset, len) < 0) {
+      tsdbDebug("vgId:%d failed to read ahead file %s offset %" PRId64 " len %" PRId64 " since %s",
+                TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFile), (int64_t)iBlock->offset, len,
+                strerror(errno));
+      continue;
+    }
+
+    nbytes += len;
+  }
+
+  return nbytes;
+}
+
 int tsdbEncodeSBlockIdx(void **buf, SBlockIdx *pIdx) {
   int tlen = 0;
 
@@ -617,6 +728,7 @@ static void tsdbResetReadFile(SReadH *pReadh) {
   tsdbResetReadTable(pReadh);
   taosArrayClear(pReadh->aBlkIdx);
   tsdbCloseDFileSet(TSDB_READ_FSET(pReadh));
+  pReadh->bloomOffset = 0;
 }
 
 static int tsdbLoadBlockDataImpl(SReadH *pReadh, SBlock *pBlock, SDataCols *pDataCols) {
@@ -692,7 +804,7 @@ static int tsdbLoadBlockDataImpl(SReadH *pReadh, SBlock *pBlock, SDataCols *pDat
     }
 
     if (tcolId == pDataCol->colId) {
-      if (pBlock->algorithm == TWO_STAGE_COMP) {
+      if (IS_TWO_STAGE_COMP(pBlock->algorithm)) {
         int zsize = pDataCol->bytes * pBlock->numOfRows + COMP_OVERFLOW_BYTES;
         if (tsdbMakeRoom((void **)(&TSDB_READ_COMP_BUF(pReadh)), zsize) < 0) return -1;
       }
@@ -729,6 +841,7 @@ static int tsdbCheckAndDecodeColumnData(SDataCol *pDataCol, void *content, int32
   }
 
   tdAllocMemForCol(pDataCol, maxPoints);
+  pDataCol->codes = NULL;
 
   // Decode the data
   if (comp) {
@@ -742,6 +855,14 @@ static int tsdbCheckAndDecodeColumnData(SDataCol *pDataCol, void *content, int32
       return -1;
     }
     pDataCol->len = tlen;
+
+    // Keep the dictionary codes, so that the query filters can evaluate each distinct value once
+    const uint8_t *codes = NULL;
+    if (IS_VAR_DATA_TYPE(pDataCol->type) &&
+        tsGetStringDictCodes(content, len - sizeof(TSCKSUM), &codes) == numOfRows) {
+      pDataCol->codes = POINTER_SHIFT(pDataCol->dataOff, sizeof(VarDataOffsetT) * maxPoints);
+      memcpy(pDataCol->codes, codes, numOfRows);
+    }
   } else {
     // No need to decompress, just memcpy it
     pDataCol->len = len - sizeof(TSCKSUM);
@@ -761,12 +882,17 @@ static int tsdbLoadBlockDataColsImpl(SReadH *pReadh, SBlock *pBlock, SDataCols *
 
   SDFile *  pDFile = (pBlock->last) ? TSDB_READ_LAST_FILE(pReadh) : TSDB_READ_DATA_FILE(pReadh);
   SBlockCol blockCol = {0};
+  int64_t   dataOffset = pBlock->offset + tsdbBlockStatisSize(pBlock->numOfCols, (uint32_t)pBlock->blkVer);
+  int       nCols = 0;
 
   tdResetDataCols(pDataCols);
 
   // If only load timestamp column, no need to load SBlockData part
   if (numOfColIds > 1 && tsdbLoadBlockOffset(pReadh, pBlock) < 0) return -1;
 
+  if (tsdbMakeRoom((void **)(&(pReadh->pColInfo)), sizeof(SReadColInfo) * numOfColIds) < 0) return -1;
+  SReadColInfo *pCols = (SReadColInfo *)pReadh->pColInfo;
+
   pDataCols->numOfRows = pBlock->numOfRows;
 
   int dcol = 0;
@@ -799,6 +925,7 @@ static int tsdbLoadBlockDataColsImpl(SReadH *pReadh, SBlock *pBlock, SDataCols *
       blockCol.len = pBlock->keyLen;
       blockCol.type = pDataCol->type;
       blockCol.offset = TSDB_KEY_COL_OFFSET;
+      blockCol.offsetH = 0;
       pBlockCol = &blockCol;
     } else {  // load non-key rows
       while (true) {
@@ -827,51 +954,145 @@ static int tsdbLoadBlockDataColsImpl(SReadH *pReadh, SBlock *pBlock, SDataCols *
       ASSERT(pBlockCol->colId == pDataCol->colId);
     }
 
-    if (tsdbLoadColData(pReadh, pDFile, pBlock, pBlockCol, pDataCol) < 0) return -1;
+    pCols[nCols].offset = dataOffset + tsdbGetBlockColOffset(pBlockCol);
+    pCols[nCols].len = pBlockCol->len;
+    pCols[nCols].pDataCol = pDataCol;
+    pCols[nCols].blockCol = *pBlockCol;
+    nCols++;
   }
 
-  return 0;
+  return tsdbLoadColsData(pReadh, pDFile, pBlock, pCols, nCols);
 }
 
-static int tsdbLoadColData(SReadH *pReadh, SDFile *pDFile, SBlock *pBlock, SBlockCol *pBlockCol, SDataCol *pDataCol) {
-  ASSERT(pDataCol->colId == pBlockCol->colId);
-
-  STsdbRepo *pRepo = TSDB_READ_REPO(pReadh);
-  STsdbCfg * pCfg = REPO_CFG(pRepo);
-  int        tsize = pDataCol->bytes * pBlock->numOfRows + COMP_OVERFLOW_BYTES;
+/**
+ * Columns are written in order of colId and the key column is the first one, so pCols is already sorted by offset.
+ * Return the number of columns from pCols[0] which can be fetched by one read of *pLen bytes, the gap between two
+ * adjacent columns in the same read is not larger than maxGap.
+ */
+int tsdbCoalesceColReads(SReadColInfo *pCols, int nCols, int64_t maxGap, int64_t *pLen) {
+  ASSERT(nCols > 0);
 
-  if (tsdbMakeRoom((void **)(&TSDB_READ_BUF(pReadh)), pBlockCol->len) < 0) return -1;
-  if (tsdbMakeRoom((void **)(&TSDB_READ_COMP_BUF(pReadh)), tsize) < 0) return -1;
+  int64_t end = pCols[0].offset + pCols[0].len;
+  int     n = 1;
 
-  int64_t offset = pBlock->offset + tsdbBlockStatisSize(pBlock->numOfCols, (uint32_t)pBlock->blkVer) +
-                   tsdbGetBlockColOffset(pBlockCol);
-  if (tsdbSeekDFile(pDFile, offset, SEEK_SET) < 0) {
-    tsdbError("vgId:%d failed to load block column data while seek file %s to offset %" PRId64 " since %s",
-              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFile), offset, tstrerror(terrno));
-    return -1;
+  for (; n < nCols; n++) {
+    ASSERT(pCols[n].offset >= pCols[n - 1].offset);
+    if (pCols[n].offset - end > maxGap) break;
+    end = MAX(end, pCols[n].offset + pCols[n].len);
   }
 
-  int64_t nread = tsdbReadDFile(pDFile, TSDB_READ_BUF(pReadh), pBlockCol->len);
-  if (nread < 0) {
-    tsdbError("vgId:%d failed to load block column data while read file %s since %s, offset:%" PRId64 " len :%d",
-              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFile), tstrerror(terrno), offset, pBlockCol->len);
-    return -1;
+  *pLen = end - pCols[0].offset;
+  return n;
+}
+
+static int tsdbLoadColsData(SReadH *pReadh, SDFile *pDFile, SBlock *pBlock, SReadColInfo *pCols, int nCols) {
+  STsdbRepo *  pRepo = TSDB_READ_REPO(pReadh);
+  STsdbCfg *   pCfg = REPO_CFG(pRepo);
+  bool         useCache = pReadh->useBlkCache && tsdbBlkCacheEnabled();
+  SBlkCacheKey key;
+  int          nLoad = 0;
+
+  // Serve what we can from the block cache, and only read the rest
+  for (int i = 0; i < nCols; i++) {
+    if (useCache) {
+      tsdbInitBlkCacheKey(&key, REPO_ID(pRepo), TSDB_FSET_FID(TSDB_READ_FSET(pReadh)),
+                          pBlock->last ? TSDB_FILE_LAST : TSDB_FILE_DATA,
+                          pBlock->last ? pReadh->lastVer : pReadh->dataVer, pBlock->offset, pCols[i].blockCol.colId);
+      if (tsdbBlkCacheGet(&key, pCols[i].pDataCol, pBlock->numOfRows, pCfg->maxRowsPerFileBlock) == 0) {
+        continue;
+      }
+    }
+
+    if (nLoad != i) pCols[nLoad] = pCols[i];
+    nLoad++;
   }
 
-  if (nread < pBlockCol->len) {
-    terrno = TSDB_CODE_TDB_FILE_CORRUPTED;
-    tsdbError("vgId:%d block column data in file %s is corrupted, offset:%" PRId64 " expected bytes:%d" PRIzu
-              " read bytes: %" PRId64,
-              TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFile), offset, pBlockCol->len, nread);
-    return -1;
+  for (int i = 0; i < nLoad;) {
+    int64_t tlen = 0;
+    int     n = tsdbCoalesceColReads(pCols + i, nLoad - i, tsTsdbReadCoalesceGap, &tlen);
+    int64_t offset = pCols[i].offset;
+
+    if (tsdbMakeRoom((void **)(&TSDB_READ_BUF(pReadh)), tlen) < 0) return -1;
+
+    if (tsdbSeekDFile(pDFile, offset, SEEK_SET) < 0) {
+      tsdbError("vgId:%d failed to load block column data while seek file %s to offset %" PRId64 " since %s",
+                TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFile), offset, tstrerror(terrno));
+      return -1;
+    }
+
+    int64_t nread = tsdbReadDFile(pDFile, TSDB_READ_BUF(pReadh), tlen);
+    if (nread < 0) {
+      tsdbError("vgId:%d failed to load block column data while read file %s since %s, offset:%" PRId64
+                " len :%" PRId64,
+                TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFile), tstrerror(terrno), offset, tlen);
+      return -1;
+    }
+
+    if (nread < tlen) {
+      terrno = TSDB_CODE_TDB_FILE_CORRUPTED;
+      tsdbError("vgId:%d block column data in file %s is corrupted, offset:%" PRId64 " expected bytes:%" PRId64
+                " read bytes: %" PRId64,
+                TSDB_READ_REPO_ID(pReadh), TSDB_FILE_FULL_NAME(pDFile), offset, tlen, nread);
+      return -1;
+    }
+
+    for (int j = i; j < i + n; j++) {
+      SDataCol *pDataCol = pCols[j].pDataCol;
+      int       tsize = pDataCol->bytes * pBlock->numOfRows + COMP_OVERFLOW_BYTES;
+
+      if (tsdbMakeRoom((void **)(&TSDB_READ_COMP_BUF(pReadh)), tsize) < 0) return -1;
+
+      if (tsdbCheckAndDecodeColumnData(pDataCol, POINTER_SHIFT(TSDB_READ_BUF(pReadh), pCols[j].offset - offset),
+                                       pCols[j].len, pBlock->algorithm, pBlock->numOfRows, pCfg->maxRowsPerFileBlock,
+                                       TSDB_READ_COMP_BUF(pReadh), (int32_t)taosTSizeof(TSDB_READ_COMP_BUF(pReadh))) < 0) {
+        tsdbError("vgId:%d file %s is broken at column %d offset %" PRId64, REPO_ID(pRepo), TSDB_FILE_FULL_NAME(pDFile),
+                  pCols[j].blockCol.colId, pCols[j].offset);
+        return -1;
+      }
+
+      if (useCache) {
+        tsdbInitBlkCacheKey(&key, REPO_ID(pRepo), TSDB_FSET_FID(TSDB_READ_FSET(pReadh)),
+                            pBlock->last ? TSDB_FILE_LAST : TSDB_FILE_DATA,
+                            pBlock->last ? pReadh->lastVer : pReadh->dataVer, pBlock->offset, pCols[j].blockCol.colId);
+        tsdbBlkCachePut(&key, pDataCol, pBlock->numOfRows);
+      }
+    }
+
+    i += n;
   }
 
-  if (tsdbCheckAndDecodeColumnData(pDataCol, pReadh->pBuf, pBlockCol->len, pBlock->algorithm, pBlock->numOfRows,
-                                   pCfg->maxRowsPerFileBlock, pReadh->pCBuf, (int32_t)taosTSizeof(pReadh->pCBuf)) < 0) {
-    tsdbError("vgId:%d file %s is broken at column %d offset %" PRId64, REPO_ID(pRepo), TSDB_FILE_FULL_NAME(pDFile),
-              pBlockCol->colId, offset);
-    return -1;
+  return 0;
+}
+
+// Drop the rows in the tombstones from pDCols[0], the kept rows are copied to pDCols[1] and the two are swapped
+static int tsdbMaskBlockData(SReadH *pReadh) {
+  SDataCols *pSrc = pReadh->pDCols[0];
+  SDataCols *pDst = pReadh->pDCols[1];
+  size_t     nTombs = taosArrayGetSize(pReadh->aTomb);
+  size_t     t = 0;
+
+  tdResetDataCols(pDst);
+  pDst->sversion = pSrc->sversion;
+
+  for (int i = 0; i < pSrc->numOfRows; i++) {
+    TSKEY key = dataColsKeyAt(pSrc, i);
+
+    while (t < nTombs && ((STableTomb *)taosArrayGet(pReadh->aTomb, t))->ekey < key) t++;
+    if (t < nTombs && ((STableTomb *)taosArrayGet(pReadh->aTomb, t))->skey <= key) continue;
+
+    for (int j = 0; j < pSrc->numOfCols; j++) {
+      if (pSrc->cols[j].len > 0 || pDst->cols[j].len > 0) {
+        if (dataColAppendVal(pDst->cols + j, tdGetColDataOfRow(pSrc->cols + j, i), pDst->numOfRows, pDst->maxPoints,
+                             0) < 0) {
+          terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+          return -1;
+        }
+      }
+    }
+    pDst->numOfRows++;
   }
 
+  pReadh->pDCols[0] = pDst;
+  pReadh->pDCols[1] = pSrc;
   return 0;
 }
@@ -0,0 +1,646 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tsdbint.h"
+#include "texpr.h"
+#include "qFilter.h"
+
+extern int32_t tsTsdbMaxTagIndexes;
+
+static void           tsdbClearTagStoreCols(SArray *aCol);
+static STagStoreSnap *tsdbNewTagStoreSnap(STable *pSuper);
+static void           tsdbUnrefTagStoreSnap(STagStoreSnap *pSnap);
+static STagStoreSnap *tsdbTakeTagStoreSnap(STable *pSuper, STagStore *pStore, SFilterInfo *info, SArray *aCol);
+static bool           tsdbTagStoreColsFit(SArray *aCol, SFilterInfo *info);
+static STagStoreCol * tsdbGetTagStoreCol(SArray *aCol, int16_t colId);
+static int            tsdbPrepareTagStoreCols(SArray *aCol, SFilterInfo *info, STable **tables, int32_t numOfTables);
+static int            tsdbFillTagStoreCol(STagStoreCol *pCol, STable **tables, int32_t numOfTables);
+static int32_t        tsdbGetTagStoreColData(void *param, int32_t id, void **data);
+static void           tsdbFilterTables(SFilterInfo *info, SArray *aCol, STable **tables, int32_t numOfTables, SArray *res);
+static int            tsdbQueryTagIndexes(STable *pSuper, STagStore *pStore, SFilterInfo *info, SArray **ppTables);
+static STagIndex *    tsdbGetTagIndex(STagStore *pStore, int16_t colId);
+static STagIndex *    tsdbCreateTagIndex(STable *pSuper, STagStore *pStore, int16_t colId, int8_t type);
+static void           tsdbDropTagIndexes(STable *pSuper, STagStore *pStore);
+static void *         tsdbGetTagIndexKey(STagIndex *pIdx, STable *pTable, int32_t *len);
+static int            tsdbAddToTagIndex(STagIndex *pIdx, STable *pTable, bool sorted);
+static SArray *       tsdbLookupTagIndex(STagIndex *pIdx, SFilterComUnit *cunit);
+static SArray *       tsdbMergeTableLists(SArray *aTable1, SArray *aTable2, bool intersect);
+static int            tsdbCompareTableTid(const void *a, const void *b);
+
+int tsdbInitTagStore(STable *pSuper) {
+  STagStore *pStore = (STagStore *)calloc(1, sizeof(*pStore));
+  if (pStore == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pStore->aIndex = taosArrayInit(4, sizeof(STagIndex));
+  if (pStore->aIndex == NULL) {
+    free(pStore);
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pthread_mutex_init(&(pStore->mutex), NULL);
+  pSuper->pTagStore = pStore;
+  return 0;
+}
+
+void tsdbFreeTagStore(STable *pSuper) {
+  STagStore *pStore = pSuper->pTagStore;
+
+  if (pStore == NULL) return;
+
+  tsdbUnrefTagStoreSnap(pStore->pSnap);
+  for (size_t i = 0; i < taosArrayGetSize(pStore->aIndex); i++) {
+    taosHashCleanup(((STagIndex *)taosArrayGet(pStore->aIndex, i))->map);
+  }
+  taosArrayDestroy(&pStore->aIndex);
+  pthread_mutex_destroy(&(pStore->mutex));
+  free(pStore);
+  pSuper->pTagStore = NULL;
+}
+
+void tsdbInvalidateTagStore(STable *pSuper) {
+  STagStore *pStore = pSuper->pTagStore;
+
+  if (pStore == NULL) return;
+
+  // the queries filtering on the snapshot go on with it
+  pthread_mutex_lock(&(pStore->mutex));
+  tsdbUnrefTagStoreSnap(pStore->pSnap);
+  pStore->pSnap = NULL;
+  pthread_mutex_unlock(&(pStore->mutex));
+}
+
+/**
+ * Evaluate the tag condition of filterInfo on the child tables of pSuper and append the tables qualified to res in tid
+ * order: on the tables listed by the tag indexes if they serve the condition, otherwise on all the tables in the store.
+ * Return -1 if neither can serve the condition, then the tables are filtered one by one.
+ */
+int tsdbQueryTagStore(STable *pSuper, void *filterInfo, SArray *res) {
+  STagStore *    pStore = pSuper->pTagStore;
+  SFilterInfo *  info = (SFilterInfo *)filterInfo;
+  STagStoreSnap *pSnap = NULL;
+  SArray *       aTable = NULL;
+  SArray *       aCol = NULL;
+  int            code = 0;
+
+  if (pStore == NULL) return -1;
+
+  if ((aCol = taosArrayInit(4, sizeof(STagStoreCol))) == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  pthread_mutex_lock(&(pStore->mutex));
+  code = tsdbQueryTagIndexes(pSuper, pStore, info, &aTable);
+  pthread_mutex_unlock(&(pStore->mutex));
+
+  if (code == 0) {
+    // the columns of the tables listed are filled for this query only
+    int32_t numOfTables = (int32_t)taosArrayGetSize(aTable);
+
+    code = tsdbPrepareTagStoreCols(aCol, info, (STable **)aTable->pData, numOfTables);
+    if (code == 0 && numOfTables > 0) tsdbFilterTables(info, aCol, (STable **)aTable->pData, numOfTables, res);
+
+    tsdbDebug("super table %s, %d tables listed by tag indexes", TABLE_CHAR_NAME(pSuper), numOfTables);
+
+    tsdbClearTagStoreCols(aCol);
+    taosArrayDestroy(&aTable);
+    if (code == 0) {
+      taosArrayDestroy(&aCol);
+      return 0;
+    }
+  }
+
+  pthread_mutex_lock(&(pStore->mutex));
+  pSnap = tsdbTakeTagStoreSnap(pSuper, pStore, info, aCol);
+  pthread_mutex_unlock(&(pStore->mutex));
+
+  if (pSnap == NULL) {
+    taosArrayDestroy(&aCol);
+    return -1;
+  }
+
+  // aCol refers to the columns of the snapshot
+  if (pSnap->numOfTables > 0) tsdbFilterTables(info, aCol, pSnap->tables, pSnap->numOfTables, res);
+  tsdbDebug("super table %s, %d tables filtered on columnar tags", TABLE_CHAR_NAME(pSuper), pSnap->numOfTables);
+
+  tsdbUnrefTagStoreSnap(pSnap);
+  taosArrayDestroy(&aCol);
+  return 0;
+}
+
+bool tsdbHasTagIndex(STable *pSuper, int16_t colId) {
+  STagStore *pStore = pSuper->pTagStore;
+  bool       has = false;
+
+  if (pStore == NULL) return false;
+
+  pthread_mutex_lock(&(pStore->mutex));
+  has = (tsdbGetTagIndex(pStore, colId) != NULL);
+  pthread_mutex_unlock(&(pStore->mutex));
+
+  return has;
+}
+
+// Called with the write lock of meta
+void tsdbAddToTagIndexes(STable *pSuper, STable *pTable) {
+  STagStore *pStore = pSuper->pTagStore;
+
+  if (pStore == NULL) return;
+
+  for (size_t i = 0; i < taosArrayGetSize(pStore->aIndex); i++) {
+    STagIndex *pIdx = (STagIndex *)taosArrayGet(pStore->aIndex, i);
+    if (tsdbAddToTagIndex(pIdx, pTable, true) < 0) {
+      // a table missing from an index would be missed by the queries, so the index goes
+      tsdbWarn("super table %s, drop the index of tag %d since %s", TABLE_CHAR_NAME(pSuper), pIdx->colId,
+               tstrerror(terrno));
+      taosHashCleanup(pIdx->map);
+      taosArrayRemove(pStore->aIndex, i--);
+    }
+  }
+}
+
+// Called with the write lock of meta, before the tags of the table change
+void tsdbRemoveFromTagIndexes(STable *pSuper, STable *pTable) {
+  STagStore *pStore = pSuper->pTagStore;
+  int32_t    len = 0;
+
+  if (pStore == NULL) return;
+
+  for (size_t i = 0; i < taosArrayGetSize(pStore->aIndex); i++) {
+    STagIndex *pIdx = (STagIndex *)taosArrayGet(pStore->aIndex, i);
+    void *     key = tsdbGetTagIndexKey(pIdx, pTable, &len);
+    if (key == NULL) continue;
+
+    SArray **paTable = (SArray **)taosHashGet(pIdx->map, key, len);
+    if (paTable == NULL) continue;
+
+    void *p = taosArraySearch(*paTable, &pTable, tsdbCompareTableTid, TD_EQ);
+    if (p != NULL) taosArrayRemove(*paTable, TARRAY_ELEM_IDX(*paTable, p));
+    if (taosArrayGetSize(*paTable) == 0) taosHashRemove(pIdx->map, key, len);
+  }
+}
+
+static void tsdbClearTagStoreCols(SArray *aCol) {
+  for (size_t i = 0; i < taosArrayGetSize(aCol); i++) {
+    STagStoreCol *pCol = (STagStoreCol *)taosArrayGet(aCol, i);
+    tfree(pCol->data);
+  }
+  taosArrayClear(aCol);
+}
+
+static STagStoreSnap *tsdbNewTagStoreSnap(STable *pSuper) {
+  int32_t        capacity = (int32_t)SL_SIZE(pSuper->pIndex);
+  STagStoreSnap *pSnap = (STagStoreSnap *)calloc(1, sizeof(*pSnap));
+
+  if (pSnap == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return NULL;
+  }
+  T_REF_INIT_VAL(pSnap, 1);
+
+  pSnap->aCol = taosArrayInit(4, sizeof(STagStoreCol));
+  pSnap->tables = (STable **)malloc(sizeof(STable *) * MAX(capacity, 1));
+  if (pSnap->aCol == NULL || pSnap->tables == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    tsdbUnrefTagStoreSnap(pSnap);
+    return NULL;
+  }
+
+  SSkipListIterator *pIter = tSkipListCreateIter(pSuper->pIndex);
+  if (pIter == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    tsdbUnrefTagStoreSnap(pSnap);
+    return NULL;
+  }
+
+  while (tSkipListIterNext(pIter) && pSnap->numOfTables < capacity) {
+    pSnap->tables[pSnap->numOfTables++] = (STable *)SL_GET_NODE_DATA(tSkipListIterGet(pIter));
+  }
+  tSkipListDestroyIter(pIter);
+
+  // in tid order like the tables listed by the tag indexes, so both paths return the tables in the same order
+  qsort(pSnap->tables, pSnap->numOfTables, sizeof(STable *), tsdbCompareTableTid);
+
+  pSnap->tversion = schemaVersion(pSuper->tagSchema);
+  return pSnap;
+}
+
+static void tsdbUnrefTagStoreSnap(STagStoreSnap *pSnap) {
+  if (pSnap == NULL || T_REF_DEC(pSnap) > 0) return;
+
+  tsdbClearTagStoreCols(pSnap->aCol);
+  taosArrayDestroy(&pSnap->aCol);
+  tfree(pSnap->tables);
+  free(pSnap);
+}
+
+/**
+ * Called with the mutex of the store. Fill the columns the filter reads in the snapshot of the store, building it
+ * again if it is invalidated or has a column of another width, then list the columns to aCol and refer the snapshot.
+ */
+static STagStoreSnap *tsdbTakeTagStoreSnap(STable *pSuper, STagStore *pStore, SFilterInfo *info, SArray *aCol) {
+  STagStoreSnap *pSnap = pStore->pSnap;
+
+  // a column in use is never filled again, the snapshot is replaced instead
+  if (pSnap != NULL &&
+      (pSnap->tversion != schemaVersion(pSuper->tagSchema) || !tsdbTagStoreColsFit(pSnap->aCol, info))) {
+    tsdbUnrefTagStoreSnap(pSnap);
+    pStore->pSnap = pSnap = NULL;
+  }
+
+  if (pSnap == NULL && (pStore->pSnap = pSnap = tsdbNewTagStoreSnap(pSuper)) == NULL) return NULL;
+
+  if (tsdbPrepareTagStoreCols(pSnap->aCol, info, pSnap->tables, pSnap->numOfTables) < 0) return NULL;
+
+  for (uint32_t i = 0; i < info->fields[FLD_TYPE_COLUMN].num; ++i) {
+    SSchema *sch = info->fields[FLD_TYPE_COLUMN].fields[i].desc;
+    if (taosArrayPush(aCol, tsdbGetTagStoreCol(pSnap->aCol, sch->colId)) == NULL) {
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return NULL;
+    }
+  }
+
+  T_REF_INC(pSnap);
+  return pSnap;
+}
+
+static bool tsdbTagStoreColsFit(SArray *aCol, SFilterInfo *info) {
+  for (uint32_t i = 0; i < info->fields[FLD_TYPE_COLUMN].num; ++i) {
+    SSchema *     sch = info->fields[FLD_TYPE_COLUMN].fields[i].desc;
+    STagStoreCol *pCol = tsdbGetTagStoreCol(aCol, sch->colId);
+
+    if (pCol != NULL && (pCol->type != sch->type || pCol->bytes != sch->bytes)) return false;
+  }
+
+  return true;
+}
+
+static STagStoreCol *tsdbGetTagStoreCol(SArray *aCol, int16_t colId) {
+  for (size_t i = 0; i < taosArrayGetSize(aCol); i++) {
+    STagStoreCol *pCol = (STagStoreCol *)taosArrayGet(aCol, i);
+    if (pCol->colId == colId) return pCol;
+  }
+
+  return NULL;
+}
+
+// Fill the columns the filter reads unless they are in aCol, a column is added once filled
+static int tsdbPrepareTagStoreCols(SArray *aCol, SFilterInfo *info, STable **tables, int32_t numOfTables) {
+  for (uint32_t i = 0; i < info->fields[FLD_TYPE_COLUMN].num; ++i) {
+    SSchema *    sch = info->fields[FLD_TYPE_COLUMN].fields[i].desc;
+    STagStoreCol col = {.colId = sch->colId, .type = sch->type, .bytes = sch->bytes};
+
+    if (tsdbGetTagStoreCol(aCol, sch->colId) != NULL) continue;
+
+    if (tsdbFillTagStoreCol(&col, tables, numOfTables) < 0) return -1;
+    if (taosArrayPush(aCol, &col) == NULL) {
+      tfree(col.data);
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int tsdbFillTagStoreCol(STagStoreCol *pCol, STable **tables, int32_t numOfTables) {
+  pCol->data = (char *)malloc((size_t)pCol->bytes * MAX(numOfTables, 1));
+  if (pCol->data == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  for (int32_t i = 0; i < numOfTables; ++i) {
+    STable *pTable = tables[i];
+    char *  dst = pCol->data + (size_t)pCol->bytes * i;
+    void *  val = (pCol->colId == TSDB_TBNAME_COLUMN_INDEX) ? TABLE_NAME(pTable)
+                                                             : tdGetKVRowValOfCol(pTable->tagVal, pCol->colId);
+
+    if (val == NULL) {
+      setNull(dst, pCol->type, pCol->bytes);
+    } else if (IS_VAR_DATA_TYPE(pCol->type)) {
+      // the value does not fit the width the filter expects, the tables are filtered one by one
+      if (varDataTLen(val) > pCol->bytes) {
+        tfree(pCol->data);
+        return -1;
+      }
+      memcpy(dst, val, varDataTLen(val));
+    } else {
+      memcpy(dst, val, pCol->bytes);
+    }
+  }
+
+  return 0;
+}
+
+static int32_t tsdbGetTagStoreColData(void *param, int32_t id, void **data) {
+  STagStoreCol *pCol = tsdbGetTagStoreCol((SArray *)param, (int16_t)id);
+
+  *data = (pCol == NULL) ? NULL : pCol->data;
+  return TSDB_CODE_SUCCESS;
+}
+
+static void tsdbFilterTables(SFilterInfo *info, SArray *aCol, STable **tables, int32_t numOfTables, SArray *res) {
+  int8_t *addToResult = NULL;
+
+  filterSetColFieldData(info, aCol, tsdbGetTagStoreColData);
+  bool all = filterExecute(info, numOfTables, &addToResult, NULL, 0);
+
+  for (int32_t i = 0; i < numOfTables; ++i) {
+    if (all || (addToResult && addToResult[i])) {
+      STableKeyInfo kInfo = {.pTable = (void *)(tables[i]), .lastKey = TSKEY_INITIAL_VAL};
+      taosArrayPush(res, &kInfo);
+    }
+  }
+
+  tfree(addToResult);
+}
+
+/**
+ * List the tables which may satisfy the condition to *ppTables, sorted by tid. The condition is OR of groups and a
+ * group is AND of units, so a group is served if one of its units is = or in on an indexed tag, and the condition is
+ * served if all its groups are. Return -1 if not served.
+ */
+static int tsdbQueryTagIndexes(STable *pSuper, STagStore *pStore, SFilterInfo *info, SArray **ppTables) {
+  SArray *aTable = NULL;
+
+  if (tsTsdbMaxTagIndexes <= 0 || FILTER_ALL_RES(info) || FILTER_EMPTY_RES(info) || info->cunits == NULL) return -1;
+
+  tsdbDropTagIndexes(pSuper, pStore);
+
+  for (uint32_t g = 0; g < info->groupNum; ++g) {
+    SFilterGroup *group = &info->groups[g];
+    SArray *      aGroup = NULL;
+
+    for (uint32_t u = 0; u < group->unitNum; ++u) {
+      SFilterComUnit *cunit = &info->cunits[group->unitIdxs[u]];
+      STColumn *      pTCol = tdGetColOfID(pSuper->tagSchema, (int16_t)cunit->colId);
+
+      if (pTCol == NULL || colType(pTCol) != cunit->dataType) continue;
+      if (cunit->dataType == TSDB_DATA_TYPE_FLOAT || cunit->dataType == TSDB_DATA_TYPE_DOUBLE ||
+          cunit->dataType == TSDB_DATA_TYPE_JSON) {
+        continue;
+      }
+      if (cunit->optr != TSDB_RELATION_EQUAL &&
+          !(cunit->optr == TSDB_RELATION_IN && IS_VAR_DATA_TYPE(cunit->dataType))) {
+        continue;
+      }
+
+      STagIndex *pIdx = tsdbGetTagIndex(pStore, (int16_t)cunit->colId);
+      if (pIdx == NULL && (pIdx = tsdbCreateTagIndex(pSuper, pStore, (int16_t)cunit->colId, cunit->dataType)) == NULL) {
+        continue;
+      }
+
+      SArray *aUnit = tsdbLookupTagIndex(pIdx, cunit);
+      if (aUnit == NULL) {
+        taosArrayDestroy(&aGroup);
+        taosArrayDestroy(&aTable);
+        return -1;
+      }
+
+      if (aGroup == NULL) {
+        aGroup = aUnit;
+      } else {
+        SArray *aMerged = tsdbMergeTableLists(aGroup, aUnit, true);
+        taosArrayDestroy(&aGroup);
+        taosArrayDestroy(&aUnit);
+        if ((aGroup = aMerged) == NULL) {
+          taosArrayDestroy(&aTable);
+          return -1;
+        }
+      }
+    }
+
+    if (aGroup == NULL) {
+      taosArrayDestroy(&aTable);
+      return -1;
+    }
+
+    if (aTable == NULL) {
+      aTable = aGroup;
+    } else {
+      SArray *aMerged = tsdbMergeTableLists(aTable, aGroup, false);
+      taosArrayDestroy(&aTable);
+      taosArrayDestroy(&aGroup);
+      if ((aTable = aMerged) == NULL) return -1;
+    }
+  }
+
+  if (aTable == NULL) return -1;
+
+  *ppTables = aTable;
+  return 0;
+}
+
+static STagIndex *tsdbGetTagIndex(STagStore *pStore, int16_t colId) {
+  for (size_t i = 0; i < taosArrayGetSize(pStore->aIndex); i++) {
+    STagIndex *pIdx = (STagIndex *)taosArrayGet(pStore->aIndex, i);
+    if (pIdx->colId == colId) return pIdx;
+  }
+
+  return NULL;
+}
+
+static STagIndex *tsdbCreateTagIndex(STable *pSuper, STagStore *pStore, int16_t colId, int8_t type) {
+  STagIndex idx = {.colId = colId, .type = type};
+
+  if (taosArrayGetSize(pStore->aIndex) >= tsTsdbMaxTagIndexes) return NULL;
+
+  idx.map = taosHashInit(1024, taosGetDefaultHashFunction(TSDB_DATA_TYPE_BINARY), true, HASH_NO_LOCK);
+  if (idx.map == NULL) return NULL;
+  taosHashSetFreeFp(idx.map, taosArrayDestroyForHash);
+
+  SSkipListIterator *pIter = tSkipListCreateIter(pSuper->pIndex);
+  if (pIter == NULL) {
+    taosHashCleanup(idx.map);
+    return NULL;
+  }
+
+  while (tSkipListIterNext(pIter)) {
+    if (tsdbAddToTagIndex(&idx, (STable *)SL_GET_NODE_DATA(tSkipListIterGet(pIter)), false) < 0) {
+      tSkipListDestroyIter(pIter);
+      taosHashCleanup(idx.map);
+      return NULL;
+    }
+  }
+  tSkipListDestroyIter(pIter);
+
+  // the lists are sorted once all the tables are in
+  SArray **paTable = taosHashIterate(idx.map, NULL);
+  while (paTable != NULL) {
+    taosArraySort(*paTable, tsdbCompareTableTid);
+    paTable = taosHashIterate(idx.map, paTable);
+  }
+
+  STagIndex *pIdx = taosArrayPush(pStore->aIndex, &idx);
+  if (pIdx == NULL) {
+    taosHashCleanup(idx.map);
+    return NULL;
+  }
+
+  tsdbInfo("super table %s, index tag %d, %d values", TABLE_CHAR_NAME(pSuper), colId,
+           (int32_t)taosHashGetSize(idx.map));
+  return pIdx;
+}
+
+// Drop the indexes of the tags dropped or changed type since
+static void tsdbDropTagIndexes(STable *pSuper, STagStore *pStore) {
+  for (size_t i = 0; i < taosArrayGetSize(pStore->aIndex); i++) {
+    STagIndex *pIdx = (STagIndex *)taosArrayGet(pStore->aIndex, i);
+    STColumn * pTCol = tdGetColOfID(pSuper->tagSchema, pIdx->colId);
+
+    if (pTCol != NULL && colType(pTCol) == pIdx->type) continue;
+
+    tsdbInfo("super table %s, drop the index of tag %d", TABLE_CHAR_NAME(pSuper), pIdx->colId);
+    taosHashCleanup(pIdx->map);
+    taosArrayRemove(pStore->aIndex, i--);
+  }
+}
+
+static void *tsdbGetTagIndexKey(STagIndex *pIdx, STable *pTable, int32_t *len) {
+  void *val = tdGetKVRowValOfCol(pTable->tagVal, pIdx->colId);
+
+  if (val == NULL || isNull(val, pIdx->type)) return NULL;
+
+  if (IS_VAR_DATA_TYPE(pIdx->type)) {
+    *len = varDataLen(val);
+    return varDataVal(val);
+  }
+
+  *len = tDataTypes[pIdx->type].bytes;
+  return val;
+}
+
+static int tsdbAddToTagIndex(STagIndex *pIdx, STable *pTable, bool sorted) {
+  int32_t len = 0;
+  void *  key = tsdbGetTagIndexKey(pIdx, pTable, &len);
+
+  // a NULL tag never satisfies = or in
+  if (key == NULL) return 0;
+
+  SArray **paTable = (SArray **)taosHashGet(pIdx->map, key, len);
+  SArray * aTable = (paTable == NULL) ? NULL : *paTable;
+  if (aTable == NULL) {
+    if ((aTable = taosArrayInit(4, POINTER_BYTES)) == NULL) {
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+    if (taosHashPut(pIdx->map, key, len, &aTable, POINTER_BYTES) < 0) {
+      taosArrayDestroy(&aTable);
+      terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+      return -1;
+    }
+  }
+
+  // tables are mostly created in tid order, so a sorted list is appended to in general
+  void *p = NULL;
+  if (sorted && taosArrayGetSize(aTable) > 0 && tsdbCompareTableTid(&pTable, taosArrayGetLast(aTable)) < 0) {
+    p = taosArraySearch(aTable, &pTable, tsdbCompareTableTid, TD_GE);
+  }
+
+  if (p != NULL) {
+    p = taosArrayInsert(aTable, TARRAY_ELEM_IDX(aTable, p), &pTable);
+  } else {
+    p = taosArrayPush(aTable, &pTable);
+  }
+
+  if (p == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  return 0;
+}
+
+static SArray *tsdbLookupTagIndex(STagIndex *pIdx, SFilterComUnit *cunit) {
+  SArray * aTable = NULL;
+  SArray **paTable = NULL;
+
+  if (cunit->optr == TSDB_RELATION_EQUAL) {
+    if (IS_VAR_DATA_TYPE(pIdx->type)) {
+      paTable = (SArray **)taosHashGet(pIdx->map, varDataVal(cunit->valData), varDataLen(cunit->valData));
+    } else {
+      paTable = (SArray **)taosHashGet(pIdx->map, cunit->valData, tDataTypes[pIdx->type].bytes);
+    }
+    return (paTable == NULL) ? taosArrayInit(1, POINTER_BYTES) : taosArrayDup(*paTable);
+  }
+
+  // in: the keys of the set are the values without the header
+  SHashObj *pSet = (SHashObj *)cunit->valData;
+  if ((aTable = taosArrayInit(4, POINTER_BYTES)) == NULL) return NULL;
+
+  void *p = taosHashIterate(pSet, NULL);
+  while (p != NULL) {
+    paTable = (SArray **)taosHashGet(pIdx->map, taosHashGetDataKey(pSet, p), taosHashGetDataKeyLen(pSet, p));
+    if (paTable != NULL) {
+      SArray *aMerged = tsdbMergeTableLists(aTable, *paTable, false);
+      taosArrayDestroy(&aTable);
+      if ((aTable = aMerged) == NULL) {
+        taosHashCancelIterate(pSet, p);
+        return NULL;
+      }
+    }
+    p = taosHashIterate(pSet, p);
+  }
+
+  return aTable;
+}
+
+// Intersect or unite two lists of tables sorted by tid
+static SArray *tsdbMergeTableLists(SArray *aTable1, SArray *aTable2, bool intersect) {
+  size_t  n1 = taosArrayGetSize(aTable1), n2 = taosArrayGetSize(aTable2);
+  size_t  i = 0, j = 0;
+  SArray *aTable = taosArrayInit((intersect ? MIN(n1, n2) : n1 + n2) + 1, POINTER_BYTES);
+
+  if (aTable == NULL) return NULL;
+
+  while (i < n1 && j < n2) {
+    void *p1 = taosArrayGet(aTable1, i);
+    void *p2 = taosArrayGet(aTable2, j);
+    int   c = tsdbCompareTableTid(p1, p2);
+
+    if (c == 0) {
+      taosArrayPush(aTable, p1);
+      i++;
+      j++;
+    } else if (c < 0) {
+      if (!intersect) taosArrayPush(aTable, p1);
+      i++;
+    } else {
+      if (!intersect) taosArrayPush(aTable, p2);
+      j++;
+    }
+  }
+
+  if (!intersect) {
+    for (; i < n1; i++) taosArrayPush(aTable, taosArrayGet(aTable1, i));
+    for (; j < n2; j++) taosArrayPush(aTable, taosArrayGet(aTable2, j));
+  }
+
+  return aTable;
+}
+
+static int tsdbCompareTableTid(const void *a, const void *b) {
+  int32_t tid1 = TABLE_TID(*(STable **)a);
+  int32_t tid2 = TABLE_TID(*(STable **)b);
+
+  if (tid1 < tid2) return -1;
+  if (tid1 > tid2) return 1;
+  return 0;
+}
@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "tsdbint.h"
+#include "tglobal.h"
+
+// Write the same history into a repo by the bulk load and by submit msgs through the memtable and the commits, then
+// reopen the repo and check all rows in the data files. Each table has the columns (ts, current float, voltage int,
+// phase float).
+
+static char    path[96] = "/tmp/tsdbLoadBench";
+static int     numOfTables = 100;
+static int     rowsPerTable = 100000;
+static int     rowsPerBatch = 4096;
+static int     rowsPerMsg = 1000;
+static TSKEY   interval = 60000;
+static int32_t daysPerFile = 10;
+
+static STSchema *pSchema = NULL;
+
+static double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+static uint64_t tableUid(int t) { return 10000 + t; }
+
+static int32_t voltageOf(int t, int i) { return 200 + (t * 31 + i) % 40; }
+
+static void setCfg(STsdbCfg *pCfg) {
+  memset(pCfg, 0, sizeof(*pCfg));
+  pCfg->tsdbId = 1;
+  pCfg->cacheBlockSize = 16;  // MB
+  pCfg->totalBlocks = 6;
+  pCfg->daysPerFile = daysPerFile;
+  pCfg->keep = 3650;
+  pCfg->keep1 = 3650;
+  pCfg->keep2 = 3650;
+  pCfg->minRowsPerFileBlock = 100;
+  pCfg->maxRowsPerFileBlock = 4096;
+  pCfg->precision = TSDB_TIME_PRECISION_MILLI;
+  pCfg->compression = 2;
+  pCfg->update = 0;
+  pCfg->cacheLastRow = 0;
+}
+
+static void createTables(STsdbRepo *pRepo) {
+  STSchemaBuilder builder;
+  tdInitTSchemaBuilder(&builder, 1);
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_TIMESTAMP, PRIMARYKEY_TIMESTAMP_COL_INDEX, 8);
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_FLOAT, 1, 4);
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_INT, 2, 4);
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_FLOAT, 3, 4);
+  pSchema = tdGetSchemaFromBuilder(&builder);
+  tdDestroyTSchemaBuilder(&builder);
+
+  for (int t = 0; t < numOfTables; t++) {
+    char      name[32];
+    STableCfg cfg = {0};
+
+    snprintf(name, sizeof(name), "d%d", t);
+    cfg.type = TSDB_NORMAL_TABLE;
+    cfg.name = strdup(name);
+    cfg.tableId.tid = t + 1;
+    cfg.tableId.uid = tableUid(t);
+    cfg.sversion = 1;
+    cfg.schema = tdDupSchema(pSchema);
+    if (tsdbCreateTable(pRepo, &cfg) < 0) {
+      printf("failed to create table %s since %s\n", name, tstrerror(terrno));
+      exit(1);
+    }
+  }
+
+  // the meta file is created by the commit
+  tsdbSyncCommit(pRepo);
+}
+
+static void loadTables(STsdbRepo *pRepo, TSKEY start) {
+  TSKEY       fsetKeys = (TSKEY)daysPerFile * tsTickPerDay[TSDB_TIME_PRECISION_MILLI];
+  int         rowsPerFSet = (int)(fsetKeys / interval);
+  SDataCols * pCols = tdNewDataCols(0, rowsPerBatch);
+  STsdbLoadH *pLoadh = tsdbOpenBulkLoad(pRepo);
+
+  if (pLoadh == NULL || pCols == NULL || tdInitDataCols(pCols, pSchema) < 0) {
+    printf("failed to open bulk load since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+
+  // start is aligned to a file set, load the rows file set by file set
+  for (int first = 0; first < rowsPerTable; first += rowsPerFSet) {
+    int last = MIN(first + rowsPerFSet, rowsPerTable);
+
+    for (int t = 0; t < numOfTables; t++) {
+      for (int i = first; i < last;) {
+        tdResetDataCols(pCols);
+        for (; i < last && pCols->numOfRows < rowsPerBatch; i++) {
+          TSKEY   key = start + i * interval;
+          int32_t voltage = voltageOf(t, i);
+          float   current = voltage / 20.0f;
+          float   phase = 0.3f;
+
+          dataColAppendVal(pCols->cols, &key, pCols->numOfRows, pCols->maxPoints, 0);
+          dataColAppendVal(pCols->cols + 1, &current, pCols->numOfRows, pCols->maxPoints, 0);
+          dataColAppendVal(pCols->cols + 2, &voltage, pCols->numOfRows, pCols->maxPoints, 0);
+          dataColAppendVal(pCols->cols + 3, &phase, pCols->numOfRows, pCols->maxPoints, 0);
+          pCols->numOfRows++;
+        }
+
+        if (tsdbBulkLoadData(pLoadh, tableUid(t), pCols) < 0) {
+          printf("failed to load table %d since %s\n", t, tstrerror(terrno));
+          exit(1);
+        }
+      }
+    }
+  }
+
+  if (tsdbCloseBulkLoad(pLoadh, true) < 0) {
+    printf("failed to close bulk load since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+  tdFreeDataCols(pCols);
+}
+
+static void insertTables(STsdbRepo *pRepo, TSKEY start) {
+  int         rowLen = TD_MEM_ROW_TYPE_SIZE + dataRowMaxBytesFromSchema(pSchema);
+  SSubmitMsg *pMsg = (SSubmitMsg *)malloc(sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + rowLen * rowsPerMsg);
+
+  for (int first = 0; first < rowsPerTable; first += rowsPerMsg) {
+    for (int t = 0; t < numOfTables; t++) {
+      SSubmitBlk *pBlk = (SSubmitBlk *)pMsg->blocks;
+      char *      row = pBlk->data;
+      int         nRows = MIN(rowsPerMsg, rowsPerTable - first);
+
+      memset(pMsg, 0, sizeof(SSubmitMsg) + sizeof(SSubmitBlk));
+      for (int i = first; i < first + nRows; i++) {
+        TSKEY   key = start + i * interval;
+        int32_t voltage = voltageOf(t, i);
+        float   current = voltage / 20.0f;
+        float   phase = 0.3f;
+
+        memRowSetType(row, SMEM_ROW_DATA);
+        SDataRow dataRow = memRowDataBody(row);
+        tdInitDataRow(dataRow, pSchema);
+        tdAppendColVal(dataRow, &key, TSDB_DATA_TYPE_TIMESTAMP, schemaColAt(pSchema, 0)->offset);
+        tdAppendColVal(dataRow, &current, TSDB_DATA_TYPE_FLOAT, schemaColAt(pSchema, 1)->offset);
+        tdAppendColVal(dataRow, &voltage, TSDB_DATA_TYPE_INT, schemaColAt(pSchema, 2)->offset);
+        tdAppendColVal(dataRow, &phase, TSDB_DATA_TYPE_FLOAT, schemaColAt(pSchema, 3)->offset);
+        row = POINTER_SHIFT(row, TD_MEM_ROW_TYPE_SIZE + dataRowLen(dataRow));
+      }
+
+      pBlk->uid = htobe64(tableUid(t));
+      pBlk->tid = htonl(t + 1);
+      pBlk->sversion = htonl(1);
+      pBlk->dataLen = htonl((int32_t)(row - pBlk->data));
+      pBlk->numOfRows = htons(nRows);
+      pMsg->numOfBlocks = htonl(1);
+      pMsg->length = htonl((int32_t)(row - (char *)pMsg));
+
+      if (tsdbInsertData(pRepo, pMsg, NULL, NULL) < 0) {
+        printf("failed to insert table %d since %s\n", t, tstrerror(terrno));
+        exit(1);
+      }
+    }
+  }
+
+  tsdbSyncCommit(pRepo);
+  free(pMsg);
+}
+
+// count the rows and sum the voltages of each table in the data files, check the keys go up
+static void checkTables(STsdbRepo *pRepo) {
+  int64_t *rows = (int64_t *)calloc(numOfTables, sizeof(int64_t));
+  int64_t *sums = (int64_t *)calloc(numOfTables, sizeof(int64_t));
+  TSKEY *  lastKeys = (TSKEY *)calloc(numOfTables, sizeof(TSKEY));
+  int      disordered = 0;
+  int      mismatched = 0;
+  SReadH   readh;
+  SFSIter  fsIter;
+  SDFileSet *pSet;
+
+  for (int t = 0; t < numOfTables; t++) lastKeys[t] = INT64_MIN;
+
+  tsdbInitReadH(&readh, pRepo);
+  tsdbFSIterInit(&fsIter, REPO_FS(pRepo), TSDB_FS_ITER_FORWARD);
+  while ((pSet = tsdbFSIterNext(&fsIter))) {
+    if (tsdbSetAndOpenReadFSet(&readh, pSet) < 0 || tsdbLoadBlockIdx(&readh) < 0) {
+      printf("failed to read FSET %d since %s\n", pSet->fid, tstrerror(terrno));
+      exit(1);
+    }
+
+    for (int t = 0; t < numOfTables; t++) {
+      STable *pTable = tsdbGetTableByUid(pRepo->tsdbMeta, tableUid(t));
+      if (tsdbSetReadTable(&readh, pTable) < 0) exit(1);
+      if (readh.pBlkIdx == NULL) continue;
+      if (tsdbLoadBlockInfo(&readh, NULL, NULL) < 0) exit(1);
+
+      for (int b = 0; b < readh.pBlkIdx->numOfBlocks; b++) {
+        if (tsdbLoadBlockData(&readh, readh.pBlkInfo->blocks + b, NULL) < 0) {
+          printf("failed to read a block of table %d since %s\n", t, tstrerror(terrno));
+          exit(1);
+        }
+
+        SDataCols *pCols = readh.pDCols[0];
+        for (int i = 0; i < pCols->numOfRows; i++) {
+          TSKEY key = dataColsKeyAt(pCols, i);
+          if (key <= lastKeys[t]) disordered++;
+          lastKeys[t] = key;
+          sums[t] += ((int32_t *)pCols->cols[2].pData)[i];
+        }
+        rows[t] += pCols->numOfRows;
+      }
+    }
+    tsdbCloseAndUnsetFSet(&readh);
+  }
+  tsdbDestroyReadH(&readh);
+
+  int64_t total = 0;
+  for (int t = 0; t < numOfTables; t++) {
+    int64_t sum = 0;
+    for (int i = 0; i < rowsPerTable; i++) sum += voltageOf(t, i);
+    if (rows[t] != 2 * (int64_t)rowsPerTable || sums[t] != 2 * sum) mismatched++;
+    total += rows[t];
+  }
+
+  printf("check: %" PRId64 " rows in %d file sets, %d tables mismatched, %d keys disordered\n", total,
+         (int)taosArrayGetSize(REPO_FS(pRepo)->cstatus->df), mismatched, disordered);
+
+  free(rows);
+  free(sums);
+  free(lastKeys);
+}
+
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-p") == 0 && i < argc - 1) {
+      tstrncpy(path, argv[++i], sizeof(path));
+    } else if (strcmp(argv[i], "-t") == 0 && i < argc - 1) {
+      numOfTables = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i < argc - 1) {
+      rowsPerTable = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-i") == 0 && i < argc - 1) {
+      interval = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-a") == 0 && i < argc - 1) {
+      tsNumOfApplyThreads = atoi(argv[++i]);
+    } else {
+      printf("\nusage: %s [options] \n", argv[0]);
+      printf("  [-p path]: data dir, removed before the run, default: %s\n", path);
+      printf("  [-t]: number of tables, default: %d\n", numOfTables);
+      printf("  [-r]: rows of each table, default: %d\n", rowsPerTable);
+      printf("  [-i]: ms between the rows, default: %" PRId64 "\n", interval);
+      printf("  [-a]: apply threads helping the commits, default: %d\n", tsNumOfApplyThreads);
+      exit(0);
+    }
+  }
+
+  char cmd[sizeof(path) * 3 + 64];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s/log %s/vnode/vnode1", path, path, path);
+  system(cmd);
+
+  snprintf(cmd, sizeof(cmd), "%s/log/tsdbload.log", path);
+  taosInitLog(cmd, 100000, 10);
+  tsDiskCfgNum = 1;
+  tstrncpy(tsDiskCfg[0].dir, path, TSDB_FILENAME_LEN);
+  tsDiskCfg[0].level = 0;
+  tsDiskCfg[0].primary = 1;
+  if (tfsInit(tsDiskCfg, tsDiskCfgNum) < 0 || tsdbInitCommitQueue() < 0 || tsdbInitBlkCache() < 0 ||
+      tsdbInitApplyPool() < 0) {
+    printf("failed to init since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+
+  STsdbCfg  cfg;
+  STsdbAppH appH = {0};
+  setCfg(&cfg);
+  tsdbCreateRepo(cfg.tsdbId);
+  STsdbRepo *pRepo = tsdbOpenRepo(&cfg, &appH);
+  if (pRepo == NULL) {
+    printf("failed to open repo since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+  createTables(pRepo);
+
+  // two ranges of history aligned to file sets, the later one ends well before now
+  TSKEY   fsetKeys = (TSKEY)daysPerFile * tsTickPerDay[TSDB_TIME_PRECISION_MILLI];
+  TSKEY   span = (rowsPerTable * interval / fsetKeys + 1) * fsetKeys;
+  TSKEY   start2 = (taosGetTimestampMs() - 30 * tsTickPerDay[TSDB_TIME_PRECISION_MILLI]) / fsetKeys * fsetKeys - span;
+  TSKEY   start1 = start2 - span;
+  int64_t nRows = (int64_t)numOfTables * rowsPerTable;
+
+  printf("%d tables, %d rows each, a row every %" PRId64 "ms:\n", numOfTables, rowsPerTable, interval);
+
+  double st = getCurTime();
+  loadTables(pRepo, start1);
+  double lt = getCurTime() - st;
+  printf("  %-6s: %.0f rows/s\n", "load", nRows / lt);
+
+  st = getCurTime();
+  insertTables(pRepo, start2);
+  double it = getCurTime() - st;
+  printf("  %-6s: %.0f rows/s\n", "insert", nRows / it);
+
+  tsdbCloseRepo(pRepo, 1);
+  pRepo = tsdbOpenRepo(&cfg, &appH);
+  if (pRepo == NULL) {
+    printf("failed to reopen repo since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+  checkTables(pRepo);
+  tsdbCloseRepo(pRepo, 0);
+
+  tsdbDestroyApplyPool();
+  tsdbDestroyBlkCache();
+  tsdbDestroyCommitQueue();
+  tfsDestroy();
+  return 0;
+}
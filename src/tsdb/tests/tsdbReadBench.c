@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "tsdbint.h"
+#include "tglobal.h"
+
+// Write a table of BIGINT columns into a repo, then load a narrow and a wide subset of the columns of each file block
+// through SReadH, reading the columns one by one and by the coalesced reads planned by tsdbCoalesceColReads(). The
+// page cache of the data files is dropped before each pass, and the read syscalls and bytes are taken from
+// /proc/self/io.
+
+static char  path[96] = "/tmp/tsdbReadBench";
+static int   numOfCols = 20;
+static int   numOfRows = 1000000;
+static int   rowsPerMsg = 1000;
+static int   numOfLoops = 5;
+static TSKEY interval = 1000;
+
+static STSchema *pSchema = NULL;
+
+static double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+static void checkCoalesce() {
+  SReadColInfo cols[3];
+  int64_t      len = 0;
+
+  cols[0].offset = 0, cols[0].len = 100;
+  cols[1].offset = 100, cols[1].len = 50;
+  cols[2].offset = 1000, cols[2].len = 10;
+
+  if (tsdbCoalesceColReads(cols, 3, 0, &len) != 2 || len != 150 || tsdbCoalesceColReads(cols, 3, 850, &len) != 3 ||
+      len != 1010 || tsdbCoalesceColReads(cols + 2, 1, 0, &len) != 1 || len != 10 ||
+      tsdbCoalesceColReads(cols, 3, -1, &len) != 1 || len != 100) {
+    printf("tsdbCoalesceColReads check failed\n");
+    exit(1);
+  }
+}
+
+static void setCfg(STsdbCfg *pCfg) {
+  memset(pCfg, 0, sizeof(*pCfg));
+  pCfg->tsdbId = 1;
+  pCfg->cacheBlockSize = 16;  // MB
+  pCfg->totalBlocks = 6;
+  pCfg->daysPerFile = 10;
+  pCfg->keep = 3650;
+  pCfg->keep1 = 3650;
+  pCfg->keep2 = 3650;
+  pCfg->minRowsPerFileBlock = 100;
+  pCfg->maxRowsPerFileBlock = 4096;
+  pCfg->precision = TSDB_TIME_PRECISION_MILLI;
+  pCfg->compression = 2;
+  pCfg->update = 0;
+  pCfg->cacheLastRow = 0;
+}
+
+static void createTable(STsdbRepo *pRepo) {
+  STSchemaBuilder builder;
+  STableCfg       cfg = {0};
+
+  tdInitTSchemaBuilder(&builder, 1);
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_TIMESTAMP, PRIMARYKEY_TIMESTAMP_COL_INDEX, 8);
+  for (int c = 1; c < numOfCols; c++) {
+    tdAddColToSchema(&builder, TSDB_DATA_TYPE_BIGINT, c, 8);
+  }
+  pSchema = tdGetSchemaFromBuilder(&builder);
+  tdDestroyTSchemaBuilder(&builder);
+
+  cfg.type = TSDB_NORMAL_TABLE;
+  cfg.name = strdup("t1");
+  cfg.tableId.tid = 1;
+  cfg.tableId.uid = 10000;
+  cfg.sversion = 1;
+  cfg.schema = tdDupSchema(pSchema);
+  if (tsdbCreateTable(pRepo, &cfg) < 0) {
+    printf("failed to create table since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+}
+
+static void insertTable(STsdbRepo *pRepo, TSKEY start) {
+  int         rowLen = TD_MEM_ROW_TYPE_SIZE + dataRowMaxBytesFromSchema(pSchema);
+  SSubmitMsg *pMsg = (SSubmitMsg *)malloc(sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + rowLen * rowsPerMsg);
+
+  srand(7);
+  for (int first = 0; first < numOfRows; first += rowsPerMsg) {
+    SSubmitBlk *pBlk = (SSubmitBlk *)pMsg->blocks;
+    char *      row = pBlk->data;
+    int         nRows = MIN(rowsPerMsg, numOfRows - first);
+
+    memset(pMsg, 0, sizeof(SSubmitMsg) + sizeof(SSubmitBlk));
+    for (int i = first; i < first + nRows; i++) {
+      TSKEY key = start + i * interval;
+
+      memRowSetType(row, SMEM_ROW_DATA);
+      SDataRow dataRow = memRowDataBody(row);
+      tdInitDataRow(dataRow, pSchema);
+      tdAppendColVal(dataRow, &key, TSDB_DATA_TYPE_TIMESTAMP, schemaColAt(pSchema, 0)->offset);
+      for (int c = 1; c < numOfCols; c++) {
+        // a slowly moving metric with some noise, so the columns compress like real ones
+        int64_t val = (int64_t)c * 1000000 + i / 16 + rand() % 1000;
+        tdAppendColVal(dataRow, &val, TSDB_DATA_TYPE_BIGINT, schemaColAt(pSchema, c)->offset);
+      }
+      row = POINTER_SHIFT(row, TD_MEM_ROW_TYPE_SIZE + dataRowLen(dataRow));
+    }
+
+    pBlk->uid = htobe64(10000);
+    pBlk->tid = htonl(1);
+    pBlk->sversion = htonl(1);
+    pBlk->dataLen = htonl((int32_t)(row - pBlk->data));
+    pBlk->numOfRows = htons(nRows);
+    pMsg->numOfBlocks = htonl(1);
+    pMsg->length = htonl((int32_t)(row - (char *)pMsg));
+
+    if (tsdbInsertData(pRepo, pMsg, NULL, NULL) < 0) {
+      printf("failed to insert since %s\n", tstrerror(terrno));
+      exit(1);
+    }
+  }
+
+  tsdbSyncCommit(pRepo);
+  free(pMsg);
+}
+
+// read syscalls and bytes of the process so far, from /proc/self/io
+static void getReadStat(int64_t *pCalls, int64_t *pBytes) {
+  char  line[64];
+  FILE *fp = fopen("/proc/self/io", "r");
+
+  *pCalls = 0;
+  *pBytes = 0;
+  if (fp == NULL) return;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    sscanf(line, "rchar: %" SCNd64, pBytes);
+    sscanf(line, "syscr: %" SCNd64, pCalls);
+  }
+  fclose(fp);
+}
+
+// drop the pages of the data files from the page cache, so every pass reads from the disk
+static void dropPageCache(STsdbRepo *pRepo) {
+  SFSIter    fsIter;
+  SDFileSet *pSet;
+
+  tsdbFSIterInit(&fsIter, REPO_FS(pRepo), TSDB_FS_ITER_FORWARD);
+  while ((pSet = tsdbFSIterNext(&fsIter))) {
+    for (TSDB_FILE_T ftype = 0; ftype < TSDB_FILE_MAX; ftype++) {
+      int fd = open(TSDB_FILE_FULL_NAME(TSDB_DFILE_IN_SET(pSet, ftype)), O_RDONLY);
+      if (fd < 0) continue;
+      fdatasync(fd);
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  }
+}
+
+// load the columns of colIds of all the blocks, return the blocks loaded
+static int64_t loadBlocks(STsdbRepo *pRepo, int16_t *colIds, int nCols, int64_t *sum) {
+  STable *   pTable = tsdbGetTableByUid(pRepo->tsdbMeta, 10000);
+  int64_t    blocks = 0;
+  SReadH     readh;
+  SFSIter    fsIter;
+  SDFileSet *pSet;
+
+  tsdbInitReadH(&readh, pRepo);
+  tsdbFSIterInit(&fsIter, REPO_FS(pRepo), TSDB_FS_ITER_FORWARD);
+  while ((pSet = tsdbFSIterNext(&fsIter))) {
+    if (tsdbSetAndOpenReadFSet(&readh, pSet) < 0 || tsdbLoadBlockIdx(&readh) < 0 ||
+        tsdbSetReadTable(&readh, pTable) < 0) {
+      printf("failed to read FSET %d since %s\n", pSet->fid, tstrerror(terrno));
+      exit(1);
+    }
+
+    if (readh.pBlkIdx != NULL) {
+      if (tsdbLoadBlockInfo(&readh, NULL, NULL) < 0) exit(1);
+
+      for (int b = 0; b < readh.pBlkIdx->numOfBlocks; b++) {
+        if (tsdbLoadBlockDataCols(&readh, readh.pBlkInfo->blocks + b, NULL, colIds, nCols) < 0) {
+          printf("failed to load a block since %s\n", tstrerror(terrno));
+          exit(1);
+        }
+
+        SDataCols *pCols = readh.pDCols[0];
+        SDataCol * pCol = pCols->cols + colIds[nCols - 1];
+        for (int i = 0; i < pCols->numOfRows; i++) *sum += ((int64_t *)pCol->pData)[i];
+        blocks++;
+      }
+    }
+    tsdbCloseAndUnsetFSet(&readh);
+  }
+  tsdbDestroyReadH(&readh);
+
+  return blocks;
+}
+
+static void runBench(STsdbRepo *pRepo, int nCols) {
+  int16_t *colIds = (int16_t *)calloc(nCols, sizeof(int16_t));
+  int32_t  gap = tsTsdbReadCoalesceGap;
+  int64_t  sums[2] = {0};
+  int64_t  statCalls, statBytes;
+
+  // always the key column, the others spread evenly over the block
+  for (int i = 0; i < nCols; i++) {
+    colIds[i] = (int16_t)((int64_t)i * numOfCols / nCols);
+  }
+
+  // the reads of /proc/self/io itself
+  int64_t calls0, bytes0;
+  getReadStat(&calls0, &bytes0);
+  getReadStat(&statCalls, &statBytes);
+  statCalls -= calls0;
+  statBytes -= bytes0;
+
+  printf("%d of %d columns:\n", nCols, numOfCols);
+  for (int coalesce = 0; coalesce < 2; coalesce++) {
+    int64_t blocks = 0, calls = 0, bytes = 0;
+    double  elapsed = 0;
+
+    tsTsdbReadCoalesceGap = coalesce ? gap : -1;
+    for (int l = 0; l < numOfLoops; l++) {
+      int64_t calls1, bytes1, calls2, bytes2;
+
+      dropPageCache(pRepo);
+      getReadStat(&calls1, &bytes1);
+      double st = getCurTime();
+      blocks += loadBlocks(pRepo, colIds, nCols, &sums[coalesce]);
+      elapsed += getCurTime() - st;
+      getReadStat(&calls2, &bytes2);
+
+      calls += calls2 - calls1 - statCalls;
+      bytes += bytes2 - bytes1 - statBytes;
+    }
+
+    printf("  %-10s: %.1f us/block, %.2f read calls/block, %.1f MB/s\n", coalesce ? "coalesced" : "per-column",
+           elapsed * 1E6 / blocks, (double)calls / blocks, bytes / elapsed / 1024 / 1024);
+  }
+  tsTsdbReadCoalesceGap = gap;
+
+  if (sums[0] != sums[1]) {
+    printf("per-column and coalesced reads loaded different data\n");
+    exit(1);
+  }
+
+  free(colIds);
+}
+
+int main(int argc, char *argv[]) {
+  int narrow = 2;
+  int wide = 16;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-p") == 0 && i < argc - 1) {
+      tstrncpy(path, argv[++i], sizeof(path));
+    } else if (strcmp(argv[i], "-c") == 0 && i < argc - 1) {
+      numOfCols = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i < argc - 1) {
+      numOfRows = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i < argc - 1) {
+      numOfLoops = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-g") == 0 && i < argc - 1) {
+      tsTsdbReadCoalesceGap = atoi(argv[++i]);
+    } else {
+      printf("\nusage: %s [options] \n", argv[0]);
+      printf("  [-p path]: data dir, removed before the run, default: %s\n", path);
+      printf("  [-c]: number of columns of the table, default: %d\n", numOfCols);
+      printf("  [-r]: number of rows, default: %d\n", numOfRows);
+      printf("  [-l]: times all the blocks are loaded, from the disk each time, default: %d\n", numOfLoops);
+      printf("  [-g]: max gap coalesced into one read, default: %d\n", tsTsdbReadCoalesceGap);
+      exit(0);
+    }
+  }
+
+  if (numOfCols < wide + 1) wide = numOfCols - 1;
+  checkCoalesce();
+
+  char cmd[sizeof(path) * 3 + 64];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s/log %s/vnode/vnode1", path, path, path);
+  system(cmd);
+
+  snprintf(cmd, sizeof(cmd), "%s/log/tsdbread.log", path);
+  taosInitLog(cmd, 100000, 10);
+  tsDiskCfgNum = 1;
+  tstrncpy(tsDiskCfg[0].dir, path, TSDB_FILENAME_LEN);
+  tsDiskCfg[0].level = 0;
+  tsDiskCfg[0].primary = 1;
+  if (tfsInit(tsDiskCfg, tsDiskCfgNum) < 0 || tsdbInitCommitQueue() < 0 || tsdbInitApplyPool() < 0) {
+    printf("failed to init since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+
+  STsdbCfg  cfg;
+  STsdbAppH appH = {0};
+  setCfg(&cfg);
+  tsdbCreateRepo(cfg.tsdbId);
+  STsdbRepo *pRepo = tsdbOpenRepo(&cfg, &appH);
+  if (pRepo == NULL) {
+    printf("failed to open repo since %s\n", tstrerror(terrno));
+    exit(1);
+  }
+  createTable(pRepo);
+
+  TSKEY fsetKeys = (TSKEY)cfg.daysPerFile * tsTickPerDay[TSDB_TIME_PRECISION_MILLI];
+  insertTable(pRepo, (taosGetTimestampMs() - 30 * tsTickPerDay[TSDB_TIME_PRECISION_MILLI]) / fsetKeys * fsetKeys -
+                         (TSKEY)numOfRows * interval);
+
+  runBench(pRepo, narrow);
+  runBench(pRepo, wide);
+
+  tsdbCloseRepo(pRepo, 0);
+  tsdbDestroyApplyPool();
+  tsdbDestroyCommitQueue();
+  tfsDestroy();
+  return 0;
+}
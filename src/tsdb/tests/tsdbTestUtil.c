@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tsdbint.h"
+#include "tsdbDelete.h"
+#include "tglobal.h"
+#include "exception.h"
+#include "texpr.h"
+#include "qFilter.h"
+#include "tsdbTestUtil.h"
+
+#define TSDB_TEST_ROWS_PER_MSG 1000
+
+int tsdbTestInit(const char *path) {
+  static bool logInited = false;
+  char        cmd[PATH_MAX + 64];
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s/vnode/vnode%d", path, path, TSDB_TEST_VNODE);
+  if (system(cmd) != 0) return -1;
+
+  // the log of all the tests goes to the first dir
+  if (!logInited) {
+    snprintf(cmd, sizeof(cmd), "%s.log", path);
+    taosInitLog(cmd, 100000, 10);
+    logInited = true;
+  }
+
+  // the nchar tag values of the tests
+  tstrncpy(tsCharset, "UTF-8", TSDB_LOCALE_LEN);
+
+  tsDiskCfgNum = 1;
+  tstrncpy(tsDiskCfg[0].dir, path, TSDB_FILENAME_LEN);
+  tsDiskCfg[0].level = 0;
+  tsDiskCfg[0].primary = 1;
+  if (tfsInit(tsDiskCfg, tsDiskCfgNum) < 0) return -1;
+  if (tsdbInitCommitQueue() < 0 || tsdbInitApplyPool() < 0) return -1;
+
+  return 0;
+}
+
+void tsdbTestCleanup() {
+  tsdbDestroyApplyPool();
+  tsdbDestroyCommitQueue();
+  tfsDestroy();
+}
+
+void tsdbTestSetCfg(STsdbCfg *pCfg) {
+  memset(pCfg, 0, sizeof(*pCfg));
+  pCfg->tsdbId = TSDB_TEST_VNODE;
+  pCfg->cacheBlockSize = 16;  // MB
+  pCfg->totalBlocks = 6;
+  pCfg->daysPerFile = 10;
+  pCfg->keep = 3650;
+  pCfg->keep1 = 3650;
+  pCfg->keep2 = 3650;
+  pCfg->minRowsPerFileBlock = 100;
+  pCfg->maxRowsPerFileBlock = 4096;
+  pCfg->precision = TSDB_TIME_PRECISION_MILLI;
+  pCfg->compression = 2;
+  pCfg->update = 0;
+  pCfg->cacheLastRow = 0;
+}
+
+int tsdbTestCreateTable(STsdbRepo *pRepo, int32_t tid, uint64_t uid, int numOfCols) {
+  STSchemaBuilder builder;
+  STableCfg       cfg = {0};
+  char            name[32];
+
+  if (tdInitTSchemaBuilder(&builder, 1) < 0) return -1;
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_TIMESTAMP, PRIMARYKEY_TIMESTAMP_COL_INDEX, 8);
+  for (int c = 1; c < numOfCols; c++) {
+    tdAddColToSchema(&builder, TSDB_DATA_TYPE_INT, c, 4);
+  }
+
+  snprintf(name, sizeof(name), "t%d", tid);
+  cfg.type = TSDB_NORMAL_TABLE;
+  cfg.name = strdup(name);
+  cfg.tableId.tid = tid;
+  cfg.tableId.uid = uid;
+  cfg.sversion = 1;
+  cfg.schema = tdGetSchemaFromBuilder(&builder);
+  tdDestroyTSchemaBuilder(&builder);
+
+  return tsdbCreateTable(pRepo, &cfg);
+}
+
+int tsdbTestInsertRows(STsdbRepo *pRepo, int32_t tid, uint64_t uid, TSKEY start, TSKEY interval, int numOfRows) {
+  STable *  pTable = tsdbGetTableByUid(pRepo->tsdbMeta, uid);
+  STSchema *pSchema = (pTable == NULL) ? NULL : tsdbGetTableSchema(pTable);
+
+  if (pSchema == NULL) {
+    terrno = TSDB_CODE_TDB_INVALID_TABLE_ID;
+    return -1;
+  }
+
+  int         rowLen = TD_MEM_ROW_TYPE_SIZE + dataRowMaxBytesFromSchema(pSchema);
+  SSubmitMsg *pMsg = (SSubmitMsg *)malloc(sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + rowLen * TSDB_TEST_ROWS_PER_MSG);
+  if (pMsg == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  for (int first = 0; first < numOfRows; first += TSDB_TEST_ROWS_PER_MSG) {
+    SSubmitBlk *pBlk = (SSubmitBlk *)pMsg->blocks;
+    char *      row = pBlk->data;
+    int         nRows = MIN(TSDB_TEST_ROWS_PER_MSG, numOfRows - first);
+
+    memset(pMsg, 0, sizeof(SSubmitMsg) + sizeof(SSubmitBlk));
+    for (int i = first; i < first + nRows; i++) {
+      TSKEY key = start + i * interval;
+
+      memRowSetType(row, SMEM_ROW_DATA);
+      SDataRow dataRow = memRowDataBody(row);
+      tdInitDataRow(dataRow, pSchema);
+      tdAppendColVal(dataRow, &key, TSDB_DATA_TYPE_TIMESTAMP, schemaColAt(pSchema, 0)->offset);
+      for (int c = 1; c < schemaNCols(pSchema); c++) {
+        int32_t val = tsdbTestVal(key, c);
+        tdAppendColVal(dataRow, &val, TSDB_DATA_TYPE_INT, schemaColAt(pSchema, c)->offset);
+      }
+      row = POINTER_SHIFT(row, TD_MEM_ROW_TYPE_SIZE + dataRowLen(dataRow));
+    }
+
+    pBlk->uid = htobe64(uid);
+    pBlk->tid = htonl(tid);
+    pBlk->sversion = htonl(schemaVersion(pSchema));
+    pBlk->dataLen = htonl((int32_t)(row - pBlk->data));
+    pBlk->numOfRows = htons(nRows);
+    pMsg->numOfBlocks = htonl(1);
+    pMsg->length = htonl((int32_t)(row - (char *)pMsg));
+
+    if (tsdbInsertData(pRepo, pMsg, NULL, NULL) < 0) {
+      free(pMsg);
+      return -1;
+    }
+  }
+
+  free(pMsg);
+  return 0;
+}
+
+int tsdbTestBulkLoadRows(STsdbRepo *pRepo, uint64_t uid, TSKEY start, TSKEY interval, int numOfRows) {
+  STable *   pTable = tsdbGetTableByUid(pRepo->tsdbMeta, uid);
+  STSchema * pSchema = (pTable == NULL) ? NULL : tsdbGetTableSchema(pTable);
+  SDataCols *pCols = NULL;
+
+  if (pSchema == NULL) {
+    terrno = TSDB_CODE_TDB_INVALID_TABLE_ID;
+    return -1;
+  }
+
+  STsdbLoadH *pLoadh = tsdbOpenBulkLoad(pRepo);
+  if (pLoadh == NULL) return -1;
+
+  pCols = tdNewDataCols(0, TSDB_TEST_ROWS_PER_MSG);
+  if (pCols == NULL || tdInitDataCols(pCols, pSchema) < 0) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    goto _err;
+  }
+
+  for (int i = 0; i < numOfRows;) {
+    tdResetDataCols(pCols);
+    for (; i < numOfRows && pCols->numOfRows < TSDB_TEST_ROWS_PER_MSG; i++) {
+      TSKEY key = start + i * interval;
+
+      dataColAppendVal(pCols->cols, &key, pCols->numOfRows, pCols->maxPoints, 0);
+      for (int c = 1; c < schemaNCols(pSchema); c++) {
+        int32_t val = tsdbTestVal(key, c);
+        dataColAppendVal(pCols->cols + c, &val, pCols->numOfRows, pCols->maxPoints, 0);
+      }
+      pCols->numOfRows++;
+    }
+
+    if (tsdbBulkLoadData(pLoadh, uid, pCols) < 0) goto _err;
+  }
+
+  tdFreeDataCols(pCols);
+  return tsdbCloseBulkLoad(pLoadh, true);
+
+_err:
+  tdFreeDataCols(pCols);
+  tsdbCloseBulkLoad(pLoadh, false);
+  return -1;
+}
+
+int tsdbTestDeleteRows(STsdbRepo *pRepo, int32_t tid, TSKEY skey, TSKEY ekey) {
+  SControlDataInfo * pCtlInfo = (SControlDataInfo *)calloc(1, sizeof(SControlDataInfo) + sizeof(int32_t));
+  SShellSubmitRspMsg rsp = {0};
+  tsem_t             sem;
+
+  if (pCtlInfo == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    return -1;
+  }
+
+  tsem_init(&sem, 0, 0);
+  pCtlInfo->pSem = &sem;
+  pCtlInfo->pRsp = &rsp;
+  pCtlInfo->win.skey = skey;
+  pCtlInfo->win.ekey = ekey;
+  pCtlInfo->command = CMD_DELETE_DATA;
+  pCtlInfo->tnum = 1;
+  pCtlInfo->tids[0] = tid;
+
+  // the commit thread frees pCtlInfo
+  if (tsdbAsyncCommit(pRepo, pCtlInfo) < 0) {
+    tsem_destroy(&sem);
+    return -1;
+  }
+
+  tsem_wait(&sem);
+  tsem_destroy(&sem);
+  return (rsp.code == 0) ? (int)htonl(rsp.affectedRows) : -1;
+}
+
+int tsdbTestNumOfTombs(STsdbRepo *pRepo, uint64_t uid) {
+  STable *pTable = tsdbGetTableByUid(pRepo->tsdbMeta, uid);
+  return (pTable == NULL || pTable->aTomb == NULL) ? 0 : (int)taosArrayGetSize(pTable->aTomb);
+}
+
+void tsdbTestDueAutoCompact(STsdbRepo *pRepo) { pRepo->compactStat.lastCheck = 0; }
+
+typedef struct {
+  STsdbRepo *     pRepo;
+  SMemSnapshot    snapshot;
+  STableDataIter *pIter;
+} STsdbTestMemIter;
+
+void *tsdbTestOpenMemIter(STsdbRepo *pRepo, uint64_t uid, const TSKEY *pKey, int32_t order) {
+  STable *pTable = tsdbGetTableByUid(pRepo->tsdbMeta, uid);
+  if (pTable == NULL) {
+    terrno = TSDB_CODE_TDB_INVALID_TABLE_ID;
+    return NULL;
+  }
+
+  STsdbTestMemIter *pMemIter = (STsdbTestMemIter *)calloc(1, sizeof(*pMemIter));
+  SArray *          pATable = taosArrayInit(1, sizeof(STable *));
+  if (pMemIter == NULL || pATable == NULL) {
+    terrno = TSDB_CODE_TDB_OUT_OF_MEMORY;
+    free(pMemIter);
+    taosArrayDestroy(&pATable);
+    return NULL;
+  }
+
+  // take the table data the way a query does
+  taosArrayPush(pATable, &pTable);
+  pMemIter->pRepo = pRepo;
+  if (tsdbTakeMemSnapshot(pRepo, &(pMemIter->snapshot), pATable) < 0) {
+    taosArrayDestroy(&pATable);
+    free(pMemIter);
+    return NULL;
+  }
+  taosArrayDestroy(&pATable);
+
+  SMemTable * pMem = pMemIter->snapshot.mem;
+  STableData *pTableData = (pMem == NULL) ? NULL : pMem->tData[TABLE_TID(pTable)];
+  if (pTableData != NULL) {
+    pMemIter->pIter = (pKey == NULL) ? tsdbCreateTableDataIter(pTableData, order)
+                                     : tsdbCreateTableDataIterFromKey(pTableData, *pKey, order);
+    if (pMemIter->pIter == NULL) {
+      tsdbTestCloseMemIter(pMemIter);
+      return NULL;
+    }
+  }
+
+  return pMemIter;
+}
+
+int tsdbTestReadMemIter(void *iter, TSKEY *keys, int maxKeys) {
+  STsdbTestMemIter *pMemIter = (STsdbTestMemIter *)iter;
+  int               nKeys = 0;
+
+  if (pMemIter->pIter == NULL) return 0;
+
+  while (nKeys < maxKeys && tsdbTableDataIterNext(pMemIter->pIter)) {
+    keys[nKeys++] = memRowKey(tsdbTableDataIterGet(pMemIter->pIter));
+  }
+
+  return nKeys;
+}
+
+void tsdbTestCloseMemIter(void *iter) {
+  STsdbTestMemIter *pMemIter = (STsdbTestMemIter *)iter;
+
+  if (pMemIter == NULL) return;
+  tsdbDestroyTableDataIter(pMemIter->pIter);
+  tsdbUnTakeMemSnapShot(pMemIter->pRepo, &(pMemIter->snapshot));
+  free(pMemIter);
+}
+
+int tsdbTestMemRowsIn(STsdbRepo *pRepo, uint64_t uid) {
+  STable *pTable = tsdbGetTableByUid(pRepo->tsdbMeta, uid);
+  if (pTable == NULL || pRepo->mem == NULL || TABLE_TID(pTable) >= pRepo->mem->maxTables) return -1;
+
+  STableData *pTableData = pRepo->mem->tData[TABLE_TID(pTable)];
+  if (pTableData == NULL || pTableData->uid != uid) return -1;
+
+  return pTableData->inSkipList ? TSDB_TEST_IN_SKIPLIST : TSDB_TEST_IN_CHUNKS;
+}
+
+static TsdbQueryHandleT tsdbTestOpenQuery(STsdbRepo *pRepo, uint64_t uid, TSKEY skey, TSKEY ekey, bool lastRow,
+                                          STableGroupInfo *pGroupInfo, SMemRef *pMemRef) {
+  SColumnInfo    cols[2];
+  STsdbQueryCond cond = {0};
+
+  if (tsdbGetOneTableGroup(pRepo, uid, skey, pGroupInfo) < 0) return NULL;
+
+  memset(cols, 0, sizeof(cols));
+  cols[0].colId = PRIMARYKEY_TIMESTAMP_COL_INDEX;
+  cols[0].type = TSDB_DATA_TYPE_TIMESTAMP;
+  cols[0].bytes = sizeof(TSKEY);
+  cols[1].colId = 1;
+  cols[1].type = TSDB_DATA_TYPE_INT;
+  cols[1].bytes = sizeof(int32_t);
+
+  cond.twindow.skey = skey;
+  cond.twindow.ekey = ekey;
+  cond.order = TSDB_ORDER_ASC;
+  cond.numOfCols = 2;
+  cond.colList = cols;
+  cond.type = BLOCK_LOAD_OFFSET_SEQ_ORDER;
+
+  TsdbQueryHandleT pQueryHandle = lastRow ? tsdbQueryLastRow(pRepo, &cond, pGroupInfo, 0, pMemRef)
+                                          : tsdbQueryTables(pRepo, &cond, pGroupInfo, 0, pMemRef);
+  if (pQueryHandle == NULL) tsdbDestroyTableGroup(pGroupInfo);
+  return pQueryHandle;
+}
+
+static int64_t tsdbTestQuery(STsdbRepo *pRepo, uint64_t uid, TSKEY skey, TSKEY ekey, bool useStatis, int64_t *pSum) {
+  STableGroupInfo groupInfo = {0};
+  SMemRef         memRef = {0};
+  int64_t         rows = 0;
+
+  TsdbQueryHandleT pQueryHandle = tsdbTestOpenQuery(pRepo, uid, skey, ekey, false, &groupInfo, &memRef);
+  if (pQueryHandle == NULL) return -1;
+
+  *pSum = 0;
+  while (tsdbNextDataBlock(pQueryHandle)) {
+    SDataBlockInfo blockInfo;
+    SDataStatis *  pStatis = NULL;
+
+    tsdbRetrieveDataBlockInfo(pQueryHandle, &blockInfo);
+    if (useStatis && tsdbRetrieveDataBlockStatisInfo(pQueryHandle, &pStatis) != TSDB_CODE_SUCCESS) {
+      rows = -1;
+      break;
+    }
+
+    if (pStatis != NULL) {
+      *pSum += pStatis[1].sum;
+    } else {
+      SArray *pBlock = tsdbRetrieveDataBlock(pQueryHandle, NULL);
+      if (pBlock == NULL) {
+        rows = -1;
+        break;
+      }
+
+      SColumnInfoData *pColData = (SColumnInfoData *)taosArrayGet(pBlock, 1);
+      for (int i = 0; i < blockInfo.rows; i++) {
+        *pSum += ((int32_t *)pColData->pData)[i];
+      }
+    }
+    rows += blockInfo.rows;
+  }
+
+  tsdbCleanupQueryHandle(pQueryHandle);
+  tsdbDestroyTableGroup(&groupInfo);
+  return rows;
+}
+
+int64_t tsdbTestQueryRows(STsdbRepo *pRepo, uint64_t uid, TSKEY skey, TSKEY ekey, int64_t *pSum) {
+  return tsdbTestQuery(pRepo, uid, skey, ekey, false, pSum);
+}
+
+int64_t tsdbTestQueryRowsByStatis(STsdbRepo *pRepo, uint64_t uid, TSKEY skey, TSKEY ekey, int64_t *pSum) {
+  return tsdbTestQuery(pRepo, uid, skey, ekey, true, pSum);
+}
+
+int tsdbTestQueryLastRow(STsdbRepo *pRepo, uint64_t uid, TSKEY *pKey) {
+  STableGroupInfo groupInfo = {0};
+  SMemRef         memRef = {0};
+  int             code = -1;
+
+  TsdbQueryHandleT pQueryHandle = tsdbTestOpenQuery(pRepo, uid, 0, INT64_MAX, true, &groupInfo, &memRef);
+  if (pQueryHandle == NULL) return -1;
+
+  if (tsdbNextDataBlock(pQueryHandle)) {
+    SArray *pBlock = tsdbRetrieveDataBlock(pQueryHandle, NULL);
+    if (pBlock != NULL) {
+      *pKey = ((TSKEY *)((SColumnInfoData *)taosArrayGet(pBlock, 0))->pData)[0];
+      code = 0;
+    }
+  }
+
+  tsdbCleanupQueryHandle(pQueryHandle);
+  tsdbDestroyTableGroup(&groupInfo);
+  return code;
+}
+
+typedef struct {
+  int16_t     colId;
+  int8_t      type;
+  int16_t     bytes;
+  const char *name;
+} STsdbTestTag;
+
+static const STsdbTestTag tsdbTestTags[] = {
+    {TSDB_TEST_TAG_T1, TSDB_DATA_TYPE_INT, sizeof(int32_t), "t1"},
+    {TSDB_TEST_TAG_T2, TSDB_DATA_TYPE_INT, sizeof(int32_t), "t2"},
+    {TSDB_TEST_TAG_T3, TSDB_DATA_TYPE_BINARY, 16 + VARSTR_HEADER_SIZE, "t3"},
+    {TSDB_TEST_TAG_T4, TSDB_DATA_TYPE_NCHAR, 8 * TSDB_NCHAR_SIZE + VARSTR_HEADER_SIZE, "t4"},
+    {TSDB_TEST_TAG_T5, TSDB_DATA_TYPE_INT, sizeof(int32_t), "t5"},
+};
+
+static const STsdbTestTag *tsdbTestGetTag(int16_t colId) {
+  for (size_t i = 0; i < tListLen(tsdbTestTags); i++) {
+    if (tsdbTestTags[i].colId == colId) return &tsdbTestTags[i];
+  }
+  return NULL;
+}
+
+static STable *tsdbTestGetSuper(STsdbRepo *pRepo) { return tsdbGetTableByUid(pRepo->tsdbMeta, TSDB_TEST_SUID); }
+
+// Encode val of the type to buf, return the length of the value
+static int tsdbTestEncodeTag(int8_t type, const char *val, char *buf, int size) {
+  int32_t len = 0;
+
+  switch (type) {
+    case TSDB_DATA_TYPE_INT:
+      *(int32_t *)buf = atoi(val);
+      return sizeof(int32_t);
+    case TSDB_DATA_TYPE_BINARY:
+      len = (int32_t)strlen(val);
+      if (len + VARSTR_HEADER_SIZE > size) return -1;
+      STR_WITH_SIZE_TO_VARSTR(buf, val, len);
+      return varDataTLen(buf);
+    case TSDB_DATA_TYPE_NCHAR:
+      if (!taosMbsToUcs4((char *)val, strlen(val), varDataVal(buf), size - VARSTR_HEADER_SIZE, &len)) return -1;
+      varDataSetLen(buf, len);
+      return varDataTLen(buf);
+    default:
+      return -1;
+  }
+}
+
+int tsdbTestCreateChildTable(STsdbRepo *pRepo, int32_t tid, uint64_t uid, const char *t1, const char *t2,
+                             const char *t3, const char *t4) {
+  const char *     vals[] = {t1, t2, t3, t4};
+  STSchemaBuilder  builder;
+  SKVRowBuilder    kvBuilder;
+  char             buf[TSDB_MAX_TAGS_LEN];
+  char             name[32];
+  STableCfg *      pCfg = (STableCfg *)calloc(1, sizeof(STableCfg));
+  int              code = -1;
+
+  if (pCfg == NULL) return -1;
+
+  snprintf(name, sizeof(name), "c%d", tid);
+  pCfg->type = TSDB_CHILD_TABLE;
+  pCfg->name = strdup(name);
+  pCfg->tableId.tid = tid;
+  pCfg->tableId.uid = uid;
+  pCfg->sversion = 1;
+  pCfg->sname = strdup("st");
+  pCfg->superUid = TSDB_TEST_SUID;
+
+  tdInitTSchemaBuilder(&builder, 1);
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_TIMESTAMP, PRIMARYKEY_TIMESTAMP_COL_INDEX, 8);
+  tdAddColToSchema(&builder, TSDB_DATA_TYPE_INT, 1, 4);
+  pCfg->schema = tdGetSchemaFromBuilder(&builder);
+
+  tdResetTSchemaBuilder(&builder, 1);
+  for (int i = 0; i < tListLen(vals); i++) {
+    tdAddColToSchema(&builder, tsdbTestTags[i].type, tsdbTestTags[i].colId, tsdbTestTags[i].bytes);
+  }
+  pCfg->tagSchema = tdGetSchemaFromBuilder(&builder);
+  tdDestroyTSchemaBuilder(&builder);
+
+  if (tdInitKVRowBuilder(&kvBuilder) < 0) goto _exit;
+  for (int i = 0; i < tListLen(vals); i++) {
+    if (vals[i] == NULL) continue;
+    if (tsdbTestEncodeTag(tsdbTestTags[i].type, vals[i], buf, tsdbTestTags[i].bytes) < 0) {
+      tdDestroyKVRowBuilder(&kvBuilder);
+      goto _exit;
+    }
+    tdAddColToKVRow(&kvBuilder, tsdbTestTags[i].colId, tsdbTestTags[i].type, buf, false);
+  }
+  pCfg->tagValues = tdGetKVRowFromBuilder(&kvBuilder);
+  tdDestroyKVRowBuilder(&kvBuilder);
+
+  code = tsdbCreateTable(pRepo, pCfg);
+
+_exit:
+  tsdbClearTableCfg(pCfg);
+  return code;
+}
+
+// Set the tag colId of the table to val by pSchema, which is newer than the one of the super table if it changes
+static int tsdbTestUpdateTag(STsdbRepo *pRepo, int32_t tid, uint64_t uid, STSchema *pSchema, int16_t colId,
+                             const char *val) {
+  STColumn *pCol = tdGetColOfID(pSchema, colId);
+  char      buf[TSDB_MAX_TAGS_LEN];
+  int       valLen = 0;
+  int32_t   schemaLen = schemaNCols(pSchema) * sizeof(STColumn);
+
+  if (pCol == NULL || (valLen = tsdbTestEncodeTag(colType(pCol), val, buf, colBytes(pCol))) < 0) return -1;
+
+  SUpdateTableTagValMsg *pMsg = (SUpdateTableTagValMsg *)calloc(1, sizeof(*pMsg) + schemaLen + valLen);
+  if (pMsg == NULL) return -1;
+
+  pMsg->uid = htobe64(uid);
+  pMsg->tid = htonl(tid);
+  pMsg->tversion = htons(schemaVersion(pSchema));
+  pMsg->colId = htons(colId);
+  pMsg->type = colType(pCol);
+  pMsg->bytes = htons(colBytes(pCol));
+  pMsg->tagValLen = htonl(valLen);
+  pMsg->numOfTags = htons(schemaNCols(pSchema));
+  pMsg->schemaLen = htonl(schemaLen);
+  for (int i = 0; i < schemaNCols(pSchema); i++) {
+    STColumn *pTCol = (STColumn *)pMsg->data + i;
+    *pTCol = *schemaColAt(pSchema, i);
+    pTCol->colId = htons(pTCol->colId);
+    pTCol->bytes = htons(pTCol->bytes);
+  }
+  memcpy(pMsg->data + schemaLen, buf, valLen);
+
+  int code = tsdbUpdateTableTagValue(pRepo, pMsg);
+  free(pMsg);
+  return code;
+}
+
+int tsdbTestSetTag(STsdbRepo *pRepo, int32_t tid, uint64_t uid, int16_t colId, const char *val) {
+  STable *pSuper = tsdbTestGetSuper(pRepo);
+
+  if (pSuper == NULL) return -1;
+  return tsdbTestUpdateTag(pRepo, tid, uid, pSuper->tagSchema, colId, val);
+}
+
+int tsdbTestAlterTag(STsdbRepo *pRepo, int32_t tid, uint64_t uid, int16_t colId, int16_t bytes, const char *val) {
+  STable *            pSuper = tsdbTestGetSuper(pRepo);
+  const STsdbTestTag *pTag = tsdbTestGetTag(colId);
+  STSchemaBuilder     builder;
+  bool                found = false;
+
+  if (pSuper == NULL || pTag == NULL) return -1;
+
+  tdInitTSchemaBuilder(&builder, schemaVersion(pSuper->tagSchema) + 1);
+  for (int i = 0; i < schemaNCols(pSuper->tagSchema); i++) {
+    STColumn *pCol = schemaColAt(pSuper->tagSchema, i);
+    found = found || (colColId(pCol) == colId);
+    tdAddColToSchema(&builder, colType(pCol), colColId(pCol), (colColId(pCol) == colId) ? bytes : colBytes(pCol));
+  }
+  if (!found) tdAddColToSchema(&builder, pTag->type, colId, bytes);
+  STSchema *pSchema = tdGetSchemaFromBuilder(&builder);
+  tdDestroyTSchemaBuilder(&builder);
+  if (pSchema == NULL) return -1;
+
+  int code = tsdbTestUpdateTag(pRepo, tid, uid, pSchema, colId, val);
+  tdFreeSchema(pSchema);
+  return code;
+}
+
+bool tsdbTestTagStoreValid(STsdbRepo *pRepo) {
+  STable *pSuper = tsdbTestGetSuper(pRepo);
+  return pSuper != NULL && pSuper->pTagStore != NULL && pSuper->pTagStore->pSnap != NULL;
+}
+
+bool tsdbTestHasTagIndex(STsdbRepo *pRepo, int16_t colId) {
+  STable *pSuper = tsdbTestGetSuper(pRepo);
+  return pSuper != NULL && tsdbHasTagIndex(pSuper, colId);
+}
+
+static tExprNode *tsdbTestTagNode(uint8_t optr, tExprNode *pLeft, tExprNode *pRight) {
+  tExprNode *pNode = (tExprNode *)calloc(1, sizeof(tExprNode));
+
+  pNode->nodeType = TSQL_NODE_EXPR;
+  pNode->_node.optr = optr;
+  pNode->_node.pLeft = pLeft;
+  pNode->_node.pRight = pRight;
+  return pNode;
+}
+
+static tExprNode *tsdbTestTagColNode(const STsdbTestTag *pTag) {
+  tExprNode *pNode = (tExprNode *)calloc(1, sizeof(tExprNode));
+
+  pNode->nodeType = TSQL_NODE_COL;
+  pNode->pSchema = (SSchema *)calloc(1, sizeof(SSchema));
+  pNode->pSchema->colId = pTag->colId;
+  pNode->pSchema->type = pTag->type;
+  pNode->pSchema->bytes = pTag->bytes;
+  tstrncpy(pNode->pSchema->name, pTag->name, sizeof(pNode->pSchema->name));
+  return pNode;
+}
+
+static tExprNode *tsdbTestTagValNode(const char *data, size_t len, uint32_t type) {
+  tExprNode *pNode = (tExprNode *)calloc(1, sizeof(tExprNode));
+
+  pNode->nodeType = TSQL_NODE_VALUE;
+  pNode->pVal = (tVariant *)calloc(1, sizeof(tVariant));
+  tVariantCreateFromBinary(pNode->pVal, data, len, type);
+  return pNode;
+}
+
+void *tsdbTestTagCond(uint8_t optr, int16_t colId, const char *val) {
+  const STsdbTestTag *pTag = tsdbTestGetTag(colId);
+  tExprNode *         pRight = NULL;
+
+  if (IS_VAR_DATA_TYPE(pTag->type)) {
+    pRight = tsdbTestTagValNode(val, strlen(val), TSDB_DATA_TYPE_BINARY);
+  } else {
+    int64_t v = atoll(val);
+    pRight = tsdbTestTagValNode((char *)&v, sizeof(v), TSDB_DATA_TYPE_BIGINT);
+  }
+
+  return tsdbTestTagNode(optr, tsdbTestTagColNode(pTag), pRight);
+}
+
+// The values are serialized as the client does for in
+void *tsdbTestTagIn(int16_t colId, const char **vals, int numOfVals) {
+  const STsdbTestTag *pTag = tsdbTestGetTag(colId);
+  SBufferWriter       bw = tbufInitWriter(NULL, false);
+  char                buf[TSDB_MAX_TAGS_LEN];
+
+  tbufWriteUint32(&bw, pTag->type);
+  tbufWriteInt32(&bw, numOfVals);
+  for (int i = 0; i < numOfVals; i++) {
+    if (pTag->type == TSDB_DATA_TYPE_NCHAR) {
+      tsdbTestEncodeTag(TSDB_DATA_TYPE_NCHAR, vals[i], buf, sizeof(buf));
+      tbufWriteBinary(&bw, varDataVal(buf), varDataLen(buf));
+    } else if (pTag->type == TSDB_DATA_TYPE_BINARY) {
+      tbufWriteBinary(&bw, vals[i], strlen(vals[i]));
+    } else {
+      tbufWriteInt64(&bw, atoll(vals[i]));
+    }
+  }
+
+  tExprNode *pRight = tsdbTestTagValNode(tbufGetData(&bw, false), tbufTell(&bw), TSDB_DATA_TYPE_BINARY);
+  tbufCloseWriter(&bw);
+
+  return tsdbTestTagNode(TSDB_RELATION_IN, tsdbTestTagColNode(pTag), pRight);
+}
+
+void *tsdbTestTagAnd(void *left, void *right) { return tsdbTestTagNode(TSDB_RELATION_AND, left, right); }
+
+void *tsdbTestTagOr(void *left, void *right) { return tsdbTestTagNode(TSDB_RELATION_OR, left, right); }
+
+void tsdbTestFreeTagCond(void *cond) { tExprTreeDestroy((tExprNode *)cond, NULL); }
+
+static int tsdbTestListTids(SArray *aKeyInfo, int32_t *tids, int maxTids, int numOfTids) {
+  for (size_t i = 0; i < taosArrayGetSize(aKeyInfo) && numOfTids < maxTids; i++) {
+    tids[numOfTids++] = TABLE_TID((STable *)((STableKeyInfo *)taosArrayGet(aKeyInfo, i))->pTable);
+  }
+  return numOfTids;
+}
+
+// By the tables one by one, as tsdbQuerySTableByTagCond() does when the super table has no tag store
+static int tsdbTestQueryTagsByTable(STsdbRepo *pRepo, STable *pSuper, const char *pCond, size_t len, int32_t *tids,
+                                    int maxTids) {
+  STagStore *     pStore = pSuper->pTagStore;
+  STableGroupInfo groupInfo = {0};
+  int             numOfTids = 0;
+
+  pSuper->pTagStore = NULL;
+  int32_t code = tsdbQuerySTableByTagCond(pRepo, TSDB_TEST_SUID, 0, pCond, len, &groupInfo, NULL, 0);
+  pSuper->pTagStore = pStore;
+  if (code != TSDB_CODE_SUCCESS) return -1;
+
+  for (size_t g = 0; g < taosArrayGetSize(groupInfo.pGroupList); g++) {
+    numOfTids = tsdbTestListTids(taosArrayGetP(groupInfo.pGroupList, g), tids, maxTids, numOfTids);
+  }
+
+  tsdbDestroyTableGroup(&groupInfo);
+  return numOfTids;
+}
+
+int tsdbTestQueryTags(STsdbRepo *pRepo, void *cond, int by, int32_t *tids, int maxTids) {
+  STable *      pSuper = tsdbTestGetSuper(pRepo);
+  SBufferWriter bw = tbufInitWriter(NULL, false);
+  tExprNode *   expr = NULL;
+  int           numOfTids = -1;
+
+  if (pSuper == NULL) return -1;
+
+  // the condition is taken as a query carries it
+  exprTreeToBinary(&bw, (tExprNode *)cond);
+  if (by == TSDB_TEST_BY_TABLE) {
+    numOfTids = tsdbTestQueryTagsByTable(pRepo, pSuper, tbufGetData(&bw, false), tbufTell(&bw), tids, maxTids);
+    tbufCloseWriter(&bw);
+    return numOfTids;
+  }
+
+  TRY(TSDB_MAX_TAG_CONDITIONS) {
+    expr = exprTreeFromBinary(tbufGetData(&bw, false), tbufTell(&bw));
+    CLEANUP_EXECUTE();
+  } CATCH(code) {
+    CLEANUP_EXECUTE();
+    terrno = code;
+  } END_TRY
+  tbufCloseWriter(&bw);
+  if (expr == NULL) return -1;
+
+  SFilterInfo *info = (SFilterInfo *)calloc(1, sizeof(SFilterInfo));
+  info->pTable = pSuper;
+  int32_t code = filterInitFromTree(expr, (void **)&info, 0);
+  tExprTreeDestroy(expr, NULL);
+  if (code != TSDB_CODE_SUCCESS || info == NULL) {
+    filterFreeInfo(info);
+    return -1;
+  }
+
+  int32_t maxTagIndexes = tsTsdbMaxTagIndexes;
+  SArray *res = taosArrayInit(8, sizeof(STableKeyInfo));
+
+  if (by == TSDB_TEST_BY_STORE) tsTsdbMaxTagIndexes = 0;
+  tsdbRLockRepoMeta(pRepo);
+  if (tsdbQueryTagStore(pSuper, info, res) == 0) numOfTids = tsdbTestListTids(res, tids, maxTids, 0);
+  tsdbUnlockRepoMeta(pRepo);
+  tsTsdbMaxTagIndexes = maxTagIndexes;
+
+  taosArrayDestroy(&res);
+  filterFreeInfo(info);
+  return numOfTids;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TD_TSDB_TEST_UTIL_H_
+#define _TD_TSDB_TEST_UTIL_H_
+
+#include "tsdb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The tests run on a repo with normal tables of the columns (ts, v0 int, v1 int ...), the value of vi of the row of key
+// is tsdbTestVal(key, i). The helpers here need the internal tsdb headers, which do not build as C++.
+
+#define TSDB_TEST_VNODE 1
+
+static inline int32_t tsdbTestVal(TSKEY key, int col) { return (int32_t)((key / 1000 + col * 7) % 1000); }
+
+int  tsdbTestInit(const char *path);
+void tsdbTestCleanup();
+void tsdbTestSetCfg(STsdbCfg *pCfg);
+int  tsdbTestCreateTable(STsdbRepo *pRepo, int32_t tid, uint64_t uid, int numOfCols);
+int  tsdbTestInsertRows(STsdbRepo *pRepo, int32_t tid, uint64_t uid, TSKEY start, TSKEY interval, int numOfRows);
+int  tsdbTestBulkLoadRows(STsdbRepo *pRepo, uint64_t uid, TSKEY start, TSKEY interval, int numOfRows);
+// Delete the rows of [skey, ekey] of the table, return the number of rows deleted, -1 if failed
+int  tsdbTestDeleteRows(STsdbRepo *pRepo, int32_t tid, TSKEY skey, TSKEY ekey);
+int  tsdbTestNumOfTombs(STsdbRepo *pRepo, uint64_t uid);
+// Let the next commit check the auto compaction, whatever the time of the last check
+void tsdbTestDueAutoCompact(STsdbRepo *pRepo);
+
+// A reader of the rows of the table in the memtable, over a memtable snapshot as a query takes. The iterator starts
+// with the key given the way tsdbCreateTableDataIterFromKey() does, or with the first row of the order if pKey is NULL.
+void *tsdbTestOpenMemIter(STsdbRepo *pRepo, uint64_t uid, const TSKEY *pKey, int32_t order);
+// Read the keys of the next rows, at most maxKeys, return the number of them
+int   tsdbTestReadMemIter(void *iter, TSKEY *keys, int maxKeys);
+void  tsdbTestCloseMemIter(void *iter);
+
+#define TSDB_TEST_IN_CHUNKS 0    // the rows of the table are appended to the chunks
+#define TSDB_TEST_IN_SKIPLIST 1  // moved into the skip list
+// Return where the memtable keeps the rows of the table, -1 if it has none of them
+int   tsdbTestMemRowsIn(STsdbRepo *pRepo, uint64_t uid);
+// Query the rows of [skey, ekey] of the table, return the number of rows and the sum of v1 in pSum, -1 if failed
+int64_t tsdbTestQueryRows(STsdbRepo *pRepo, uint64_t uid, TSKEY skey, TSKEY ekey, int64_t *pSum);
+// The same as tsdbTestQueryRows(), but the sum of a block is taken from its statistics if it has any
+int64_t tsdbTestQueryRowsByStatis(STsdbRepo *pRepo, uint64_t uid, TSKEY skey, TSKEY ekey, int64_t *pSum);
+int  tsdbTestQueryLastRow(STsdbRepo *pRepo, uint64_t uid, TSKEY *pKey);
+
+// The child tables of the tag tests are of the super table TSDB_TEST_SUID of the tags (t1 int, t2 int, t3 binary(16),
+// t4 nchar(8)), the skip list of the tables is on t1. A tag value is given as a string, NULL for a tag not set.
+#define TSDB_TEST_SUID 20000
+#define TSDB_TEST_TAG_T1 2
+#define TSDB_TEST_TAG_T2 3
+#define TSDB_TEST_TAG_T3 4
+#define TSDB_TEST_TAG_T4 5
+#define TSDB_TEST_TAG_T5 6  // an int tag added by tsdbTestAlterTag()
+
+#define TSDB_TEST_BY_TABLE 0  // the tables filtered one by one, as without the tag store
+#define TSDB_TEST_BY_STORE 1  // by the tag store, the tag indexes disabled
+#define TSDB_TEST_BY_INDEX 2  // by the tag indexes, or by the tag store if they do not serve the condition
+
+int  tsdbTestCreateChildTable(STsdbRepo *pRepo, int32_t tid, uint64_t uid, const char *t1, const char *t2,
+                              const char *t3, const char *t4);
+int  tsdbTestSetTag(STsdbRepo *pRepo, int32_t tid, uint64_t uid, int16_t colId, const char *val);
+// Widen the tag colId to bytes, or add it if missing, by a new version of the tag schema, then set it to val
+int  tsdbTestAlterTag(STsdbRepo *pRepo, int32_t tid, uint64_t uid, int16_t colId, int16_t bytes, const char *val);
+bool tsdbTestTagStoreValid(STsdbRepo *pRepo);
+bool tsdbTestHasTagIndex(STsdbRepo *pRepo, int16_t colId);
+
+// A tag condition is built by the width of the tags above and freed by tsdbTestFreeTagCond()
+void *tsdbTestTagCond(uint8_t optr, int16_t colId, const char *val);
+void *tsdbTestTagIn(int16_t colId, const char **vals, int numOfVals);
+void *tsdbTestTagAnd(void *left, void *right);
+void *tsdbTestTagOr(void *left, void *right);
+void  tsdbTestFreeTagCond(void *cond);
+// List the tids of the tables qualified in the order returned, return the number of them, -1 if the tables would be
+// filtered one by one instead of by the way asked
+int   tsdbTestQueryTags(STsdbRepo *pRepo, void *cond, int by, int32_t *tids, int maxTids);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TD_TSDB_TEST_UTIL_H_ */
@@ -1,9 +1,21 @@
+#include <dirent.h>
 #include <gtest/gtest.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "tsdb.h"
-#include "tsdbMain.h"
+#include "taoserror.h"
+#include "tglobal.h"
+#include "tsdbTestUtil.h"
 
 static double getCurTime() {
   struct timeval tv;
@@ -11,153 +23,864 @@ static double getCurTime() {
   return tv.tv_sec + tv.tv_usec * 1E-6;
 }
 
-typedef struct {
-  STsdbRepo *pRepo;
-  bool       isAscend;
-  int        tid;
-  uint64_t   uid;
-  int        sversion;
-  TSKEY      startTime;
-  TSKEY      interval;
-  int        totalRows;
-  int        rowsPerSubmit;
-  STSchema * pSchema;
-} SInsertInfo;
-
-static int insertData(SInsertInfo *pInfo) {
-  SSubmitMsg *pMsg =
-      (SSubmitMsg *)malloc(sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + dataRowMaxBytesFromSchema(pInfo->pSchema) * pInfo->rowsPerSubmit);
-  if (pMsg == NULL) return -1;
-  TSKEY start_time = pInfo->startTime;
-
-  // Loop to write data
+class TsdbTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(tsdbTestInit("/tmp/tsdbTests"), 0);
+    tsdbTestSetCfg(&cfg);
+    tsdbCreateRepo(cfg.tsdbId);
+    repo = tsdbOpenRepo(&cfg, &appH);
+    ASSERT_NE(repo, nullptr);
+  }
+
+  void TearDown() override {
+    if (repo != NULL) tsdbCloseRepo(repo, 0);
+    tsdbTestCleanup();
+  }
+
+  STsdbCfg   cfg;
+  STsdbAppH  appH = {0};
+  STsdbRepo *repo = NULL;
+};
+
+TEST_F(TsdbTest, testInsertSpeed) {
+  int   totalRows = 1000000;
+  TSKEY start = 1590000000000;
+
+  ASSERT_EQ(tsdbTestCreateTable(repo, 1, 5849583783847394, 5), 0);
+
   double stime = getCurTime();
+  ASSERT_EQ(tsdbTestInsertRows(repo, 1, 5849583783847394, start, 10, totalRows), 0) << tstrerror(terrno);
+  double etime = getCurTime();
 
-  for (int k = 0; k < pInfo->totalRows/pInfo->rowsPerSubmit; k++) {
-    memset((void *)pMsg, 0, sizeof(SSubmitMsg));
-    SSubmitBlk *pBlock = (SSubmitBlk *)pMsg->blocks;
-    pBlock->uid = pInfo->uid;
-    pBlock->tid = pInfo->tid;
-    pBlock->sversion = pInfo->sversion;
-    pBlock->dataLen = 0;
-    pBlock->schemaLen = 0;
-    pBlock->numOfRows = 0;
-    for (int i = 0; i < pInfo->rowsPerSubmit; i++) {
-      // start_time += 1000;
-      if (pInfo->isAscend) {
-        start_time += pInfo->interval;
-      } else {
-        start_time -= pInfo->interval;
-      }
-      SDataRow row = (SDataRow)(pBlock->data + pBlock->dataLen);
-      tdInitDataRow(row, pInfo->pSchema);
-
-      for (int j = 0; j < schemaNCols(pInfo->pSchema); j++) {
-        STColumn *pTCol = schemaColAt(pInfo->pSchema, j);
-        if (j == 0) {  // Just for timestamp
-          tdAppendColVal(row, (void *)(&start_time), pTCol->type, pTCol->offset);
-        } else {  // For int
-          int val = 10;
-          tdAppendColVal(row, (void *)(&val), pTCol->type, pTCol->offset);
-        }
-      }
-      pBlock->dataLen += dataRowLen(row);
-      pBlock->numOfRows++;
-    }
-    pMsg->length = sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + pBlock->dataLen;
-    pMsg->numOfBlocks = 1;
+  printf("Spent %f seconds to write %d records\n", etime - stime, totalRows);
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+}
+
+TEST_F(TsdbTest, bulkLoad) {
+  uint64_t uid = 10000;
+  TSKEY    start = 1590000000000;
+  TSKEY    interval = 60000;  // the rows span 4 file sets
+  int      numOfRows = 50000;
+  int64_t  sum = 0;
+  int64_t  expected = 0;
+
+  for (int i = 0; i < numOfRows; i++) expected += tsdbTestVal(start + i * interval, 1);
+
+  ASSERT_EQ(tsdbTestCreateTable(repo, 1, uid, 3), 0);
+
+  // no meta file to refer the tables from the loaded files
+  ASSERT_LT(tsdbTestBulkLoadRows(repo, uid, start, interval, numOfRows), 0);
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+
+  ASSERT_EQ(tsdbTestBulkLoadRows(repo, uid, start, interval, numOfRows), 0) << tstrerror(terrno);
+  ASSERT_EQ(tsdbTestQueryRows(repo, uid, start, start + numOfRows * interval, &sum), numOfRows);
+  ASSERT_EQ(sum, expected);
+
+  // the file sets exist now
+  ASSERT_LT(tsdbTestBulkLoadRows(repo, uid, start, interval, 10), 0);
+
+  // the rows inserted after the loaded ones are merged with them
+  ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, start + numOfRows * interval, interval, 1000), 0);
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  for (int i = numOfRows; i < numOfRows + 1000; i++) expected += tsdbTestVal(start + i * interval, 1);
+
+  tsdbCloseRepo(repo, 0);
+  repo = tsdbOpenRepo(&cfg, &appH);
+  ASSERT_NE(repo, nullptr);
+  ASSERT_EQ(tsdbTestQueryRows(repo, uid, start, start + (numOfRows + 1000) * interval, &sum), numOfRows + 1000);
+  ASSERT_EQ(sum, expected);
+}
+
+class TsdbDeleteTest : public TsdbTest {
+ protected:
+  void SetUp() override {
+    TsdbTest::SetUp();
+    ASSERT_EQ(tsdbTestCreateTable(repo, 1, uid, 3), 0);
+    ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, start, interval, numOfRows), 0) << tstrerror(terrno);
+    ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  }
+
+  TSKEY keyOf(int row) { return start + row * interval; }
+
+  // sum of v1 of the rows [from, to)
+  int64_t sumOf(int from, int to) {
+    int64_t sum = 0;
+    for (int i = from; i < to; i++) sum += tsdbTestVal(keyOf(i), 1);
+    return sum;
+  }
+
+  // return the rows masked
+  int deleteRows(int from, int to) { return tsdbTestDeleteRows(repo, 1, keyOf(from), keyOf(to - 1)); }
+
+  void checkRows(int64_t rows, int64_t sum) {
+    int64_t qsum = 0;
+    ASSERT_EQ(tsdbTestQueryRows(repo, uid, keyOf(0), keyOf(numOfRows * 2), &qsum), rows);
+    ASSERT_EQ(qsum, sum);
+    ASSERT_EQ(tsdbTestQueryRowsByStatis(repo, uid, keyOf(0), keyOf(numOfRows * 2), &qsum), rows);
+    ASSERT_EQ(qsum, sum);
+  }
+
+  void reopen() {
+    tsdbCloseRepo(repo, 0);
+    repo = tsdbOpenRepo(&cfg, &appH);
+    ASSERT_NE(repo, nullptr);
+  }
+
+  uint64_t uid = 10000;
+  TSKEY    start = 1590000000000;
+  TSKEY    interval = 60000;  // the rows span 2 file sets
+  int      numOfRows = 20000;
+};
+
+TEST_F(TsdbDeleteTest, deleteMasksRows) {
+  TSKEY lastKey = 0;
+
+  // across the borders of the blocks
+  ASSERT_EQ(deleteRows(3000, 8000), 5000);
+  checkRows(numOfRows - 5000, sumOf(0, numOfRows) - sumOf(3000, 8000));
+
+  ASSERT_EQ(deleteRows(19000, numOfRows), 1000);
+  // the rows masked before are not counted again
+  ASSERT_EQ(deleteRows(2000, 8000), 1000);
+  checkRows(numOfRows - 7000, sumOf(0, numOfRows) - sumOf(2000, 8000) - sumOf(19000, numOfRows));
+  ASSERT_EQ(tsdbTestQueryLastRow(repo, uid, &lastKey), 0);
+  ASSERT_EQ(lastKey, keyOf(18999));
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 2);
+
+  // the tombstones are in the meta records
+  reopen();
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 2);
+  checkRows(numOfRows - 7000, sumOf(0, numOfRows) - sumOf(2000, 8000) - sumOf(19000, numOfRows));
+  ASSERT_EQ(tsdbTestQueryLastRow(repo, uid, &lastKey), 0);
+  ASSERT_EQ(lastKey, keyOf(18999));
+}
+
+TEST_F(TsdbDeleteTest, commitIntoDeletedRange) {
+  int64_t sum = 0;
+
+  ASSERT_EQ(deleteRows(3000, 8000), 5000);
+
+  // new rows between the keys deleted
+  ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, keyOf(3000) + interval / 2, interval, 5000), 0);
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  for (int i = 0; i < 5000; i++) sum += tsdbTestVal(keyOf(3000 + i) + interval / 2, 1);
+
+  checkRows(numOfRows, sumOf(0, numOfRows) - sumOf(3000, 8000) + sum);
+
+  // the rows masked are purged by the commit, the tombstone is cut
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 0);
+  reopen();
+  checkRows(numOfRows, sumOf(0, numOfRows) - sumOf(3000, 8000) + sum);
+}
+
+TEST_F(TsdbDeleteTest, compactCutsTombs) {
+  int64_t sum = sumOf(0, numOfRows) - sumOf(3000, 8000) - sumOf(15000, 16000);
+
+  // one in each file set
+  ASSERT_EQ(deleteRows(3000, 8000), 5000);
+  ASSERT_EQ(deleteRows(15000, 16000), 1000);
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 2);
+
+  ASSERT_EQ(tsdbCompact(repo), 0);
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 0);
+  checkRows(numOfRows - 6000, sum);
+
+  reopen();
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 0);
+  checkRows(numOfRows - 6000, sum);
+}
+
+class TsdbBlkCacheTest : public TsdbDeleteTest {
+ protected:
+  void SetUp() override {
+    cacheSize = tsTsdbBlkCacheSize;
+    tsTsdbBlkCacheSize = 64;
+    ASSERT_EQ(tsdbInitBlkCache(), 0);
+    TsdbDeleteTest::SetUp();
+  }
+
+  void TearDown() override {
+    TsdbDeleteTest::TearDown();
+    tsdbDestroyBlkCache();
+    tsTsdbBlkCacheSize = cacheSize;
+  }
+
+  STsdbBlkCacheStat getStat() {
+    STsdbBlkCacheStat stat;
+    tsdbGetBlkCacheStat(&stat);
+    return stat;
+  }
+
+  int32_t cacheSize = 0;
+};
+
+TEST_F(TsdbBlkCacheTest, onlyQueriesUseCache) {
+  // the commit of the fixture read nothing through the cache
+  STsdbBlkCacheStat stat = getStat();
+  ASSERT_EQ(stat.numOfEntries, 0);
+  ASSERT_EQ(stat.hits + stat.misses, 0);
+
+  checkRows(numOfRows, sumOf(0, numOfRows));
+  stat = getStat();
+  ASSERT_GT(stat.numOfEntries, 0);
+  ASSERT_GT(stat.misses, 0);
+  checkRows(numOfRows, sumOf(0, numOfRows));
+  ASSERT_GT(getStat().hits, stat.hits);
+  ASSERT_EQ(getStat().misses, stat.misses);
+
+  // the commit merging rows into the blocks neither hits nor fills the cache
+  stat = getStat();
+  ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, keyOf(100) + interval / 2, interval, 100), 0);
+  ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, keyOf(15000) + interval / 2, interval, 100), 0);
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  ASSERT_EQ(getStat().hits, stat.hits);
+  ASSERT_EQ(getStat().misses, stat.misses);
+
+  // nor does the compaction, and the entries of the files it replaces are dropped
+  int64_t sum = 0;
+  for (int i = 0; i < 100; i++) sum += tsdbTestVal(keyOf(100 + i) + interval / 2, 1);
+  for (int i = 0; i < 100; i++) sum += tsdbTestVal(keyOf(15000 + i) + interval / 2, 1);
+  checkRows(numOfRows + 200, sumOf(0, numOfRows) + sum);
+  ASSERT_GT(getStat().numOfEntries, 0);
 
-    pBlock->dataLen = htonl(pBlock->dataLen);
-    pBlock->numOfRows = htonl(pBlock->numOfRows);
-    pBlock->schemaLen = htonl(pBlock->schemaLen);
-    pBlock->uid = htobe64(pBlock->uid);
-    pBlock->tid = htonl(pBlock->tid);
+  ASSERT_EQ(deleteRows(3000, 8000), 5000);
+  ASSERT_EQ(deleteRows(16000, 17000), 1000);
+  stat = getStat();
+  ASSERT_EQ(tsdbCompact(repo), 0);
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  ASSERT_EQ(getStat().hits, stat.hits);
+  ASSERT_EQ(getStat().misses, stat.misses);
+  ASSERT_EQ(getStat().numOfEntries, 0);
+  ASSERT_EQ(getStat().used, 0);
+}
+
+class TsdbAutoCompactTest : public TsdbTest {
+ protected:
+  void SetUp() override {
+    interval = tsTsdbAutoCompactInterval;
+    ratio = tsTsdbAutoCompactRatio;
+    tsTsdbAutoCompactInterval = 0;
+    tsTsdbAutoCompactRatio = 33;
 
-    pBlock->sversion = htonl(pBlock->sversion);
-    pBlock->flag = htonl(pBlock->flag);
+    TsdbTest::SetUp();
+    ASSERT_EQ(tsdbTestCreateTable(repo, 1, uid, 3), 0);
+    // one block in each of the 2 file sets
+    ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, start, step, rowsPerFSet * 2), 0) << tstrerror(terrno);
+    ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  }
 
-    pMsg->length = htonl(pMsg->length);
-    pMsg->numOfBlocks = htonl(pMsg->numOfBlocks);
+  void TearDown() override {
+    TsdbTest::TearDown();
+    tsTsdbAutoCompactInterval = interval;
+    tsTsdbAutoCompactRatio = ratio;
+  }
 
-    if (tsdbInsertData(pInfo->pRepo, pMsg, NULL, NULL) < 0) {
-      tfree(pMsg);
-      return -1;
+  // rows between the keys of the first file set, each commit of them adds a sub-block to its block
+  void fragmentFirstFSet(int commits) {
+    for (int c = 0; c < commits; c++) {
+      ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, start + step / 2 + extraRows * 20 * step, step, 5), 0);
+      ASSERT_EQ(tsdbSyncCommit(repo), 0);
+      extraRows += 5;
     }
   }
 
-  double etime = getCurTime();
+  // the commit of a row in a new file set lets the auto compaction check all of them
+  void commitAndCheck() {
+    tsdbTestDueAutoCompact(repo);
+    ASSERT_EQ(tsdbTestInsertRows(repo, 1, uid, start + (rowsPerFSet * (2 + newFSets++)) * step, step, 1), 0);
+    ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  }
+
+  std::vector<STsdbFSetCompactStat> getStats() {
+    SArray *aStat = (SArray *)taosArrayInit(4, sizeof(STsdbFSetCompactStat));
+    EXPECT_EQ(tsdbGetFSetCompactStat(repo, aStat), 0);
+    std::vector<STsdbFSetCompactStat> stats((STsdbFSetCompactStat *)aStat->pData,
+                                            (STsdbFSetCompactStat *)aStat->pData + taosArrayGetSize(aStat));
+    taosArrayDestroy(&aStat);
+    return stats;
+  }
+
+  uint64_t uid = 10000;
+  TSKEY    start = 1589760000000;  // the start of a file set of 10 days
+  TSKEY    step = 600000;
+  int      rowsPerFSet = 1440;
+  int      extraRows = 0;
+  int      newFSets = 0;
+  int32_t  interval = 0;
+  int32_t  ratio = 0;
+};
+
+TEST_F(TsdbAutoCompactTest, fragmentedFSetCompacted) {
+  fragmentFirstFSet(3);
+
+  // not checked while disabled
+  tsdbTestDueAutoCompact(repo);
+  fragmentFirstFSet(1);
+  for (auto &stat : getStats()) ASSERT_EQ(stat.checkTime, 0);
+
+  tsTsdbAutoCompactInterval = 1;
+  commitAndCheck();
 
-  printf("Spent %f seconds to write %d records\n", etime - stime, pInfo->totalRows);
-  tfree(pMsg);
-  return 0;
+  std::vector<STsdbFSetCompactStat> stats = getStats();
+  ASSERT_EQ(stats.size(), 3u);
+  for (auto &stat : stats) ASSERT_GT(stat.checkTime, 0);
+  ASSERT_GE(stats[0].numOfSubBlocks, 1);
+  ASSERT_GE(stats[0].fragmentation, tsTsdbAutoCompactRatio);
+  ASSERT_GT(stats[0].compactTime, 0);
+  ASSERT_LT(stats[1].fragmentation, tsTsdbAutoCompactRatio);
+  ASSERT_EQ(stats[1].compactTime, 0);
+  ASSERT_EQ(stats[2].compactTime, 0);
+  ASSERT_FALSE(stats[0].toPurge || stats[1].toPurge || stats[2].toPurge);
+
+  int64_t sum = 0;
+  ASSERT_EQ(tsdbTestQueryRows(repo, uid, start, start + rowsPerFSet * step - 1, &sum), rowsPerFSet + extraRows);
+
+  // no fragmentation is left to compact again
+  int64_t compactTime = stats[0].compactTime;
+  commitAndCheck();
+  stats = getStats();
+  ASSERT_EQ(stats.size(), 4u);
+  ASSERT_EQ(stats[0].numOfSubBlocks, 0);
+  ASSERT_LT(stats[0].fragmentation, tsTsdbAutoCompactRatio);
+  ASSERT_EQ(stats[0].compactTime, compactTime);
+  ASSERT_EQ(tsdbTestQueryRows(repo, uid, start, start + rowsPerFSet * step - 1, &sum), rowsPerFSet + extraRows);
 }
 
-static void tsdbSetCfg(STsdbCfg *pCfg, int32_t tsdbId, int32_t cacheBlockSize, int32_t totalBlocks, int32_t maxTables,
-                       int32_t daysPerFile, int32_t keep, int32_t minRows, int32_t maxRows, int8_t precision,
-                       int8_t compression) {
-  pCfg->tsdbId = tsdbId;
-  pCfg->cacheBlockSize = cacheBlockSize;
-  pCfg->totalBlocks = totalBlocks;
-  // pCfg->maxTables = maxTables;
-  pCfg->daysPerFile = daysPerFile;
-  pCfg->keep = keep;
-  pCfg->minRowsPerFileBlock = minRows;
-  pCfg->maxRowsPerFileBlock = maxRows;
-  pCfg->precision = precision;
-  pCfg->compression = compression;
+TEST_F(TsdbAutoCompactTest, deletedRowsPurged) {
+  tsTsdbAutoCompactInterval = 1;
+  tsTsdbAutoCompactRatio = 100;
+
+  // the rows deleted from the second file set are purged whatever its fragmentation
+  ASSERT_EQ(tsdbTestDeleteRows(repo, 1, start + (rowsPerFSet + 100) * step, start + (rowsPerFSet + 199) * step), 100);
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 1);
+  commitAndCheck();
+
+  std::vector<STsdbFSetCompactStat> stats = getStats();
+  ASSERT_EQ(stats.size(), 3u);
+  ASSERT_FALSE(stats[0].toPurge);
+  ASSERT_EQ(stats[0].compactTime, 0);
+  ASSERT_TRUE(stats[1].toPurge);
+  ASSERT_GT(stats[1].compactTime, 0);
+  ASSERT_EQ(tsdbTestNumOfTombs(repo, uid), 0);
+
+  int64_t sum = 0;
+  ASSERT_EQ(tsdbTestQueryRows(repo, uid, start, start + rowsPerFSet * 2 * step - 1, &sum), rowsPerFSet * 2 - 100);
 }
 
-static void tsdbSetTableCfg(STableCfg *pCfg) {
-  STSchemaBuilder schemaBuilder = {0};
+class TsdbMemTest : public TsdbTest {
+ protected:
+  void SetUp() override {
+    TsdbTest::SetUp();
+    ASSERT_EQ(tsdbTestCreateTable(repo, 1, uid, 3), 0);
+  }
+
+  TSKEY keyOf(int row) { return start + row * interval; }
+
+  int insert(TSKEY key, int rows) { return tsdbTestInsertRows(repo, 1, uid, key, interval, rows); }
+
+  static std::vector<TSKEY> readIter(void *iter, int maxKeys) {
+    std::vector<TSKEY> keys(maxKeys);
+    keys.resize(tsdbTestReadMemIter(iter, keys.data(), maxKeys));
+    return keys;
+  }
+
+  // the keys of the memtable from key in the order, from the first one if pKey is NULL
+  std::vector<TSKEY> read(const TSKEY *pKey, int32_t order) {
+    void *iter = tsdbTestOpenMemIter(repo, uid, pKey, order);
+    EXPECT_NE(iter, nullptr) << tstrerror(terrno);
+    if (iter == NULL) return std::vector<TSKEY>();
+
+    std::vector<TSKEY> keys = readIter(iter, maxRows);
+    tsdbTestCloseMemIter(iter);
+    return keys;
+  }
+
+  // the keys of the rows [from, to) in the order
+  std::vector<TSKEY> keysOf(int from, int to, int32_t order) {
+    std::vector<TSKEY> keys;
+    for (int i = from; i < to; i++) keys.push_back(keyOf(i));
+    if (order == TSDB_ORDER_DESC) std::reverse(keys.begin(), keys.end());
+    return keys;
+  }
 
-  pCfg->type = TSDB_NORMAL_TABLE;
-  pCfg->superUid = TSDB_INVALID_SUPER_TABLE_ID;
-  pCfg->tableId.tid = 1;
-  pCfg->tableId.uid = 5849583783847394;
-  tdInitTSchemaBuilder(&schemaBuilder, 0);
+  // the keys of all not less than key for ascending order, or not greater than key for descending order
+  static std::vector<TSKEY> keysFrom(const std::vector<TSKEY> &all, TSKEY key, int32_t order) {
+    std::vector<TSKEY> keys;
+    for (TSKEY k : all) {
+      if (order == TSDB_ORDER_ASC ? k >= key : k <= key) keys.push_back(k);
+    }
+    if (order == TSDB_ORDER_DESC) std::reverse(keys.begin(), keys.end());
+    return keys;
+  }
 
-  int colId = 0;
-  for (int i = 0; i < 5; i++) {
-    tdAddColToSchema(&schemaBuilder, (colId == 0) ? TSDB_DATA_TYPE_TIMESTAMP : TSDB_DATA_TYPE_INT, colId, 0);
-    colId++;
+  void checkSeek(const std::vector<TSKEY> &all, const std::vector<TSKEY> &seekKeys) {
+    for (TSKEY key : seekKeys) {
+      ASSERT_EQ(read(&key, TSDB_ORDER_ASC), keysFrom(all, key, TSDB_ORDER_ASC)) << "asc from " << key;
+      ASSERT_EQ(read(&key, TSDB_ORDER_DESC), keysFrom(all, key, TSDB_ORDER_DESC)) << "desc from " << key;
+    }
   }
 
-  pCfg->schema = tdGetSchemaFromBuilder(&schemaBuilder);
-  pCfg->name = strdup("t1");
+  uint64_t uid = 10000;
+  TSKEY    start = 1590000000000;
+  TSKEY    interval = 1000;
+  int      maxRows = 100000;
+};
 
-  tdDestroyTSchemaBuilder(&schemaBuilder);
+TEST_F(TsdbMemTest, outOfOrderMovesToSkipList) {
+  ASSERT_EQ(insert(keyOf(0), 1000), 0);
+  ASSERT_EQ(tsdbTestMemRowsIn(repo, uid), TSDB_TEST_IN_CHUNKS);
+  ASSERT_EQ(read(NULL, TSDB_ORDER_ASC), keysOf(0, 1000, TSDB_ORDER_ASC));
+  ASSERT_EQ(read(NULL, TSDB_ORDER_DESC), keysOf(0, 1000, TSDB_ORDER_DESC));
+
+  // a row between the rows appended
+  ASSERT_EQ(insert(keyOf(500) + 1, 1), 0);
+  ASSERT_EQ(tsdbTestMemRowsIn(repo, uid), TSDB_TEST_IN_SKIPLIST);
+
+  std::vector<TSKEY> all = keysOf(0, 1000, TSDB_ORDER_ASC);
+  all.insert(all.begin() + 501, keyOf(500) + 1);
+  ASSERT_EQ(read(NULL, TSDB_ORDER_ASC), all);
+  ASSERT_EQ(read(NULL, TSDB_ORDER_DESC), std::vector<TSKEY>(all.rbegin(), all.rend()));
+
+  // the rows in order go on to the skip list
+  ASSERT_EQ(insert(keyOf(1000), 10), 0);
+  all = keysOf(0, 1010, TSDB_ORDER_ASC);
+  all.insert(all.begin() + 501, keyOf(500) + 1);
+  ASSERT_EQ(read(NULL, TSDB_ORDER_ASC), all);
+
+  int64_t sum = 0;
+  ASSERT_EQ(tsdbTestQueryRows(repo, uid, keyOf(0), keyOf(2000), &sum), 1011);
 }
 
-TEST(TsdbTest, testInsertSpeed) {
-  int         vnode = 1;
-  int         ret = 0;
-  STsdbCfg    tsdbCfg;
-  STableCfg   tableCfg;
-  std::string testDir = "./test";
-  char *      rootDir = strdup((testDir + "/vnode" + std::to_string(vnode)).c_str());
+TEST_F(TsdbMemTest, duplicateMovesToSkipList) {
+  ASSERT_EQ(insert(keyOf(0), 1000), 0);
+
+  // the last key again, dropped as the repo does not update
+  ASSERT_EQ(insert(keyOf(999), 1), 0);
+  ASSERT_EQ(tsdbTestMemRowsIn(repo, uid), TSDB_TEST_IN_SKIPLIST);
+  ASSERT_EQ(read(NULL, TSDB_ORDER_ASC), keysOf(0, 1000, TSDB_ORDER_ASC));
 
-  tsdbDebugFlag = 131; //NOTE: you must set the flag
+  // a duplicate in the middle of a batch in order
+  ASSERT_EQ(insert(keyOf(990), 20), 0);
+  ASSERT_EQ(read(NULL, TSDB_ORDER_ASC), keysOf(0, 1010, TSDB_ORDER_ASC));
+  ASSERT_EQ(read(NULL, TSDB_ORDER_DESC), keysOf(0, 1010, TSDB_ORDER_DESC));
+}
 
-  taosRemoveDir(rootDir);
+TEST_F(TsdbMemTest, seekFromKey) {
+  // the chunks of 16, 32, 64 ... rows
+  int                numOfRows = 5000;
+  std::vector<TSKEY> all = keysOf(0, numOfRows, TSDB_ORDER_ASC);
+  std::vector<TSKEY> seekKeys = {keyOf(0) - 1, keyOf(0),    keyOf(15),       keyOf(16),
+                                 keyOf(47),    keyOf(48),   keyOf(2500),     keyOf(2500) + interval / 2,
+                                 keyOf(4079),  keyOf(4080), keyOf(numOfRows - 1), keyOf(numOfRows - 1) + 1};
 
-  // Create and open repository
-  tsdbSetCfg(&tsdbCfg, 1, 16, 4, -1, -1, -1, -1, -1, -1, -1);
-  tsdbCreateRepo(rootDir, &tsdbCfg);
-  STsdbRepo *repo = tsdbOpenRepo(rootDir, NULL);
+  ASSERT_EQ(insert(keyOf(0), numOfRows), 0);
+  ASSERT_EQ(tsdbTestMemRowsIn(repo, uid), TSDB_TEST_IN_CHUNKS);
+  checkSeek(all, seekKeys);
+
+  // the same in the skip list
+  ASSERT_EQ(insert(keyOf(0), 1), 0);
+  ASSERT_EQ(tsdbTestMemRowsIn(repo, uid), TSDB_TEST_IN_SKIPLIST);
+  checkSeek(all, seekKeys);
+}
+
+TEST_F(TsdbMemTest, iterOpenedBeforeMove) {
+  ASSERT_EQ(insert(keyOf(0), 1000), 0);
+
+  TSKEY from = keyOf(300);
+  void *ascIter = tsdbTestOpenMemIter(repo, uid, NULL, TSDB_ORDER_ASC);
+  void *descIter = tsdbTestOpenMemIter(repo, uid, &from, TSDB_ORDER_DESC);
+  ASSERT_NE(ascIter, nullptr);
+  ASSERT_NE(descIter, nullptr);
+  ASSERT_EQ(readIter(ascIter, 100), keysOf(0, 100, TSDB_ORDER_ASC));
+  ASSERT_EQ(readIter(descIter, 100), keysOf(201, 301, TSDB_ORDER_DESC));
+
+  ASSERT_EQ(insert(keyOf(500) + 1, 1), 0);
+  ASSERT_EQ(tsdbTestMemRowsIn(repo, uid), TSDB_TEST_IN_SKIPLIST);
+
+  // the iterators go on with the chunks as they were before the move
+  ASSERT_EQ(readIter(ascIter, maxRows), keysOf(100, 1000, TSDB_ORDER_ASC));
+  ASSERT_EQ(readIter(descIter, maxRows), keysOf(0, 201, TSDB_ORDER_DESC));
+  tsdbTestCloseMemIter(ascIter);
+  tsdbTestCloseMemIter(descIter);
+
+  ASSERT_EQ(read(NULL, TSDB_ORDER_ASC).size(), 1001);
+}
+
+TEST_F(TsdbMemTest, readWhileAppending) {
+  int               batches = 200;
+  int               rowsPerBatch = 100;
+  std::atomic<bool> done(false);
+
+  ASSERT_EQ(insert(keyOf(0), rowsPerBatch), 0);
+
+  std::thread writer([&]() {
+    for (int b = 1; b < batches; b++) {
+      EXPECT_EQ(insert(keyOf(b * rowsPerBatch), rowsPerBatch), 0);
+    }
+    done = true;
+  });
+
+  // each read sees the rows appended before it, in order and none missing
+  size_t             lastRows = 0;
+  int                reads = 0;
+  std::vector<TSKEY> all = keysOf(0, batches * rowsPerBatch, TSDB_ORDER_ASC);
+  while (!done || reads == 0) {
+    std::vector<TSKEY> keys = read(NULL, reads % 2 == 0 ? TSDB_ORDER_ASC : TSDB_ORDER_DESC);
+    if (reads % 2 != 0) std::reverse(keys.begin(), keys.end());
+
+    ASSERT_GE(keys.size(), lastRows);
+    ASSERT_TRUE(std::equal(keys.begin(), keys.end(), all.begin())) << "read " << reads << " of " << keys.size();
+    lastRows = keys.size();
+    reads++;
+  }
+  writer.join();
+
+  ASSERT_EQ(tsdbTestMemRowsIn(repo, uid), TSDB_TEST_IN_CHUNKS);
+  ASSERT_EQ(read(NULL, TSDB_ORDER_ASC), all);
+}
+
+// Commit the same rows with numOfThreads apply threads, return the content of the files of the file sets by name
+static void commitWithApplyThreads(int numOfThreads, std::map<std::string, std::string> &files) {
+  const char *path = "/tmp/tsdbTests";
+  int32_t     threads = tsNumOfApplyThreads;
+  STsdbCfg    cfg;
+  STsdbAppH   appH = {0};
+  TSKEY       start = 1590000000000;
+
+  tsNumOfApplyThreads = numOfThreads;
+  ASSERT_EQ(tsdbTestInit(path), 0);
+  tsdbTestSetCfg(&cfg);
+  tsdbCreateRepo(cfg.tsdbId);
+  STsdbRepo *repo = tsdbOpenRepo(&cfg, &appH);
   ASSERT_NE(repo, nullptr);
 
-  // Create table
-  tsdbSetTableCfg(&tableCfg);
-  tsdbCreateTable(repo, &tableCfg);
+  // more tables than a round of the lanes, of several file sets, and small ones only in the .last files
+  for (int t = 1; t <= 100; t++) {
+    ASSERT_EQ(tsdbTestCreateTable(repo, t, 10000 + t, 4), 0);
+    int numOfRows = (t % 4 == 0) ? 50 + t : 3000 + t * 37;
+    ASSERT_EQ(tsdbTestInsertRows(repo, t, 10000 + t, start + t, 600000 + t, numOfRows), 0) << tstrerror(terrno);
+  }
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+
+  // the 2nd commit merges with the blocks in the files
+  for (int t = 1; t <= 100; t += 3) {
+    ASSERT_EQ(tsdbTestInsertRows(repo, t, 10000 + t, start + 7 * t + 300000, 6000000, 500), 0) << tstrerror(terrno);
+  }
+  ASSERT_EQ(tsdbSyncCommit(repo), 0);
+  tsdbCloseRepo(repo, 0);
+  tsdbTestCleanup();
+  tsNumOfApplyThreads = threads;
+
+  std::string dir = std::string(path) + "/vnode/vnode1/tsdb/data";
+  DIR *       pDir = opendir(dir.c_str());
+  ASSERT_NE(pDir, nullptr);
+  struct dirent *pEntry;
+  while ((pEntry = readdir(pDir)) != NULL) {
+    if (pEntry->d_name[0] == '.') continue;
+
+    std::ifstream     file(dir + "/" + pEntry->d_name, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    files[pEntry->d_name] = content.str();
+  }
+  closedir(pDir);
+}
 
-  // Insert data
-  SInsertInfo iInfo = {repo, true, 1, 5849583783847394, 0, 1590000000000, 10, 10000000, 100, tableCfg.schema};
+TEST(TsdbApplyTest, sameFilesWithApplyThreads) {
+  std::map<std::string, std::string> serial;
+  std::map<std::string, std::string> parallel;
 
-  insertData(&iInfo);
+  commitWithApplyThreads(0, serial);
+  commitWithApplyThreads(4, parallel);
 
-  tsdbCloseRepo(repo, 1);
+  ASSERT_GT(serial.size(), 5u);
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (auto &file : serial) {
+    auto it = parallel.find(file.first);
+    ASSERT_NE(it, parallel.end()) << file.first;
+    ASSERT_TRUE(file.second == it->second) << file.first << " differs";
+  }
 }
 
-static char *getTKey(const void *data) {
-  return (char *)data;
-}
\ No newline at end of file
+// The tags of a child table as the tests set them, an empty value for a tag not set
+struct TagVals {
+  std::string t1, t2, t3, t4, t5;
+};
+
+class TsdbTagTest : public TsdbTest {
+ protected:
+  void SetUp() override {
+    TsdbTest::SetUp();
+    for (int32_t tid = 1; tid <= numOfTables; tid++) {
+      ASSERT_EQ(createTable(tid, std::to_string(tid % 5), (tid % 11 == 0) ? "" : std::to_string(tid % 7),
+                            "b" + std::to_string(tid % 13), "n" + std::to_string(tid % 4)),
+                0);
+    }
+  }
+
+  uint64_t uidOf(int32_t tid) { return 30000 + tid; }
+
+  int createTable(int32_t tid, std::string t1, std::string t2, std::string t3, std::string t4) {
+    tags[tid] = {t1, t2, t3, t4, ""};
+    return tsdbTestCreateChildTable(repo, tid, uidOf(tid), t1.c_str(), t2.empty() ? NULL : t2.c_str(), t3.c_str(),
+                                    t4.c_str());
+  }
+
+  int dropTable(int32_t tid) {
+    tags.erase(tid);
+    return tsdbDropTable(repo, {uidOf(tid), tid});
+  }
+
+  int setTag(int32_t tid, int16_t colId, std::string val) {
+    tagOf(tid, colId) = val;
+    return tsdbTestSetTag(repo, tid, uidOf(tid), colId, val.c_str());
+  }
+
+  int alterTag(int32_t tid, int16_t colId, int16_t bytes, std::string val) {
+    tagOf(tid, colId) = val;
+    return tsdbTestAlterTag(repo, tid, uidOf(tid), colId, bytes, val.c_str());
+  }
+
+  std::string &tagOf(int32_t tid, int16_t colId) {
+    TagVals &vals = tags[tid];
+    switch (colId) {
+      case TSDB_TEST_TAG_T1: return vals.t1;
+      case TSDB_TEST_TAG_T2: return vals.t2;
+      case TSDB_TEST_TAG_T3: return vals.t3;
+      case TSDB_TEST_TAG_T4: return vals.t4;
+      default: return vals.t5;
+    }
+  }
+
+  // the tids of the tables qualified in the order returned, -1 if filtered one by one instead
+  int query(void *cond, int by, std::vector<int32_t> &tids) {
+    tids.resize(tags.size() + 1);
+    int n = tsdbTestQueryTags(repo, cond, by, tids.data(), (int)tids.size());
+    tids.resize(n < 0 ? 0 : n);
+    return n < 0 ? -1 : 0;
+  }
+
+  // the tables qualified by the tags the tests set, in tid order
+  std::vector<int32_t> expected(std::function<bool(const TagVals &)> match) {
+    std::vector<int32_t> tids;
+    for (auto &it : tags) {
+      if (match(it.second)) tids.push_back(it.first);
+    }
+    return tids;
+  }
+
+  // the condition is freed
+  void check(void *cond, std::function<bool(const TagVals &)> match) {
+    std::vector<int32_t> byTable, byStore, byIndex;
+
+    ASSERT_EQ(query(cond, TSDB_TEST_BY_TABLE, byTable), 0);
+    ASSERT_EQ(query(cond, TSDB_TEST_BY_STORE, byStore), 0);
+    ASSERT_EQ(query(cond, TSDB_TEST_BY_INDEX, byIndex), 0);
+    tsdbTestFreeTagCond(cond);
+
+    // the order of the skip list, but tid order by the store and the indexes
+    std::sort(byTable.begin(), byTable.end());
+    ASSERT_EQ(byTable, expected(match));
+    ASSERT_EQ(byStore, byTable);
+    ASSERT_EQ(byIndex, byTable);
+  }
+
+  // the same as check(), but the condition must be served by the indexes, so the store is not built
+  void checkIndexed(void *cond, std::function<bool(const TagVals &)> match) {
+    std::vector<int32_t> byTable, byIndex;
+
+    ASSERT_FALSE(tsdbTestTagStoreValid(repo));
+    ASSERT_EQ(query(cond, TSDB_TEST_BY_INDEX, byIndex), 0);
+    ASSERT_FALSE(tsdbTestTagStoreValid(repo));
+    ASSERT_EQ(query(cond, TSDB_TEST_BY_TABLE, byTable), 0);
+    tsdbTestFreeTagCond(cond);
+
+    std::sort(byTable.begin(), byTable.end());
+    ASSERT_EQ(byTable, expected(match));
+    ASSERT_EQ(byIndex, byTable);
+  }
+
+  int                         numOfTables = 200;
+  std::map<int32_t, TagVals> tags;
+};
+
+TEST_F(TsdbTagTest, storeSameAsByTable) {
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "3"), [](const TagVals &t) { return t.t2 == "3"; });
+  ASSERT_TRUE(tsdbTestTagStoreValid(repo));
+
+  check(tsdbTestTagCond(TSDB_RELATION_LIKE, TSDB_TEST_TAG_T3, "b1%"),
+        [](const TagVals &t) { return t.t3.compare(0, 2, "b1") == 0; });
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T4, "n2"), [](const TagVals &t) { return t.t4 == "n2"; });
+  check(tsdbTestTagAnd(tsdbTestTagCond(TSDB_RELATION_GREATER, TSDB_TEST_TAG_T2, "2"),
+                       tsdbTestTagCond(TSDB_RELATION_NOT_EQUAL, TSDB_TEST_TAG_T4, "n0")),
+        [](const TagVals &t) { return !t.t2.empty() && std::stoi(t.t2) > 2 && t.t4 != "n0"; });
+  check(tsdbTestTagOr(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b5"),
+                      tsdbTestTagCond(TSDB_RELATION_LESS, TSDB_TEST_TAG_T2, "2")),
+        [](const TagVals &t) { return t.t3 == "b5" || (!t.t2.empty() && std::stoi(t.t2) < 2); });
+
+  // the first tag is filtered on the skip list
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T1, "4"), [](const TagVals &t) { return t.t1 == "4"; });
+}
+
+TEST_F(TsdbTagTest, storeInvalidated) {
+  auto t2Is1 = [](const TagVals &t) { return t.t2 == "1"; };
+
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "1"), t2Is1);
+  ASSERT_TRUE(tsdbTestTagStoreValid(repo));
+
+  ASSERT_EQ(createTable(numOfTables + 1, "0", "1", "b0", "n0"), 0);
+  ASSERT_FALSE(tsdbTestTagStoreValid(repo));
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "1"), t2Is1);
+  ASSERT_TRUE(tsdbTestTagStoreValid(repo));
+
+  ASSERT_EQ(dropTable(8), 0);
+  ASSERT_FALSE(tsdbTestTagStoreValid(repo));
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "1"), t2Is1);
+
+  ASSERT_EQ(setTag(15, TSDB_TEST_TAG_T2, "6"), 0);
+  ASSERT_EQ(setTag(16, TSDB_TEST_TAG_T2, "1"), 0);
+  ASSERT_FALSE(tsdbTestTagStoreValid(repo));
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "1"), t2Is1);
+
+  ASSERT_EQ(setTag(20, TSDB_TEST_TAG_T4, "n9"), 0);
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T4, "n9"), [](const TagVals &t) { return t.t4 == "n9"; });
+
+  // a tag added is filled on the first query on it
+  ASSERT_EQ(alterTag(30, TSDB_TEST_TAG_T5, sizeof(int32_t), "7"), 0);
+  ASSERT_FALSE(tsdbTestTagStoreValid(repo));
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T5, "7"), [](const TagVals &t) { return t.t5 == "7"; });
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "1"), t2Is1);
+}
+
+TEST_F(TsdbTagTest, storeSharedByQueries) {
+  int32_t                  maxTagIndexes = tsTsdbMaxTagIndexes;
+  std::atomic<bool>        done(false);
+  std::atomic<int>         queries(0);
+  std::vector<std::thread> readers;
+  std::vector<int32_t>     t2Is3 = expected([](const TagVals &t) { return t.t2 == "3"; });
+
+  // the readers filter on the store while the tables have their other tags changed, each change invalidates it
+  tsTsdbMaxTagIndexes = 0;
+  for (int r = 0; r < 4; r++) {
+    readers.emplace_back([&]() {
+      void *               cond = tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "3");
+      std::vector<int32_t> tids(numOfTables + 1);
+
+      while (!done) {
+        int n = tsdbTestQueryTags(repo, cond, TSDB_TEST_BY_INDEX, tids.data(), (int)tids.size());
+        EXPECT_EQ(std::vector<int32_t>(tids.begin(), tids.begin() + std::max(n, 0)), t2Is3);
+        queries++;
+      }
+      tsdbTestFreeTagCond(cond);
+    });
+  }
+
+  for (int i = 0; i < 400; i++) {
+    ASSERT_EQ(setTag(i % numOfTables + 1, TSDB_TEST_TAG_T4, "n" + std::to_string(i % 9)), 0);
+    if (i % 100 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  done = true;
+  for (auto &reader : readers) reader.join();
+  tsTsdbMaxTagIndexes = maxTagIndexes;
+
+  ASSERT_GT(queries, 0);
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T4, "n5"), [](const TagVals &t) { return t.t4 == "n5"; });
+}
+
+TEST_F(TsdbTagTest, tooWideFallsBack) {
+  std::vector<int32_t> tids;
+  auto                 t3IsB3 = [](const TagVals &t) { return t.t3 == "b3"; };
+
+  // a value of t3 wider than the conditions built before t3 was widened
+  ASSERT_EQ(alterTag(40, TSDB_TEST_TAG_T3, 32 + VARSTR_HEADER_SIZE, "b3-a-value-of-24-bytes"), 0);
+
+  void *cond = tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3");
+  ASSERT_EQ(query(cond, TSDB_TEST_BY_STORE, tids), -1);
+  ASSERT_EQ(query(cond, TSDB_TEST_BY_TABLE, tids), 0);
+  tsdbTestFreeTagCond(cond);
+  std::sort(tids.begin(), tids.end());
+  ASSERT_EQ(tids, expected(t3IsB3));
+
+  cond = tsdbTestTagCond(TSDB_RELATION_LIKE, TSDB_TEST_TAG_T3, "b3%");
+  ASSERT_EQ(query(cond, TSDB_TEST_BY_TABLE, tids), 0);
+  tsdbTestFreeTagCond(cond);
+  std::sort(tids.begin(), tids.end());
+  ASSERT_EQ(tids, expected([](const TagVals &t) { return t.t3.compare(0, 2, "b3") == 0; }));
+
+  // the other tags are still filtered on the store
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T4, "n1"), [](const TagVals &t) { return t.t4 == "n1"; });
+}
+
+TEST_F(TsdbTagTest, indexServesAndOr) {
+  checkIndexed(tsdbTestTagAnd(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3"),
+                              tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "1")),
+               [](const TagVals &t) { return t.t3 == "b3" && t.t2 == "1"; });
+  checkIndexed(tsdbTestTagOr(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3"),
+                             tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T4, "n1")),
+               [](const TagVals &t) { return t.t3 == "b3" || t.t4 == "n1"; });
+
+  // a group served by one of its units, the others filter the tables listed
+  checkIndexed(tsdbTestTagOr(tsdbTestTagAnd(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3"),
+                                            tsdbTestTagCond(TSDB_RELATION_NOT_EQUAL, TSDB_TEST_TAG_T4, "n1")),
+                             tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T2, "5")),
+               [](const TagVals &t) { return (t.t3 == "b3" && t.t4 != "n1") || t.t2 == "5"; });
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T2));
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T3));
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T4));
+
+  // a group with no = or in, the store serves the condition
+  check(tsdbTestTagOr(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3"),
+                      tsdbTestTagCond(TSDB_RELATION_GREATER, TSDB_TEST_TAG_T2, "4")),
+        [](const TagVals &t) { return t.t3 == "b3" || (!t.t2.empty() && std::stoi(t.t2) > 4); });
+  ASSERT_TRUE(tsdbTestTagStoreValid(repo));
+}
+
+TEST_F(TsdbTagTest, indexServesInOnStrings) {
+  const char *t3s[] = {"b1", "b2", "b99"};
+  const char *t4s[] = {"n0", "n3"};
+  const char *t4n1[] = {"n1"};
+
+  checkIndexed(tsdbTestTagIn(TSDB_TEST_TAG_T3, t3s, 3),
+               [](const TagVals &t) { return t.t3 == "b1" || t.t3 == "b2" || t.t3 == "b99"; });
+  checkIndexed(tsdbTestTagIn(TSDB_TEST_TAG_T4, t4s, 2), [](const TagVals &t) { return t.t4 == "n0" || t.t4 == "n3"; });
+  checkIndexed(tsdbTestTagAnd(tsdbTestTagIn(TSDB_TEST_TAG_T4, t4n1, 1), tsdbTestTagIn(TSDB_TEST_TAG_T3, t3s, 3)),
+               [](const TagVals &t) { return t.t4 == "n1" && (t.t3 == "b1" || t.t3 == "b2"); });
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T3));
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T4));
+}
+
+TEST_F(TsdbTagTest, indexFollowsChanges) {
+  const char *t4s[] = {"n2", "n7"};
+  auto        t1Is3 = [](const TagVals &t) { return t.t1 == "3"; };
+  auto        t3IsB3 = [](const TagVals &t) { return t.t3 == "b3"; };
+  auto        t4InN2N7 = [](const TagVals &t) { return t.t4 == "n2" || t.t4 == "n7"; };
+
+  checkIndexed(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T1, "3"), t1Is3);
+  checkIndexed(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3"), t3IsB3);
+  checkIndexed(tsdbTestTagIn(TSDB_TEST_TAG_T4, t4s, 2), t4InN2N7);
+
+  // the indexes are updated instead of built again, the first tag moves the table in the skip list as well
+  ASSERT_EQ(setTag(3, TSDB_TEST_TAG_T3, "b5"), 0);
+  ASSERT_EQ(setTag(10, TSDB_TEST_TAG_T3, "b3"), 0);
+  ASSERT_EQ(setTag(11, TSDB_TEST_TAG_T4, "n7"), 0);
+  ASSERT_EQ(setTag(5, TSDB_TEST_TAG_T1, "3"), 0);
+  ASSERT_EQ(setTag(13, TSDB_TEST_TAG_T1, "1"), 0);
+  ASSERT_EQ(dropTable(16), 0);
+  ASSERT_EQ(dropTable(18), 0);
+  ASSERT_EQ(createTable(numOfTables + 1, "3", "1", "b3", "n2"), 0);
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T1));
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T3));
+  ASSERT_TRUE(tsdbTestHasTagIndex(repo, TSDB_TEST_TAG_T4));
+
+  checkIndexed(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T1, "3"), t1Is3);
+  checkIndexed(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T1, "1"),
+               [](const TagVals &t) { return t.t1 == "1"; });
+  checkIndexed(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3"), t3IsB3);
+  checkIndexed(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b5"),
+               [](const TagVals &t) { return t.t3 == "b5"; });
+  checkIndexed(tsdbTestTagIn(TSDB_TEST_TAG_T4, t4s, 2), t4InN2N7);
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T3, "b3"), t3IsB3);
+  check(tsdbTestTagCond(TSDB_RELATION_EQUAL, TSDB_TEST_TAG_T1, "3"), t1Is3);
+}
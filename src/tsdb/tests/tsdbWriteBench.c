@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "tskiplist.h"
+
+// Insert rows into memtable style skip lists with the nodes from calloc against the nodes from the buffer blocks
+// holding the rows, and count the heap allocations of each row. malloc and calloc are wrapped by the linker.
+
+static int     numOfTables = 100;
+static int     rowsPerTable = 10000;
+static int     rowsPerBatch = 100;
+static int     rowBytes = 64;
+static int32_t bufBlockSize = 16 * 1024 * 1024;
+
+static int64_t numOfAllocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  numOfAllocs++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  numOfAllocs++;
+  return __real_calloc(nmemb, size);
+}
+
+// the buffer pool, blocks are allocated and touched before the runs as tsdbOpenBufPool() does
+typedef struct {
+  char ** blocks;
+  int     nBlocks;
+  int     curBlock;
+  int32_t offset;
+} SBenchBuf;
+
+typedef struct {
+  SBenchBuf *pBuf;
+  int64_t    key;
+  int        nRows;
+} SBenchIter;
+
+static double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+static void *allocBytes(void *param, int32_t bytes) {
+  SBenchBuf *pBuf = (SBenchBuf *)param;
+
+  if (pBuf->curBlock < 0 || pBuf->offset + bytes > bufBlockSize) {
+    if (++pBuf->curBlock == pBuf->nBlocks) {
+      printf("buffer pool is used up\n");
+      exit(1);
+    }
+    pBuf->offset = 0;
+  }
+
+  void *ptr = pBuf->blocks[pBuf->curBlock] + pBuf->offset;
+  pBuf->offset += bytes;
+  return ptr;
+}
+
+static void *allocNode(void *param, int32_t bytes) {
+  void *ptr = allocBytes(param, bytes + sizeof(void *) - 1);
+  return (void *)ALIGN_NUM((uintptr_t)ptr, sizeof(void *));
+}
+
+static char *getRowKey(const void *data) { return (char *)data; }
+
+static void *nextRow(void *iter) {
+  SBenchIter *pIter = (SBenchIter *)iter;
+  if (pIter->nRows == 0) return NULL;
+
+  char *row = (char *)allocBytes(pIter->pBuf, rowBytes);
+  memcpy(row, &pIter->key, sizeof(int64_t));
+  memset(row + sizeof(int64_t), 'a', rowBytes - sizeof(int64_t));
+
+  pIter->key++;
+  pIter->nRows--;
+  return row;
+}
+
+static void runBench(SBenchBuf *pBuf, bool arena) {
+  SSkipList **pLists = (SSkipList **)calloc(numOfTables, POINTER_BYTES);
+
+  for (int t = 0; t < numOfTables; t++) {
+    pLists[t] = tSkipListCreate(5, TSDB_DATA_TYPE_TIMESTAMP, sizeof(int64_t), NULL, SL_UPDATE_DUP_KEY, getRowKey);
+    if (arena) tSkipListSetNodeAllocator(pLists[t], allocNode, pBuf);
+  }
+
+  pBuf->curBlock = -1;
+
+  int64_t allocs = numOfAllocs;
+  double  st = getCurTime();
+
+  for (int r = 0; r < rowsPerTable; r += rowsPerBatch) {
+    for (int t = 0; t < numOfTables; t++) {
+      SBenchIter iter = {.pBuf = pBuf, .key = r, .nRows = rowsPerBatch};
+      tSkipListPutBatchByIter(pLists[t], &iter, nextRow);
+    }
+  }
+
+  double  et = getCurTime();
+  int64_t nRows = (int64_t)numOfTables * rowsPerTable;
+
+  allocs = numOfAllocs - allocs;
+  for (int t = 0; t < numOfTables; t++) {
+    tSkipListDestroy(pLists[t]);
+  }
+  double ft = getCurTime();
+
+  printf("  %-6s: %.4f allocs/row, %d buffer blocks, insert %.0f rows/s, free %.1f ms\n", arena ? "arena" : "calloc",
+         (double)allocs / nRows, pBuf->curBlock + 1, nRows / (et - st), (ft - et) * 1000);
+
+  free(pLists);
+}
+
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-t") == 0 && i < argc - 1) {
+      numOfTables = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i < argc - 1) {
+      rowsPerTable = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-b") == 0 && i < argc - 1) {
+      rowsPerBatch = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i < argc - 1) {
+      rowBytes = atoi(argv[++i]);
+    } else {
+      printf("\nusage: %s [options] \n", argv[0]);
+      printf("  [-t]: number of tables, default: %d\n", numOfTables);
+      printf("  [-r]: rows of each table, default: %d\n", rowsPerTable);
+      printf("  [-b]: rows of each table in a batch, default: %d\n", rowsPerBatch);
+      printf("  [-l]: bytes of each row, default: %d\n", rowBytes);
+      exit(0);
+    }
+  }
+
+  if (rowBytes < (int)sizeof(int64_t)) rowBytes = sizeof(int64_t);
+
+  // rows and nodes of the highest level with the padding
+  int64_t   bytes = (int64_t)numOfTables * rowsPerTable * (rowBytes + sizeof(SSkipListNode) + POINTER_BYTES * 11);
+  SBenchBuf buf = {0};
+
+  buf.nBlocks = (int)(bytes / bufBlockSize) + 2;
+  buf.blocks = (char **)calloc(buf.nBlocks, sizeof(char *));
+  for (int i = 0; i < buf.nBlocks; i++) {
+    buf.blocks[i] = (char *)malloc(bufBlockSize);
+    memset(buf.blocks[i], 0, bufBlockSize);
+  }
+
+  printf("%d tables, %d rows each, %d rows a batch:\n", numOfTables, rowsPerTable, rowsPerBatch);
+  runBench(&buf, false);
+  runBench(&buf, true);
+
+  for (int i = 0; i < buf.nBlocks; i++) {
+    free(buf.blocks[i]);
+  }
+  free(buf.blocks);
+
+  return 0;
+}
@@ -33,6 +33,9 @@ extern "C" {
 #define NO_COMPRESSION 0
 #define ONE_STAGE_COMP 1
 #define TWO_STAGE_COMP 2
+#define TWO_STAGE_COMP_ZSTD 3  // as TWO_STAGE_COMP, but the second stage uses zstd instead of LZ4
+
+#define IS_TWO_STAGE_COMP(algorithm) ((algorithm) == TWO_STAGE_COMP || (algorithm) == TWO_STAGE_COMP_ZSTD)
 
 //
 // compressed data first byte foramt
@@ -46,16 +49,28 @@ extern "C" {
 
 // compression algorithm save first byte higher 7 bit
 #define ALGO_SZ_LOSSY     1 // SZ compress 
+#define ALGO_INT_FOR      2 // frame of reference + bit-packing for integers
+#define ALGO_STR_DICT     3 // dictionary for binary and nchar
+#define ALGO_ZSTD         4 // zstd, the second stage of TWO_STAGE_COMP_ZSTD
 
 #define HEAD_MODE(x)  x%2
 #define HEAD_ALGO(x)  x/2
 
+// Use the SIMD decoders if enabled and supported by the CPU, return whether they are used
+extern bool tsSetDecompressSIMD(bool enable);
+
 extern int tsCompressINTImp(const char *const input, const int nelements, char *const output, const char type);
 extern int tsDecompressINTImp(const char *const input, const int nelements, char *const output, const char type);
+extern int tsGetINTForSize(const char *const input, const int nelements, const char type);
+extern int tsCompressINTForImp(const char *const input, const int nelements, char *const output, const char type);
 extern int tsCompressBoolImp(const char *const input, const int nelements, char *const output);
 extern int tsDecompressBoolImp(const char *const input, const int nelements, char *const output);
 extern int tsCompressStringImp(const char *const input, int inputSize, char *const output, int outputSize);
 extern int tsDecompressStringImp(const char *const input, int compressedSize, char *const output, int outputSize);
+extern int tsCompressStringZstdImp(const char *const input, int inputSize, char *const output, int outputSize);
+extern int tsCompressStringDictImp(const char *const input, int inputSize, const int nelements, char *const output,
+                                   int outputSize);
+extern int tsGetStringDictCodes(const char *const input, int compressedSize, const uint8_t **codes);
 extern int tsCompressTimestampImp(const char *const input, const int nelements, char *const output);
 extern int tsDecompressTimestampImp(const char *const input, const int nelements, char *const output);
 extern int tsCompressDoubleImp(const char *const input, const int nelements, char *const output);
@@ -77,13 +92,36 @@ int tsCompressInit();
 void tsCompressExit();
 #endif
 
+// The second stage of the two stage compression, tsDecompressStringImp tells the codec by the first byte
+static FORCE_INLINE int tsCompressSecondStage(const char *const input, int inputSize, char *const output,
+                                              int outputSize, char algorithm) {
+  if (algorithm == TWO_STAGE_COMP_ZSTD) {
+    return tsCompressStringZstdImp(input, inputSize, output, outputSize);
+  }
+  return tsCompressStringImp(input, inputSize, output, outputSize);
+}
+
 static FORCE_INLINE int tsCompressTinyint(const char *const input, int inputSize, const int nelements, char *const output, int outputSize, char algorithm,
                       char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_TINYINT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_TINYINT);
-    return tsCompressStringImp(buffer, len, output, outputSize);
+    return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
+  } else {
+    assert(0);
+    return -1;
+  }
+}
+
+// Frame of reference encoding, the data is decompressed by the type's integer decompression function
+static FORCE_INLINE int tsCompressIntegerFOR(const char *const input, const int nelements, char *const output,
+                                             int outputSize, char algorithm, char *const buffer, const char type) {
+  if (algorithm == ONE_STAGE_COMP) {
+    return tsCompressINTForImp(input, nelements, output, type);
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
+    int len = tsCompressINTForImp(input, nelements, buffer, type);
+    return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
   } else {
     assert(0);
     return -1;
@@ -94,7 +132,7 @@ static FORCE_INLINE int tsDecompressTinyint(const char *const input, int compres
                         int outputSize, char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_TINYINT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_TINYINT);
   } else {
@@ -107,9 +145,9 @@ static FORCE_INLINE int tsCompressSmallint(const char *const input, int inputSiz
                        char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_SMALLINT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_SMALLINT);
-    return tsCompressStringImp(buffer, len, output, outputSize);
+    return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
   } else {
     assert(0);
     return -1;
@@ -120,7 +158,7 @@ static FORCE_INLINE int tsDecompressSmallint(const char *const input, int compre
                          int outputSize, char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_SMALLINT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_SMALLINT);
   } else {
@@ -133,9 +171,9 @@ static FORCE_INLINE int tsCompressInt(const char *const input, int inputSize, co
                   char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_INT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_INT);
-    return tsCompressStringImp(buffer, len, output, outputSize);
+    return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
   } else {
     assert(0);
     return -1;
@@ -146,7 +184,7 @@ static FORCE_INLINE int tsDecompressInt(const char *const input, int compressedS
                     int outputSize, char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_INT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_INT);
   } else {
@@ -159,9 +197,9 @@ static FORCE_INLINE int tsCompressBigint(const char *const input, int inputSize,
                      char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_BIGINT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_BIGINT);
-    return tsCompressStringImp(buffer, len, output, outputSize);
+    return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
   } else {
     assert(0);
     return -1;
@@ -172,7 +210,7 @@ static FORCE_INLINE int tsDecompressBigint(const char *const input, int compress
                        int outputSize, char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_BIGINT);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_BIGINT);
   } else {
@@ -185,9 +223,9 @@ static FORCE_INLINE int tsCompressBool(const char *const input, int inputSize, c
                    char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsCompressBoolImp(input, nelements, output);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     int len = tsCompressBoolImp(input, nelements, buffer);
-    return tsCompressStringImp(buffer, len, output, outputSize);
+    return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
   } else {
     assert(0);
     return -1;
@@ -198,7 +236,7 @@ static FORCE_INLINE int tsDecompressBool(const char *const input, int compressed
                      int outputSize, char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsDecompressBoolImp(input, nelements, output);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
     return tsDecompressBoolImp(buffer, nelements, output);
   } else {
@@ -209,7 +247,7 @@ static FORCE_INLINE int tsDecompressBool(const char *const input, int compressed
 
 static FORCE_INLINE int tsCompressString(const char *const input, int inputSize, const int nelements, char *const output, int outputSize,
                      char algorithm, char *const buffer, int bufferSize) {
-  return tsCompressStringImp(input, inputSize, output, outputSize);
+  return tsCompressSecondStage(input, inputSize, output, outputSize, algorithm);
 }
 
 static FORCE_INLINE int tsDecompressString(const char *const input, int compressedSize, const int nelements, char *const output,
@@ -228,9 +266,9 @@ static FORCE_INLINE int tsCompressFloat(const char *const input, int inputSize,
 #endif    
     if (algorithm == ONE_STAGE_COMP) {
       return tsCompressFloatImp(input, nelements, output);
-    } else if (algorithm == TWO_STAGE_COMP) {
+    } else if (IS_TWO_STAGE_COMP(algorithm)) {
       int len = tsCompressFloatImp(input, nelements, buffer);
-      return tsCompressStringImp(buffer, len, output, outputSize);
+      return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
     } else {
       assert(0);
       return -1;
@@ -251,7 +289,7 @@ static FORCE_INLINE int tsDecompressFloat(const char *const input, int compresse
     // decompress lossless
     if (algorithm == ONE_STAGE_COMP) {
       return tsDecompressFloatImp(input, nelements, output);
-    } else if (algorithm == TWO_STAGE_COMP) {
+    } else if (IS_TWO_STAGE_COMP(algorithm)) {
       if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
       return tsDecompressFloatImp(buffer, nelements, output);
     } else {
@@ -275,9 +313,9 @@ static FORCE_INLINE int tsCompressDouble(const char *const input, int inputSize,
     // lossless mode
     if (algorithm == ONE_STAGE_COMP) {
       return tsCompressDoubleImp(input, nelements, output);
-    } else if (algorithm == TWO_STAGE_COMP) {
+    } else if (IS_TWO_STAGE_COMP(algorithm)) {
       int len = tsCompressDoubleImp(input, nelements, buffer);
-      return tsCompressStringImp(buffer, len, output, outputSize);
+      return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
     } else {
       assert(0);
       return -1;
@@ -298,7 +336,7 @@ static FORCE_INLINE int tsDecompressDouble(const char *const input, int compress
     // decompress lossless
     if (algorithm == ONE_STAGE_COMP) {
       return tsDecompressDoubleImp(input, nelements, output);
-    } else if (algorithm == TWO_STAGE_COMP) {
+    } else if (IS_TWO_STAGE_COMP(algorithm)) {
       if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
       return tsDecompressDoubleImp(buffer, nelements, output);
     } else {
@@ -340,9 +378,9 @@ static FORCE_INLINE int tsCompressTimestamp(const char *const input, int inputSi
                         char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsCompressTimestampImp(input, nelements, output);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     int len = tsCompressTimestampImp(input, nelements, buffer);
-    return tsCompressStringImp(buffer, len, output, outputSize);
+    return tsCompressSecondStage(buffer, len, output, outputSize, algorithm);
   } else {
     assert(0);
     return -1;
@@ -353,7 +391,7 @@ static FORCE_INLINE int tsDecompressTimestamp(const char *const input, int compr
                           int outputSize, char algorithm, char *const buffer, int bufferSize) {
   if (algorithm == ONE_STAGE_COMP) {
     return tsDecompressTimestampImp(input, nelements, output);
-  } else if (algorithm == TWO_STAGE_COMP) {
+  } else if (IS_TWO_STAGE_COMP(algorithm)) {
     if (tsDecompressStringImp(input, compressedSize, buffer, bufferSize) < 0) return -1;
     return tsDecompressTimestampImp(buffer, nelements, output);
   } else {
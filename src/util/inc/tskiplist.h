@@ -41,6 +41,7 @@ typedef char *(*__sl_key_fn_t)(const void *);
 
 typedef void (*sl_patch_row_fn_t)(void * pDst, const void * pSrc);
 typedef void* (*iter_next_fn_t)(void *iter);
+typedef void* (*sl_alloc_node_fn_t)(void *param, int32_t bytes);
 
 typedef struct SSkipListNode {
   uint8_t        level;
@@ -123,6 +124,9 @@ typedef struct SSkipList {
   tSkipListState state;  // skiplist state
 #endif
   tGenericSavedFunc* insertHandleFn;
+  // nodes from allocNodeFn are owned by the allocator and never freed one by one
+  sl_alloc_node_fn_t allocNodeFn;
+  void *             allocParam;
 } SSkipList;
 
 typedef struct SSkipListIterator {
@@ -143,6 +147,7 @@ typedef struct SSkipListIterator {
 SSkipList *tSkipListCreate(uint8_t maxLevel, uint8_t keyType, uint16_t keyLen, __compar_fn_t comparFn, uint8_t flags,
                            __sl_key_fn_t fn);
 void       tSkipListDestroy(SSkipList *pSkipList);
+void       tSkipListSetNodeAllocator(SSkipList *pSkipList, sl_alloc_node_fn_t fn, void *param);
 SSkipListNode *    tSkipListPut(SSkipList *pSkipList, void *pData);
 void               tSkipListPutBatchByIter(SSkipList *pSkipList, void *iter, iter_next_fn_t iterate);
 SArray *           tSkipListGet(SSkipList *pSkipList, SSkipListKey pKey);
@@ -51,12 +51,19 @@
 #include "lz4.h"
 #ifdef TD_TSZ  
   #include "td_sz.h"
+  #include "zstd.h"
 #endif
 #include "taosdef.h"
+#include "ttype.h"
 #include "tscompression.h"
 #include "tulog.h"
+#include "hashfunc.h"
 #include "tglobal.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(WINDOWS)
+  #define TD_COMPRESS_AVX2
+  #include <immintrin.h>
+#endif
 
 static const int TEST_NUMBER = 1;
 #define is_bigendian() ((*(char *)&TEST_NUMBER) == 0)
@@ -99,6 +106,319 @@ void tsCompressExit(){
 
 #endif
 
+/* -----------------------------------------SIMD Decompression
+ * ---------------------------------------------- */
+// -1: not resolved, 0: scalar decoders, 1: AVX2 decoders
+static int8_t tsDecompressSIMD = -1;
+
+bool tsSetDecompressSIMD(bool enable) {
+#ifdef TD_COMPRESS_AVX2
+  tsDecompressSIMD = (enable && __builtin_cpu_supports("avx2")) ? 1 : 0;
+#else
+  tsDecompressSIMD = 0;
+#endif
+  return tsDecompressSIMD == 1;
+}
+
+static FORCE_INLINE bool tsDecompressUseSIMD() {
+  if (tsDecompressSIMD < 0) tsSetDecompressSIMD(true);
+  return tsDecompressSIMD == 1;
+}
+
+#ifdef TD_COMPRESS_AVX2
+#define TD_AVX2_FUNC __attribute__((target("avx2")))
+#define COMP_SIMD_CHUNK 1024  // values decoded per round, must be even
+
+TD_AVX2_FUNC static FORCE_INLINE __m256i tsZigzagDecodeAvx2(__m256i v) {
+  __m256i sign = _mm256_sub_epi64(_mm256_setzero_si256(), _mm256_and_si256(v, _mm256_set1_epi64x(1)));
+  return _mm256_xor_si256(_mm256_srli_epi64(v, 1), sign);
+}
+
+// inclusive prefix sum of the 4 lanes
+TD_AVX2_FUNC static FORCE_INLINE __m256i tsPrefixSumAvx2(__m256i v) {
+  __m256i zero = _mm256_setzero_si256();
+  v = _mm256_add_epi64(v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, 0x90), zero, 0x03));
+  v = _mm256_add_epi64(v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, 0x40), zero, 0x0F));
+  return v;
+}
+
+#define AVX2_LAST_LANE(v) _mm256_permute4x64_epi64(v, 0xFF)
+#define AVX2_FIRST_LANE(v) _mm_cvtsi128_si64(_mm256_castsi256_si128(v))
+
+TD_AVX2_FUNC static int tsDecompressINTAvx2(const char *const input, const int nelements, char *const output,
+                                            const char type) {
+  static const char bit_per_integer[] = {0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 15, 20, 30, 60};
+  static const int  selector_to_elems[] = {240, 120, 60, 30, 20, 15, 12, 10, 8, 7, 6, 5, 4, 3, 2, 1};
+
+  uint64_t    buf[COMP_SIMD_CHUNK + 240];
+  const char *ip = input + 1;
+  int         count = 0;
+  int64_t     prev_value = 0;
+
+  while (count < nelements) {
+    // Unpack the zigzag values of the following words, a word is unpacked by 4 values at a time
+    int n = 0;
+    while (n < COMP_SIMD_CHUNK && count + n < nelements) {
+      uint64_t w = 0;
+      memcpy(&w, ip, LONG_BYTES);
+      ip += LONG_BYTES;
+
+      int selector = (int)(w & INT64MASK(4));
+      int bit = bit_per_integer[selector];
+      int elems = MIN(selector_to_elems[selector], nelements - count - n);
+
+      if (selector == 0 || selector == 1) {
+        memset(buf + n, 0, elems * sizeof(uint64_t));
+      } else {
+        __m256i vw = _mm256_set1_epi64x((int64_t)w);
+        __m256i vmask = _mm256_set1_epi64x((int64_t)INT64MASK(bit));
+        __m256i vshift = _mm256_setr_epi64x(4, 4 + bit, 4 + 2 * bit, 4 + 3 * bit);
+        __m256i vstep = _mm256_set1_epi64x(4 * bit);
+        for (int i = 0; i < elems; i += 4) {
+          _mm256_storeu_si256((__m256i *)(buf + n + i), _mm256_and_si256(_mm256_srlv_epi64(vw, vshift), vmask));
+          vshift = _mm256_add_epi64(vshift, vstep);
+        }
+      }
+      n += elems;
+    }
+
+    // Zigzag decode and accumulate the differences
+    __m256i carry = _mm256_set1_epi64x(prev_value);
+    int     i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m256i v = tsPrefixSumAvx2(tsZigzagDecodeAvx2(_mm256_loadu_si256((__m256i *)(buf + i))));
+      v = _mm256_add_epi64(v, carry);
+      _mm256_storeu_si256((__m256i *)(buf + i), v);
+      carry = AVX2_LAST_LANE(v);
+    }
+    prev_value = AVX2_FIRST_LANE(carry);
+    for (; i < n; i++) {
+      int64_t diff = ZIGZAG_DECODE(int64_t, buf[i]);
+      prev_value += diff;
+      buf[i] = (uint64_t)prev_value;
+    }
+
+    switch (type) {
+      case TSDB_DATA_TYPE_BIGINT:
+        memcpy((int64_t *)output + count, buf, n * LONG_BYTES);
+        break;
+      case TSDB_DATA_TYPE_INT:
+        for (i = 0; i < n; i++) *((int32_t *)output + count + i) = (int32_t)buf[i];
+        break;
+      case TSDB_DATA_TYPE_SMALLINT:
+        for (i = 0; i < n; i++) *((int16_t *)output + count + i) = (int16_t)buf[i];
+        break;
+      default:
+        for (i = 0; i < n; i++) *((int8_t *)output + count + i) = (int8_t)buf[i];
+        break;
+    }
+    count += n;
+  }
+
+  return 0;
+}
+
+TD_AVX2_FUNC static int tsDecompressTimestampAvx2(const char *const input, const int nelements, char *const output) {
+  int64_t *ostream = (int64_t *)output;
+  uint64_t buf[COMP_SIMD_CHUNK];
+  int      ipos = 1, opos = 0;
+  int64_t  prev_value = 0;
+  int64_t  prev_delta = 0;
+
+  while (opos < nelements) {
+    int n = MIN(COMP_SIMD_CHUNK, nelements - opos);
+
+    // Unpack the zigzag delta of deltas, the chunk is even so a flag byte never spans two chunks
+    for (int i = 0; i < n; i += 2) {
+      uint8_t flags = input[ipos++];
+      int8_t  nbytes = flags & INT8MASK(4);
+
+      buf[i] = 0;
+      memcpy(buf + i, input + ipos, nbytes);
+      ipos += nbytes;
+
+      if (i + 1 < n) {
+        nbytes = (flags >> 4) & INT8MASK(4);
+        buf[i + 1] = 0;
+        memcpy(buf + i + 1, input + ipos, nbytes);
+        ipos += nbytes;
+      }
+    }
+
+    int i = 0;
+    if (opos == 0) {  // the first value is stored as is
+      prev_value = ZIGZAG_DECODE(int64_t, buf[0]);
+      prev_delta = 0;
+      ostream[0] = prev_value;
+      i = 1;
+    }
+
+    __m256i cdelta = _mm256_set1_epi64x(prev_delta);
+    __m256i cvalue = _mm256_set1_epi64x(prev_value);
+    for (; i + 4 <= n; i += 4) {
+      __m256i delta = tsPrefixSumAvx2(tsZigzagDecodeAvx2(_mm256_loadu_si256((__m256i *)(buf + i))));
+      delta = _mm256_add_epi64(delta, cdelta);
+      cdelta = AVX2_LAST_LANE(delta);
+
+      __m256i value = _mm256_add_epi64(tsPrefixSumAvx2(delta), cvalue);
+      cvalue = AVX2_LAST_LANE(value);
+      _mm256_storeu_si256((__m256i *)(ostream + opos + i), value);
+    }
+    prev_delta = AVX2_FIRST_LANE(cdelta);
+    prev_value = AVX2_FIRST_LANE(cvalue);
+
+    for (; i < n; i++) {
+      int64_t delta_of_delta = ZIGZAG_DECODE(int64_t, buf[i]);
+      prev_delta = delta_of_delta + prev_delta;
+      prev_value = prev_value + prev_delta;
+      ostream[opos + i] = prev_value;
+    }
+
+    opos += n;
+  }
+
+  return 0;
+}
+
+// inclusive prefix xor of the 4 lanes
+TD_AVX2_FUNC static FORCE_INLINE __m256i tsPrefixXor64Avx2(__m256i v) {
+  __m256i zero = _mm256_setzero_si256();
+  v = _mm256_xor_si256(v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, 0x90), zero, 0x03));
+  v = _mm256_xor_si256(v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, 0x40), zero, 0x0F));
+  return v;
+}
+
+// inclusive prefix xor of the 8 lanes
+TD_AVX2_FUNC static FORCE_INLINE __m256i tsPrefixXor32Avx2(__m256i v) {
+  v = _mm256_xor_si256(v, _mm256_slli_si256(v, 4));
+  v = _mm256_xor_si256(v, _mm256_slli_si256(v, 8));
+  __m256i low = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(3));
+  return _mm256_xor_si256(v, _mm256_blend_epi32(low, _mm256_setzero_si256(), 0x0F));
+}
+
+/*
+ * Parse the flags of the following n values, save the flag and the input position of each value, and return the input
+ * position after them. n must be even unless the values are the last ones.
+ */
+static FORCE_INLINE int tsParseXorFlags(const char *const input, int ipos, int n, uint8_t *flag, int32_t *pos) {
+  for (int i = 0; i < n; i += 2) {
+    uint8_t flags = input[ipos++];
+
+    flag[i] = flags & INT8MASK(4);
+    pos[i] = ipos;
+    ipos += (flag[i] & INT8MASK(3)) + 1;
+
+    if (i + 1 < n) {
+      flag[i + 1] = flags >> 4;
+      pos[i + 1] = ipos;
+      ipos += (flag[i + 1] & INT8MASK(3)) + 1;
+    }
+  }
+
+  return ipos;
+}
+
+uint64_t decodeDoubleValue(const char *const input, int *const ipos, uint8_t flag);
+uint32_t decodeFloatValue(const char *const input, int *const ipos, uint8_t flag);
+
+TD_AVX2_FUNC static int tsDecompressDoubleAvx2(const char *const input, const int nelements, char *const output) {
+  uint64_t *ostream = (uint64_t *)output;
+  uint8_t   flag[COMP_SIMD_CHUNK];
+  int32_t   pos[COMP_SIMD_CHUNK];
+  int       ipos = 1, opos = 0;
+  __m256i   carry = _mm256_setzero_si256();
+
+  while (opos < nelements) {
+    int n = MIN(COMP_SIMD_CHUNK, nelements - opos);
+    int iend = tsParseXorFlags(input, ipos, n, flag, pos);
+
+    // Gather the xor differences, a value is fetched by one unaligned load if it does not read beyond the chunk
+    for (int i = 0; i < n; i++) {
+      int      nbytes = (flag[i] & INT8MASK(3)) + 1;
+      uint64_t diff;
+
+      if (pos[i] + LONG_BYTES <= iend) {
+        memcpy(&diff, input + pos[i], LONG_BYTES);
+        if (nbytes < LONG_BYTES) diff &= INT64MASK(nbytes * BITS_PER_BYTE);
+        diff <<= (LONG_BYTES * BITS_PER_BYTE - nbytes * BITS_PER_BYTE) * (flag[i] >> 3);
+      } else {
+        int p = pos[i];
+        diff = decodeDoubleValue(input, &p, flag[i]);
+      }
+      ostream[opos + i] = diff;
+    }
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m256i v = _mm256_xor_si256(tsPrefixXor64Avx2(_mm256_loadu_si256((__m256i *)(ostream + opos + i))), carry);
+      _mm256_storeu_si256((__m256i *)(ostream + opos + i), v);
+      carry = AVX2_LAST_LANE(v);
+    }
+    uint64_t prev_value = (uint64_t)AVX2_FIRST_LANE(carry);
+    for (; i < n; i++) {
+      prev_value ^= ostream[opos + i];
+      ostream[opos + i] = prev_value;
+    }
+    carry = _mm256_set1_epi64x((int64_t)prev_value);
+
+    ipos = iend;
+    opos += n;
+  }
+
+  return 0;
+}
+
+TD_AVX2_FUNC static int tsDecompressFloatAvx2(const char *const input, const int nelements, char *const output) {
+  uint32_t *ostream = (uint32_t *)output;
+  uint8_t   flag[COMP_SIMD_CHUNK];
+  int32_t   pos[COMP_SIMD_CHUNK];
+  int       ipos = 1, opos = 0;
+  __m256i   carry = _mm256_setzero_si256();
+
+  while (opos < nelements) {
+    int n = MIN(COMP_SIMD_CHUNK, nelements - opos);
+    int iend = tsParseXorFlags(input, ipos, n, flag, pos);
+
+    for (int i = 0; i < n; i++) {
+      int      nbytes = (flag[i] & INT8MASK(3)) + 1;
+      uint32_t diff;
+
+      if (nbytes <= FLOAT_BYTES && pos[i] + FLOAT_BYTES <= iend) {
+        memcpy(&diff, input + pos[i], FLOAT_BYTES);
+        if (nbytes < FLOAT_BYTES) diff &= INT32MASK(nbytes * BITS_PER_BYTE);
+        diff <<= (FLOAT_BYTES * BITS_PER_BYTE - nbytes * BITS_PER_BYTE) * (flag[i] >> 3);
+      } else {
+        int p = pos[i];
+        diff = decodeFloatValue(input, &p, flag[i]);
+      }
+      ostream[opos + i] = diff;
+    }
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+      __m256i v = _mm256_xor_si256(tsPrefixXor32Avx2(_mm256_loadu_si256((__m256i *)(ostream + opos + i))), carry);
+      _mm256_storeu_si256((__m256i *)(ostream + opos + i), v);
+      carry = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(7));
+    }
+    uint32_t prev_value = (uint32_t)_mm256_cvtsi256_si32(carry);
+    for (; i < n; i++) {
+      prev_value ^= ostream[opos + i];
+      ostream[opos + i] = prev_value;
+    }
+    carry = _mm256_set1_epi32((int32_t)prev_value);
+
+    ipos = iend;
+    opos += n;
+  }
+
+  return 0;
+}
+#endif
+
+static int tsDecompressINTForImp(const char *const input, const int nelements, char *const output, const char type);
+static int tsDecompressStringZstdImp(const char *const input, int compressedSize, char *const output, int outputSize);
+static int tsDecompressStringDictImp(const char *const input, int compressedSize, char *const output, int outputSize);
+
 /*
  * Compress Integer (Simple8B).
  */
@@ -258,6 +578,18 @@ int tsDecompressINTImp(const char *const input, const int nelements, char *const
     return nelements * word_length;
   }
 
+  if (HEAD_ALGO(input[0]) == ALGO_INT_FOR) {
+    if (tsDecompressINTForImp(input, nelements, output, type) < 0) return -1;
+    return nelements * word_length;
+  }
+
+#ifdef TD_COMPRESS_AVX2
+  if (tsDecompressUseSIMD()) {
+    tsDecompressINTAvx2(input, nelements, output, type);
+    return nelements * word_length;
+  }
+#endif
+
   // Selector value:              0    1   2   3   4   5   6   7   8  9  10  11
   // 12  13  14  15
   char bit_per_integer[] = {0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 15, 20, 30, 60};
@@ -320,6 +652,172 @@ int tsDecompressINTImp(const char *const input, const int nelements, char *const
   return nelements * word_length;
 }
 
+/* ------------------------------------Frame of Reference Compression
+ * ---------------------------------------------- */
+// Header: algorithm(1 byte) + bit width(1 byte) + reference(8 bytes), then the offsets to the reference bit-packed
+#define FOR_HEAD_SIZE (CHAR_BYTES + CHAR_BYTES + LONG_BYTES)
+// An offset plus its bit position in the first byte always fit in one 8-byte load
+#define FOR_MAX_BITS 56
+
+static FORCE_INLINE int64_t getINTValue(const char *const input, int i, const char type) {
+  switch (type) {
+    case TSDB_DATA_TYPE_BIGINT:
+      return *((int64_t *)input + i);
+    case TSDB_DATA_TYPE_INT:
+      return *((int32_t *)input + i);
+    case TSDB_DATA_TYPE_SMALLINT:
+      return *((int16_t *)input + i);
+    default:
+      return *((int8_t *)input + i);
+  }
+}
+
+// Return the bit width needed by the offsets to the minimum value
+static int getINTFrame(const char *const input, const int nelements, const char type, int64_t *pMin) {
+  int64_t min = getINTValue(input, 0, type);
+  int64_t max = min;
+
+  for (int i = 1; i < nelements; i++) {
+    int64_t v = getINTValue(input, i, type);
+    if (v < min) min = v;
+    if (v > max) max = v;
+  }
+
+  uint64_t range = (uint64_t)max - (uint64_t)min;
+
+  *pMin = min;
+  return (range == 0) ? 0 : (LONG_BYTES * BITS_PER_BYTE - BUILDIN_CLZL(range));
+}
+
+/*
+ * Return the compressed size of the frame of reference encoding, or -1 if the value range is too wide for it.
+ */
+int tsGetINTForSize(const char *const input, const int nelements, const char type) {
+  int64_t min = 0;
+
+  if (nelements <= 0) return -1;
+
+  int bits = getINTFrame(input, nelements, type, &min);
+  if (bits > FOR_MAX_BITS) return -1;
+
+  return FOR_HEAD_SIZE + (int)(((int64_t)nelements * bits + BITS_PER_BYTE - 1) / BITS_PER_BYTE);
+}
+
+int tsCompressINTForImp(const char *const input, const int nelements, char *const output, const char type) {
+  int64_t min = 0;
+  int     bits = getINTFrame(input, nelements, type, &min);
+  int     plen = (int)(((int64_t)nelements * bits + BITS_PER_BYTE - 1) / BITS_PER_BYTE);
+
+  assert(nelements > 0 && bits <= FOR_MAX_BITS);
+
+  output[0] = (char)(ALGO_INT_FOR << 1);
+  output[1] = (char)bits;
+  memcpy(output + 2, &min, LONG_BYTES);
+
+  uint8_t *packed = (uint8_t *)(output + FOR_HEAD_SIZE);
+  memset(packed, 0, plen);
+  if (bits == 0) return FOR_HEAD_SIZE;
+
+  for (int i = 0; i < nelements; i++) {
+    uint64_t bitpos = (uint64_t)i * bits;
+    uint64_t offset = ((uint64_t)getINTValue(input, i, type) - (uint64_t)min) << (bitpos % BITS_PER_BYTE);
+    for (uint8_t *p = packed + bitpos / BITS_PER_BYTE; offset; offset >>= BITS_PER_BYTE) {
+      *(p++) |= (uint8_t)offset;
+    }
+  }
+
+  return FOR_HEAD_SIZE + plen;
+}
+
+static FORCE_INLINE void setINTValue(char *const output, int i, int64_t v, const char type) {
+  switch (type) {
+    case TSDB_DATA_TYPE_BIGINT:
+      *((int64_t *)output + i) = v;
+      break;
+    case TSDB_DATA_TYPE_INT:
+      *((int32_t *)output + i) = (int32_t)v;
+      break;
+    case TSDB_DATA_TYPE_SMALLINT:
+      *((int16_t *)output + i) = (int16_t)v;
+      break;
+    default:
+      *((int8_t *)output + i) = (int8_t)v;
+      break;
+  }
+}
+
+#ifdef TD_COMPRESS_AVX2
+// Unpack 4 offsets at a time by gathering the 8 bytes each one starts in, return the number of values decoded
+TD_AVX2_FUNC static int tsDecompressINTForAvx2(const uint8_t *packed, int plen, int bits, int64_t min,
+                                               const int nelements, char *const output, const char type) {
+  int64_t buf[4];
+  __m256i vmask = _mm256_set1_epi64x((int64_t)INT64MASK(bits));
+  __m256i vmin = _mm256_set1_epi64x(min);
+  __m256i vbitpos = _mm256_setr_epi64x(0, bits, 2 * bits, 3 * bits);
+  __m256i vstep = _mm256_set1_epi64x(4 * bits);
+  __m256i vbyte = _mm256_set1_epi64x(BITS_PER_BYTE - 1);
+  int     i = 0;
+
+  // the last gather of the round reads bytes [(i + 3) * bits / 8, (i + 3) * bits / 8 + 8)
+  for (; (int64_t)(i + 3) * bits / BITS_PER_BYTE + LONG_BYTES <= plen && i + 4 <= nelements; i += 4) {
+    __m256i w = _mm256_i64gather_epi64((const long long *)packed, _mm256_srli_epi64(vbitpos, 3), 1);
+    __m256i v = _mm256_add_epi64(_mm256_and_si256(_mm256_srlv_epi64(w, _mm256_and_si256(vbitpos, vbyte)), vmask), vmin);
+    vbitpos = _mm256_add_epi64(vbitpos, vstep);
+
+    if (type == TSDB_DATA_TYPE_BIGINT) {
+      _mm256_storeu_si256((__m256i *)((int64_t *)output + i), v);
+    } else {
+      _mm256_storeu_si256((__m256i *)buf, v);
+      for (int j = 0; j < 4; j++) setINTValue(output, i + j, buf[j], type);
+    }
+  }
+
+  return i;
+}
+#endif
+
+static int tsDecompressINTForImp(const char *const input, const int nelements, char *const output, const char type) {
+  int            bits = (uint8_t)input[1];
+  int64_t        min = 0;
+  const uint8_t *packed = (const uint8_t *)(input + FOR_HEAD_SIZE);
+  int            plen = (int)(((int64_t)nelements * bits + BITS_PER_BYTE - 1) / BITS_PER_BYTE);
+  int            i = 0;
+
+  memcpy(&min, input + 2, LONG_BYTES);
+
+  // never written by the encoder, the data is corrupted
+  if (bits > FOR_MAX_BITS) {
+    uError("Invalid frame of reference bit width:%d", bits);
+    return -1;
+  }
+
+  if (bits == 0) {
+    for (; i < nelements; i++) setINTValue(output, i, min, type);
+    return 0;
+  }
+
+#ifdef TD_COMPRESS_AVX2
+  if (tsDecompressUseSIMD()) {
+    i = tsDecompressINTForAvx2(packed, plen, bits, min, nelements, output, type);
+  }
+#endif
+
+  for (; i < nelements; i++) {
+    uint64_t bitpos = (uint64_t)i * bits;
+    int      start = (int)(bitpos / BITS_PER_BYTE);
+    uint64_t w = 0;
+
+    if (start + LONG_BYTES <= plen) {
+      memcpy(&w, packed + start, LONG_BYTES);
+    } else {
+      memcpy(&w, packed + start, plen - start);
+    }
+    setINTValue(output, i, (int64_t)((uint64_t)min + ((w >> (bitpos % BITS_PER_BYTE)) & INT64MASK(bits))), type);
+  }
+
+  return 0;
+}
+
 /* ----------------------------------------------Bool Compression
  * ---------------------------------------------- */
 // TODO: You can also implement it using RLE method.
@@ -449,7 +947,11 @@ int tsCompressStringImp(const char *const input, int inputSize, char *const outp
 int tsDecompressStringImp(const char *const input, int compressedSize, char *const output, int outputSize) {
   // compressedSize is the size of data after compression.
   
-  if (input[0] == 1) {
+  if (HEAD_ALGO(input[0]) == ALGO_STR_DICT) {
+    return tsDecompressStringDictImp(input, compressedSize, output, outputSize);
+  } else if (HEAD_ALGO(input[0]) == ALGO_ZSTD) {
+    return tsDecompressStringZstdImp(input, compressedSize, output, outputSize);
+  } else if (input[0] == 1) {
     /* It is compressed by LZ4 algorithm */
     const int decompressed_size = LZ4_decompress_safe(input + 1, output, compressedSize - 1, outputSize);
     if (decompressed_size < 0) {
@@ -468,6 +970,205 @@ int tsDecompressStringImp(const char *const input, int compressedSize, char *con
   }
 }
 
+/* ----------------------------------------------Zstd Compression
+ * ---------------------------------------------- */
+// The contexts are kept by each thread since creating them for each column block is expensive, and freed by the
+// destructor of zstdKey when the thread exits
+#ifdef TD_TSZ
+typedef struct {
+  ZSTD_CCtx *cctx;
+  ZSTD_DCtx *dctx;
+} SZstdCtx;
+
+static pthread_once_t zstdKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t  zstdKey;
+
+static void tsFreeZstdCtx(void *param) {
+  SZstdCtx *pCtx = (SZstdCtx *)param;
+
+  ZSTD_freeCCtx(pCtx->cctx);
+  ZSTD_freeDCtx(pCtx->dctx);
+  free(pCtx);
+}
+
+static void tsInitZstdKey() { pthread_key_create(&zstdKey, tsFreeZstdCtx); }
+
+static SZstdCtx *tsGetZstdCtx() {
+  pthread_once(&zstdKeyOnce, tsInitZstdKey);
+
+  SZstdCtx *pCtx = (SZstdCtx *)pthread_getspecific(zstdKey);
+  if (pCtx == NULL) {
+    pCtx = (SZstdCtx *)calloc(1, sizeof(SZstdCtx));
+    if (pCtx == NULL) return NULL;
+    if (pthread_setspecific(zstdKey, pCtx) != 0) {
+      free(pCtx);
+      return NULL;
+    }
+  }
+
+  return pCtx;
+}
+#endif
+
+// Same output size requirement as tsCompressStringImp, it falls back to LZ4 if zstd is not built in
+int tsCompressStringZstdImp(const char *const input, int inputSize, char *const output, int outputSize) {
+#ifdef TD_TSZ
+  SZstdCtx *pCtx = tsGetZstdCtx();
+  if (pCtx != NULL && pCtx->cctx == NULL) {
+    pCtx->cctx = ZSTD_createCCtx();
+  }
+
+  if (pCtx != NULL && pCtx->cctx != NULL) {
+    size_t len = ZSTD_compressCCtx(pCtx->cctx, output + 1, outputSize - 1, input, inputSize, tsZstdLevel);
+    if (!ZSTD_isError(len) && len < (size_t)inputSize) {
+      output[0] = (char)((ALGO_ZSTD << 1) | MODE_COMPRESS);
+      return (int)len + 1;
+    }
+  }
+#endif
+
+  return tsCompressStringImp(input, inputSize, output, outputSize);
+}
+
+static int tsDecompressStringZstdImp(const char *const input, int compressedSize, char *const output, int outputSize) {
+#ifdef TD_TSZ
+  SZstdCtx *pCtx = tsGetZstdCtx();
+  if (pCtx != NULL && pCtx->dctx == NULL) {
+    pCtx->dctx = ZSTD_createDCtx();
+  }
+
+  if (pCtx == NULL || pCtx->dctx == NULL) {
+    uError("Failed to create zstd decompression context");
+    return -1;
+  }
+
+  size_t len = ZSTD_decompressDCtx(pCtx->dctx, output, outputSize, input + 1, compressedSize - 1);
+  if (ZSTD_isError(len)) {
+    uError("Failed to decompress string with zstd algorithm, reason:%s", ZSTD_getErrorName(len));
+    return -1;
+  }
+
+  return (int)len;
+#else
+  uError("Failed to decompress string with zstd algorithm since it is not supported");
+  return -1;
+#endif
+}
+
+/* ----------------------------------------Dictionary Compression
+ * ---------------------------------------------- */
+// Header: algorithm(1 byte) + number of entries(2 bytes), then the entries and one code byte for each value
+#define DICT_HEAD_SIZE (CHAR_BYTES + SHORT_BYTES)
+#define DICT_MAX_ENTRIES 256
+#define DICT_HASH_SLOTS 512  // must be a power of 2 and larger than DICT_MAX_ENTRIES
+
+/*
+ * Dictionary encode nelements var data values. Return the compressed size, or -1 if the values have more than
+ * DICT_MAX_ENTRIES distinct ones or the result does not fit in outputSize.
+ */
+int tsCompressStringDictImp(const char *const input, int inputSize, const int nelements, char *const output,
+                            int outputSize) {
+  int16_t     slots[DICT_HASH_SLOTS];
+  const char *entries[DICT_MAX_ENTRIES];
+  int         nEntries = 0;
+  int         opos = DICT_HEAD_SIZE;
+  int         ipos = 0;
+
+  // The codes are put at the end of output at first, and moved after the entries when all entries are known
+  char *codes = output + outputSize - nelements;
+  if (codes < output + DICT_HEAD_SIZE) return -1;
+
+  memset(slots, -1, sizeof(slots));
+
+  for (int i = 0; i < nelements; i++) {
+    const char *v = input + ipos;
+    int         len = (int)varDataTLen(v);
+    uint32_t    slot = MurmurHash3_32(v, len) & (DICT_HASH_SLOTS - 1);
+
+    if (ipos + len > inputSize) return -1;
+    ipos += len;
+
+    while (slots[slot] >= 0 && (varDataTLen(entries[slots[slot]]) != len || memcmp(entries[slots[slot]], v, len) != 0)) {
+      slot = (slot + 1) & (DICT_HASH_SLOTS - 1);
+    }
+
+    if (slots[slot] < 0) {
+      if (nEntries >= DICT_MAX_ENTRIES || output + opos + len > codes) return -1;
+      memcpy(output + opos, v, len);
+      entries[nEntries] = output + opos;
+      slots[slot] = (int16_t)nEntries++;
+      opos += len;
+    }
+
+    codes[i] = (char)slots[slot];
+  }
+
+  memmove(output + opos, codes, nelements);
+
+  uint16_t n = (uint16_t)nEntries;
+  output[0] = (char)(ALGO_STR_DICT << 1);
+  memcpy(output + 1, &n, SHORT_BYTES);
+
+  return opos + nelements;
+}
+
+static int tsDecompressStringDictImp(const char *const input, int compressedSize, char *const output, int outputSize) {
+  const char *entries[DICT_MAX_ENTRIES];
+  uint16_t    nEntries = 0;
+  int         ipos = DICT_HEAD_SIZE;
+  int         opos = 0;
+
+  memcpy(&nEntries, input + 1, SHORT_BYTES);
+  if (nEntries > DICT_MAX_ENTRIES) goto _err;
+
+  for (int i = 0; i < nEntries; i++) {
+    if (ipos + (int)sizeof(VarDataLenT) > compressedSize) goto _err;
+    entries[i] = input + ipos;
+    ipos += (int)varDataTLen(entries[i]);
+    if (ipos > compressedSize) goto _err;
+  }
+
+  for (; ipos < compressedSize; ipos++) {
+    uint8_t code = (uint8_t)input[ipos];
+    if (code >= nEntries) goto _err;
+
+    int len = (int)varDataTLen(entries[code]);
+    if (opos + len > outputSize) goto _err;
+
+    memcpy(output + opos, entries[code], len);
+    opos += len;
+  }
+
+  return opos;
+
+_err:
+  uError("Failed to decompress string with dictionary, compressed size:%d", compressedSize);
+  return -1;
+}
+
+/*
+ * Point *codes to the per-row dictionary codes of a dictionary encoded string column. Return the number of codes, or -1
+ * if the input is not dictionary encoded.
+ */
+int tsGetStringDictCodes(const char *const input, int compressedSize, const uint8_t **codes) {
+  uint16_t nEntries = 0;
+  int      ipos = DICT_HEAD_SIZE;
+
+  if (compressedSize < DICT_HEAD_SIZE || HEAD_ALGO(input[0]) != ALGO_STR_DICT) return -1;
+
+  memcpy(&nEntries, input + 1, SHORT_BYTES);
+  if (nEntries > DICT_MAX_ENTRIES) return -1;
+
+  for (int i = 0; i < nEntries; i++) {
+    if (ipos + (int)sizeof(VarDataLenT) > compressedSize) return -1;
+    ipos += (int)varDataTLen(input + ipos);
+    if (ipos > compressedSize) return -1;
+  }
+
+  *codes = (const uint8_t *)(input + ipos);
+  return compressedSize - ipos;
+}
+
 /* --------------------------------------------Timestamp Compression
  * ---------------------------------------------- */
 // TODO: Take care here, we assumes little endian encoding.
@@ -575,6 +1276,13 @@ int tsDecompressTimestampImp(const char *const input, const int nelements, char
     memcpy(output, input + 1, nelements * LONG_BYTES);
     return nelements * LONG_BYTES;
   } else if (input[0] == 1) {  // Decompress
+#ifdef TD_COMPRESS_AVX2
+    if (tsDecompressUseSIMD()) {
+      tsDecompressTimestampAvx2(input, nelements, output);
+      return nelements * LONG_BYTES;
+    }
+#endif
+
     int64_t *ostream = (int64_t *)output;
 
     int     ipos = 1, opos = 0;
@@ -755,6 +1463,13 @@ int tsDecompressDoubleImp(const char *const input, const int nelements, char *co
     return nelements * DOUBLE_BYTES;
   }
 
+#ifdef TD_COMPRESS_AVX2
+  if (tsDecompressUseSIMD()) {
+    tsDecompressDoubleAvx2(input, nelements, output);
+    return nelements * DOUBLE_BYTES;
+  }
+#endif
+
   uint8_t  flags = 0;
   int      ipos = 1;
   int      opos = 0;
@@ -901,6 +1616,13 @@ int tsDecompressFloatImp(const char *const input, const int nelements, char *con
     return nelements * FLOAT_BYTES;
   }
 
+#ifdef TD_COMPRESS_AVX2
+  if (tsDecompressUseSIMD()) {
+    tsDecompressFloatAvx2(input, nelements, output);
+    return nelements * FLOAT_BYTES;
+  }
+#endif
+
   uint8_t  flags = 0;
   int      ipos = 1;
   int      opos = 0;
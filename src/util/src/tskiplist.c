@@ -28,6 +28,7 @@ static SSkipListIterator *doCreateSkipListIterator(SSkipList *pSkipList, int32_t
 static void tSkipListDoInsert(SSkipList *pSkipList, SSkipListNode **direction, SSkipListNode *pNode, bool isForward);
 static bool tSkipListGetPosToPut(SSkipList *pSkipList, SSkipListNode **backward, void *pData);
 static SSkipListNode *tSkipListNewNode(uint8_t level);
+static SSkipListNode *tSkipListAllocNode(SSkipList *pSkipList, uint8_t level);
 #define tSkipListFreeNode(n) tfree((n))
 static SSkipListNode *tSkipListPutImpl(SSkipList *pSkipList, void *pData, SSkipListNode **direction, bool isForward,
                                        bool hasDup);
@@ -94,7 +95,8 @@ void tSkipListDestroy(SSkipList *pSkipList) {
 
   SSkipListNode *pNode = SL_NODE_GET_FORWARD_POINTER(pSkipList->pHead, 0);
 
-  while (pNode != pSkipList->pTail) {
+  // the memory of the allocator may be already released, do not touch the nodes
+  while (pSkipList->allocNodeFn == NULL && pNode != pSkipList->pTail) {
     SSkipListNode *pTemp = pNode;
     pNode = SL_NODE_GET_FORWARD_POINTER(pNode, 0);
     tSkipListFreeNode(pTemp);
@@ -113,6 +115,16 @@ void tSkipListDestroy(SSkipList *pSkipList) {
   tfree(pSkipList);
 }
 
+/**
+ * Allocate the data nodes by fn(param, bytes) instead of calloc, the head and tail are still from the heap. Should be
+ * called before any node is put and the nodes are released with the allocator, not by the skip list.
+ */
+void tSkipListSetNodeAllocator(SSkipList *pSkipList, sl_alloc_node_fn_t fn, void *param) {
+  ASSERT(pSkipList->size == 0);
+  pSkipList->allocNodeFn = fn;
+  pSkipList->allocParam = param;
+}
+
 SSkipListNode *tSkipListPut(SSkipList *pSkipList, void *pData) {
   if (pSkipList == NULL || pData == NULL) return NULL;
 
@@ -535,7 +547,7 @@ static void tSkipListRemoveNodeImpl(SSkipList *pSkipList, SSkipListNode *pNode)
     SL_NODE_GET_BACKWARD_POINTER(next, j) = prev;
   }
 
-  tSkipListFreeNode(pNode);
+  if (pSkipList->allocNodeFn == NULL) tSkipListFreeNode(pNode);
   pSkipList->size--;
 }
 
@@ -677,6 +689,19 @@ static SSkipListNode *tSkipListNewNode(uint8_t level) {
   return pNode;
 }
 
+static SSkipListNode *tSkipListAllocNode(SSkipList *pSkipList, uint8_t level) {
+  if (pSkipList->allocNodeFn == NULL) return tSkipListNewNode(level);
+
+  int32_t tsize = sizeof(SSkipListNode) + sizeof(SSkipListNode *) * level * 2;
+
+  SSkipListNode *pNode = (SSkipListNode *)pSkipList->allocNodeFn(pSkipList->allocParam, tsize);
+  if (pNode == NULL) return NULL;
+
+  memset(pNode, 0, tsize);
+  pNode->level = level;
+  return pNode;
+}
+
 static SSkipListNode *tSkipListPutImpl(SSkipList *pSkipList, void *pData, SSkipListNode **direction, bool isForward,
                                        bool hasDup) {
   uint8_t        dupMode = SL_DUP_MODE(pSkipList);
@@ -706,7 +731,7 @@ static SSkipListNode *tSkipListPutImpl(SSkipList *pSkipList, void *pData, SSkipL
       }
     }
   } else {
-    pNode = tSkipListNewNode(getSkipListRandLevel(pSkipList));
+    pNode = tSkipListAllocNode(pSkipList, getSkipListRandLevel(pSkipList));
     if (pNode != NULL) {
       // insertHandleFn will be assigned only for timeseries data,
       // in which case, pData is pointed to an memory to be freed later;
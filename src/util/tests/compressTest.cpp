@@ -0,0 +1,473 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "os.h"
+#include "tscompression.h"
+#include "ttype.h"
+
+namespace {
+
+double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+int typeBytes(char type) {
+  switch (type) {
+    case TSDB_DATA_TYPE_BIGINT:
+      return LONG_BYTES;
+    case TSDB_DATA_TYPE_INT:
+      return INT_BYTES;
+    case TSDB_DATA_TYPE_SMALLINT:
+      return SHORT_BYTES;
+    default:
+      return CHAR_BYTES;
+  }
+}
+
+// Integers whose differences need from 0 up to maxBits bits, with runs of equal values
+std::vector<int64_t> genIntegers(std::mt19937_64 &rng, int nelements, int maxBits) {
+  std::vector<int64_t> data(nelements);
+  int64_t              v = 0;
+
+  for (int i = 0; i < nelements; i++) {
+    int bits = (int)(rng() % (maxBits + 1));
+    if (rng() % 4 != 0 && bits > 0) {
+      int64_t diff = (int64_t)(rng() & ((((uint64_t)1) << bits) - 1)) - (((int64_t)1) << (bits - 1));
+      v += diff;
+    }
+    data[i] = v;
+  }
+
+  return data;
+}
+
+void decodeINT(const std::vector<char> &comp, int nelements, char type, bool simd, std::vector<char> &out) {
+  out.assign(nelements * typeBytes(type), 0);
+  tsSetDecompressSIMD(simd);
+  ASSERT_EQ(tsDecompressINTImp(comp.data(), nelements, out.data(), type), nelements * typeBytes(type));
+}
+
+void checkINT(std::mt19937_64 &rng, char type, int nelements, int maxBits) {
+  std::vector<int64_t> values = genIntegers(rng, nelements, maxBits);
+  int                  bytes = typeBytes(type);
+  std::vector<char>    input(nelements * bytes);
+  std::vector<char>    comp(nelements * bytes + 64);
+
+  for (int i = 0; i < nelements; i++) {
+    switch (type) {
+      case TSDB_DATA_TYPE_BIGINT:
+        ((int64_t *)input.data())[i] = values[i];
+        break;
+      case TSDB_DATA_TYPE_INT:
+        ((int32_t *)input.data())[i] = (int32_t)values[i];
+        break;
+      case TSDB_DATA_TYPE_SMALLINT:
+        ((int16_t *)input.data())[i] = (int16_t)values[i];
+        break;
+      default:
+        ((int8_t *)input.data())[i] = (int8_t)values[i];
+        break;
+    }
+  }
+
+  tsCompressINTImp(input.data(), nelements, comp.data(), type);
+
+  std::vector<char> scalar, simd;
+  decodeINT(comp, nelements, type, false, scalar);
+  decodeINT(comp, nelements, type, true, simd);
+  ASSERT_TRUE(scalar == input);
+  ASSERT_TRUE(simd == scalar);
+}
+
+std::vector<int64_t> genTimestamps(std::mt19937_64 &rng, int nelements, int64_t jitter) {
+  std::vector<int64_t> data(nelements);
+  int64_t              ts = 1600000000000L;
+
+  for (int i = 0; i < nelements; i++) {
+    ts += 1000 + (jitter ? (int64_t)(rng() % jitter) - jitter / 2 : 0);
+    data[i] = ts;
+  }
+
+  return data;
+}
+
+void checkTimestamp(const std::vector<int64_t> &input) {
+  int               nelements = (int)input.size();
+  std::vector<char> comp(nelements * LONG_BYTES + 64);
+
+  tsCompressTimestampImp((const char *)input.data(), nelements, comp.data());
+
+  std::vector<int64_t> scalar(nelements), simd(nelements);
+  tsSetDecompressSIMD(false);
+  ASSERT_EQ(tsDecompressTimestampImp(comp.data(), nelements, (char *)scalar.data()), nelements * LONG_BYTES);
+  tsSetDecompressSIMD(true);
+  ASSERT_EQ(tsDecompressTimestampImp(comp.data(), nelements, (char *)simd.data()), nelements * LONG_BYTES);
+  ASSERT_TRUE(scalar == input);
+  ASSERT_TRUE(simd == scalar);
+}
+
+// Bit patterns the XOR encoder handles differently: repeats, slow drift, sign flips, special values and random bits
+template <typename T, typename U>
+std::vector<T> genReals(std::mt19937_64 &rng, int nelements, int pattern) {
+  std::vector<T> data(nelements);
+  T              v = (T)20.5;
+
+  for (int i = 0; i < nelements; i++) {
+    switch (pattern) {
+      case 0:
+        v = (rng() % 8 == 0) ? (T)(rng() % 100) : v;
+        break;
+      case 1:
+        v += (T)((int64_t)(rng() % 1000) - 500) / 1000;
+        break;
+      case 2: {
+        const T specials[] = {(T)0, -(T)0, (T)NAN, (T)INFINITY, -(T)INFINITY, std::numeric_limits<T>::denorm_min(),
+                              std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest(), (T)1, (T)-1};
+        v = specials[rng() % (sizeof(specials) / sizeof(specials[0]))];
+        break;
+      }
+      default: {
+        U bits = (U)rng();
+        memcpy(&v, &bits, sizeof(v));
+        break;
+      }
+    }
+    data[i] = v;
+  }
+
+  return data;
+}
+
+template <typename T>
+void checkReal(const std::vector<T> &input, int (*compress)(const char *const, const int, char *const),
+               int (*decompress)(const char *const, const int, char *const)) {
+  int               nelements = (int)input.size();
+  int               bytes = nelements * (int)sizeof(T);
+  std::vector<char> comp(bytes + 64);
+
+  compress((const char *)input.data(), nelements, comp.data());
+
+  std::vector<T> scalar(nelements), simd(nelements);
+  tsSetDecompressSIMD(false);
+  ASSERT_EQ(decompress(comp.data(), nelements, (char *)scalar.data()), bytes);
+  tsSetDecompressSIMD(true);
+  ASSERT_EQ(decompress(comp.data(), nelements, (char *)simd.data()), bytes);
+
+  // compare the bits, NaN != NaN
+  ASSERT_EQ(memcmp(scalar.data(), input.data(), bytes), 0);
+  ASSERT_EQ(memcmp(simd.data(), scalar.data(), bytes), 0);
+}
+
+}  // namespace
+
+TEST(compressTest, decompressINT_simd) {
+  std::mt19937_64 rng(2021);
+  const char      types[] = {TSDB_DATA_TYPE_BIGINT, TSDB_DATA_TYPE_INT, TSDB_DATA_TYPE_SMALLINT, TSDB_DATA_TYPE_TINYINT};
+  const int       sizes[] = {1, 2, 3, 5, 7, 239, 240, 241, 1023, 1024, 1025, 4096, 5000};
+
+  for (char type : types) {
+    for (int n : sizes) {
+      for (int maxBits = 0; maxBits <= 60; maxBits += 6) {
+        checkINT(rng, type, n, std::min(maxBits, typeBytes(type) * 8));
+      }
+    }
+  }
+
+  tsSetDecompressSIMD(true);
+}
+
+TEST(compressTest, compressINT_for) {
+  std::mt19937_64 rng(2021);
+  const char      types[] = {TSDB_DATA_TYPE_BIGINT, TSDB_DATA_TYPE_INT, TSDB_DATA_TYPE_SMALLINT, TSDB_DATA_TYPE_TINYINT};
+  const int       sizes[] = {1, 2, 3, 5, 7, 8, 9, 63, 64, 65, 1000, 4096};
+
+  for (char type : types) {
+    int bytes = typeBytes(type);
+    for (int n : sizes) {
+      for (int bits = 0; bits <= std::min(bytes * 8, 56); bits++) {
+        // random values in [base, base + 2^bits)
+        std::vector<char> input(n * bytes);
+        int64_t           base = (int64_t)rng();
+        for (int i = 0; i < n; i++) {
+          int64_t v = base + (bits ? (int64_t)(rng() & ((((uint64_t)1) << bits) - 1)) : 0);
+          memcpy(input.data() + i * bytes, &v, bytes);
+        }
+
+        int expect = tsGetINTForSize(input.data(), n, type);
+        if (expect < 0) continue;
+
+        std::vector<char> comp(expect + 8);
+        ASSERT_EQ(tsCompressINTForImp(input.data(), n, comp.data(), type), expect);
+        ASSERT_EQ(HEAD_ALGO(comp[0]), ALGO_INT_FOR);
+
+        std::vector<char> scalar, simd;
+        decodeINT(comp, n, type, false, scalar);
+        decodeINT(comp, n, type, true, simd);
+        ASSERT_TRUE(scalar == input);
+        ASSERT_TRUE(simd == input);
+      }
+    }
+  }
+
+  // a full range bigint column can not be encoded
+  int64_t wide[] = {INT64_MIN, INT64_MAX};
+  ASSERT_EQ(tsGetINTForSize((char *)wide, 2, TSDB_DATA_TYPE_BIGINT), -1);
+
+  // a bit width the encoder never writes is rejected as corrupted
+  int64_t           narrow[] = {1, 2, 3};
+  std::vector<char> comp(64), out(3 * LONG_BYTES);
+  ASSERT_GT(tsCompressINTForImp((char *)narrow, 3, comp.data(), TSDB_DATA_TYPE_BIGINT), 0);
+  comp[1] = 57;
+  ASSERT_EQ(tsDecompressINTImp(comp.data(), 3, out.data(), TSDB_DATA_TYPE_BIGINT), -1);
+
+  tsSetDecompressSIMD(true);
+}
+
+TEST(compressTest, compressString_dict) {
+  std::mt19937_64 rng(2021);
+  const int       sizes[] = {1, 2, 100, 4096};
+  const int       cardinalities[] = {1, 5, 50, 256, 257};
+
+  for (int n : sizes) {
+    for (int card : cardinalities) {
+      std::vector<std::string> dict;
+      for (int i = 0; i < card; i++) dict.push_back("status_" + std::to_string(i * 7919) + std::string(i % 5, 'x'));
+
+      // var data: length + string of each value
+      std::vector<char> input;
+      for (int i = 0; i < n; i++) {
+        const std::string &v = dict[(i < card) ? i : rng() % card];
+        VarDataLenT        len = (VarDataLenT)v.size();
+        input.insert(input.end(), (char *)&len, (char *)&len + sizeof(len));
+        input.insert(input.end(), v.begin(), v.end());
+      }
+
+      std::vector<char> comp(input.size() * 2 + 64);
+      int len = tsCompressStringDictImp(input.data(), (int)input.size(), n, comp.data(), (int)comp.size());
+      if (std::min(n, card) > 256) {
+        ASSERT_EQ(len, -1);
+        continue;
+      }
+      ASSERT_GT(len, 0);
+      ASSERT_EQ(HEAD_ALGO(comp[0]), ALGO_STR_DICT);
+
+      std::vector<char> out(input.size());
+      ASSERT_EQ(tsDecompressStringImp(comp.data(), len, out.data(), (int)out.size()), (int)input.size());
+      ASSERT_TRUE(out == input);
+
+      // one code per row, the same code for the same value
+      const uint8_t *codes = NULL;
+      ASSERT_EQ(tsGetStringDictCodes(comp.data(), len, &codes), n);
+      std::vector<int> firstRow(256, -1);
+      for (int i = 0, ipos = 0; i < n; ipos += (int)varDataTLen(input.data() + ipos), i++) {
+        if (firstRow[codes[i]] < 0) {
+          firstRow[codes[i]] = ipos;
+          continue;
+        }
+        const char *first = input.data() + firstRow[codes[i]];
+        ASSERT_EQ(memcmp(first, input.data() + ipos, varDataTLen(first)), 0);
+      }
+      ASSERT_EQ(tsGetStringDictCodes(input.data(), (int)input.size(), &codes), -1);
+
+      // does not fit
+      ASSERT_EQ(tsCompressStringDictImp(input.data(), (int)input.size(), n, comp.data(), len - 1), -1);
+
+      // a code out of the dictionary
+      comp[len - 1] = (char)0xFF;
+      if (std::min(n, card) < 256) {
+        ASSERT_EQ(tsDecompressStringImp(comp.data(), len, out.data(), (int)out.size()), -1);
+      }
+    }
+  }
+}
+
+TEST(compressTest, compressTwoStage_zstd) {
+  std::mt19937_64 rng(2021);
+  const int       sizes[] = {1, 100, 4096};
+
+  for (int n : sizes) {
+    std::vector<int64_t> data = genTimestamps(rng, n, 1000);
+    int                  size = n * (int)sizeof(int64_t);
+
+    std::vector<char> buf(size + COMP_OVERFLOW_BYTES), comp(size + COMP_OVERFLOW_BYTES);
+    std::vector<char> lz4(size + COMP_OVERFLOW_BYTES), out(size);
+
+    int len = tsCompressTimestamp((char *)data.data(), size, n, comp.data(), (int)comp.size(), TWO_STAGE_COMP_ZSTD,
+                                  buf.data(), (int)buf.size());
+    ASSERT_GT(len, 0);
+    if (n > 1) {
+      ASSERT_EQ(HEAD_ALGO(comp[0]), ALGO_ZSTD);
+    }
+    ASSERT_EQ(tsDecompressTimestamp(comp.data(), len, n, out.data(), size, TWO_STAGE_COMP_ZSTD, buf.data(),
+                                    (int)buf.size()),
+              size);
+    ASSERT_EQ(memcmp(out.data(), data.data(), size), 0);
+
+    // the second stage is told by the data, so zstd blocks can be read as TWO_STAGE_COMP and vice versa
+    ASSERT_EQ(tsDecompressTimestamp(comp.data(), len, n, out.data(), size, TWO_STAGE_COMP, buf.data(),
+                                    (int)buf.size()),
+              size);
+    ASSERT_EQ(memcmp(out.data(), data.data(), size), 0);
+
+    int lz4Len = tsCompressTimestamp((char *)data.data(), size, n, lz4.data(), (int)lz4.size(), TWO_STAGE_COMP,
+                                     buf.data(), (int)buf.size());
+    ASSERT_EQ(tsDecompressTimestamp(lz4.data(), lz4Len, n, out.data(), size, TWO_STAGE_COMP_ZSTD, buf.data(),
+                                    (int)buf.size()),
+              size);
+    ASSERT_EQ(memcmp(out.data(), data.data(), size), 0);
+  }
+
+  // strings
+  std::string input;
+  for (int i = 0; i < 1000; i++) input += "host_" + std::to_string(rng() % 20) + ".taosdata.com;";
+  std::vector<char> comp(input.size() + COMP_OVERFLOW_BYTES), out(input.size());
+  int len = tsCompressString(input.data(), (int)input.size(), 1, comp.data(), (int)comp.size(), TWO_STAGE_COMP_ZSTD,
+                             NULL, 0);
+  ASSERT_GT(len, 0);
+  ASSERT_LT(len, (int)input.size() / 4);
+  ASSERT_EQ(tsDecompressString(comp.data(), len, 1, out.data(), (int)out.size(), TWO_STAGE_COMP_ZSTD, NULL, 0),
+            (int)input.size());
+  ASSERT_EQ(memcmp(out.data(), input.data(), input.size()), 0);
+
+  // truncated
+  ASSERT_EQ(tsDecompressString(comp.data(), len - 1, 1, out.data(), (int)out.size(), TWO_STAGE_COMP_ZSTD, NULL, 0), -1);
+}
+
+TEST(compressTest, decompressTimestamp_simd) {
+  std::mt19937_64 rng(2021);
+  const int       sizes[] = {1, 2, 3, 4, 5, 8, 1023, 1024, 1025, 2048, 4096, 5001};
+
+  for (int n : sizes) {
+    checkTimestamp(genTimestamps(rng, n, 0));
+    checkTimestamp(genTimestamps(rng, n, 100));
+    checkTimestamp(genTimestamps(rng, n, 1000000));
+
+    std::vector<int64_t> data(n);
+    for (int i = 0; i < n; i++) data[i] = (int64_t)(rng() >> 8) - (int64_t)(rng() >> 8);
+    checkTimestamp(data);
+  }
+
+  tsSetDecompressSIMD(true);
+}
+
+TEST(compressTest, decompressDouble_fuzz) {
+  std::mt19937_64 rng(2021);
+
+  for (int round = 0; round < 200; round++) {
+    int n = (round < 20) ? round + 1 : (int)(rng() % 5000) + 1;
+    for (int pattern = 0; pattern < 4; pattern++) {
+      checkReal(genReals<double, uint64_t>(rng, n, pattern), tsCompressDoubleImp, tsDecompressDoubleImp);
+    }
+  }
+
+  tsSetDecompressSIMD(true);
+}
+
+TEST(compressTest, decompressFloat_fuzz) {
+  std::mt19937_64 rng(2021);
+
+  for (int round = 0; round < 200; round++) {
+    int n = (round < 20) ? round + 1 : (int)(rng() % 5000) + 1;
+    for (int pattern = 0; pattern < 4; pattern++) {
+      checkReal(genReals<float, uint32_t>(rng, n, pattern), tsCompressFloatImp, tsDecompressFloatImp);
+    }
+  }
+
+  tsSetDecompressSIMD(true);
+}
+
+TEST(compressTest, decompress_throughput) {
+  std::mt19937_64 rng(2021);
+  const int       nelements = 4096;
+  const int       loops = 2000;
+
+  std::vector<int64_t> ints = genIntegers(rng, nelements, 12);
+  std::vector<int64_t> ts = genTimestamps(rng, nelements, 100);
+  std::vector<double>  reals = genReals<double, uint64_t>(rng, nelements, 1);
+  std::vector<int32_t> gauges(nelements);
+  for (int i = 0; i < nelements; i++) gauges[i] = (int32_t)(rng() % 100);
+  std::vector<char>    intComp(nelements * LONG_BYTES + 64), tsComp(nelements * LONG_BYTES + 64);
+  std::vector<char>    realComp(nelements * DOUBLE_BYTES + 64);
+  std::vector<char>    s8bComp(nelements * INT_BYTES + 64), forComp(nelements * INT_BYTES + 64);
+  std::vector<char>    out(nelements * LONG_BYTES);
+
+  tsCompressINTImp((const char *)ints.data(), nelements, intComp.data(), TSDB_DATA_TYPE_BIGINT);
+  tsCompressTimestampImp((const char *)ts.data(), nelements, tsComp.data());
+  tsCompressDoubleImp((const char *)reals.data(), nelements, realComp.data());
+  int s8bLen = tsCompressINTImp((const char *)gauges.data(), nelements, s8bComp.data(), TSDB_DATA_TYPE_INT);
+  int forLen = tsCompressINTForImp((const char *)gauges.data(), nelements, forComp.data(), TSDB_DATA_TYPE_INT);
+  std::cout << "gauge of 0-99, simple8b: " << s8bLen << " bytes, frame of reference: " << forLen << " bytes"
+            << std::endl;
+
+  for (int simd = 0; simd < 2; simd++) {
+    if (simd && !tsSetDecompressSIMD(true)) {
+      std::cout << "SIMD decoders are not supported by this CPU" << std::endl;
+      break;
+    }
+    tsSetDecompressSIMD(simd);
+
+    double st = getCurTime();
+    for (int i = 0; i < loops; i++) tsDecompressINTImp(intComp.data(), nelements, out.data(), TSDB_DATA_TYPE_BIGINT);
+    double intTime = getCurTime() - st;
+
+    st = getCurTime();
+    for (int i = 0; i < loops; i++) tsDecompressTimestampImp(tsComp.data(), nelements, out.data());
+    double tsTime = getCurTime() - st;
+
+    st = getCurTime();
+    for (int i = 0; i < loops; i++) tsDecompressDoubleImp(realComp.data(), nelements, out.data());
+    double realTime = getCurTime() - st;
+
+    st = getCurTime();
+    for (int i = 0; i < loops; i++) tsDecompressINTImp(s8bComp.data(), nelements, out.data(), TSDB_DATA_TYPE_INT);
+    double s8bTime = getCurTime() - st;
+
+    st = getCurTime();
+    for (int i = 0; i < loops; i++) tsDecompressINTImp(forComp.data(), nelements, out.data(), TSDB_DATA_TYPE_INT);
+    double forTime = getCurTime() - st;
+
+    std::cout << (simd ? "simd  " : "scalar") << " bigint: " << (double)nelements * loops / intTime / 1e6
+              << " M values/s, timestamp: " << (double)nelements * loops / tsTime / 1e6
+              << " M values/s, double: " << (double)nelements * loops / realTime / 1e6
+              << " M values/s, gauge simple8b: " << (double)nelements * loops / s8bTime / 1e6
+              << " M values/s, gauge frame of reference: " << (double)nelements * loops / forTime / 1e6 << " M values/s"
+              << std::endl;
+  }
+
+  tsSetDecompressSIMD(true);
+}
+
+TEST(compressTest, compressString_zstd_threads) {
+  // each thread gets its own zstd contexts, freed when the thread exits
+  auto roundTrip = [](int seed, bool *ok) {
+    std::mt19937_64   rng(seed);
+    std::vector<char> input(65536), comp(65536 + 64), out(65536);
+
+    for (size_t i = 0; i < input.size(); i++) input[i] = 'a' + rng() % 4;
+    *ok = true;
+    for (int loop = 0; loop < 8 && *ok; loop++) {
+      int clen = tsCompressStringZstdImp(input.data(), (int)input.size(), comp.data(), (int)comp.size());
+      int dlen = tsDecompressStringImp(comp.data(), clen, out.data(), (int)out.size());
+      *ok = (clen > 0 && clen < (int)input.size() && dlen == (int)input.size() && out == input);
+    }
+  };
+
+  for (int round = 0; round < 4; round++) {
+    bool                     oks[4];
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) threads.emplace_back(roundTrip, round * 4 + t, &oks[t]);
+    for (auto &thread : threads) thread.join();
+    for (bool ok : oks) ASSERT_TRUE(ok);
+  }
+}
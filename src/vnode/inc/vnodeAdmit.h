@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TDENGINE_VNODE_ADMIT_H
+#define TDENGINE_VNODE_ADMIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "tsdb.h"
+
+// retry-after hints of the rejected submit msgs
+#define ADMIT_RETRY_MS 100
+#define ADMIT_MIN_RETRY_MS 20
+#define ADMIT_MAX_RETRY_MS 2000
+
+int32_t vnodeGetAdmitLevel(const STsdbWritePressure *pPressure, int64_t bytes, int32_t maxDelay, int32_t *pMs);
+void *  vnodeBuildRejectRsp(int32_t retryAfter, int32_t *pContLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -39,9 +39,12 @@ typedef struct {
   int32_t  vgId;      // global vnode group ID
   int32_t  refCount;  // reference count
   int64_t  queuedWMsgSize;
+  int64_t  delayedWMsg;   // submit msgs delayed by the admission control
+  int64_t  rejectedWMsg;  // submit msgs rejected by the admission control
   int32_t  queuedWMsg;
   int32_t  queuedRMsg;
   int32_t  flowctrlLevel;
+  int32_t  admitLevel;    // TSDB_FLOWCTRL_*, by the write pressure of tsdb
   int8_t   preClose;  // drop and close switch
   int8_t   reserved[3];
   int64_t  sequence;  // for topic
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+#include "os.h"
+#include "taosmsg.h"
+#include "taoserror.h"
+#include "trpc.h"
+#include "vnodeAdmit.h"
+
+/*
+ * While a commit is going on, the writes wait for it once the memtable is full. If the headroom of the memtable does
+ * not last through the commit at the ingest rate, each submit msg of bytes is delayed to slow the ingest down to the
+ * rate it lasts with. The msg is rejected with a retry-after hint instead if the delay is longer than maxDelay or the
+ * headroom can not take it. Return TSDB_FLOWCTRL_*, *pMs is the delay or the hint.
+ */
+int32_t vnodeGetAdmitLevel(const STsdbWritePressure *pPressure, int64_t bytes, int32_t maxDelay, int32_t *pMs) {
+  int32_t level = TSDB_FLOWCTRL_ACCEPT;
+
+  *pMs = 0;
+  if (maxDelay <= 0) return TSDB_FLOWCTRL_ACCEPT;
+
+  if (pPressure->headroom < bytes) {
+    level = TSDB_FLOWCTRL_REJECT;
+  } else if (pPressure->commitLeft > 0 && pPressure->ingestRate > 0 &&
+             pPressure->headroom * 1000 < pPressure->ingestRate * pPressure->commitLeft) {
+    int64_t rate = MAX(pPressure->headroom * 1000 / pPressure->commitLeft, 1);
+    int64_t delay = bytes * 1000 / rate - bytes * 1000 / pPressure->ingestRate;
+    if (delay > maxDelay) {
+      level = TSDB_FLOWCTRL_REJECT;
+    } else if (delay > 0) {
+      level = TSDB_FLOWCTRL_DELAY;
+      *pMs = (int32_t)delay;
+    }
+  }
+
+  if (level == TSDB_FLOWCTRL_REJECT) {
+    int32_t ms = (pPressure->commitLeft > 0) ? MAX(pPressure->commitLeft, ADMIT_MIN_RETRY_MS) : ADMIT_RETRY_MS;
+    *pMs = MIN(ms, ADMIT_MAX_RETRY_MS);
+  }
+
+  return level;
+}
+
+// The response of a rejected submit msg, SShellSubmitRspExt after SShellSubmitRspMsg carries the retry-after hint
+void *vnodeBuildRejectRsp(int32_t retryAfter, int32_t *pContLen) {
+  int32_t             contLen = sizeof(SShellSubmitRspMsg) + sizeof(SShellSubmitRspExt);
+  SShellSubmitRspMsg *pRsp = rpcMallocCont(contLen);
+
+  *pContLen = 0;
+  if (pRsp == NULL) return NULL;
+
+  memset(pRsp, 0, contLen);
+  pRsp->extend = 1;
+  pRsp->code = htonl(TSDB_CODE_VND_IS_FLOWCTRL);
+
+  SShellSubmitRspExt *pExt = POINTER_SHIFT(pRsp, sizeof(SShellSubmitRspMsg));
+  pExt->retryAfter = htonl(retryAfter);
+
+  *pContLen = contLen;
+  return pRsp;
+}
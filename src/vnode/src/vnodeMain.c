@@ -131,6 +131,47 @@ int32_t vnodeCompact(int32_t vgId) {
   return TSDB_CODE_SUCCESS;  
 }
 
+int32_t vnodeOpenBulkLoad(int32_t vgId, void **ppVnode, void **ppLoadh) {
+  SVnodeObj *pVnode = vnodeAcquire(vgId);
+  if (pVnode == NULL) {
+    vInfo("vgId:%d, vnode not exist, can't bulk load it", vgId);
+    return TSDB_CODE_VND_INVALID_VGROUP_ID;
+  }
+
+  // the loaded files bypass the WAL, which is all the replicas are synced by
+  if (pVnode->syncCfg.replica > 1 || pVnode->dbReplica > 1) {
+    vError("vgId:%d, bulk load is refused since replica:%d", vgId, MAX(pVnode->syncCfg.replica, pVnode->dbReplica));
+    vnodeRelease(pVnode);
+    return TSDB_CODE_TDB_INVALID_ACTION;
+  }
+
+  if (!vnodeInReadyStatus(pVnode) || pVnode->tsdb == NULL) {
+    vDebug("vgId:%d, bulk load is refused since vstatus:%d", vgId, pVnode->status);
+    vnodeRelease(pVnode);
+    return TSDB_CODE_APP_NOT_READY;
+  }
+
+  void *pLoadh = tsdbOpenBulkLoad(pVnode->tsdb);
+  if (pLoadh == NULL) {
+    int32_t code = terrno;
+    vnodeRelease(pVnode);
+    return code;
+  }
+
+  *ppVnode = pVnode;
+  *ppLoadh = pLoadh;
+  return TSDB_CODE_SUCCESS;
+}
+
+int32_t vnodeCloseBulkLoad(void *pVnode, void *pLoadh, bool toInstall) {
+  int32_t code = TSDB_CODE_SUCCESS;
+
+  if (tsdbCloseBulkLoad(pLoadh, toInstall) < 0) code = terrno;
+  vnodeRelease(pVnode);
+
+  return code;
+}
+
 static int32_t vnodeAlterImp(SVnodeObj *pVnode, SCreateVnodeMsg *pVnodeCfg) {
   STsdbCfg tsdbCfg = pVnode->tsdbCfg;
   SSyncCfg syncCfg = pVnode->syncCfg;
@@ -251,6 +292,33 @@ static void vnodeFindWalRootDir(int32_t vgId, char *walRootDir) {
   tfsClosedir(tdir);
 }
 
+// bytes of the wal files to be restored when the vnode is opened
+int64_t vnodeGetWalSize(int32_t vgId) {
+  char walRootDir[TSDB_FILENAME_LEN * 2] = {0};
+  char walDir[TSDB_FILENAME_LEN * 3];
+  char name[sizeof(walDir) + NAME_MAX + 2];
+
+  vnodeFindWalRootDir(vgId, walRootDir);
+  if (walRootDir[0] == 0) return 0;
+
+  snprintf(walDir, sizeof(walDir), "%s/wal", walRootDir);
+  DIR *dir = opendir(walDir);
+  if (dir == NULL) return 0;
+
+  int64_t        size = 0;
+  struct dirent *de = NULL;
+  while ((de = readdir(dir)) != NULL) {
+    if (strncmp(de->d_name, "wal", 3) != 0) continue;
+
+    struct stat st;
+    snprintf(name, sizeof(name), "%s/%s", walDir, de->d_name);
+    if (stat(name, &st) == 0) size += st.st_size;
+  }
+  closedir(dir);
+
+  return size;
+}
+
 int32_t vnodeOpen(int32_t vgId) {
   char temp[TSDB_FILENAME_LEN * 3];
   char rootDir[TSDB_FILENAME_LEN * 2];
@@ -35,7 +35,9 @@ static SStep tsVnodeSteps[] = {
   {"vnode-write",  vnodeInitWrite,      vnodeCleanupWrite},
   {"vnode-read",   vnodeInitRead,       vnodeCleanupRead},
   {"vnode-hash",   vnodeInitHash,       vnodeCleanupHash},
-  {"tsdb-queue",   tsdbInitCommitQueue, tsdbDestroyCommitQueue}
+  {"tsdb-queue",   tsdbInitCommitQueue, tsdbDestroyCommitQueue},
+  {"tsdb-apply",   tsdbInitApplyPool,   tsdbDestroyApplyPool},
+  {"tsdb-cache",   tsdbInitBlkCache,    tsdbDestroyBlkCache}
 };
 
 int32_t vnodeInitMgmt() {
@@ -163,6 +165,7 @@ static void vnodeBuildVloadMsg(SVnodeObj *pVnode, SStatusMsg *pStatus) {
   pLoad->role = pVnode->role;
   pLoad->replica = pVnode->syncCfg.replica;  
   pLoad->compact = (pVnode->tsdb != NULL) ? tsdbGetCompactState(pVnode->tsdb) : 0; 
+  pLoad->flowctrl = (uint8_t)pVnode->admitLevel;
 }
 
 int32_t vnodeGetVnodeList(int32_t vnodeList[], int32_t *numOfVnodes) {
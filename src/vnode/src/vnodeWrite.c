@@ -23,10 +23,13 @@
 #include "ttimer.h"
 #include "dnode.h"
 #include "vnodeStatus.h"
+#include "vnodeAdmit.h"
 
 #define MAX_QUEUED_MSG_NUM 100000
 #define MAX_QUEUED_MSG_SIZE 1024*1024*1024  //1GB
 
+static const char *admitLevelStr[] = {"accept", "delay", "reject"};
+
 static int64_t tsSubmitReqSucNum = 0;
 static int64_t tsSubmitRowNum = 0;
 static int64_t tsSubmitRowSucNum = 0;
@@ -40,6 +43,7 @@ static int32_t vnodeProcessAlterTableMsg(SVnodeObj *pVnode, void *pCont, SRspRet
 static int32_t vnodeProcessDropStableMsg(SVnodeObj *pVnode, void *pCont, SRspRet *);
 static int32_t vnodeProcessUpdateTagValMsg(SVnodeObj *pVnode, void *pCont, SRspRet *);
 static int32_t vnodePerformFlowCtrl(SVWriteMsg *pWrite);
+static int32_t vnodeAdmitWMsg(SVWriteMsg *pWrite);
 static int32_t vnodeCheckWal(SVnodeObj *pVnode);
 
 int32_t vnodeInitWrite(void) {
@@ -55,18 +59,11 @@ int32_t vnodeInitWrite(void) {
 
 void vnodeCleanupWrite() {}
 
-int32_t vnodeProcessWrite(void *vparam, void *wparam, int32_t qtype, void *rparam) {
-  int32_t    code = 0;
-  SVnodeObj *pVnode = vparam;
-  SWalHead * pHead = wparam;
-  SVWriteMsg*pWrite = rparam;
-
-  SRspRet *pRspRet = NULL;
-  if (pWrite != NULL) pRspRet = &pWrite->rspRet;
-  // if wal and forward write , no need response
-  if( qtype == TAOS_QTYPE_WAL || qtype == TAOS_QTYPE_FWD) {
-    pRspRet = NULL;
-  }   
+// Check the msg and assign its version after lastVer, then forward it to peers. *pSkip is set if the msg from WAL or
+// forward is already processed
+static int32_t vnodePrepareWrite(SVnodeObj *pVnode, SWalHead *pHead, int32_t qtype, SVWriteMsg *pWrite,
+                                 uint64_t lastVer, bool *pSkip) {
+  *pSkip = false;
 
   if (vnodeProcessWriteMsgFp[pHead->msgType] == NULL) {
     vError("vgId:%d, msg:%s not processed since no handle, qtype:%s hver:%" PRIu64, pVnode->vgId,
@@ -75,7 +72,7 @@ int32_t vnodeProcessWrite(void *vparam, void *wparam, int32_t qtype, void *rpara
   }
 
   vTrace("vgId:%d, msg:%s will be processed in vnode, qtype:%s hver:%" PRIu64 " vver:%" PRIu64, pVnode->vgId,
-         taosMsg[pHead->msgType], qtypeStr[qtype], pHead->version, pVnode->version);
+         taosMsg[pHead->msgType], qtypeStr[qtype], pHead->version, lastVer);
 
   if (pHead->version == 0) {  // from client or CQ
     if (!vnodeInReadyStatus(pVnode)) {
@@ -91,36 +88,47 @@ int32_t vnodeProcessWrite(void *vparam, void *wparam, int32_t qtype, void *rpara
     }
 
     // assign version
-    pHead->version = pVnode->version + 1;
+    pHead->version = lastVer + 1;
   } else {  // from wal or forward
     // for data from WAL or forward, version may be smaller
-    if (pHead->version <= pVnode->version) return 0;
+    if (pHead->version <= lastVer) {
+      *pSkip = true;
+      return 0;
+    }
   }
 
   // forward to peers, even it is WAL/FWD, it shall be called to update version in sync
   int32_t syncCode = 0;
-  bool    force = (pWrite == NULL ? false : pWrite->walHead.msgType != TSDB_MSG_TYPE_SUBMIT);
+  bool    force = (pWrite == NULL ? false : pWrite->pHead->msgType != TSDB_MSG_TYPE_SUBMIT);
   syncCode = syncForwardToPeer(pVnode->sync, pHead, pWrite, qtype, force);
   if (syncCode < 0) {
     pHead->version = 0;
-    return syncCode;
   }
 
-  // write into WAL
-  if (!(tsShortcutFlag & TSDB_SHORTCUT_NR_VNODE_WAL_WRITE)) {
-    code = walWrite(pVnode->wal, pHead);
-  }
-  if (code < 0) {
-    if (syncCode > 0 && pWrite) atomic_sub_fetch_32(&pWrite->processedCount, 1);
-    vError("vgId:%d, hver:%" PRIu64 " vver:%" PRIu64 " code:0x%x", pVnode->vgId, pHead->version, pVnode->version, code);
-    pHead->version = 0;
-    return code;
+  return syncCode;
+}
+
+static int32_t vnodeFailWrite(SVnodeObj *pVnode, SWalHead *pHead, SVWriteMsg *pWrite, int32_t syncCode, int32_t code) {
+  if (syncCode > 0 && pWrite) atomic_sub_fetch_32(&pWrite->processedCount, 1);
+  vError("vgId:%d, hver:%" PRIu64 " vver:%" PRIu64 " code:0x%x", pVnode->vgId, pHead->version, pVnode->version, code);
+  pHead->version = 0;
+  return code;
+}
+
+// Write the msg locally after it is written into WAL
+static int32_t vnodeApplyWrite(SVnodeObj *pVnode, SWalHead *pHead, int32_t qtype, SVWriteMsg *pWrite,
+                               int32_t syncCode) {
+  SRspRet *pRspRet = NULL;
+  if (pWrite != NULL) pRspRet = &pWrite->rspRet;
+  // if wal and forward write , no need response
+  if (qtype == TAOS_QTYPE_WAL || qtype == TAOS_QTYPE_FWD) {
+    pRspRet = NULL;
   }
 
   pVnode->version = pHead->version;
 
   // write data locally
-  code = (*vnodeProcessWriteMsgFp[pHead->msgType])(pVnode, pHead->cont, pRspRet);
+  int32_t code = (*vnodeProcessWriteMsgFp[pHead->msgType])(pVnode, pHead->cont, pRspRet);
   if (code < 0) {
     if (syncCode > 0 && pWrite) atomic_sub_fetch_32(&pWrite->processedCount, 1);
     return code;
@@ -129,6 +137,80 @@ int32_t vnodeProcessWrite(void *vparam, void *wparam, int32_t qtype, void *rpara
   return syncCode;
 }
 
+int32_t vnodeProcessWrite(void *vparam, void *wparam, int32_t qtype, void *rparam) {
+  int32_t    code = 0;
+  SVnodeObj *pVnode = vparam;
+  SWalHead * pHead = wparam;
+  SVWriteMsg*pWrite = rparam;
+  bool       skip = false;
+
+  int32_t syncCode = vnodePrepareWrite(pVnode, pHead, qtype, pWrite, pVnode->version, &skip);
+  if (syncCode < 0 || skip) return syncCode;
+
+  // write into WAL
+  if (!(tsShortcutFlag & TSDB_SHORTCUT_NR_VNODE_WAL_WRITE)) {
+    code = walWrite(pVnode->wal, pHead);
+  }
+  if (code < 0) {
+    return vnodeFailWrite(pVnode, pHead, pWrite, syncCode, code);
+  }
+
+  return vnodeApplyWrite(pVnode, pHead, qtype, pWrite, syncCode);
+}
+
+/**
+ * Process the msgs read from the write queue in one round. The versions of all msgs are assigned first and their
+ * heads are written into WAL by one walWriteBatch(), then the msgs are written locally in order. The result of each
+ * msg is set into its code as vnodeProcessWrite() returns. walWriteBatch() cuts a batch it fails to write completely,
+ * so a failure fails all the msgs of the batch and none of them is left in WAL to be restored.
+ */
+void vnodeProcessWriteBatch(void *vparam, SVWriteMsg **pWrites, int32_t num) {
+  SVnodeObj *pVnode = vparam;
+  int32_t    code = 0;
+
+  SVWriteMsg **pReady = tmalloc((sizeof(SVWriteMsg *) + sizeof(SWalHead *)) * num);
+  if (pReady == NULL) {
+    for (int32_t i = 0; i < num; ++i) {
+      SVWriteMsg *pWrite = pWrites[i];
+      pWrite->code = vnodeProcessWrite(pVnode, pWrite->pHead, pWrite->qtype, pWrite);
+    }
+    return;
+  }
+
+  SWalHead **pHeads = (SWalHead **)(pReady + num);
+  uint64_t   lastVer = pVnode->version;
+  int32_t    numOfReady = 0;
+
+  for (int32_t i = 0; i < num; ++i) {
+    SVWriteMsg *pWrite = pWrites[i];
+    bool        skip = false;
+
+    pWrite->code = vnodePrepareWrite(pVnode, pWrite->pHead, pWrite->qtype, pWrite, lastVer, &skip);
+    if (pWrite->code < 0 || skip) continue;
+
+    lastVer = pWrite->pHead->version;
+    pReady[numOfReady] = pWrite;
+    pHeads[numOfReady] = pWrite->pHead;
+    numOfReady++;
+  }
+
+  // write into WAL
+  if (numOfReady > 0 && !(tsShortcutFlag & TSDB_SHORTCUT_NR_VNODE_WAL_WRITE)) {
+    code = walWriteBatch(pVnode->wal, pHeads, numOfReady);
+  }
+
+  for (int32_t i = 0; i < numOfReady; ++i) {
+    SVWriteMsg *pWrite = pReady[i];
+    if (code < 0) {
+      pWrite->code = vnodeFailWrite(pVnode, pWrite->pHead, pWrite, pWrite->code, code);
+    } else {
+      pWrite->code = vnodeApplyWrite(pVnode, pWrite->pHead, pWrite->qtype, pWrite, pWrite->code);
+    }
+  }
+
+  tfree(pReady);
+}
+
 static int32_t vnodeCheckWrite(SVnodeObj *pVnode) {
   if (!(pVnode->accessState & TSDB_VN_WRITE_ACCCESS)) {
     vDebug("vgId:%d, no write auth, refCount:%d pVnode:%p", pVnode->vgId, pVnode->refCount, pVnode);
@@ -263,6 +345,11 @@ static int32_t vnodeProcessUpdateTagValMsg(SVnodeObj *pVnode, void *pCont, SRspR
   return TSDB_CODE_SUCCESS;
 }
 
+static void vnodeFreeVWriteMsg(SVWriteMsg *pWrite) {
+  rpcFreeCont(pWrite->pCont);
+  taosFreeQitem(pWrite);
+}
+
 static SVWriteMsg *vnodeBuildVWriteMsg(SVnodeObj *pVnode, SWalHead *pHead, int32_t qtype, SRpcMsg *pRpcMsg) {
   if (pHead->len > TSDB_MAX_WAL_SIZE) {
     vError("vgId:%d, wal len:%d exceeds limit, hver:%" PRIu64, pVnode->vgId, pHead->len, pHead->version);
@@ -270,7 +357,11 @@ static SVWriteMsg *vnodeBuildVWriteMsg(SVnodeObj *pVnode, SWalHead *pHead, int32
     return NULL;
   }
 
-  int32_t size = sizeof(SVWriteMsg) + pHead->len;
+  // The head of a msg from the client is in the rpc msg, which is held by the write msg rather than copied. The room of
+  // the rpc head before it is big enough for the sync head
+  bool zeroCopy = (qtype == TAOS_QTYPE_RPC && pRpcMsg != NULL && pRpcMsg->pCont != NULL);
+
+  int32_t size = sizeof(SVWriteMsg) + (zeroCopy ? 0 : pHead->len);
   SVWriteMsg *pWrite = taosAllocateQitem(size);
   if (pWrite == NULL) {
     terrno = TSDB_CODE_VND_OUT_OF_MEMORY;
@@ -281,7 +372,17 @@ static SVWriteMsg *vnodeBuildVWriteMsg(SVnodeObj *pVnode, SWalHead *pHead, int32
     pWrite->rpcMsg = *pRpcMsg;
   }
 
-  memcpy(&pWrite->walHead, pHead, sizeof(SWalHead) + pHead->len);
+  if (zeroCopy) {
+    // the buffer is owned by pCont only, so neither copy of the rpc msg frees it again
+    pWrite->pCont = pRpcMsg->pCont;
+    pWrite->pHead = pHead;
+    pWrite->rpcMsg.pCont = NULL;
+    pRpcMsg->pCont = NULL;
+  } else {
+    pWrite->pHead = &pWrite->walHead;
+    memcpy(pWrite->pHead, pHead, sizeof(SWalHead) + pHead->len);
+  }
+
   pWrite->pVnode = pVnode;
   pWrite->qtype = qtype;
 
@@ -297,7 +398,7 @@ static int32_t vnodeWriteToWQueueImp(SVWriteMsg *pWrite) {
     int32_t code = vnodeCheckWrite(pVnode);
     if (code != TSDB_CODE_SUCCESS) {
       vError("vgId:%d, failed to write into vwqueue since %s", pVnode->vgId, tstrerror(code));
-      taosFreeQitem(pWrite);
+      vnodeFreeVWriteMsg(pWrite);
       vnodeRelease(pVnode);
       return code;
     }
@@ -305,7 +406,7 @@ static int32_t vnodeWriteToWQueueImp(SVWriteMsg *pWrite) {
 
   if (tsAvailDataDirGB <= tsMinimalDataDirGB) {
     vError("vgId:%d, failed to write into vwqueue since no diskspace, avail:%fGB", pVnode->vgId, tsAvailDataDirGB);
-    taosFreeQitem(pWrite);
+    vnodeFreeVWriteMsg(pWrite);
     vnodeRelease(pVnode);
     return TSDB_CODE_VND_NO_DISKSPACE;
   }
@@ -313,18 +414,18 @@ static int32_t vnodeWriteToWQueueImp(SVWriteMsg *pWrite) {
   if (!vnodeInReadyOrUpdatingStatus(pVnode)) {
     vError("vgId:%d, failed to write into vwqueue, vstatus is %s, refCount:%d pVnode:%p", pVnode->vgId,
            vnodeStatus[pVnode->status], pVnode->refCount, pVnode);
-    taosFreeQitem(pWrite);
+    vnodeFreeVWriteMsg(pWrite);
     vnodeRelease(pVnode);
     return TSDB_CODE_APP_NOT_READY;
   }
 
   int32_t queued = atomic_add_fetch_32(&pVnode->queuedWMsg, 1);
-  int64_t queuedSize = atomic_add_fetch_64(&pVnode->queuedWMsgSize, pWrite->walHead.len);
+  int64_t queuedSize = atomic_add_fetch_64(&pVnode->queuedWMsgSize, pWrite->pHead->len);
 
   if (queued > MAX_QUEUED_MSG_NUM || queuedSize > MAX_QUEUED_MSG_SIZE) {
     if (pWrite->qtype == TAOS_QTYPE_FWD) {
       queued = atomic_sub_fetch_32(&pVnode->queuedWMsg, 1);
-      queuedSize = atomic_sub_fetch_64(&pVnode->queuedWMsgSize, pWrite->walHead.len);
+      queuedSize = atomic_sub_fetch_64(&pVnode->queuedWMsgSize, pWrite->pHead->len);
 
       return -1;
     }
@@ -370,13 +471,13 @@ void vnodeFreeFromWQueue(void *vparam, SVWriteMsg *pWrite) {
   SVnodeObj *pVnode = vparam;
   if (pVnode) {
     int32_t queued = atomic_sub_fetch_32(&pVnode->queuedWMsg, 1);
-    int64_t queuedSize = atomic_sub_fetch_64(&pVnode->queuedWMsgSize, pWrite->walHead.len);
+    int64_t queuedSize = atomic_sub_fetch_64(&pVnode->queuedWMsgSize, pWrite->pHead->len);
 
     vTrace("vgId:%d, msg:%p, app:%p, free from vwqueue, queued:%d size:%" PRId64, pVnode->vgId, pWrite,
            pWrite->rpcMsg.ahandle, queued, queuedSize);
   }
 
-  taosFreeQitem(pWrite);
+  vnodeFreeVWriteMsg(pWrite);
   vnodeRelease(pVnode);
 }
 
@@ -392,7 +493,7 @@ static void vnodeFlowCtrlMsgToWQueue(void *param, void *tmrId) {
     vError("vgId:%d, msg:%p, failed to process since %s, retry:%d", pVnode->vgId, pWrite, tstrerror(code),
            pWrite->processedCount);
     void *handle = pWrite->rpcMsg.handle;
-    taosFreeQitem(pWrite);
+    vnodeFreeVWriteMsg(pWrite);
     vnodeRelease(pVnode);
     SRpcMsg rpcRsp = {.handle = handle, .code = code};
     rpcSendResponse(&rpcRsp);
@@ -417,7 +518,7 @@ static int32_t vnodePerformFlowCtrl(SVWriteMsg *pWrite) {
   if (pWrite->qtype != TAOS_QTYPE_RPC) return 0;
   if (pVnode->queuedWMsg < MAX_QUEUED_MSG_NUM && pVnode->queuedWMsgSize < MAX_QUEUED_MSG_SIZE &&
       pVnode->flowctrlLevel <= 0)
-    return 0;
+    return (tsEnableFlowCtrl == 0) ? 0 : vnodeAdmitWMsg(pWrite);
 
   if (tsEnableFlowCtrl == 0) {
     int32_t ms = (int32_t)pow(2, pVnode->flowctrlLevel + 2);
@@ -435,6 +536,69 @@ static int32_t vnodePerformFlowCtrl(SVWriteMsg *pWrite) {
   }
 }
 
+// Return TSDB_FLOWCTRL_* of the msg by the write pressure of the vnode, *pMs is the delay or the retry-after hint
+static int32_t vnodeCheckAdmission(SVnodeObj *pVnode, SVWriteMsg *pWrite, int32_t *pMs) {
+  STsdbWritePressure pressure;
+
+  *pMs = 0;
+  if (tsFlowCtrlMaxDelay <= 0 || pWrite->pHead->msgType != TSDB_MSG_TYPE_SUBMIT || pVnode->tsdb == NULL) {
+    return TSDB_FLOWCTRL_ACCEPT;
+  }
+
+  tsdbGetWritePressure(pVnode->tsdb, &pressure);
+  int32_t level = vnodeGetAdmitLevel(&pressure, pWrite->pHead->len, tsFlowCtrlMaxDelay, pMs);
+
+  int32_t oldLevel = atomic_exchange_32(&pVnode->admitLevel, level);
+  if (oldLevel != level) {
+    vDebug("vgId:%d, admission level from %s to %s, headroom:%" PRId64 " ingest:%" PRId64 "B/s commit:%" PRId64
+           "B/s left:%dms blocks:%d/%d, delayed:%" PRId64 " rejected:%" PRId64,
+           pVnode->vgId, admitLevelStr[oldLevel], admitLevelStr[level], pressure.headroom, pressure.ingestRate, pressure.commitRate,
+           pressure.commitLeft, pressure.usedBlocks, pressure.totalBlocks, pVnode->delayedWMsg, pVnode->rejectedWMsg);
+  }
+
+  return level;
+}
+
+static void vnodeRejectWMsg(SVWriteMsg *pWrite, int32_t retryAfter) {
+  SVnodeObj *pVnode = pWrite->pVnode;
+  SRpcMsg    rpcRsp = {.handle = pWrite->rpcMsg.handle, .code = TSDB_CODE_VND_IS_FLOWCTRL};
+
+  vTrace("vgId:%d, msg:%p, app:%p, rejected by admission, retry after %d ms", pVnode->vgId, pWrite,
+         pWrite->rpcMsg.ahandle, retryAfter);
+
+  // without the hint if out of memory, the client takes it as an error
+  rpcRsp.pCont = vnodeBuildRejectRsp(retryAfter, &rpcRsp.contLen);
+
+  vnodeFreeVWriteMsg(pWrite);
+  vnodeRelease(pVnode);
+  rpcSendResponse(&rpcRsp);
+}
+
+static int32_t vnodeAdmitWMsg(SVWriteMsg *pWrite) {
+  SVnodeObj *pVnode = pWrite->pVnode;
+  int32_t    ms = 0;
+
+  // a delayed msg is admitted when its timer fires
+  if (pWrite->processedCount > 0) return 0;
+
+  int32_t level = vnodeCheckAdmission(pVnode, pWrite, &ms);
+  if (level == TSDB_FLOWCTRL_ACCEPT) return 0;
+
+  if (level == TSDB_FLOWCTRL_DELAY) {
+    atomic_add_fetch_64(&pVnode->delayedWMsg, 1);
+
+    void *unUsedTimerId = NULL;
+    taosTmrReset(vnodeFlowCtrlMsgToWQueue, ms, pWrite, tsDnodeTmr, &unUsedTimerId);
+    vTrace("vgId:%d, msg:%p, app:%p, delayed by admission for %d ms", pVnode->vgId, pWrite, pWrite->rpcMsg.ahandle,
+           ms);
+  } else {
+    atomic_add_fetch_64(&pVnode->rejectedWMsg, 1);
+    vnodeRejectWMsg(pWrite, ms);
+  }
+
+  return TSDB_CODE_VND_ACTION_IN_PROGRESS;
+}
+
 void vnodeWaitWriteCompleted(SVnodeObj *pVnode) {
   int32_t extraSleep = 0;
   while (pVnode->queuedWMsg > 0) {
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "os.h"
+#include "taosmsg.h"
+#include "taoserror.h"
+#include "trpc.h"
+#include "vnodeAdmit.h"
+
+#define MB (1024 * 1024)
+
+static STsdbWritePressure pressureOf(int64_t headroom, int64_t ingestRate, int32_t commitLeft) {
+  STsdbWritePressure pressure = {0};
+  pressure.committing = (commitLeft > 0);
+  pressure.headroom = headroom;
+  pressure.ingestRate = ingestRate;
+  pressure.commitLeft = commitLeft;
+  return pressure;
+}
+
+TEST(VnodeAdmitTest, admitWhileHeadroomLasts) {
+  int32_t ms = -1;
+
+  // no commit going on
+  STsdbWritePressure pressure = pressureOf(64 * MB, 10 * MB, 0);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, MB, 100, &ms), TSDB_FLOWCTRL_ACCEPT);
+  ASSERT_EQ(ms, 0);
+
+  // the 10MB of headroom outlast the 5s of the commit at 1MB/s
+  pressure = pressureOf(10 * MB, MB, 5000);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, 16384, 100, &ms), TSDB_FLOWCTRL_ACCEPT);
+  ASSERT_EQ(ms, 0);
+
+  // the ingest rate is not known yet
+  pressure = pressureOf(MB, 0, 5000);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, 16384, 100, &ms), TSDB_FLOWCTRL_ACCEPT);
+
+  // admission disabled, even if the memtable is full
+  pressure = pressureOf(0, 10 * MB, 5000);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, 16384, 0, &ms), TSDB_FLOWCTRL_ACCEPT);
+  ASSERT_EQ(ms, 0);
+}
+
+TEST(VnodeAdmitTest, delaySlowsIngestDown) {
+  int32_t ms = -1;
+
+  // 4MB last 5s at 0.8MB/s instead of 1MB/s, so each 16KB waits 19.5ms instead of 15.6ms
+  STsdbWritePressure pressure = pressureOf(4 * MB, MB, 5000);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, 16384, 100, &ms), TSDB_FLOWCTRL_DELAY);
+  ASSERT_EQ(ms, 4);
+
+  // the delay grows with the msg
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, 160 * 1024, 100, &ms), TSDB_FLOWCTRL_DELAY);
+  ASSERT_EQ(ms, 195 - 156);
+}
+
+TEST(VnodeAdmitTest, rejectWithRetryAfter) {
+  int32_t ms = -1;
+
+  // a delay of 4.9s to slow 10MB/s down to 0.2MB/s, longer than flowCtrlMaxDelay
+  STsdbWritePressure pressure = pressureOf(MB, 10 * MB, 5000);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, MB, 100, &ms), TSDB_FLOWCTRL_REJECT);
+  ASSERT_EQ(ms, ADMIT_MAX_RETRY_MS);
+
+  // but delayed if flowCtrlMaxDelay allows
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, MB, 10000, &ms), TSDB_FLOWCTRL_DELAY);
+  ASSERT_EQ(ms, 5000 - 100);
+
+  // the headroom can not take the msg, retry after the commit
+  pressure = pressureOf(MB - 1, MB, 500);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, MB, 100, &ms), TSDB_FLOWCTRL_REJECT);
+  ASSERT_EQ(ms, 500);
+
+  pressure = pressureOf(0, MB, 5);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, MB, 100, &ms), TSDB_FLOWCTRL_REJECT);
+  ASSERT_EQ(ms, ADMIT_MIN_RETRY_MS);
+
+  // the time left of the commit is not known
+  pressure = pressureOf(0, MB, 0);
+  ASSERT_EQ(vnodeGetAdmitLevel(&pressure, MB, 100, &ms), TSDB_FLOWCTRL_REJECT);
+  ASSERT_EQ(ms, ADMIT_RETRY_MS);
+}
+
+TEST(VnodeAdmitTest, rejectRspCarriesRetryAfter) {
+  int32_t contLen = 0;
+  void *  pCont = vnodeBuildRejectRsp(1234, &contLen);
+
+  ASSERT_NE(pCont, nullptr);
+  ASSERT_EQ(contLen, (int32_t)(sizeof(SShellSubmitRspMsg) + sizeof(SShellSubmitRspExt)));
+
+  SShellSubmitRspMsg *pRsp = (SShellSubmitRspMsg *)pCont;
+  SShellSubmitRspExt *pExt = (SShellSubmitRspExt *)POINTER_SHIFT(pRsp, sizeof(SShellSubmitRspMsg));
+  ASSERT_EQ(pRsp->extend, 1);
+  ASSERT_EQ((int32_t)htonl(pRsp->code), TSDB_CODE_VND_IS_FLOWCTRL);
+  ASSERT_EQ((int32_t)htonl(pRsp->numOfRows), 0);
+  ASSERT_EQ((int32_t)htonl(pExt->retryAfter), 1234);
+
+  rpcFreeCont(pCont);
+}
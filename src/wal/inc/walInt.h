@@ -21,6 +21,7 @@ extern "C" {
 #endif
 
 #include "tlog.h"
+#include "twal.h"
 
 extern int32_t wDebugFlag;
 
@@ -39,9 +40,44 @@ extern int32_t wDebugFlag;
 #define WAL_PATH_LEN   (TSDB_FILENAME_LEN + 12)
 #define WAL_FILE_LEN   (WAL_PATH_LEN + 32)
 #define WAL_FILE_NUM   1 // 3
+#define WAL_BATCH_SIZE (1024 * 1024)
+#define WAL_BATCH_IOVS 64
+#define WAL_SVER_COMP  3    // sver of the records whose body is compressed, the body is the raw len and the compressed data
+#define WAL_COMP_EXTRA 5    // the raw len and the indicator byte of the compressed data
+#define WAL_COMP_MIN_LEN 512
+#define WAL_COMP_LZ4   1
+#define WAL_COMP_ZSTD  2
+#define WAL_MAX_DISKS  16
+#define WAL_FSYNC_REPORT_MS 300000  // interval to print the fsync latency of a disk
+#define WAL_RESTORE_REPORT_MS   5000               // interval to print the progress of restoring a wal file
+#define WAL_RESTORE_QUEUE_SIZE  (4 * 1024 * 1024)  // bytes of the records read ahead of the ones applied
+
+typedef struct SWalFsyncReq {
+  struct SWalFsyncReq *next;
+  struct SWal *        pWal;  // the wal is acquired until the request is done
+  uint64_t             version;
+  uint64_t             syncedVersion;  // version of the wal made durable by a syncfs of the disk
+  FWalSynced *         fp;
+  void *               param;
+} SWalFsyncReq;
 
 typedef struct {
+  int64_t         dev;  // device of the wal directories
+  int8_t          stop;
+  pthread_t       thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  SWalFsyncReq *  pHead;  // pending requests
+  SWalFsyncReq *  pTail;
+  int64_t         lastReport;
+  SWalFsyncStat   stat;      // since the thread is launched, updated with the mutex locked
+  SWalFsyncStat   reported;  // stat of the last report
+} SWalDisk;
+
+typedef struct SWal {
   uint64_t version;
+  uint64_t fsyncVersion;   // version requested to be durable by walFsyncAsync()
+  uint64_t syncedVersion;  // version known to be durable
   int64_t  fileId;
   int64_t  rid;
   int64_t  tfd;
@@ -54,6 +90,8 @@ typedef struct {
   int8_t   reserved[3];
   char     path[WAL_PATH_LEN];
   char     name[WAL_FILE_LEN];
+  char *   batchBuf;  // compressed records of a batch are built here by walWriteBatch()
+  SWalDisk *pDisk;
   pthread_mutex_t mutex;
 } SWal;
 
@@ -61,6 +99,11 @@ int32_t walGetNextFile(SWal *pWal, int64_t *nextFileId);
 int32_t walGetOldFile(SWal *pWal, int64_t curFileId, int32_t minDiff, int64_t *oldFileId);
 int32_t walGetNewFile(SWal *pWal, int64_t *newFileId);
 
+SWal *    walAcquire(SWal *pWal);
+void      walRelease(SWal *pWal);
+SWalDisk *walGetDisk(const char *path);
+void      walCleanUpDisks();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+#include "os.h"
+#include "taoserror.h"
+#include "tglobal.h"
+#include "tfile.h"
+#include "twal.h"
+#include "walInt.h"
+
+/*
+ * Each disk holding wal files has a fsync thread. walFsyncAsync() queues a request to make the written version of a
+ * wal durable, and the thread takes all the pending requests of the disk at once, makes their wals durable by one
+ * syncfs of the disk, or one fsync per wal if they are of a single wal or syncfs fails, and calls back the requests.
+ */
+static SWalDisk        tsWalDisks[WAL_MAX_DISKS];
+static int32_t         tsWalNumOfDisks = 0;
+static pthread_mutex_t tsWalDiskMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *walFsyncThreadFunc(void *param);
+static void  walReportFsync(SWalDisk *pDisk);
+
+SWalDisk *walGetDisk(const char *path) {
+  struct stat st;
+  int64_t     dev = 0;
+  SWalDisk *  pDisk = NULL;
+
+  if (stat(path, &st) == 0) dev = (int64_t)st.st_dev;
+
+  pthread_mutex_lock(&tsWalDiskMutex);
+
+  for (int32_t i = 0; i < tsWalNumOfDisks; ++i) {
+    if (tsWalDisks[i].dev == dev) {
+      pDisk = tsWalDisks + i;
+      break;
+    }
+  }
+
+  if (pDisk == NULL && tsWalNumOfDisks < WAL_MAX_DISKS) {
+    SWalDisk *pNew = tsWalDisks + tsWalNumOfDisks;
+    memset(pNew, 0, sizeof(SWalDisk));
+    pNew->dev = dev;
+    pNew->lastReport = taosGetTimestampMs();
+    pthread_mutex_init(&pNew->mutex, NULL);
+    pthread_cond_init(&pNew->cond, NULL);
+
+    pthread_attr_t thAttr;
+    pthread_attr_init(&thAttr);
+    pthread_attr_setdetachstate(&thAttr, PTHREAD_CREATE_JOINABLE);
+
+    if (pthread_create(&pNew->thread, &thAttr, walFsyncThreadFunc, pNew) != 0) {
+      wError("disk:%" PRId64 ", failed to create wal fsync thread since %s", dev, strerror(errno));
+      pthread_mutex_destroy(&pNew->mutex);
+      pthread_cond_destroy(&pNew->cond);
+    } else {
+      wDebug("disk:%" PRId64 ", wal fsync thread is launched", dev);
+      pDisk = pNew;
+      tsWalNumOfDisks++;
+    }
+
+    pthread_attr_destroy(&thAttr);
+  }
+
+  // share the last one if there are too many disks
+  if (pDisk == NULL && tsWalNumOfDisks > 0) pDisk = tsWalDisks + tsWalNumOfDisks - 1;
+
+  pthread_mutex_unlock(&tsWalDiskMutex);
+
+  return pDisk;
+}
+
+void walCleanUpDisks() {
+  pthread_mutex_lock(&tsWalDiskMutex);
+
+  for (int32_t i = 0; i < tsWalNumOfDisks; ++i) {
+    SWalDisk *pDisk = tsWalDisks + i;
+
+    pthread_mutex_lock(&pDisk->mutex);
+    pDisk->stop = 1;
+    pthread_cond_signal(&pDisk->cond);
+    pthread_mutex_unlock(&pDisk->mutex);
+
+    pthread_join(pDisk->thread, NULL);
+    walReportFsync(pDisk);
+
+    pthread_mutex_destroy(&pDisk->mutex);
+    pthread_cond_destroy(&pDisk->cond);
+  }
+
+  tsWalNumOfDisks = 0;
+  pthread_mutex_unlock(&tsWalDiskMutex);
+}
+
+/**
+ * Request the written version of the wal to be durable, fp is called with param by the fsync thread after that. Return
+ * false if the request is not accepted, then the caller shall call walFsync() and go on by itself.
+ */
+bool walFsyncAsync(void *handle, bool forceFsync, FWalSynced *fp, void *param) {
+  SWal *pWal = handle;
+  if (pWal == NULL || !tsWalFsyncThread || pWal->pDisk == NULL || !tfValid(pWal->tfd)) return false;
+  if (!forceFsync && (pWal->level != TAOS_WAL_FSYNC || pWal->fsyncPeriod != 0)) return false;
+
+  SWalFsyncReq *pReq = tmalloc(sizeof(SWalFsyncReq));
+  if (pReq == NULL) return false;
+
+  if (walAcquire(pWal) == NULL) {
+    tfree(pReq);
+    return false;
+  }
+
+  pthread_mutex_lock(&pWal->mutex);
+  pReq->version = pWal->version;
+  if (pWal->fsyncVersion < pReq->version) pWal->fsyncVersion = pReq->version;
+  pthread_mutex_unlock(&pWal->mutex);
+
+  pReq->next = NULL;
+  pReq->pWal = pWal;
+  pReq->fp = fp;
+  pReq->param = param;
+
+  SWalDisk *pDisk = pWal->pDisk;
+  pthread_mutex_lock(&pDisk->mutex);
+  if (pDisk->pTail == NULL) {
+    pDisk->pHead = pReq;
+  } else {
+    pDisk->pTail->next = pReq;
+  }
+  pDisk->pTail = pReq;
+  pthread_cond_signal(&pDisk->cond);
+  pthread_mutex_unlock(&pDisk->mutex);
+
+  return true;
+}
+
+static void walAddFsyncLatency(SWalFsyncStat *pStat, int64_t latency) {
+  int32_t bucket = 0;
+  while (bucket < WAL_FSYNC_BUCKETS - 1 && latency >= (64LL << bucket)) bucket++;
+  pStat->latency[bucket]++;
+  pStat->numOfFsyncs++;
+}
+
+static int32_t walFsyncToVersion(SWalFsyncStat *pStat, SWal *pWal, uint64_t fsyncVer) {
+  int32_t code = 0;
+
+  pthread_mutex_lock(&pWal->mutex);
+  bool     synced = (pWal->syncedVersion >= fsyncVer);
+  uint64_t wver = pWal->version;
+  int64_t  tfd = pWal->tfd;
+  pthread_mutex_unlock(&pWal->mutex);
+
+  if (synced) return 0;
+
+  // the wal is not locked, writes go on during fsync
+  int64_t st = taosGetTimestampUs();
+  if (tfFsync(tfd) < 0) code = TAOS_SYSTEM_ERROR(errno);
+  int64_t latency = taosGetTimestampUs() - st;
+  walAddFsyncLatency(pStat, latency);
+
+  pthread_mutex_lock(&pWal->mutex);
+  if (code == 0) {
+    if (pWal->syncedVersion < wver) pWal->syncedVersion = wver;
+  } else if (pWal->syncedVersion >= fsyncVer) {
+    // the file is renewed and the old one is synced during fsync
+    code = 0;
+  }
+  pthread_mutex_unlock(&pWal->mutex);
+
+  if (code != 0) {
+    wError("vgId:%d, file:%s, failed to fsync since %s", pWal->vgId, pWal->name, tstrerror(code));
+  } else {
+    wTrace("vgId:%d, fileId:%" PRId64 ", fsync to version:%" PRIu64 " latency:%" PRId64 "us", pWal->vgId,
+           pWal->fileId, wver, latency);
+  }
+
+  return code;
+}
+
+// Move the requests of the same wal next to each other, the wals keep the order of their first requests
+static SWalFsyncReq *walGroupFsyncReqs(SWalFsyncReq *pReqs, int32_t *pNumOfWals) {
+  SWalFsyncReq * pHead = NULL;
+  SWalFsyncReq **ppTail = &pHead;
+
+  *pNumOfWals = 0;
+  while (pReqs != NULL) {
+    SWal *         pWal = pReqs->pWal;
+    SWalFsyncReq **ppReq = &pReqs;
+
+    while (*ppReq != NULL) {
+      SWalFsyncReq *pReq = *ppReq;
+      if (pReq->pWal != pWal) {
+        ppReq = &pReq->next;
+        continue;
+      }
+
+      *ppReq = pReq->next;
+      pReq->next = NULL;
+      *ppTail = pReq;
+      ppTail = &pReq->next;
+    }
+
+    (*pNumOfWals)++;
+  }
+
+  return pHead;
+}
+
+/*
+ * Make all the wals of the grouped requests durable by one syncfs of their file system, instead of one fsync per wal.
+ * The versions written before syncfs are durable after it. Nothing is marked synced if syncfs fails, then each wal
+ * is fsynced by itself.
+ */
+static void walSyncFsToVersion(SWalFsyncStat *pStat, SWalFsyncReq *pReqs) {
+  int64_t tfd = -1;
+
+  for (SWalFsyncReq *pReq = pReqs; pReq != NULL; pReq = pReq->next) {
+    SWal *pWal = pReq->pWal;
+    pthread_mutex_lock(&pWal->mutex);
+    pReq->syncedVersion = pWal->version;
+    if (tfd < 0 && tfValid(pWal->tfd)) tfd = pWal->tfd;
+    pthread_mutex_unlock(&pWal->mutex);
+  }
+
+  int64_t st = taosGetTimestampUs();
+  if (tfd < 0 || tfSyncFs(tfd) < 0) {
+    wDebug("failed to syncfs the wals of a disk since %s, fsync them one by one", strerror(errno));
+    return;
+  }
+  int64_t latency = taosGetTimestampUs() - st;
+  walAddFsyncLatency(pStat, latency);
+  pStat->numOfSyncFs++;
+
+  for (SWalFsyncReq *pReq = pReqs; pReq != NULL; pReq = pReq->next) {
+    SWal *pWal = pReq->pWal;
+    pthread_mutex_lock(&pWal->mutex);
+    if (pWal->syncedVersion < pReq->syncedVersion) pWal->syncedVersion = pReq->syncedVersion;
+    pthread_mutex_unlock(&pWal->mutex);
+  }
+
+  wTrace("syncfs the wals of a disk, latency:%" PRId64 "us", latency);
+}
+
+static void walProcessFsyncReqs(SWalDisk *pDisk, SWalFsyncReq *pReqs) {
+  SWalFsyncStat stat = {0};
+  int32_t       numOfWals = 0;
+
+  pReqs = walGroupFsyncReqs(pReqs, &numOfWals);
+  if (numOfWals > 1) walSyncFsToVersion(&stat, pReqs);
+
+  while (pReqs != NULL) {
+    SWal *   pWal = pReqs->pWal;
+    uint64_t fsyncVer = 0;
+
+    // the requests of the same wal are done by one fsync, or none if syncfs has made them durable
+    for (SWalFsyncReq *pReq = pReqs; pReq != NULL && pReq->pWal == pWal; pReq = pReq->next) {
+      if (pReq->version > fsyncVer) fsyncVer = pReq->version;
+    }
+
+    int32_t code = walFsyncToVersion(&stat, pWal, fsyncVer);
+
+    while (pReqs != NULL && pReqs->pWal == pWal) {
+      SWalFsyncReq *pReq = pReqs;
+      pReqs = pReq->next;
+      (*pReq->fp)(pReq->param, code);
+      stat.numOfReqs++;
+      tfree(pReq);
+    }
+
+    walRelease(pWal);
+  }
+
+  pthread_mutex_lock(&pDisk->mutex);
+  pDisk->stat.numOfReqs += stat.numOfReqs;
+  pDisk->stat.numOfFsyncs += stat.numOfFsyncs;
+  pDisk->stat.numOfSyncFs += stat.numOfSyncFs;
+  for (int32_t i = 0; i < WAL_FSYNC_BUCKETS; ++i) {
+    pDisk->stat.latency[i] += stat.latency[i];
+  }
+  pthread_mutex_unlock(&pDisk->mutex);
+}
+
+static void *walFsyncThreadFunc(void *param) {
+  SWalDisk *pDisk = param;
+  setThreadName("walFsync");
+
+  while (1) {
+    pthread_mutex_lock(&pDisk->mutex);
+    while (pDisk->pHead == NULL && !pDisk->stop) {
+      pthread_cond_wait(&pDisk->cond, &pDisk->mutex);
+    }
+    SWalFsyncReq *pReqs = pDisk->pHead;
+    pDisk->pHead = NULL;
+    pDisk->pTail = NULL;
+    int8_t stop = pDisk->stop;
+    pthread_mutex_unlock(&pDisk->mutex);
+
+    if (pReqs == NULL && stop) break;
+
+    walProcessFsyncReqs(pDisk, pReqs);
+
+    if (taosGetTimestampMs() - pDisk->lastReport >= WAL_FSYNC_REPORT_MS) walReportFsync(pDisk);
+  }
+
+  return NULL;
+}
+
+// print the fsync latency histogram of the disk since the last report
+static void walReportFsync(SWalDisk *pDisk) {
+  char          buf[WAL_FSYNC_BUCKETS * 32] = {0};
+  int32_t       len = 0;
+  SWalFsyncStat stat;
+
+  pDisk->lastReport = taosGetTimestampMs();
+
+  pthread_mutex_lock(&pDisk->mutex);
+  stat = pDisk->stat;
+  pthread_mutex_unlock(&pDisk->mutex);
+
+  int64_t numOfFsyncs = stat.numOfFsyncs - pDisk->reported.numOfFsyncs;
+  if (numOfFsyncs == 0) return;
+
+  for (int32_t i = 0; i < WAL_FSYNC_BUCKETS; ++i) {
+    int64_t n = stat.latency[i] - pDisk->reported.latency[i];
+    if (n == 0) continue;
+    if (i < WAL_FSYNC_BUCKETS - 1) {
+      len += snprintf(buf + len, sizeof(buf) - len, " <%" PRId64 "us:%" PRId64, (int64_t)(64LL << i), n);
+    } else {
+      len += snprintf(buf + len, sizeof(buf) - len, " >=%" PRId64 "us:%" PRId64, (int64_t)(64LL << (i - 1)), n);
+    }
+  }
+
+  wInfo("disk:%" PRId64 ", %" PRId64 " fsync requests are done by %" PRId64 " fsyncs (%" PRId64 " syncfs), latency%s",
+        pDisk->dev, stat.numOfReqs - pDisk->reported.numOfReqs, numOfFsyncs,
+        stat.numOfSyncFs - pDisk->reported.numOfSyncFs, buf);
+
+  pDisk->reported = stat;
+}
+
+void walGetFsyncStat(SWalFsyncStat *pStat) {
+  memset(pStat, 0, sizeof(*pStat));
+
+  pthread_mutex_lock(&tsWalDiskMutex);
+
+  for (int32_t i = 0; i < tsWalNumOfDisks; ++i) {
+    SWalDisk *pDisk = tsWalDisks + i;
+
+    pthread_mutex_lock(&pDisk->mutex);
+    pStat->numOfReqs += pDisk->stat.numOfReqs;
+    pStat->numOfFsyncs += pDisk->stat.numOfFsyncs;
+    pStat->numOfSyncFs += pDisk->stat.numOfSyncFs;
+    for (int32_t b = 0; b < WAL_FSYNC_BUCKETS; ++b) {
+      pStat->latency[b] += pDisk->stat.latency[b];
+    }
+    pthread_mutex_unlock(&pDisk->mutex);
+  }
+
+  pthread_mutex_unlock(&tsWalDiskMutex);
+}
@@ -57,6 +57,7 @@ int32_t walInit() {
 
 void walCleanUp() {
   walStopThread();
+  walCleanUpDisks();
   taosCloseRef(tsWal.refId);
   pthread_mutex_destroy(&tsWal.mutex);
   wInfo("wal module is cleaned up");
@@ -86,6 +87,8 @@ void *walOpen(char *path, SWalCfg *pCfg) {
     return NULL;
   }
 
+  pWal->pDisk = walGetDisk(pWal->path);
+
    pWal->rid = taosAddRef(tsWal.refId, pWal);
    if (pWal->rid < 0) {
     walFreeObj(pWal);
@@ -138,6 +141,10 @@ void walClose(void *handle) {
   taosRemoveRef(tsWal.refId, pWal->rid);
 }
 
+SWal *walAcquire(SWal *pWal) { return taosAcquireRef(tsWal.refId, pWal->rid); }
+
+void walRelease(SWal *pWal) { taosReleaseRef(tsWal.refId, pWal->rid); }
+
 static int32_t walInitObj(SWal *pWal) {
   if (taosMkDir(pWal->path, 0755) != 0) {
     wError("vgId:%d, path:%s, failed to create directory since %s", pWal->vgId, pWal->path, strerror(errno));
@@ -154,6 +161,7 @@ static void walFreeObj(void *wal) {
 
   tfClose(pWal->tfd);
   pthread_mutex_destroy(&pWal->mutex);
+  tfree(pWal->batchBuf);
   tfree(pWal);
 }
 
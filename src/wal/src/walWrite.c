@@ -19,6 +19,8 @@
 #include "taoserror.h"
 #include "taosmsg.h"
 #include "tchecksum.h"
+#include "tglobal.h"
+#include "tscompression.h"
 #include "tfile.h"
 #include "twal.h"
 #include "walInt.h"
@@ -39,6 +41,15 @@ int32_t walRenew(void *handle) {
   pthread_mutex_lock(&pWal->mutex);
 
   if (tfValid(pWal->tfd)) {
+    // the pending fsync requests can not reach the closed file
+    if (pWal->syncedVersion < pWal->fsyncVersion) {
+      if (tfFsync(pWal->tfd) < 0) {
+        wError("vgId:%d, file:%s, failed to fsync while renew since %s", pWal->vgId, pWal->name, strerror(errno));
+      } else {
+        pWal->syncedVersion = pWal->version;
+      }
+    }
+
     tfClose(pWal->tfd);
     wDebug("vgId:%d, file:%s, it is closed while renew", pWal->vgId, pWal->name);
   }
@@ -115,7 +126,6 @@ void walRemoveAllOldFiles(void *handle) {
 #if defined(WAL_CHECKSUM_WHOLE)
 
 static void walUpdateChecksum(SWalHead *pHead) {
-  pHead->sver = 2;
   pHead->cksum = 0;
   pHead->cksum = taosCalcChecksum(0, (uint8_t *)pHead, sizeof(*pHead) + pHead->len);
 }
@@ -134,45 +144,208 @@ static int walValidateChecksum(SWalHead *pHead) {
 
 #endif
 
-int32_t walWrite(void *handle, SWalHead *pHead) {
-  if (handle == NULL) return -1;
-
-  SWal *  pWal = handle;
-  int32_t code = 0;
-
-  // no wal
-  if (!tfValid(pWal->tfd)) return 0;
-  if (pWal->level == TAOS_WAL_NOLOG) return 0;
-  if (pHead->version <= pWal->version) return 0;
-
+static void walSignHead(SWalHead *pHead) {
   pHead->signature = WAL_SIGNATURE;
 #if defined(WAL_CHECKSUM_WHOLE)
+  pHead->sver = 2;
   walUpdateChecksum(pHead);
 #else
   pHead->sver = 0;
   taosCalcChecksumAppend(0, (uint8_t *)pHead, sizeof(SWalHead));
 #endif
+}
+
+// Called with the mutex of the wal
+static int32_t walWriteVecs(SWal *pWal, struct iovec *iov, int32_t iovcnt, int64_t len, uint64_t lastVer) {
+  int64_t written = tfWritev(pWal->tfd, iov, iovcnt);
+
+  if (written != len) {
+    // a short write leaves errno alone
+    int32_t code = (written < 0 && errno != 0) ? TAOS_SYSTEM_ERROR(errno) : TAOS_SYSTEM_ERROR(EIO);
+    wError("vgId:%d, file:%s, failed to write %" PRId64 " bytes, written:%" PRId64 " since %s", pWal->vgId,
+           pWal->name, len, written, tstrerror(code));
+    return code;
+  }
+
+  wTrace("vgId:%d, write wal, fileId:%" PRId64 " tfd:%" PRId64 " hver:%" PRIu64 " wver:%" PRIu64 " len:%" PRId64,
+         pWal->vgId, pWal->fileId, pWal->tfd, lastVer, pWal->version, len);
+  pWal->version = lastVer;
+
+  return 0;
+}
+
+// Cut the records of a failed batch, which start at offset of the file fileId, so none of the batch is in WAL. Called
+// with the mutex of the wal
+static void walRollbackBatch(SWal *pWal, int64_t fileId, int64_t offset, uint64_t lastVer) {
+  if (pWal->fileId == fileId && tfValid(pWal->tfd)) {
+    if (tfFtruncate(pWal->tfd, offset) < 0 || tfLseek(pWal->tfd, offset, SEEK_SET) < 0) {
+      wError("vgId:%d, file:%s, failed to roll back to offset:%" PRId64 " since %s", pWal->vgId, pWal->name, offset,
+             strerror(errno));
+    }
+  }
+
+  wDebug("vgId:%d, file:%s, batch is rolled back, wver:%" PRIu64 " to %" PRIu64, pWal->vgId, pWal->name, pWal->version,
+         lastVer);
+  pWal->version = lastVer;
+}
+
+// Compress the body of the head into dest as a record of WAL_SVER_COMP, which has room for the head and pHead->len +
+// WAL_COMP_EXTRA bytes. Return the length of the record, or 0 if the body is not compressed
+static int32_t walCompressHead(SWalHead *pHead, char *dest) {
+#if defined(WAL_CHECKSUM_WHOLE)
+  if (tsWalCompression == 0 || pHead->len < WAL_COMP_MIN_LEN) return 0;
+
+  SWalHead *pDest = (SWalHead *)dest;
+  char *    output = pDest->cont + sizeof(int32_t);
+  int32_t   len = 0;
+
+  if (tsWalCompression == WAL_COMP_ZSTD) {
+    len = tsCompressStringZstdImp(pHead->cont, pHead->len, output, pHead->len + 1);
+  } else {
+    len = tsCompressStringImp(pHead->cont, pHead->len, output, pHead->len + 1);
+  }
 
-  int32_t contLen = pHead->len + sizeof(SWalHead);
+  // the first byte 0 means the data is stored as it is
+  if (len <= 0 || output[0] == 0 || len + (int32_t)sizeof(int32_t) >= pHead->len) return 0;
 
+  memcpy(pDest, pHead, sizeof(SWalHead));
+  memcpy(pDest->cont, &pHead->len, sizeof(int32_t));
+  pDest->len = len + sizeof(int32_t);
+  pDest->signature = WAL_SIGNATURE;
+  pDest->sver = WAL_SVER_COMP;
+  walUpdateChecksum(pDest);
+
+  return (int32_t)sizeof(SWalHead) + pDest->len;
+#else
+  return 0;
+#endif
+}
+
+int32_t walWrite(void *handle, SWalHead *pHead) { return walWriteBatch(handle, &pHead, 1); }
+
+/**
+ * Write the heads of a batch with one writev. The heads are signed in place and written from where they are, only the
+ * compressed records are built in batchBuf. If any part of the batch fails, the records written before are cut, so
+ * either the whole batch is in WAL or none of it.
+ */
+int32_t walWriteBatch(void *handle, SWalHead **pHeads, int32_t num) {
+  if (handle == NULL) return -1;
+
+  SWal *       pWal = handle;
+  struct iovec iov[WAL_BATCH_IOVS];
+  int32_t      iovcnt = 0;
+  int64_t      len = 0;
+  int32_t      bufLen = 0;
+  int32_t      code = 0;
+
+  // no wal
+  if (!tfValid(pWal->tfd)) return 0;
+  if (pWal->level == TAOS_WAL_NOLOG) return 0;
+
+  // the version, the file and the offset rolled back to do not change until the batch is written
   pthread_mutex_lock(&pWal->mutex);
 
-  if (tfWrite(pWal->tfd, pHead, contLen) != contLen) {
+  uint64_t startVer = pWal->version;
+  uint64_t lastVer = startVer;
+  int64_t  fileId = pWal->fileId;
+  int64_t  offset = tfLseek(pWal->tfd, 0, SEEK_CUR);
+  if (offset < 0) {
     code = TAOS_SYSTEM_ERROR(errno);
-    wError("vgId:%d, file:%s, failed to write since %s", pWal->vgId, pWal->name, strerror(errno));
-  } else {
-    wTrace("vgId:%d, write wal, fileId:%" PRId64 " tfd:%" PRId64 " hver:%" PRId64 " wver:%" PRIu64 " len:%d", pWal->vgId,
-           pWal->fileId, pWal->tfd, pHead->version, pWal->version, pHead->len);
-    pWal->version = pHead->version;
+    pthread_mutex_unlock(&pWal->mutex);
+    return code;
   }
 
-  pthread_mutex_unlock(&pWal->mutex);
+  for (int32_t i = 0; i < num; ++i) {
+    SWalHead *pHead = pHeads[i];
+    if (pHead->version <= lastVer) continue;
+
+    int32_t contLen = pHead->len + sizeof(SWalHead);
+    int32_t room = contLen + WAL_COMP_EXTRA;
+    bool    compress = (tsWalCompression != 0 && room <= WAL_BATCH_SIZE);
+
+    if (iovcnt == WAL_BATCH_IOVS || (compress && bufLen + room > WAL_BATCH_SIZE)) {
+      code = walWriteVecs(pWal, iov, iovcnt, len, lastVer);
+      if (code != 0) break;
+      iovcnt = 0;
+      len = 0;
+      bufLen = 0;
+    }
+
+    int32_t recLen = 0;
+    if (compress) {
+      if (pWal->batchBuf == NULL) {
+        pWal->batchBuf = tmalloc(WAL_BATCH_SIZE);
+        if (pWal->batchBuf == NULL) {
+          code = TSDB_CODE_COM_OUT_OF_MEMORY;
+          break;
+        }
+      }
+
+      recLen = walCompressHead(pHead, pWal->batchBuf + bufLen);
+    }
 
-  ASSERT(contLen == pHead->len + sizeof(SWalHead));
+    if (recLen > 0) {
+      iov[iovcnt].iov_base = pWal->batchBuf + bufLen;
+      bufLen += recLen;
+    } else {
+      walSignHead(pHead);
+      iov[iovcnt].iov_base = pHead;
+      recLen = contLen;
+    }
+
+    iov[iovcnt].iov_len = recLen;
+    iovcnt++;
+    len += recLen;
+    lastVer = pHead->version;
+  }
+
+  if (code == 0 && iovcnt > 0) {
+    code = walWriteVecs(pWal, iov, iovcnt, len, lastVer);
+  }
+
+  if (code != 0) {
+    walRollbackBatch(pWal, fileId, offset, startVer);
+  }
+
+  pthread_mutex_unlock(&pWal->mutex);
 
   return code;
 }
 
+/**
+ * Restore the body of a record of WAL_SVER_COMP in place, pHead has room for size bytes. The records not compressed
+ * are left as they are.
+ */
+int32_t walDecompressHead(SWalHead *pHead, int32_t size) {
+  if (pHead->sver != WAL_SVER_COMP) return 0;
+
+  int32_t rawLen = 0;
+  int32_t compLen = pHead->len - (int32_t)sizeof(int32_t);
+  memcpy(&rawLen, pHead->cont, sizeof(int32_t));
+
+  if (compLen <= 0 || rawLen <= 0 || rawLen > size - (int32_t)sizeof(SWalHead)) {
+    wError("wal record is not valid for decompression, hver:%" PRIu64 " len:%d rawLen:%d", pHead->version, pHead->len,
+           rawLen);
+    return TSDB_CODE_WAL_FILE_CORRUPTED;
+  }
+
+  char *input = tmalloc(compLen);
+  if (input == NULL) return TSDB_CODE_COM_OUT_OF_MEMORY;
+  memcpy(input, pHead->cont + sizeof(int32_t), compLen);
+
+  int32_t len = tsDecompressStringImp(input, compLen, pHead->cont, rawLen);
+  tfree(input);
+
+  if (len != rawLen) {
+    wError("failed to decompress wal record, hver:%" PRIu64 " len:%d rawLen:%d", pHead->version, pHead->len, rawLen);
+    return TSDB_CODE_WAL_FILE_CORRUPTED;
+  }
+
+  pHead->len = rawLen;
+  pHead->sver = 2;
+  return 0;
+}
+
 void walFsync(void *handle, bool forceFsync) {
   SWal *pWal = handle;
   if (pWal == NULL || !tfValid(pWal->tfd)) return;
@@ -417,7 +590,85 @@ static int walSMemRowCheck(SWalHead *pHead) {
   return 0;
 }
 
-static int32_t walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp, char *name, int64_t fileId) {
+typedef struct SWalRecord {
+  struct SWalRecord *next;
+  int64_t            offset;  // offset of the end of the record in the file
+  char               data[];  // the head and body
+} SWalRecord;
+
+typedef struct {
+  SWal *          pWal;
+  void *          pVnode;
+  FWalWrite *     writeFp;
+  char *          name;
+  int64_t         fileId;
+  int64_t         fileSize;
+  int64_t         records;
+  int64_t         lastReport;
+  int8_t          pipeline;
+  int8_t          done;
+  int32_t         code;
+  int64_t         bytes;  // bytes of the records queued
+  SWalRecord *    pHead;
+  SWalRecord *    pTail;
+  pthread_mutex_t mutex;
+  pthread_cond_t  notEmpty;
+  pthread_cond_t  notFull;
+} SWalRestore;
+
+static void walApplyRecord(SWalRestore *pRestore, SWalHead *pHead, int64_t offset) {
+  SWal *pWal = pRestore->pWal;
+
+  pWal->version = pHead->version;
+  (*pRestore->writeFp)(pRestore->pVnode, pHead, TAOS_QTYPE_WAL, NULL);
+  pRestore->records++;
+
+  if (taosGetTimestampMs() - pRestore->lastReport >= WAL_RESTORE_REPORT_MS) {
+    pRestore->lastReport = taosGetTimestampMs();
+    wInfo("vgId:%d, file:%s, %" PRId64 " of %" PRId64 " bytes are restored, records:%" PRId64 " wver:%" PRIu64,
+          pWal->vgId, pRestore->name, offset, pRestore->fileSize, pRestore->records, pWal->version);
+  }
+}
+
+// Apply the record read from the file, or queue it for the restore thread if the file is read by another thread
+static int32_t walRestoreRecord(SWalRestore *pRestore, SWalHead *pHead, int64_t offset) {
+  if (!pRestore->pipeline) {
+    walApplyRecord(pRestore, pHead, offset);
+    return 0;
+  }
+
+  int32_t     len = sizeof(SWalHead) + pHead->len;
+  SWalRecord *pRecord = tmalloc(sizeof(SWalRecord) + len);
+  if (pRecord == NULL) return TSDB_CODE_COM_OUT_OF_MEMORY;
+
+  pRecord->next = NULL;
+  pRecord->offset = offset;
+  memcpy(pRecord->data, pHead, len);
+
+  pthread_mutex_lock(&pRestore->mutex);
+  while (pRestore->bytes >= WAL_RESTORE_QUEUE_SIZE) {
+    pthread_cond_wait(&pRestore->notFull, &pRestore->mutex);
+  }
+
+  if (pRestore->pTail == NULL) {
+    pRestore->pHead = pRecord;
+  } else {
+    pRestore->pTail->next = pRecord;
+  }
+  pRestore->pTail = pRecord;
+  pRestore->bytes += len;
+
+  pthread_cond_signal(&pRestore->notEmpty);
+  pthread_mutex_unlock(&pRestore->mutex);
+
+  return 0;
+}
+
+// Read, check and decompress the records of the file
+static int32_t walReadWalFile(SWalRestore *pRestore) {
+  SWal *  pWal = pRestore->pWal;
+  char *  name = pRestore->name;
+  int64_t fileId = pRestore->fileId;
   int32_t size = WAL_MAX_SIZE;
   void *  buffer = tmalloc(size);
   if (buffer == NULL) {
@@ -455,7 +706,7 @@ static int32_t walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp, ch
     }
 
 #if defined(WAL_CHECKSUM_WHOLE)
-    if ((pHead->sver == 0 && !walValidateChecksum(pHead)) || pHead->sver < 0 || pHead->sver > 2) {
+    if ((pHead->sver == 0 && !walValidateChecksum(pHead)) || pHead->sver < 0 || pHead->sver > WAL_SVER_COMP) {
       wError("vgId:%d, file:%s, wal head cksum is messed up, hver:%" PRIu64 " len:%d offset:%" PRId64, pWal->vgId, name,
              pHead->version, pHead->len, offset);
       code = walSkipCorruptedRecord(pWal, pHead, tfd, &offset);
@@ -538,17 +789,22 @@ static int32_t walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp, ch
     wTrace("vgId:%d, restore wal, fileId:%" PRId64 " hver:%" PRIu64 " wver:%" PRIu64 " len:%d offset:%" PRId64,
            pWal->vgId, fileId, pHead->version, pWal->version, pHead->len, offset);
 
-    pWal->version = pHead->version;
+    if (walDecompressHead(pHead, size) != 0) {
+      wError("vgId:%d, file:%s, failed to decompress wal record, hver:%" PRIu64 " offset:%" PRId64, pWal->vgId, name,
+             pHead->version, offset);
+      continue;
+    }
 
     // wInfo("writeFp: %ld", offset);
     if (0 != walSMemRowCheck(pHead)) {
       wError("vgId:%d, restore wal, fileId:%" PRId64 " hver:%" PRIu64 " wver:%" PRIu64 " len:%d offset:%" PRId64,
              pWal->vgId, fileId, pHead->version, pWal->version, pHead->len, offset);
-      tfClose(tfd);
-      tfree(buffer);
-      return TAOS_SYSTEM_ERROR(errno);
+      code = TAOS_SYSTEM_ERROR(errno);
+      break;
     }
-    (*writeFp)(pVnode, pHead, TAOS_QTYPE_WAL, NULL);
+
+    code = walRestoreRecord(pRestore, pHead, offset);
+    if (code != 0) break;
   }
 
   tfClose(tfd);
@@ -558,6 +814,98 @@ static int32_t walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp, ch
   return code;
 }
 
+static void *walReadThreadFunc(void *param) {
+  SWalRestore *pRestore = param;
+  setThreadName("walRead");
+
+  int32_t code = walReadWalFile(pRestore);
+
+  pthread_mutex_lock(&pRestore->mutex);
+  pRestore->code = code;
+  pRestore->done = 1;
+  pthread_cond_signal(&pRestore->notEmpty);
+  pthread_mutex_unlock(&pRestore->mutex);
+
+  return NULL;
+}
+
+// The file is read and checked by a read thread while the records are applied by this one
+static int32_t walRestoreWalFileInPipeline(SWalRestore *pRestore) {
+  pthread_t      thread;
+  pthread_attr_t thAttr;
+
+  pthread_mutex_init(&pRestore->mutex, NULL);
+  pthread_cond_init(&pRestore->notEmpty, NULL);
+  pthread_cond_init(&pRestore->notFull, NULL);
+
+  pthread_attr_init(&thAttr);
+  pthread_attr_setdetachstate(&thAttr, PTHREAD_CREATE_JOINABLE);
+  if (pthread_create(&thread, &thAttr, walReadThreadFunc, pRestore) != 0) {
+    wError("vgId:%d, file:%s, failed to create read thread since %s", pRestore->pWal->vgId, pRestore->name,
+           strerror(errno));
+    pthread_attr_destroy(&thAttr);
+    pRestore->pipeline = 0;
+    return walReadWalFile(pRestore);
+  }
+  pthread_attr_destroy(&thAttr);
+
+  while (1) {
+    pthread_mutex_lock(&pRestore->mutex);
+    while (pRestore->pHead == NULL && !pRestore->done) {
+      pthread_cond_wait(&pRestore->notEmpty, &pRestore->mutex);
+    }
+
+    SWalRecord *pRecords = pRestore->pHead;
+    pRestore->pHead = NULL;
+    pRestore->pTail = NULL;
+    pRestore->bytes = 0;
+    pthread_cond_signal(&pRestore->notFull);
+    pthread_mutex_unlock(&pRestore->mutex);
+
+    if (pRecords == NULL) break;
+
+    while (pRecords != NULL) {
+      SWalRecord *pRecord = pRecords;
+      pRecords = pRecord->next;
+      walApplyRecord(pRestore, (SWalHead *)pRecord->data, pRecord->offset);
+      tfree(pRecord);
+    }
+  }
+
+  pthread_join(thread, NULL);
+  pthread_mutex_destroy(&pRestore->mutex);
+  pthread_cond_destroy(&pRestore->notEmpty);
+  pthread_cond_destroy(&pRestore->notFull);
+
+  return pRestore->code;
+}
+
+static int32_t walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp, char *name, int64_t fileId) {
+  SWalRestore restore = {0};
+  struct stat st;
+  int32_t     code = 0;
+
+  restore.pWal = pWal;
+  restore.pVnode = pVnode;
+  restore.writeFp = writeFp;
+  restore.name = name;
+  restore.fileId = fileId;
+  restore.lastReport = taosGetTimestampMs();
+  if (stat(name, &st) == 0) restore.fileSize = st.st_size;
+
+  int64_t stime = restore.lastReport;
+  if (tsWalRestorePipeline) {
+    restore.pipeline = 1;
+    code = walRestoreWalFileInPipeline(&restore);
+  } else {
+    code = walReadWalFile(&restore);
+  }
+
+  wInfo("vgId:%d, file:%s, %" PRId64 " bytes %" PRId64 " records are restored in %" PRId64 "ms, wver:%" PRIu64,
+        pWal->vgId, name, restore.fileSize, restore.records, taosGetTimestampMs() - stime, pWal->version);
+  return code;
+}
+
 uint64_t walGetVersion(twalh param) {
   SWal *pWal = param;
   if (pWal == 0) return 0;
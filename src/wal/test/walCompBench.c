@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+#include "os.h"
+#include "tutil.h"
+#include "tglobal.h"
+#include "tlog.h"
+#include "taosmsg.h"
+#include "tdataformat.h"
+#include "twal.h"
+#include "tfile.h"
+
+// Write submit msgs of the meters table (ts, current float, voltage int, phase float, location binary(24)) into a wal
+// with each walCompression, then restore them and check the bodies.
+
+static char      path[128] = "/tmp/walcomp";
+static int       numOfMsgs = 200;
+static int       rowsPerMsg = 500;
+static int       level = 1;
+static SWalHead **pHeads = NULL;
+static int       restored = 0;
+static int       mismatched = 0;
+
+static const char *locations[] = {"California.SanFrancisco", "California.LosAngeles", "California.SanDiego",
+                                  "California.SanJose",      "California.PaloAlto",    "California.Campbell"};
+
+static SWalHead *buildSubmitMsg(int msgIndex) {
+  int       rowLen = TD_MEM_ROW_DATA_HEAD_SIZE + 8 + 4 + 4 + 4 + 2 + sizeof(VarDataLenT) + 24;
+  int       bodyLen = sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + rowLen * rowsPerMsg;
+  SWalHead *pHead = calloc(1, sizeof(SWalHead) + bodyLen);
+
+  SSubmitMsg *pMsg = (SSubmitMsg *)pHead->cont;
+  SSubmitBlk *pBlk = (SSubmitBlk *)pMsg->blocks;
+  char *      row = pBlk->data;
+  const char *location = locations[msgIndex % tListLen(locations)];
+  int64_t     ts = 1600000000000LL + (int64_t)msgIndex * rowsPerMsg * 1000;
+
+  for (int i = 0; i < rowsPerMsg; ++i) {
+    memRowSetType(row, SMEM_ROW_DATA);
+    SDataRow dataRow = memRowDataBody(row);
+    char *   p = POINTER_SHIFT(dataRow, TD_DATA_ROW_HEAD_SIZE);
+
+    int64_t  key = ts + (int64_t)i * 1000 + rand() % 10;
+    float    current = 10.0f + (rand() % 400) / 100.0f;
+    int32_t  voltage = 218 + rand() % 5;
+    float    phase = 0.31f + (rand() % 10) / 100.0f;
+    uint16_t offset = 8 + 4 + 4 + 4 + 2;
+
+    memcpy(p, &key, 8);
+    memcpy(p + 8, &current, 4);
+    memcpy(p + 12, &voltage, 4);
+    memcpy(p + 16, &phase, 4);
+    memcpy(p + 20, &offset, 2);
+    varDataSetLen(p + offset, (VarDataLenT)strlen(location));
+    memcpy(varDataVal(p + offset), location, strlen(location));
+
+    int len = TD_DATA_ROW_HEAD_SIZE + offset + sizeof(VarDataLenT) + (int)strlen(location);
+    dataRowSetLen(dataRow, len);
+    dataRowSetVersion(dataRow, 1);
+    row = POINTER_SHIFT(row, TD_MEM_ROW_TYPE_SIZE + len);
+  }
+
+  pBlk->dataLen = htonl((int32_t)(row - pBlk->data));
+  pBlk->numOfRows = htons(rowsPerMsg);
+  pMsg->numOfBlocks = htonl(1);
+  pMsg->length = htonl((int32_t)(row - pHead->cont));
+
+  pHead->msgType = TSDB_MSG_TYPE_SUBMIT;
+  pHead->len = (int32_t)(row - pHead->cont);
+  return pHead;
+}
+
+static int checkRestored(void *pVnode, void *data, int type, void *pMsg) {
+  SWalHead *pHead = data;
+  SWalHead *pOrig = pHeads[pHead->version - 1];
+
+  if (pHead->len != pOrig->len || memcmp(pHead->cont, pOrig->cont, pHead->len) != 0) mismatched++;
+  restored++;
+  return 0;
+}
+
+static void runBench(int compression) {
+  char cmd[256];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+  system(cmd);
+
+  tsWalCompression = compression;
+
+  SWalCfg walCfg = {.walLevel = level, .keep = TAOS_WAL_KEEP};
+  void *  pWal = walOpen(path, &walCfg);
+  walRestore(pWal, NULL, checkRestored);
+
+  int64_t bytes = 0;
+  int64_t st = taosGetTimestampUs();
+  for (int i = 0; i < numOfMsgs; ++i) {
+    pHeads[i]->version = i + 1;
+    walWrite(pWal, pHeads[i]);
+    walFsync(pWal, false);
+    bytes += pHeads[i]->len;
+  }
+  int64_t wt = taosGetTimestampUs() - st;
+
+  int64_t fsize = walGetFSize(pWal);
+  walClose(pWal);
+
+  restored = 0;
+  mismatched = 0;
+  pWal = walOpen(path, &walCfg);
+  st = taosGetTimestampUs();
+  walRestore(pWal, NULL, checkRestored);
+  int64_t rt = taosGetTimestampUs() - st;
+  walClose(pWal);
+
+  printf("  %-4s: %6.1f bytes/row, ratio %5.2f, write %7.1f MB/s, restore %7.1f MB/s, restored %d mismatched %d\n",
+         compression == 0 ? "none" : (compression == 1 ? "lz4" : "zstd"), (double)fsize / numOfMsgs / rowsPerMsg,
+         (double)bytes / fsize, bytes / (double)wt, bytes / (double)rt, restored, mismatched);
+}
+
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-p") == 0 && i < argc - 1) {
+      tstrncpy(path, argv[++i], sizeof(path));
+    } else if (strcmp(argv[i], "-n") == 0 && i < argc - 1) {
+      numOfMsgs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i < argc - 1) {
+      rowsPerMsg = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i < argc - 1) {
+      level = atoi(argv[++i]);
+    } else {
+      printf("\nusage: %s [options] \n", argv[0]);
+      printf("  [-p path]: wal file path, default is:%s\n", path);
+      printf("  [-n msgs]: number of submit msgs, default is:%d\n", numOfMsgs);
+      printf("  [-r rows]: rows of each submit msg, default is:%d\n", rowsPerMsg);
+      printf("  [-l level]: wal level, default is:%d\n", level);
+      exit(0);
+    }
+  }
+
+  taosInitLog("walcomp.log", 100000, 10);
+  tfInit();
+  walInit();
+
+  srand(7);
+  pHeads = calloc(numOfMsgs, sizeof(SWalHead *));
+  for (int i = 0; i < numOfMsgs; ++i) {
+    pHeads[i] = buildSubmitMsg(i);
+  }
+
+  printf("%d submit msgs of %d rows, %d bytes each, wal level %d:\n", numOfMsgs, rowsPerMsg, pHeads[0]->len, level);
+  runBench(0);
+  runBench(1);
+  runBench(2);
+
+  walCleanUp();
+  tfCleanup();
+  return 0;
+}
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "os.h"
+#include "tfile.h"
+#include "tglobal.h"
+#include "twal.h"
+
+// fsync and syncfs are wrapped at link time, so the tests see when the wals become durable and can hold the fsync
+// thread inside the call
+extern "C" {
+int __real_fsync(int fd);
+int __real_syncfs(int fd);
+int __wrap_fsync(int fd);
+int __wrap_syncfs(int fd);
+}
+
+static std::mutex              gateMutex;
+static std::condition_variable gateCond;
+static bool                    gateClosed = false;
+static int                     gateWaiters = 0;
+static std::atomic<int>        numOfFsyncs(0);
+static std::atomic<int>        numOfSyncFs(0);
+
+static void passGate() {
+  std::unique_lock<std::mutex> lock(gateMutex);
+  gateWaiters++;
+  gateCond.notify_all();
+  gateCond.wait(lock, [] { return !gateClosed; });
+  gateWaiters--;
+}
+
+int __wrap_fsync(int fd) {
+  passGate();
+  int code = __real_fsync(fd);
+  numOfFsyncs++;
+  return code;
+}
+
+int __wrap_syncfs(int fd) {
+  passGate();
+  int code = __real_syncfs(fd);
+  numOfSyncFs++;
+  return code;
+}
+
+static void closeGate() {
+  std::lock_guard<std::mutex> lock(gateMutex);
+  gateClosed = true;
+}
+
+static void openGate() {
+  std::lock_guard<std::mutex> lock(gateMutex);
+  gateClosed = false;
+  gateCond.notify_all();
+}
+
+static void waitGateWaiters(int n) {
+  std::unique_lock<std::mutex> lock(gateMutex);
+  gateCond.wait(lock, [n] { return gateWaiters >= n; });
+}
+
+// a durable response, with the fsync and syncfs calls done when it is sent
+typedef struct {
+  std::atomic<bool> done;
+  int32_t           code;
+  int               fsyncs;
+  int               syncfs;
+} SResponse;
+
+static void sendResponse(void *param, int32_t code) {
+  SResponse *pRsp = (SResponse *)param;
+  pRsp->code = code;
+  pRsp->fsyncs = numOfFsyncs;
+  pRsp->syncfs = numOfSyncFs;
+  pRsp->done = true;
+}
+
+static bool waitResponse(SResponse *pRsp, int ms) {
+  for (int i = 0; i < ms && !pRsp->done; i++) taosMsleep(1);
+  return pRsp->done;
+}
+
+static const int numOfWals = 3;
+static char      rootDir[] = "/tmp/walFsyncTest";
+
+class WalFsyncTest : public ::testing::Test {
+ protected:
+  void *   wals[numOfWals];
+  uint64_t version = 0;
+
+  void SetUp() override {
+    taosRemoveDir(rootDir);
+    taosMkDir(rootDir, 0755);
+    ASSERT_EQ(tsWalFsyncThread, 1);
+    ASSERT_EQ(tfInit(), 0);
+    ASSERT_EQ(walInit(), 0);
+
+    for (int i = 0; i < numOfWals; i++) {
+      char    path[64];
+      SWalCfg cfg = {0};
+      cfg.vgId = i + 1;
+      cfg.walLevel = TAOS_WAL_FSYNC;
+      cfg.fsyncPeriod = 0;
+      cfg.keep = TAOS_WAL_NOT_KEEP;
+
+      snprintf(path, sizeof(path), "%s/vnode%d", rootDir, i + 1);
+      taosMkDir(path, 0755);
+      wals[i] = walOpen(path, &cfg);
+      ASSERT_NE(wals[i], nullptr);
+      ASSERT_EQ(walRenew(wals[i]), 0);
+    }
+  }
+
+  void TearDown() override {
+    openGate();
+    for (int i = 0; i < numOfWals; i++) walClose(wals[i]);
+    walCleanUp();
+    tfCleanup();
+    taosRemoveDir(rootDir);
+  }
+
+  void write(void *pWal) {
+    char      buf[sizeof(SWalHead) + 64] = {0};
+    SWalHead *pHead = (SWalHead *)buf;
+    pHead->version = ++version;
+    pHead->len = 64;
+    ASSERT_EQ(walWrite(pWal, pHead), 0);
+  }
+};
+
+TEST_F(WalFsyncTest, responseAfterFsync) {
+  SResponse rsp;
+  rsp.done = false;
+
+  write(wals[0]);
+  int fsyncs = numOfFsyncs;
+
+  closeGate();
+  ASSERT_TRUE(walFsyncAsync(wals[0], false, sendResponse, &rsp));
+
+  // the fsync thread is held inside fsync, the response must not be out yet
+  waitGateWaiters(1);
+  taosMsleep(50);
+  ASSERT_FALSE(rsp.done);
+
+  openGate();
+  ASSERT_TRUE(waitResponse(&rsp, 5000));
+  ASSERT_EQ(rsp.code, 0);
+  ASSERT_EQ(rsp.fsyncs, fsyncs + 1);
+}
+
+TEST_F(WalFsyncTest, walsOfDiskMergedBySyncFs) {
+  SResponse rsps[numOfWals];
+  for (int i = 0; i < numOfWals; i++) rsps[i].done = false;
+
+  // hold the thread in the fsync of the first wal, so the other requests queue up meanwhile
+  write(wals[0]);
+  closeGate();
+  ASSERT_TRUE(walFsyncAsync(wals[0], false, sendResponse, &rsps[0]));
+  waitGateWaiters(1);
+
+  int fsyncs = numOfFsyncs + 1;
+  int syncfs = numOfSyncFs;
+  for (int i = 1; i < numOfWals; i++) {
+    write(wals[i]);
+    write(wals[i]);
+    ASSERT_TRUE(walFsyncAsync(wals[i], false, sendResponse, &rsps[i]));
+  }
+
+  openGate();
+  for (int i = 0; i < numOfWals; i++) {
+    ASSERT_TRUE(waitResponse(&rsps[i], 5000));
+    ASSERT_EQ(rsps[i].code, 0);
+  }
+
+  // one syncfs for the other wals, and no fsync of their own
+  ASSERT_EQ(rsps[0].fsyncs, fsyncs);
+  for (int i = 1; i < numOfWals; i++) {
+    ASSERT_EQ(rsps[i].syncfs, syncfs + 1);
+    ASSERT_EQ(rsps[i].fsyncs, fsyncs);
+  }
+
+  SWalFsyncStat stat;
+  walGetFsyncStat(&stat);
+  ASSERT_EQ(stat.numOfReqs, numOfWals);
+  ASSERT_EQ(stat.numOfFsyncs, 2);
+  ASSERT_EQ(stat.numOfSyncFs, 1);
+
+  int64_t total = 0;
+  for (int b = 0; b < WAL_FSYNC_BUCKETS; b++) total += stat.latency[b];
+  ASSERT_EQ(total, stat.numOfFsyncs);
+}
@@ -36,6 +36,146 @@ int writeToQueue(void *pVnode, void *data, int type, void *pMsg) {
   return 0;
 }
 
+// Let the file size limit fail the 2nd writev of a batch, the batch must be cut from the file and written again as a
+// whole once the limit is gone
+static void checkBatchFailure(int size) {
+  int           num = 200;
+  int           contLen = sizeof(SWalHead) + size;
+  int64_t       fsize = 0;
+  struct rlimit limit, oldLimit;
+
+  walRenew(pWal);
+  fsize = walGetFSize(pWal);
+
+  SWalHead **pHeads = (SWalHead **) malloc(sizeof(SWalHead *) * num);
+  for (int b=0; b<num; ++b) {
+    pHeads[b] = (SWalHead *) calloc(1, contLen);
+    pHeads[b]->version = ver + b + 1;
+    pHeads[b]->len = size;
+  }
+
+  signal(SIGXFSZ, SIG_IGN);
+  getrlimit(RLIMIT_FSIZE, &oldLimit);
+  limit = oldLimit;
+  limit.rlim_cur = fsize + (int64_t)contLen * num / 2;
+  setrlimit(RLIMIT_FSIZE, &limit);
+
+  int code = walWriteBatch(pWal, pHeads, num);
+  setrlimit(RLIMIT_FSIZE, &oldLimit);
+
+  if (code == 0 || walGetFSize(pWal) != fsize) {
+    printf("failed batch is not rolled back, code:0x%x size:%" PRId64 " expected:%" PRId64 "\n", code,
+           walGetFSize(pWal), fsize);
+    exit(-1);
+  }
+
+  code = walWriteBatch(pWal, pHeads, num);
+  if (code != 0 || walGetFSize(pWal) != fsize + (int64_t)contLen * num) {
+    printf("failed to write the batch again, code:0x%x size:%" PRId64 " expected:%" PRId64 "\n", code,
+           walGetFSize(pWal), fsize + (int64_t)contLen * num);
+    exit(-1);
+  }
+
+  ver += num;
+  printf("failed batch is rolled back and written again\n");
+
+  for (int b=0; b<num; ++b) free(pHeads[b]);
+  free(pHeads);
+}
+
+static int64_t restoredVer = 0;
+static int64_t restoredNum = 0;
+
+static char restoredByte(int64_t v, int32_t i) { return (char)((v + i / 32) & 0xff); }
+
+static int checkRestoredRecord(void *pVnode, void *data, int type, void *pMsg) {
+  SWalHead *pHead = data;
+
+  if ((int64_t)pHead->version != restoredVer + 1) {
+    printf("record is restored out of order, version:%" PRIu64 " expected:%" PRId64 "\n", pHead->version,
+           restoredVer + 1);
+    exit(-1);
+  }
+
+  for (int32_t i = 0; i < pHead->len; ++i) {
+    if (pHead->cont[i] != restoredByte(pHead->version, i)) {
+      printf("record is restored with wrong content, version:%" PRIu64 " offset:%d\n", pHead->version, i);
+      exit(-1);
+    }
+  }
+
+  restoredVer = pHead->version;
+  restoredNum++;
+  return 0;
+}
+
+// Write the records to a few wal files, then restore them with and without the read thread of the pipeline,
+// each record must reach writeFp once, in the order of the versions and with the content written
+static void checkRestore(char *path, int size) {
+  int     files = 3;
+  int     num = 4000;
+  int     contLen = sizeof(SWalHead) + size;
+  char    restorePath[160];
+  SWalCfg walCfg = {0};
+
+  snprintf(restorePath, sizeof(restorePath), "%s/restore", path);
+  taosRemoveDir(restorePath);
+  taosMkDir(path, 0755);
+
+  walCfg.walLevel = TAOS_WAL_WRITE;
+  walCfg.keep = TAOS_WAL_NOT_KEEP;
+
+  void *pRestoreWal = walOpen(restorePath, &walCfg);
+  if (pRestoreWal == NULL || walRestore(pRestoreWal, NULL, checkRestoredRecord) != 0) {
+    printf("failed to open the wal to restore\n");
+    exit(-1);
+  }
+
+  SWalHead *pHead = (SWalHead *) calloc(1, contLen);
+  int64_t   written = 0;
+
+  for (int f = 0; f < files; ++f) {
+    walRenew(pRestoreWal);
+    for (int r = 0; r < num; ++r) {
+      pHead->version = ++written;
+      pHead->len = size;
+      for (int32_t i = 0; i < size; ++i) pHead->cont[i] = restoredByte(pHead->version, i);
+      if (walWrite(pRestoreWal, pHead) != 0) {
+        printf("failed to write the wal to restore, version:%" PRId64 "\n", written);
+        exit(-1);
+      }
+    }
+  }
+
+  free(pHead);
+  walClose(pRestoreWal);
+
+  int8_t pipeline = tsWalRestorePipeline;
+  for (int p = 1; p >= 0; --p) {
+    tsWalRestorePipeline = p;
+    restoredVer = 0;
+    restoredNum = 0;
+
+    pRestoreWal = walOpen(restorePath, &walCfg);
+    if (pRestoreWal == NULL || walRestore(pRestoreWal, NULL, checkRestoredRecord) != 0) {
+      printf("failed to restore the wal, pipeline:%d\n", p);
+      exit(-1);
+    }
+
+    if (restoredNum != written || restoredVer != written || (int64_t)walGetVersion(pRestoreWal) != written) {
+      printf("wal is not fully restored, pipeline:%d records:%" PRId64 " version:%" PRId64 " expected:%" PRId64 "\n",
+             p, restoredNum, restoredVer, written);
+      exit(-1);
+    }
+
+    walClose(pRestoreWal);
+  }
+
+  tsWalRestorePipeline = pipeline;
+  taosRemoveDir(restorePath);
+  printf("%" PRId64 " records are restored in order with and without the pipeline\n", written);
+}
+
 int main(int argc, char *argv[]) {
   char path[128] = "/tmp/wal";
   int  level = 2;
@@ -43,6 +183,9 @@ int main(int argc, char *argv[]) {
   int  rows = 10000;
   int  size = 128;
   int  keep = 0;
+  int  batch = 1;
+  int  fail = 0;
+  int  restore = 0;
 
   for (int i=1; i<argc; ++i) {
     if (strcmp(argv[i], "-p")==0 && i < argc-1) {
@@ -57,6 +200,12 @@ int main(int argc, char *argv[]) {
       total = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-s")==0 && i < argc-1) {
       size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-b")==0 && i < argc-1) {
+      batch = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-f")==0) {
+      fail = 1;
+    } else if (strcmp(argv[i], "-c")==0) {
+      restore = 1;
     } else if (strcmp(argv[i], "-v")==0 && i < argc-1) {
       ver = atoll(argv[++i]);
     } else if (strcmp(argv[i], "-d")==0 && i < argc-1) {
@@ -68,6 +217,9 @@ int main(int argc, char *argv[]) {
       printf("  [-t total]: total wal files, default is:%d\n", total);
       printf("  [-r rows]: rows of records per wal file, default is:%d\n", rows);
       printf("  [-k keep]: keep the wal after closing, default is:%d\n", keep);
+      printf("  [-b batch]: records written by one walWriteBatch, 1 for walWrite, default is:%d\n", batch);
+      printf("  [-f]: fail a batch in the middle first and check it is rolled back\n");
+      printf("  [-c]: check the wal is restored in order with and without the pipeline\n");
       printf("  [-v version]: initial version, default is:%" PRId64 "\n", ver);
       printf("  [-d debugFlag]: debug flag, default:%d\n", dDebugFlag);
       printf("  [-h help]: print out this help\n\n");
@@ -79,6 +231,8 @@ int main(int argc, char *argv[]) {
   tfInit();
   walInit();
 
+  if (restore) checkRestore(path, 1024);
+
   SWalCfg walCfg = {0};
   walCfg.walLevel = level;
   walCfg.keep = keep;
@@ -96,21 +250,43 @@ int main(int argc, char *argv[]) {
   }
 
   printf("version starts from:%" PRId64 "\n", ver);
+
+  if (fail) checkBatchFailure(size);
   
-  int contLen = sizeof(SWalHead) + size;
-  SWalHead *pHead = (SWalHead *) malloc(contLen);
+  if (batch < 1) batch = 1;
+
+  int        contLen = sizeof(SWalHead) + size;
+  SWalHead **pHeads = (SWalHead **) malloc(sizeof(SWalHead *) * batch);
+  for (int b=0; b<batch; ++b) {
+    pHeads[b] = (SWalHead *) calloc(1, contLen);
+  }
+
+  int64_t st = taosGetTimestampUs();
 
   for (int i=0; i<total; ++i) {
-    for (int k=0; k<rows; ++k) {
-      pHead->version = ++ver;
-      pHead->len = size;
-      walWrite(pWal, pHead);
+    for (int k=0; k<rows; k+=batch) {
+      int num = MIN(batch, rows - k);
+      for (int b=0; b<num; ++b) {
+        pHeads[b]->version = ++ver;
+        pHeads[b]->len = size;
+      }
+
+      if (batch == 1) {
+        walWrite(pWal, pHeads[0]);
+      } else {
+        walWriteBatch(pWal, pHeads, num);
+      }
+      walFsync(pWal, false);
     }
        
     printf("renew a wal, i:%d\n", i);
     walRenew(pWal);
   }
 
+  int64_t et = taosGetTimestampUs();
+  printf("%d records are written in %.3f seconds, %.0f records/s\n", total * rows, (et - st) / 1000000.0,
+         total * rows * 1000000.0 / (et - st));
+
   printf("%d wal files are written\n", total);
 
   int64_t index = 0;